@@ -27,14 +27,10 @@ Application::Application(unsigned int width, unsigned int height) :
 	glfwSetErrorCallback(errorCallback);
 	if (glfwInit() != GLFW_TRUE)
 		throw std::runtime_error("Could not init GLFW");
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-#if !defined(__APPLE__)
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
-#else
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	// Persistent mapping & multi draw indirect, see engine::Renderer.
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#endif
 	window = glfwCreateWindow(width, height, "Renderer Engine", NULL, NULL);
 	if (window == NULL) {
 		glfwTerminate();
@@ -50,49 +46,23 @@ Application::Application(unsigned int width, unsigned int height) :
 		throw std::runtime_error("Could not init GLEW");
 	}
 #endif
-
-	
+	// Programs compile on driver threads & load from the binaries of previous runs.
+	engine::enableParallelShaderCompile();
+	programCache = std::make_unique<engine::ProgramCache>("cache/programs");
+	renderer = std::make_unique<engine::Renderer>(programCache.get());
 }
 
 Application::~Application()
 {
+	// Before the context goes away.
+	renderer.reset();
+	glfwDestroyWindow(window);
+	glfwTerminate();
 }
 
-bool Application::setModel(const engine::world::Model & model)
-{
-	return false;
-}
-
-void render(Application *app)
+void Application::setModel(std::shared_ptr<engine::world::AsyncModel> model)
 {
-	/*if (material != nullptr)
-	{
-		material->use();
-		GL::Program * p = material->getProgram();
-		if (p != nullptr && p->isValid())
-		{
-			glm::mat4 mv = p_view * p_model;
-			glm::mat4 mvp = p_projection * mv;
-			//glm::mat3 normal = glm::inverseTranspose(glm::mat3(p_model));
-
-			p->updateMatrixUniform(GL::MatrixUniform::MATRIX_MODEL, p_model);
-			p->updateMatrixUniform(GL::MatrixUniform::MATRIX_VIEW, p_view);
-			p->updateMatrixUniform(GL::MatrixUniform::MATRIX_PROJECTION, p_projection);
-			p->updateMatrixUniform(GL::MatrixUniform::MATRIX_MVP, mvp);
-		}
-		else
-			Log::warn("No valid program set");
-	}
-	if (m_vao)
-	{
-		// VAO has been created : bind VAO
-		glBindVertexArray(m_vao);
-
-		glDrawElements(GL_TRIANGLES, triangles.size() * 3, GL_UNSIGNED_INT, 0);
-
-		// Unbind all
-		glBindVertexArray(0);
-	}*/
+	this->model = model;
 }
 
 void Application::run()
@@ -112,21 +82,38 @@ void Application::run()
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK);
 
-	glEnable(GL_TEXTURE_2D);
-
 	/*glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);*/
 
-	glViewport(0, 0, width, height);
-	glScissor(0, 0, width, height);
 	glEnable(GL_SCISSOR_TEST);
 
-	engine::Camera camera;
+	// From +z looking down -z, turned so that +y is up on screen, see engine::Camera::perspective.
+	engine::RenderingSession session;
+	session.model = nullptr;
+	session.camera.transform = engine::geom::mat4::translate(engine::geom::vec3(0.f, 0.f, 5.f)) * engine::geom::mat4::rotate(engine::geom::vec3(1.f, 0.f, 0.f), engine::geom::radianf(3.14159265f));
 	do {
+		// Publish loaded assets, placeholders are drawn until then.
+		if (model != nullptr)
+			model->update();
+		// Meshes are uploaded by the renderer as they are published.
+		session.model = (model != nullptr && model->isParsed()) ? &model->model() : nullptr;
+		// World transforms of the nodes moved since the last frame, read by prepare.
+		if (session.model != nullptr)
+			model->model().hierarchy.update();
+		session.width = width;
+		session.height = height;
+		session.camera.aspectRatio = (height > 0) ? static_cast<float>(width) / height : 1.f;
+
+		glViewport(0, 0, width, height);
+		glScissor(0, 0, width, height);
 		glClearColor(0.2f, 0.2f, 0.2f, 1.f);
 		glClearDepth(1.f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		renderer->commit(session);
+		renderer->prepare(session);
+		renderer->render(session);
+		renderer->finish(session);
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
@@ -135,6 +122,9 @@ void Application::run()
 
 void Application::resize(unsigned int width, unsigned int height)
 {
+	// Applied by the next frame.
+	this->width = width;
+	this->height = height;
 }
 
 }
\ No newline at end of file
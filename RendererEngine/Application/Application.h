@@ -1,6 +1,7 @@
 #pragma once
 
-#include "../Engine/Model.h"
+#include "../Engine/ModelLoader.h"
+#include "../Engine/Renderer.h"
 
 #include "RenderThread.h"
 
@@ -23,14 +24,17 @@ public:
 	Application(unsigned int width, unsigned int height);
 	~Application();
 
-	bool setModel(const engine::world::Model &model);
+	// Model streamed in while running, parts are drawn as they are published.
+	void setModel(std::shared_ptr<engine::world::AsyncModel> model);
 	void run();
 	void resize(unsigned int width, unsigned int height);
 
 	unsigned int width, height;
-	engine::world::Model model;
+	std::shared_ptr<engine::world::AsyncModel> model;
 	RenderThread renderThread;
 	GLFWwindow *window;
+	std::unique_ptr<engine::ProgramCache> programCache;
+	std::unique_ptr<engine::Renderer> renderer; // Created with the GL context
 };
 
 }
\ No newline at end of file
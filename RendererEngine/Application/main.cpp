@@ -6,10 +6,11 @@
 int main(int argc, char * argv[])
 {
 	using namespace engine;
+	engine::job::Scheduler scheduler;
 	engine::world::ModelLoader loader;
-	engine::world::Model model = loader.loadGLTF("data/model/Cube.gltf");
 	app::Application app(800, 600);
-	//app.setModel(model);
+	// First frame does not wait for the assets.
+	app.setModel(loader.loadGLTFAsync(scheduler, "data/model/Cube.gltf"));
 	app.run();
 
 	return 0;
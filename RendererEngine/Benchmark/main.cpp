@@ -0,0 +1,309 @@
+#include "../Engine/Meshlet.h"
+#include "../Engine/ModelLoader.h"
+#include "../Engine/Package.h"
+#include "../Engine/RenderQueue.h"
+#include "../Engine/math/geometry.h"
+#include "../Framework/JobSystem.h"
+#include "../Framework/json.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <random>
+#include <vector>
+
+using namespace geometry;
+
+namespace {
+
+// Time of a call in milliseconds, averaged over the iterations.
+template <typename Function>
+double measure(unsigned int iterations, Function function)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int iIteration = 0; iIteration < iterations; iIteration++)
+		function(iIteration);
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count() / (iterations > 0 ? iterations : 1);
+}
+
+quatf randomRotation(std::mt19937 &generator)
+{
+	// Uniform rotation, from "Uniform Random Rotations", Ken Shoemake
+	std::uniform_real_distribution<float> distribution(0.f, 1.f);
+	const float u0 = distribution(generator), u1 = distribution(generator), u2 = distribution(generator);
+	const float r1 = sqrt(1.f - u0), r2 = sqrt(u0);
+	const radianf a1(6.2831853f * u1), a2(6.2831853f * u2);
+	return quatf(r1 * sin(a1), r1 * cos(a1), r2 * sin(a2), r2 * cos(a2));
+}
+
+// Sample a track of jointCount joints at every frame of its duration.
+void benchmarkJoints(size_t jointCount, size_t keyCount, unsigned int frames)
+{
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> translation(-1.f, 1.f);
+	std::vector<float> times(keyCount);
+	std::vector<quatf> keys(keyCount * jointCount);
+	std::vector<dualquatf> transforms(keyCount * jointCount);
+	for (size_t iKey = 0; iKey < keyCount; iKey++)
+	{
+		times[iKey] = static_cast<float>(iKey) / 30.f;
+		for (size_t iJoint = 0; iJoint < jointCount; iJoint++)
+		{
+			keys[iKey * jointCount + iJoint] = randomRotation(generator);
+			transforms[iKey * jointCount + iJoint] = dualquatf(keys[iKey * jointCount + iJoint], vec3f(translation(generator), translation(generator), translation(generator)));
+		}
+	}
+	const anim::RotationTrack<float> track = { times.data(), keys.data(), keyCount, jointCount };
+	const float duration = times[keyCount - 1];
+	auto frameTime = [=](unsigned int iFrame) { return duration * static_cast<float>(iFrame) / frames; };
+
+	std::vector<quatf> rotations(jointCount);
+	std::vector<dualquatf> poses(jointCount);
+	const double nlerpTime = measure(frames, [&](unsigned int iFrame) {
+		anim::sample(track, frameTime(iFrame), anim::Interpolation::NLERP, rotations.data());
+	});
+	const double slerpTime = measure(frames, [&](unsigned int iFrame) {
+		anim::sample(track, frameTime(iFrame), anim::Interpolation::SLERP, rotations.data());
+	});
+	// Reference, one trigonometric slerp per joint
+	const double scalarTime = measure(frames, [&](unsigned int iFrame) {
+		const float time = frameTime(iFrame);
+		const size_t key = anim::findKeyframe(times.data(), keyCount, time);
+		const float t = clamp((time - times[key]) / (times[key + 1] - times[key]), 0.f, 1.f);
+		for (size_t iJoint = 0; iJoint < jointCount; iJoint++)
+			rotations[iJoint] = quatf::slerp(keys[key * jointCount + iJoint], keys[(key + 1) * jointCount + iJoint], t);
+	});
+	const double sclerpTime = measure(frames, [&](unsigned int iFrame) {
+		const float time = frameTime(iFrame);
+		const size_t key = anim::findKeyframe(times.data(), keyCount, time);
+		const float t = clamp((time - times[key]) / (times[key + 1] - times[key]), 0.f, 1.f);
+		for (size_t iJoint = 0; iJoint < jointCount; iJoint++)
+			poses[iJoint] = dualquatf::sclerp(transforms[key * jointCount + iJoint], transforms[(key + 1) * jointCount + iJoint], t);
+	});
+	std::printf("Joints: %zu per frame, %zu keyframes. Rotations nlerp %.3f ms, slerp %.3f ms, scalar slerp %.3f ms. Rigid transforms sclerp %.3f ms\n",
+		jointCount, keyCount, nlerpTime, slerpTime, scalarTime, sclerpTime
+	);
+}
+
+// Mirror of the legacy sampler of ProceduralRenderer/data/shaders/noise.h
+uint32_t lcg(uint32_t &prev)
+{
+	prev = 1664525u * prev + 1013904223u;
+	return prev & 0x00FFFFFF;
+}
+
+uint32_t genFirstSeed(uint32_t v0, uint32_t v1)
+{
+	uint32_t s0 = 0;
+	for (uint32_t n = 0; n < 8; n++)
+	{
+		s0 += 0x9e3779b9;
+		v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4);
+		v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761e);
+	}
+	return v0;
+}
+
+// Error of the samplers of ProceduralRenderer/data/shaders/procedural.comp against their sample count.
+// Each pixel of a tile estimates the coverage of a quarter disc, an edge through the pixel, with its
+// own sequence. The error is the root mean square over the pixels.
+void benchmarkSamplers(uint32_t tileSize, uint32_t maxSamples)
+{
+	std::vector<float> blueNoise(tileSize * tileSize);
+	sample::blueNoise(tileSize, blueNoise.data());
+	auto coverage = [](const vec2f &p) { return (p.x * p.x + p.y * p.y < 1.f) ? 1.f : 0.f; };
+	const double reference = 3.14159265358979323846 / 4.0;
+	enum { LCG, SOBOL_OWEN, R2_BLUE_NOISE, SAMPLER_COUNT };
+	const uint32_t pixelCount = tileSize * tileSize;
+	std::vector<double> sums(pixelCount * SAMPLER_COUNT, 0.0);
+	std::printf("Samplers: RMSE of %u pixels against samples per pixel\n%8s %12s %12s %12s\n", pixelCount, "samples", "lcg", "sobol owen", "r2 blue");
+	for (uint32_t iSample = 0, nextReport = 1; iSample < maxSamples; iSample++)
+	{
+		for (uint32_t y = 0; y < tileSize; y++)
+		{
+			for (uint32_t x = 0; x < tileSize; x++)
+			{
+				const uint32_t iPixel = x + y * tileSize;
+				uint32_t seed = genFirstSeed(x, y + iSample);
+				const float u = static_cast<float>(lcg(seed)) / float(0x01000000);
+				const float v = static_cast<float>(lcg(seed)) / float(0x01000000);
+				sums[iPixel * SAMPLER_COUNT + LCG] += coverage(vec2f(u, v));
+				sums[iPixel * SAMPLER_COUNT + SOBOL_OWEN] += coverage(sample::sobolOwen<float>(iSample, sample::hash(iPixel)));
+				// Cranley Patterson rotation, the second dimension is read with a half tile offset
+				const vec2f offset = sample::r2<float>(iSample);
+				const float rx = offset.x + blueNoise[iPixel];
+				const float ry = offset.y + blueNoise[((x + tileSize / 2) % tileSize) + ((y + tileSize / 2) % tileSize) * tileSize];
+				sums[iPixel * SAMPLER_COUNT + R2_BLUE_NOISE] += coverage(vec2f(rx - floor(rx), ry - floor(ry)));
+			}
+		}
+		if (iSample + 1 != nextReport)
+			continue;
+		nextReport *= 2;
+		double error[SAMPLER_COUNT] = {};
+		for (uint32_t iPixel = 0; iPixel < pixelCount; iPixel++)
+		{
+			for (uint32_t iSampler = 0; iSampler < SAMPLER_COUNT; iSampler++)
+			{
+				const double difference = sums[iPixel * SAMPLER_COUNT + iSampler] / (iSample + 1) - reference;
+				error[iSampler] += difference * difference;
+			}
+		}
+		std::printf("%8u %12.6f %12.6f %12.6f\n", iSample + 1, std::sqrt(error[LCG] / pixelCount), std::sqrt(error[SOBOL_OWEN] / pixelCount), std::sqrt(error[R2_BLUE_NOISE] / pixelCount));
+	}
+}
+
+// Loads of the model & of its package, decoding of its images, then meshlets of each mesh
+// seen from outside its bounds, looking at its center along +z.
+void benchmarkModel(engine::job::Scheduler &scheduler, const char *modelPath, const char *packagePath)
+{
+	using namespace engine;
+	world::ModelLoader loader;
+	const world::Model model = loader.loadGLTF(modelPath);
+	pack::cook(scheduler, model, packagePath);
+	double gltfTime, packageTime;
+	pack::benchmarkPackage(scheduler, modelPath, packagePath, gltfTime, packageTime);
+	std::printf("Load: glTF %.2f ms, package %.2f ms\n", gltfTime, packageTime);
+	// Images referenced by path, embedded ones are decoded from the model buffers.
+	std::vector<std::string> imagePaths;
+	for (const world::Texture &texture : model.textures)
+		if (!texture.path.empty())
+			imagePaths.push_back(texture.path);
+	if (!imagePaths.empty())
+	{
+		double serialRate, parallelRate;
+		io::benchmarkDecode(imagePaths, 10, serialRate, parallelRate);
+		std::printf("Decode: %zu images, %.1f MP/s serial, %.1f MP/s with jobs\n", imagePaths.size(), serialRate, parallelRate);
+	}
+	for (size_t iMesh = 0; iMesh < model.meshes.size(); iMesh++)
+	{
+		const world::Mesh &mesh = model.meshes[iMesh];
+		if (mesh.indices.size() == 0)
+			continue;
+		geom::point3 minimum = mesh.positions[0], maximum = mesh.positions[0];
+		for (const geom::point3 &position : mesh.positions)
+		{
+			minimum = geom::point3(std::min(minimum.x, position.x), std::min(minimum.y, position.y), std::min(minimum.z, position.z));
+			maximum = geom::point3(std::max(maximum.x, position.x), std::max(maximum.y, position.y), std::max(maximum.z, position.z));
+		}
+		const float extent = std::max(std::max(maximum.x - minimum.x, maximum.y - minimum.y), maximum.z - minimum.z);
+		const geom::point3 camera((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, minimum.z - extent);
+		const geom::mat4 viewProjection = geom::mat4::perspective(geom::radianf(1.f), 16.f / 9.f, 0.01f * extent, 10.f * extent) *
+			geom::mat4::translate(geom::vec3(-camera.x, -camera.y, -camera.z));
+		const world::Meshlets meshlets = world::buildMeshlets(mesh);
+		Buffer<uint32_t> visible;
+		const world::MeshletCullingStatistics statistics = world::cullMeshlets(scheduler, meshlets, viewProjection, camera, visible);
+		double buildTime, serialTime, parallelTime;
+		world::benchmarkMeshlets(scheduler, mesh, viewProjection, camera, 100, buildTime, serialTime, parallelTime);
+		std::printf("Mesh %zu: %zu meshlets, %zu visible, %zu frustum culled, %zu cone culled, %zu / %zu triangles. Build %.2f ms, cull %.3f ms serial, %.3f ms with jobs\n",
+			iMesh, statistics.meshlets, statistics.visibleMeshlets, statistics.frustumCulled, statistics.coneCulled, statistics.visibleTriangles, statistics.triangles,
+			buildTime, serialTime, parallelTime
+		);
+	}
+}
+
+// glTF-like manifest of a large scene, nodes with a name, a mesh & a matrix like exported levels.
+std::string generateManifest(size_t nodeCount)
+{
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> distribution(-1000.0, 1000.0);
+	std::string str = "{\"asset\":{\"version\":\"2.0\"},\"nodes\":[";
+	char buffer[64];
+	for (size_t iNode = 0; iNode < nodeCount; iNode++)
+	{
+		std::snprintf(buffer, sizeof(buffer), "%s{\"name\":\"node%zu\",\"mesh\":%zu,\"matrix\":[", iNode > 0 ? "," : "", iNode, iNode % 64);
+		str += buffer;
+		for (unsigned int i = 0; i < 16; i++)
+		{
+			std::snprintf(buffer, sizeof(buffer), "%s%.9g", i > 0 ? "," : "", distribution(generator));
+			str += buffer;
+		}
+		str += "]}";
+	}
+	str += "]}";
+	return str;
+}
+
+// DOM parsing of a generated manifest, then structural indexing of it minified & pretty printed.
+void benchmarkJSON(size_t nodeCount)
+{
+	const std::string minified = generateManifest(nodeCount);
+	std::string pretty;
+	{
+		json::Parser parser;
+		const json::JSON document = parser(minified);
+		json::Writer writer(pretty);
+		json::Serializer serializer(true);
+		serializer(document, writer);
+	}
+	std::printf("JSON: %.1f MB manifest of %zu nodes, %.1f MB pretty printed. Parse %.1f MB/s. Structural index %.2f GB/s minified, %.2f GB/s pretty\n",
+		minified.size() / (1024.0 * 1024.0), nodeCount, pretty.size() / (1024.0 * 1024.0), benchmarkParse(minified, 5),
+		benchmarkStructuralIndex(minified, 10), benchmarkStructuralIndex(pretty, 10)
+	);
+}
+
+// Round trip of random doubles through the json writer & parser, throwing on the first mismatch,
+// then their conversion throughputs.
+void benchmarkDoubles(unsigned int count)
+{
+	testNumbers(count);
+	double parsed, written;
+	benchmarkNumbers(count, parsed, written);
+	std::printf("Numbers: %u doubles round tripped. Parse %.1f M/s, write %.1f M/s\n", count, parsed, written);
+}
+
+// Loads of a generated grid from .gltf + .bin & from .glb, written in the working directory.
+void benchmarkGrid(size_t triangles)
+{
+	double gltfTime, glbTime;
+	engine::world::benchmarkGLB("", triangles, gltfTime, glbTime);
+	std::printf("Grid of %zu triangles: load .gltf + .bin %.2f ms, .glb %.2f ms\n", triangles, gltfTime, glbTime);
+}
+
+// Render queue of random draws, independent of any model.
+void benchmarkQueue(engine::job::Scheduler &scheduler, size_t drawCount)
+{
+	const engine::RenderQueueBenchmark queue = engine::benchmarkRenderQueue(scheduler, drawCount, 20);
+	std::printf("Render queue of %zu draws: state changes %zu passes, %zu programs, %zu materials, %zu meshes unsorted, %zu, %zu, %zu, %zu sorted. Build & sort %.2f ms serial, %.2f ms with jobs, submit %.2f ms unsorted, %.2f ms sorted\n",
+		drawCount,
+		queue.unsorted.passes, queue.unsorted.programs, queue.unsorted.materials, queue.unsorted.meshes,
+		queue.sorted.passes, queue.sorted.programs, queue.sorted.materials, queue.sorted.meshes,
+		queue.serialTime, queue.parallelTime, queue.unsortedSubmitTime, queue.sortedSubmitTime
+	);
+}
+
+}
+
+// Microbenchmarks of the engine, timings are averaged per frame or per iteration.
+// Usage: Benchmark [input.gltf|input.glb package.pak]
+// A generated grid is written as benchmark.gltf, .bin & .glb in the working directory to compare their loads.
+// The model, if any, is cooked into the package to compare their loads, its images decoded, then its meshes are split in meshlets & culled.
+int main(int argc, char * argv[])
+{
+	if (argc != 1 && argc != 3)
+	{
+		std::fprintf(stderr, "Usage: %s [input.gltf|input.glb package.pak]\n", argv[0]);
+		return 1;
+	}
+	try
+	{
+		engine::job::Scheduler scheduler;
+		benchmarkJoints(100000, 31, 60);
+		benchmarkSamplers(64, 1024);
+		benchmarkQueue(scheduler, 100000);
+		benchmarkJSON(100000);
+		benchmarkDoubles(1000000);
+		benchmarkGrid(1000000);
+		if (argc == 3)
+			benchmarkModel(scheduler, argv[1], argv[2]);
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
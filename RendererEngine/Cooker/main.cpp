@@ -0,0 +1,179 @@
+#include "../Engine/MeshOptimizer.h"
+#include "../Engine/MeshSimplifier.h"
+#include "../Engine/ModelLoader.h"
+#include "../Engine/Package.h"
+#include "../Framework/JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+// Cook a glTF model & its images into a package loaded without parsing.
+// Usage: Cooker [--uncompressed] [--full-precision] [--no-optimize] [--lod] input.gltf|input.glb output.pak
+// --uncompressed keeps RGBA8 textures, --full-precision keeps float vertices, --lod adds levels of detail to every mesh.
+int main(int argc, char * argv[])
+{
+	using namespace engine;
+	pack::CookOptions options;
+	bool optimize = true;
+	bool lod = false;
+	const char *paths[2] = { nullptr, nullptr };
+	unsigned int pathCount = 0;
+	for (int iArg = 1; iArg < argc; iArg++)
+	{
+		if (std::strcmp(argv[iArg], "--uncompressed") == 0)
+			options.compressTextures = false;
+		else if (std::strcmp(argv[iArg], "--full-precision") == 0)
+			options.vertexFormat = pack::VertexFormat::uncompressed();
+		else if (std::strcmp(argv[iArg], "--no-optimize") == 0)
+			optimize = false;
+		else if (std::strcmp(argv[iArg], "--lod") == 0)
+			lod = true;
+		else if (pathCount < 2)
+			paths[pathCount++] = argv[iArg];
+		else
+			pathCount = 3;
+	}
+	if (pathCount != 2)
+	{
+		std::fprintf(stderr, "Usage: %s [--uncompressed] [--full-precision] [--no-optimize] [--lod] input.gltf|input.glb output.pak\n", argv[0]);
+		return 1;
+	}
+	try
+	{
+		job::Scheduler scheduler;
+		auto start = std::chrono::high_resolution_clock::now();
+		world::ModelLoader loader;
+		world::Model model = loader.loadGLTF(paths[0]);
+		if (optimize)
+		{
+			// Simulated caches: 16 entries post-transform, 64 lines of 64 bytes for fetches.
+			world::VertexCacheStatistics cacheBefore = {}, cacheAfter = {};
+			world::VertexFetchStatistics fetchBefore = {}, fetchAfter = {};
+			size_t triangleCount = 0, verticesBefore = 0, verticesAfter = 0, bytesBefore = 0, bytesAfter = 0;
+			auto accumulate = [&options](const world::Mesh &mesh, world::VertexCacheStatistics &cache, world::VertexFetchStatistics &fetch, size_t &vertexCount, size_t &vertexBytes) {
+				const size_t stride = pack::VertexLayout(options.vertexFormat.fit(mesh)).stride;
+				const world::VertexCacheStatistics meshCache = world::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.positions.size());
+				const world::VertexFetchStatistics meshFetch = world::analyzeVertexFetch(mesh.indices.data(), mesh.indices.size(), mesh.positions.size(), stride);
+				cache.transforms += meshCache.transforms;
+				fetch.bytesFetched += meshFetch.bytesFetched;
+				vertexCount += mesh.positions.size();
+				vertexBytes += mesh.positions.size() * stride;
+			};
+			for (world::Mesh &mesh : model.meshes)
+			{
+				accumulate(mesh, cacheBefore, fetchBefore, verticesBefore, bytesBefore);
+				world::optimize(mesh);
+				accumulate(mesh, cacheAfter, fetchAfter, verticesAfter, bytesAfter);
+				triangleCount += mesh.indices.size() / 3;
+			}
+			auto ratio = [](size_t lhs, size_t rhs) { return (rhs > 0) ? static_cast<double>(lhs) / rhs : 0.0; };
+			std::printf("Optimized %zu triangles, %zu -> %zu vertices: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overfetch %.3f -> %.3f\n",
+				triangleCount, verticesBefore, verticesAfter,
+				ratio(cacheBefore.transforms, triangleCount), ratio(cacheAfter.transforms, triangleCount),
+				ratio(cacheBefore.transforms, verticesBefore), ratio(cacheAfter.transforms, verticesAfter),
+				ratio(fetchBefore.bytesFetched, bytesBefore), ratio(fetchAfter.bytesFetched, bytesAfter)
+			);
+		}
+		if (lod)
+		{
+			world::generateLods(scheduler, model);
+			// Totals of every mesh, level by level. Meshes with fewer levels are counted at their coarsest.
+			size_t levelCount = 0;
+			for (const world::Mesh &mesh : model.meshes)
+				levelCount = std::max(levelCount, mesh.lods.levels.size());
+			for (size_t iLevel = 0; iLevel <= levelCount; iLevel++)
+			{
+				size_t triangleCount = 0;
+				float error = 0.f;
+				for (const world::Mesh &mesh : model.meshes)
+				{
+					const size_t meshLevel = std::min(iLevel, mesh.lods.levels.size());
+					if (meshLevel == 0)
+					{
+						triangleCount += mesh.indices.size() / 3;
+					}
+					else
+					{
+						const world::Lod &level = mesh.lods.levels[meshLevel - 1];
+						triangleCount += level.indices.size() / 3;
+						error = std::max(error, (mesh.lods.radius > 0.f) ? level.error / mesh.lods.radius : 0.f);
+					}
+				}
+				std::printf("Lod %zu: %zu triangles, error %g of the mesh radius\n", iLevel, triangleCount, error);
+			}
+		}
+		pack::cook(scheduler, model, paths[1], options);
+		auto end = std::chrono::high_resolution_clock::now();
+		const pack::Package package(paths[1]);
+		std::printf("Cooked %s into %s: %u meshes, %u textures, %u materials, %u nodes, %zu bytes in %.1f ms\n",
+			paths[0], paths[1],
+			package.header().meshCount, package.header().textureCount, package.header().materialCount, package.header().nodeCount,
+			package.size(), std::chrono::duration<double, std::milli>(end - start).count()
+		);
+		{
+			// Check the decoded vertices against the bounds of their format.
+			size_t fullBytes = 0, cookedBytes = 0;
+			pack::VertexError measured = {}, bound = {};
+			bool withinBounds = true;
+			for (uint32_t iMesh = 0; iMesh < package.header().meshCount; iMesh++)
+			{
+				const pack::MeshEntry &entry = package.mesh(iMesh);
+				Buffer<pack::Vertex> vertices(model.meshes[iMesh].positions.size());
+				pack::interleave(model.meshes[iMesh], vertices.data());
+				const pack::VertexError meshMeasured = pack::measureVertexError(vertices.data(), vertices.size(), entry.format);
+				const pack::VertexError meshBound = pack::maxVertexError(entry.format, entry.bounds);
+				withinBounds = withinBounds && meshMeasured.position <= meshBound.position && meshMeasured.normal <= meshBound.normal &&
+					meshMeasured.texcoord <= meshBound.texcoord && meshMeasured.color <= meshBound.color;
+				measured.position = std::max(measured.position, meshMeasured.position);
+				measured.normal = std::max(measured.normal, meshMeasured.normal);
+				measured.texcoord = std::max(measured.texcoord, meshMeasured.texcoord);
+				bound.position = std::max(bound.position, meshBound.position);
+				bound.normal = std::max(bound.normal, meshBound.normal);
+				bound.texcoord = std::max(bound.texcoord, meshBound.texcoord);
+				fullBytes += vertices.size() * sizeof(pack::Vertex);
+				cookedBytes += static_cast<size_t>(entry.vertexCount) * entry.stride;
+			}
+			std::printf("Vertices: %zu -> %zu bytes, error position %g (max %g), normal %g rad (max %g), texcoord %g (max %g)\n",
+				fullBytes, cookedBytes, measured.position, bound.position, measured.normal, bound.normal, measured.texcoord, bound.texcoord
+			);
+			if (!withinBounds)
+				throw std::runtime_error("Vertex error out of the format bounds");
+		}
+		{
+			// Check the cooked textures against the header of their source, a file or bytes embedded in the model.
+			size_t embedded = 0;
+			for (uint32_t iTexture = 0; iTexture < package.header().textureCount; iTexture++)
+			{
+				const world::Texture &texture = model.textures[iTexture];
+				io::Image::Info info;
+				if (texture.path.empty())
+				{
+					info = io::Image::info(texture.encoded.data(), texture.encoded.size());
+					embedded++;
+				}
+				else
+				{
+					const io::MappedFile file(texture.path.c_str());
+					if (!file.isOpen())
+						throw std::runtime_error("Could not open " + texture.path);
+					info = io::Image::info(file.data(), file.size());
+				}
+				const pack::TextureEntry &entry = package.texture(iTexture);
+				if (entry.width != info.width || entry.height != info.height)
+					throw std::runtime_error("Texture " + std::to_string(iTexture) + " size differs from its source image");
+			}
+			std::printf("Textures: %u checked against their source, %zu embedded\n", package.header().textureCount, embedded);
+		}
+	}
+	catch (const std::exception &e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -1,18 +1,38 @@
 #include "Camera.h"
 
+#include <algorithm>
+#include <cmath>
+
 
 namespace engine {
 
-Camera::Camera()
+Camera::Camera() :
+	pnear(0.1f),
+	pfar(1000.f),
+	fov(1.0471975f),
+	aspectRatio(16.f / 9.f),
+	transform(geom::mat4::identity())
 {
 }
-geom::mat4 Camera::perspective()
+geom::mat4 Camera::perspective() const
 {
-	return geom::mat4();
+	return geom::mat4::perspective(geom::radianf(fov), aspectRatio, pnear, pfar);
 }
 geom::mat4 Camera::orthographic()
 {
 	return geom::mat4();
 }
+geom::mat4 Camera::view() const
+{
+	return geom::mat4::inverse(transform);
+}
+geom::point3 Camera::position() const
+{
+	return geom::point3(transform[3][0], transform[3][1], transform[3][2]);
+}
+float Camera::pixelsPerUnit(float distance, float viewportHeight) const
+{
+	return viewportHeight / (2.f * std::tan(fov * 0.5f) * std::max(distance, pnear));
+}
 
 }
\ No newline at end of file
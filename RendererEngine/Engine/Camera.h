@@ -8,14 +8,22 @@ struct Camera
 	Camera();
 
 	float pnear, pfar;		// Near and far of the camera
-	float fov;				// Field of view of the camera
+	float fov;				// Vertical field of view of the camera, in radians
 	float aspectRatio;		// Aspect ratio of the camera
 	geom::mat4 transform;	// Transform of the camera
 
-	// Compute perspective projection matrix
-	geom::mat4 perspective();
+	// Compute perspective projection matrix, the camera looks down +z with +y down on screen
+	geom::mat4 perspective() const;
 	// Compute orthographic projection matrix
 	geom::mat4 orthographic();
+	// Compute view matrix, the inverse of the transform
+	geom::mat4 view() const;
+
+	// Position of the camera in the world
+	geom::point3 position() const;
+	// Pixels covered by a unit length seen at the distance, for a viewport of the height in pixels.
+	// Distances under the near plane count as the near plane.
+	float pixelsPerUnit(float distance, float viewportHeight) const;
 };
 
 }
\ No newline at end of file
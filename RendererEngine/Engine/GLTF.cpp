@@ -0,0 +1,561 @@
+#include "GLTF.h"
+
+#include "../Framework/json.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace engine {
+namespace world {
+namespace gltf {
+
+// Keys of the properties read, anything else is skipped.
+enum class Key {
+	NONE,
+	// Root
+	ACCESSORS,
+	BUFFERS,
+	BUFFER_VIEWS,
+	IMAGES,
+	TEXTURES,
+	MATERIALS,
+	MESHES,
+	NODES,
+	// Accessor
+	BUFFER_VIEW,
+	BYTE_OFFSET,
+	COMPONENT_TYPE,
+	NORMALIZED,
+	COUNT,
+	TYPE,
+	MIN,
+	MAX,
+	// BufferView
+	BUFFER,
+	BYTE_LENGTH,
+	BYTE_STRIDE,
+	TARGET,
+	// Buffer & Image
+	URI,
+	MIME_TYPE,
+	// Texture
+	SOURCE,
+	SAMPLER,
+	// Material
+	PBR_METALLIC_ROUGHNESS,
+	NORMAL_TEXTURE,
+	BASE_COLOR_FACTOR,
+	BASE_COLOR_TEXTURE,
+	METALLIC_FACTOR,
+	ROUGHNESS_FACTOR,
+	METALLIC_ROUGHNESS_TEXTURE,
+	INDEX,
+	TEX_COORD,
+	// Mesh
+	PRIMITIVES,
+	ATTRIBUTES,
+	INDICES,
+	MATERIAL,
+	MODE,
+	// Node
+	MESH,
+	CHILDREN,
+	MATRIX,
+	TRANSLATION,
+	ROTATION,
+	SCALE,
+};
+
+// Position in the document
+enum class Scope {
+	ROOT,
+	ACCESSORS,
+	ACCESSOR,
+	BUFFERS,
+	BUFFER,
+	BUFFER_VIEWS,
+	BUFFER_VIEW,
+	IMAGES,
+	IMAGE,
+	TEXTURES,
+	TEXTURE,
+	MATERIALS,
+	MATERIAL,
+	PBR,
+	TEXTURE_INFO,
+	MESHES,
+	MESH,
+	PRIMITIVES,
+	PRIMITIVE,
+	ATTRIBUTES,
+	NODES,
+	NODE,
+	VALUES, // Array of numbers
+};
+
+struct Handler : json::Handler
+{
+	Handler(Document &document) : document(document), property(Key::NONE), attribute(Attribute::NB_ATTRIBUTE), textureInfo(nullptr), valueIndex(0) {}
+
+	bool number(double value);
+	bool integer(int64_t value) { return number(static_cast<double>(value)); }
+	bool string(std::string_view value);
+	bool boolean(bool value);
+	bool startObject();
+	json::Action key(std::string_view name);
+	bool endObject();
+	bool startArray();
+	bool endArray();
+
+	Document &document;
+	std::vector<Scope> scopes;
+	Key property; // Last key read
+	Attribute attribute;
+	TextureInfo *textureInfo; // Texture of the material being read
+	size_t valueIndex;
+};
+
+static Key lookup(Scope scope, std::string_view name)
+{
+	switch (scope)
+	{
+	case Scope::ROOT:
+		if (name == "accessors") return Key::ACCESSORS;
+		if (name == "buffers") return Key::BUFFERS;
+		if (name == "bufferViews") return Key::BUFFER_VIEWS;
+		if (name == "images") return Key::IMAGES;
+		if (name == "textures") return Key::TEXTURES;
+		if (name == "materials") return Key::MATERIALS;
+		if (name == "meshes") return Key::MESHES;
+		if (name == "nodes") return Key::NODES;
+		break;
+	case Scope::ACCESSOR:
+		if (name == "bufferView") return Key::BUFFER_VIEW;
+		if (name == "byteOffset") return Key::BYTE_OFFSET;
+		if (name == "componentType") return Key::COMPONENT_TYPE;
+		if (name == "normalized") return Key::NORMALIZED;
+		if (name == "count") return Key::COUNT;
+		if (name == "type") return Key::TYPE;
+		if (name == "min") return Key::MIN;
+		if (name == "max") return Key::MAX;
+		break;
+	case Scope::BUFFER:
+		if (name == "uri") return Key::URI;
+		if (name == "byteLength") return Key::BYTE_LENGTH;
+		break;
+	case Scope::IMAGE:
+		if (name == "uri") return Key::URI;
+		if (name == "mimeType") return Key::MIME_TYPE;
+		if (name == "bufferView") return Key::BUFFER_VIEW;
+		break;
+	case Scope::TEXTURE:
+		if (name == "source") return Key::SOURCE;
+		if (name == "sampler") return Key::SAMPLER;
+		break;
+	case Scope::MATERIAL:
+		if (name == "pbrMetallicRoughness") return Key::PBR_METALLIC_ROUGHNESS;
+		if (name == "normalTexture") return Key::NORMAL_TEXTURE;
+		break;
+	case Scope::PBR:
+		if (name == "baseColorFactor") return Key::BASE_COLOR_FACTOR;
+		if (name == "baseColorTexture") return Key::BASE_COLOR_TEXTURE;
+		if (name == "metallicFactor") return Key::METALLIC_FACTOR;
+		if (name == "roughnessFactor") return Key::ROUGHNESS_FACTOR;
+		if (name == "metallicRoughnessTexture") return Key::METALLIC_ROUGHNESS_TEXTURE;
+		break;
+	case Scope::TEXTURE_INFO:
+		if (name == "index") return Key::INDEX;
+		if (name == "texCoord") return Key::TEX_COORD;
+		break;
+	case Scope::BUFFER_VIEW:
+		if (name == "buffer") return Key::BUFFER;
+		if (name == "byteOffset") return Key::BYTE_OFFSET;
+		if (name == "byteLength") return Key::BYTE_LENGTH;
+		if (name == "byteStride") return Key::BYTE_STRIDE;
+		if (name == "target") return Key::TARGET;
+		break;
+	case Scope::MESH:
+		if (name == "primitives") return Key::PRIMITIVES;
+		break;
+	case Scope::PRIMITIVE:
+		if (name == "attributes") return Key::ATTRIBUTES;
+		if (name == "indices") return Key::INDICES;
+		if (name == "material") return Key::MATERIAL;
+		if (name == "mode") return Key::MODE;
+		break;
+	case Scope::NODE:
+		if (name == "mesh") return Key::MESH;
+		if (name == "children") return Key::CHILDREN;
+		if (name == "matrix") return Key::MATRIX;
+		if (name == "translation") return Key::TRANSLATION;
+		if (name == "rotation") return Key::ROTATION;
+		if (name == "scale") return Key::SCALE;
+		break;
+	default:
+		break;
+	}
+	return Key::NONE;
+}
+
+static Attribute lookupAttribute(std::string_view name)
+{
+	if (name == "POSITION") return Attribute::POSITION;
+	if (name == "NORMAL") return Attribute::NORMAL;
+	if (name == "TANGENT") return Attribute::TANGENT;
+	if (name == "TEXCOORD_0") return Attribute::TEXCOORD_0;
+	if (name == "TEXCOORD_1") return Attribute::TEXCOORD_1;
+	if (name == "COLOR_0") return Attribute::COLOR_0;
+	if (name == "JOINTS_0") return Attribute::JOINTS_0;
+	if (name == "WEIGHTS_0") return Attribute::WEIGHTS_0;
+	return Attribute::NB_ATTRIBUTE;
+}
+
+json::Action Handler::key(std::string_view name)
+{
+	const Scope scope = scopes.back();
+	if (scope == Scope::ATTRIBUTES)
+	{
+		attribute = lookupAttribute(name);
+		return (attribute == Attribute::NB_ATTRIBUTE) ? json::Action::eSKIP : json::Action::ePARSE;
+	}
+	property = lookup(scope, name);
+	return (property == Key::NONE) ? json::Action::eSKIP : json::Action::ePARSE;
+}
+
+bool Handler::startObject()
+{
+	if (scopes.empty())
+	{
+		scopes.push_back(Scope::ROOT);
+		return true;
+	}
+	switch (scopes.back())
+	{
+	case Scope::ACCESSORS:
+		document.accessors.emplace_back();
+		scopes.push_back(Scope::ACCESSOR);
+		return true;
+	case Scope::BUFFERS:
+		document.buffers.emplace_back();
+		scopes.push_back(Scope::BUFFER);
+		return true;
+	case Scope::BUFFER_VIEWS:
+		document.bufferViews.emplace_back();
+		scopes.push_back(Scope::BUFFER_VIEW);
+		return true;
+	case Scope::IMAGES:
+		document.images.emplace_back();
+		scopes.push_back(Scope::IMAGE);
+		return true;
+	case Scope::TEXTURES:
+		document.textures.emplace_back();
+		scopes.push_back(Scope::TEXTURE);
+		return true;
+	case Scope::MATERIALS:
+		document.materials.emplace_back();
+		scopes.push_back(Scope::MATERIAL);
+		return true;
+	case Scope::MATERIAL:
+		if (property == Key::PBR_METALLIC_ROUGHNESS)
+		{
+			scopes.push_back(Scope::PBR);
+			return true;
+		}
+		if (property != Key::NORMAL_TEXTURE)
+			return false;
+		textureInfo = &document.materials.back().normalTexture;
+		scopes.push_back(Scope::TEXTURE_INFO);
+		return true;
+	case Scope::PBR:
+		if (property == Key::BASE_COLOR_TEXTURE)
+			textureInfo = &document.materials.back().baseColorTexture;
+		else if (property == Key::METALLIC_ROUGHNESS_TEXTURE)
+			textureInfo = &document.materials.back().metallicRoughnessTexture;
+		else
+			return false;
+		scopes.push_back(Scope::TEXTURE_INFO);
+		return true;
+	case Scope::MESHES:
+		document.meshes.emplace_back();
+		scopes.push_back(Scope::MESH);
+		return true;
+	case Scope::PRIMITIVES:
+		document.meshes.back().primitives.emplace_back();
+		scopes.push_back(Scope::PRIMITIVE);
+		return true;
+	case Scope::PRIMITIVE:
+		if (property != Key::ATTRIBUTES)
+			return false;
+		scopes.push_back(Scope::ATTRIBUTES);
+		return true;
+	case Scope::NODES:
+		document.nodes.emplace_back();
+		scopes.push_back(Scope::NODE);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool Handler::endObject()
+{
+	scopes.pop_back();
+	return true;
+}
+
+bool Handler::startArray()
+{
+	if (scopes.empty())
+		return false;
+	switch (scopes.back())
+	{
+	case Scope::ROOT:
+		switch (property)
+		{
+		case Key::ACCESSORS: scopes.push_back(Scope::ACCESSORS); return true;
+		case Key::BUFFERS: scopes.push_back(Scope::BUFFERS); return true;
+		case Key::BUFFER_VIEWS: scopes.push_back(Scope::BUFFER_VIEWS); return true;
+		case Key::IMAGES: scopes.push_back(Scope::IMAGES); return true;
+		case Key::TEXTURES: scopes.push_back(Scope::TEXTURES); return true;
+		case Key::MATERIALS: scopes.push_back(Scope::MATERIALS); return true;
+		case Key::MESHES: scopes.push_back(Scope::MESHES); return true;
+		case Key::NODES: scopes.push_back(Scope::NODES); return true;
+		default: return false;
+		}
+	case Scope::MESH:
+		if (property != Key::PRIMITIVES)
+			return false;
+		scopes.push_back(Scope::PRIMITIVES);
+		return true;
+	case Scope::ACCESSOR:
+	case Scope::PBR:
+	case Scope::NODE:
+		valueIndex = 0;
+		scopes.push_back(Scope::VALUES);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool Handler::endArray()
+{
+	scopes.pop_back();
+	return true;
+}
+
+static bool write(float *values, size_t count, size_t &index, double value)
+{
+	if (index >= count)
+		return false;
+	values[index++] = static_cast<float>(value);
+	return true;
+}
+
+bool Handler::number(double value)
+{
+	switch (scopes.back())
+	{
+	case Scope::ACCESSOR: {
+		Accessor &accessor = document.accessors.back();
+		switch (property)
+		{
+		case Key::BUFFER_VIEW: accessor.bufferView = static_cast<int>(value); return true;
+		case Key::BYTE_OFFSET: accessor.byteOffset = static_cast<size_t>(value); return true;
+		case Key::COMPONENT_TYPE: accessor.componentType = static_cast<ComponentType>(static_cast<int>(value)); return true;
+		case Key::COUNT: accessor.count = static_cast<size_t>(value); return true;
+		default: return false;
+		}
+	}
+	case Scope::BUFFER_VIEW: {
+		BufferView &bufferView = document.bufferViews.back();
+		switch (property)
+		{
+		case Key::BUFFER: bufferView.buffer = static_cast<int>(value); return true;
+		case Key::BYTE_OFFSET: bufferView.byteOffset = static_cast<size_t>(value); return true;
+		case Key::BYTE_LENGTH: bufferView.byteLength = static_cast<size_t>(value); return true;
+		case Key::BYTE_STRIDE: bufferView.byteStride = static_cast<size_t>(value); return true;
+		case Key::TARGET: bufferView.target = static_cast<int>(value); return true;
+		default: return false;
+		}
+	}
+	case Scope::BUFFER:
+		if (property != Key::BYTE_LENGTH)
+			return false;
+		document.buffers.back().byteLength = static_cast<size_t>(value);
+		return true;
+	case Scope::IMAGE:
+		if (property != Key::BUFFER_VIEW)
+			return false;
+		document.images.back().bufferView = static_cast<int>(value);
+		return true;
+	case Scope::TEXTURE: {
+		Texture &texture = document.textures.back();
+		switch (property)
+		{
+		case Key::SOURCE: texture.source = static_cast<int>(value); return true;
+		case Key::SAMPLER: texture.sampler = static_cast<int>(value); return true;
+		default: return false;
+		}
+	}
+	case Scope::PBR: {
+		Material &material = document.materials.back();
+		switch (property)
+		{
+		case Key::METALLIC_FACTOR: material.metallicFactor = static_cast<float>(value); return true;
+		case Key::ROUGHNESS_FACTOR: material.roughnessFactor = static_cast<float>(value); return true;
+		default: return false;
+		}
+	}
+	case Scope::TEXTURE_INFO:
+		switch (property)
+		{
+		case Key::INDEX: textureInfo->index = static_cast<int>(value); return true;
+		case Key::TEX_COORD: textureInfo->texCoord = static_cast<int>(value); return true;
+		default: return false;
+		}
+	case Scope::PRIMITIVE: {
+		Primitive &primitive = document.meshes.back().primitives.back();
+		switch (property)
+		{
+		case Key::INDICES: primitive.indices = static_cast<int>(value); return true;
+		case Key::MATERIAL: primitive.material = static_cast<int>(value); return true;
+		case Key::MODE: primitive.mode = static_cast<int>(value); return true;
+		default: return false;
+		}
+	}
+	case Scope::ATTRIBUTES:
+		document.meshes.back().primitives.back().attributes[static_cast<unsigned int>(attribute)] = static_cast<int>(value);
+		return true;
+	case Scope::NODE:
+		if (property != Key::MESH)
+			return false;
+		document.nodes.back().mesh = static_cast<int>(value);
+		return true;
+	case Scope::VALUES: {
+		const Scope parent = scopes[scopes.size() - 2];
+		if (parent == Scope::ACCESSOR)
+		{
+			Accessor &accessor = document.accessors.back();
+			return write((property == Key::MIN) ? accessor.min : accessor.max, 16, valueIndex, value);
+		}
+		if (parent == Scope::PBR)
+			return write(document.materials.back().baseColorFactor, 4, valueIndex, value);
+		Node &node = document.nodes.back();
+		switch (property)
+		{
+		case Key::CHILDREN: node.children.push_back(static_cast<int>(value)); return true;
+		case Key::MATRIX: node.hasMatrix = true; return write(node.matrix, 16, valueIndex, value);
+		case Key::TRANSLATION: return write(node.translation, 3, valueIndex, value);
+		case Key::ROTATION: return write(node.rotation, 4, valueIndex, value);
+		case Key::SCALE: return write(node.scale, 3, valueIndex, value);
+		default: return false;
+		}
+	}
+	default:
+		return false;
+	}
+}
+
+bool Handler::string(std::string_view value)
+{
+	if (scopes.back() == Scope::BUFFER && property == Key::URI)
+	{
+		document.buffers.back().uri = value;
+		return true;
+	}
+	if (scopes.back() == Scope::IMAGE && (property == Key::URI || property == Key::MIME_TYPE))
+	{
+		Image &image = document.images.back();
+		(property == Key::URI ? image.uri : image.mimeType) = value;
+		return true;
+	}
+	if (scopes.back() != Scope::ACCESSOR || property != Key::TYPE)
+		return false;
+	AccessorType &type = document.accessors.back().type;
+	if (value == "SCALAR") type = AccessorType::SCALAR;
+	else if (value == "VEC2") type = AccessorType::VEC2;
+	else if (value == "VEC3") type = AccessorType::VEC3;
+	else if (value == "VEC4") type = AccessorType::VEC4;
+	else if (value == "MAT2") type = AccessorType::MAT2;
+	else if (value == "MAT3") type = AccessorType::MAT3;
+	else if (value == "MAT4") type = AccessorType::MAT4;
+	else return false;
+	return true;
+}
+
+bool Handler::boolean(bool value)
+{
+	if (scopes.back() != Scope::ACCESSOR || property != Key::NORMALIZED)
+		return false;
+	document.accessors.back().normalized = value;
+	return true;
+}
+
+static uint32_t readUint32(const unsigned char *bytes)
+{
+	// Little endian
+	return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+		(static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+static const uint32_t magic = 0x46546C67; // glTF
+static const uint32_t chunkJSON = 0x4E4F534A;
+static const uint32_t chunkBIN = 0x004E4942;
+
+bool isBinary(const unsigned char *bytes, size_t size)
+{
+	return size >= 4 && readUint32(bytes) == magic;
+}
+
+Container split(const unsigned char *bytes, size_t size)
+{
+	// Header: magic, version, length. Chunks: length, type, data padded to 4 bytes.
+	if (size < 12 || readUint32(bytes) != magic)
+		throw std::runtime_error("Invalid GLB header");
+	if (readUint32(bytes + 4) != 2)
+		throw std::runtime_error("Unsupported GLB version");
+	const size_t length = readUint32(bytes + 8);
+	if (length > size)
+		throw std::runtime_error("Truncated GLB file");
+	Container container;
+	size_t offset = 12;
+	bool first = true;
+	while (offset + 8 <= length)
+	{
+		const size_t chunkLength = readUint32(bytes + offset);
+		const uint32_t chunkType = readUint32(bytes + offset + 4);
+		offset += 8;
+		if (chunkLength > length - offset)
+			throw std::runtime_error("Truncated GLB chunk");
+		if (first && chunkType != chunkJSON)
+			throw std::runtime_error("GLB must start with a JSON chunk");
+		if (chunkType == chunkJSON && first)
+			container.json = std::string_view(reinterpret_cast<const char*>(bytes + offset), chunkLength);
+		else if (chunkType == chunkBIN && container.binary == nullptr)
+		{
+			container.binary = bytes + offset;
+			container.binarySize = chunkLength;
+		}
+		// Unknown chunks are ignored
+		offset += (chunkLength + 3) & ~size_t(3);
+		first = false;
+	}
+	if (first)
+		throw std::runtime_error("GLB without JSON chunk");
+	return container;
+}
+
+Document parse(std::string_view json)
+{
+	Document document;
+	Handler handler(document);
+	json::SaxParser<Handler> parser(handler);
+	if (!parser(json))
+		throw json::InvalidValue("Invalid glTF document");
+	return document;
+}
+
+}
+}
+}
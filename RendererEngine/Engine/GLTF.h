@@ -0,0 +1,143 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace engine {
+namespace world {
+namespace gltf {
+
+static const int invalid = -1;
+
+enum class ComponentType {
+	BYTE = 5120,
+	UNSIGNED_BYTE = 5121,
+	SHORT = 5122,
+	UNSIGNED_SHORT = 5123,
+	UNSIGNED_INT = 5125,
+	FLOAT = 5126,
+};
+
+enum class AccessorType {
+	SCALAR,
+	VEC2,
+	VEC3,
+	VEC4,
+	MAT2,
+	MAT3,
+	MAT4,
+};
+
+enum class Attribute {
+	POSITION,
+	NORMAL,
+	TANGENT,
+	TEXCOORD_0,
+	TEXCOORD_1,
+	COLOR_0,
+	JOINTS_0,
+	WEIGHTS_0,
+	NB_ATTRIBUTE
+};
+
+struct Accessor {
+	int bufferView = invalid;
+	size_t byteOffset = 0;
+	ComponentType componentType = ComponentType::FLOAT;
+	bool normalized = false;
+	size_t count = 0;
+	AccessorType type = AccessorType::SCALAR;
+	float min[16] = {};
+	float max[16] = {};
+};
+
+struct Buffer {
+	std::string uri; // External file or base64 data uri, empty for the GLB binary chunk
+	size_t byteLength = 0;
+};
+
+struct BufferView {
+	int buffer = invalid;
+	size_t byteOffset = 0;
+	size_t byteLength = 0;
+	size_t byteStride = 0;
+	int target = 0;
+};
+
+struct Primitive {
+	int attributes[static_cast<unsigned int>(Attribute::NB_ATTRIBUTE)] = { invalid, invalid, invalid, invalid, invalid, invalid, invalid, invalid };
+	int indices = invalid;
+	int material = invalid;
+	int mode = 4; // TRIANGLES
+};
+
+struct Mesh {
+	std::vector<Primitive> primitives;
+};
+
+struct Image {
+	std::string uri;
+	std::string mimeType;
+	int bufferView = invalid;
+};
+
+struct Texture {
+	int source = invalid;
+	int sampler = invalid;
+};
+
+struct TextureInfo {
+	int index = invalid;
+	int texCoord = 0; // TEXCOORD_n attribute used
+};
+
+struct Material {
+	float baseColorFactor[4] = { 1, 1, 1, 1 };
+	float metallicFactor = 1;
+	float roughnessFactor = 1;
+	TextureInfo baseColorTexture;
+	TextureInfo metallicRoughnessTexture;
+	TextureInfo normalTexture;
+};
+
+struct Node {
+	int mesh = invalid;
+	std::vector<int> children;
+	bool hasMatrix = false;
+	float matrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	float translation[3] = { 0, 0, 0 };
+	float rotation[4] = { 0, 0, 0, 1 };
+	float scale[3] = { 1, 1, 1 };
+};
+
+// Parts of a glTF document needed to build a Model.
+struct Document {
+	std::vector<Accessor> accessors;
+	std::vector<Buffer> buffers;
+	std::vector<BufferView> bufferViews;
+	std::vector<Image> images;
+	std::vector<Texture> textures;
+	std::vector<Material> materials;
+	std::vector<Mesh> meshes;
+	std::vector<Node> nodes;
+};
+
+// Stream the JSON chunk of a glTF file, no DOM is built and unused subtrees are skipped.
+Document parse(std::string_view json);
+
+// Chunks of a binary glTF file, viewing the file bytes.
+struct Container {
+	std::string_view json;
+	const unsigned char *binary = nullptr;	// BIN chunk, null if absent
+	size_t binarySize = 0;
+};
+
+// Return true if the bytes start with the GLB magic.
+bool isBinary(const unsigned char *bytes, size_t size);
+// Split a GLB file in its chunks without copying. Throw on malformed headers.
+Container split(const unsigned char *bytes, size_t size);
+
+}
+}
+}
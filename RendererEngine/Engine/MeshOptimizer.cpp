@@ -0,0 +1,442 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace engine {
+namespace world {
+
+namespace {
+
+const unsigned int invalid = ~0U;
+
+// FIFO cache simulated with insertion times: a vertex is cached while fewer than
+// cacheSize misses happened since it was inserted. Reset by advancing the time.
+struct FIFOCache {
+	FIFOCache(size_t count, unsigned int cacheSize) : times(count, 0), time(cacheSize + 1), size(cacheSize) {}
+
+	// Return true on a miss.
+	bool access(unsigned int element)
+	{
+		if (time - times[element] < size)
+			return false;
+		times[element] = ++time;
+		return true;
+	}
+	void reset() { time += size + 1; }
+
+	Buffer<unsigned int> times;
+	unsigned int time;
+	unsigned int size;
+};
+
+template <typename T>
+void remapStream(Stream<T> &stream, const Buffer<unsigned int> &remap, size_t count)
+{
+	if (stream.size() == 0)
+		return;
+	Buffer<T> remapped(count);
+	for (size_t iVertex = 0; iVertex < stream.size(); iVertex++)
+		if (remap[iVertex] != invalid)
+			remapped[remap[iVertex]] = stream[iVertex];
+	stream.own() = std::move(remapped);
+}
+
+// Move vertex i to remap[i], dropping invalid ones.
+void remapVertices(Mesh &mesh, const Buffer<unsigned int> &remap, size_t count)
+{
+	remapStream(mesh.positions, remap, count);
+	remapStream(mesh.normals, remap, count);
+	for (Stream<geom::uv2> &texcoords : mesh.texcoords)
+		remapStream(texcoords, remap, count);
+	remapStream(mesh.colors, remap, count);
+	Buffer<unsigned int> indices(mesh.indices.begin(), mesh.indices.end());
+	for (unsigned int &index : indices)
+		index = remap[index];
+	mesh.indices.own() = std::move(indices);
+	// Levels of detail only use vertices of the full mesh, none of them is dropped.
+	for (Lod &lod : mesh.lods.levels)
+		for (unsigned int &index : lod.indices)
+			index = remap[index];
+}
+
+template <typename T>
+uint64_t hashStream(uint64_t hash, const Stream<T> &stream, size_t index)
+{
+	if (stream.size() == 0)
+		return hash;
+	// FNV-1a
+	const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&stream[index]);
+	for (size_t iByte = 0; iByte < sizeof(T); iByte++)
+		hash = (hash ^ bytes[iByte]) * 1099511628211ULL;
+	return hash;
+}
+
+template <typename T>
+bool equalStream(const Stream<T> &stream, size_t lhs, size_t rhs)
+{
+	return stream.size() == 0 || std::memcmp(&stream[lhs], &stream[rhs], sizeof(T)) == 0;
+}
+
+// Forsyth scores, see "Linear-Speed Vertex Cache Optimisation".
+const unsigned int forsythCacheSize = 32;
+const unsigned int forsythMaxValence = 32;
+
+struct ForsythScores {
+	ForsythScores()
+	{
+		for (unsigned int iPosition = 0; iPosition < forsythCacheSize; iPosition++)
+		{
+			// The last triangle vertices get a fixed score, so that strips are not favored.
+			if (iPosition < 3)
+				cache[iPosition] = 0.75f;
+			else
+				cache[iPosition] = std::pow(1.f - static_cast<float>(iPosition - 3) / (forsythCacheSize - 3), 1.5f);
+		}
+		valence[0] = 0.f;
+		// Boost vertices with few triangles left, so that they are not left alone.
+		for (unsigned int iValence = 1; iValence <= forsythMaxValence; iValence++)
+			valence[iValence] = 2.f / std::sqrt(static_cast<float>(iValence));
+	}
+	float operator()(unsigned int position, unsigned int liveTriangles) const
+	{
+		if (liveTriangles == 0)
+			return -1.f;
+		const float cacheScore = (position < forsythCacheSize) ? cache[position] : 0.f;
+		return cacheScore + valence[std::min(liveTriangles, forsythMaxValence)];
+	}
+	float cache[forsythCacheSize];
+	float valence[forsythMaxValence + 1];
+};
+
+}
+
+VertexCacheStatistics analyzeVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	FIFOCache cache(vertexCount, cacheSize);
+	VertexCacheStatistics statistics = {};
+	for (size_t iIndex = 0; iIndex < indexCount; iIndex++)
+		if (cache.access(indices[iIndex]))
+			statistics.transforms++;
+	const size_t triangleCount = indexCount / 3;
+	statistics.acmr = (triangleCount > 0) ? static_cast<float>(statistics.transforms) / triangleCount : 0.f;
+	statistics.atvr = (vertexCount > 0) ? static_cast<float>(statistics.transforms) / vertexCount : 0.f;
+	return statistics;
+}
+
+VertexFetchStatistics analyzeVertexFetch(const unsigned int *indices, size_t indexCount, size_t vertexCount, size_t vertexSize)
+{
+	const size_t lineSize = 64;
+	const unsigned int lineCount = 64;
+	FIFOCache cache((vertexCount * vertexSize + lineSize - 1) / lineSize, lineCount);
+	VertexFetchStatistics statistics = {};
+	for (size_t iIndex = 0; iIndex < indexCount; iIndex++)
+	{
+		// A vertex can straddle two lines.
+		const size_t begin = indices[iIndex] * vertexSize;
+		const size_t end = begin + vertexSize;
+		for (size_t line = begin / lineSize; line * lineSize < end; line++)
+			if (cache.access(static_cast<unsigned int>(line)))
+				statistics.bytesFetched += lineSize;
+	}
+	statistics.overfetch = (vertexCount > 0) ? static_cast<float>(statistics.bytesFetched) / (vertexCount * vertexSize) : 0.f;
+	return statistics;
+}
+
+void deduplicateVertices(Mesh &mesh)
+{
+	const size_t vertexCount = mesh.positions.size();
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize *= 2;
+	// Open addressing, holding the first vertex of each unique value.
+	Buffer<unsigned int> table(tableSize, invalid);
+	Buffer<unsigned int> remap(vertexCount);
+	unsigned int uniqueCount = 0;
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		hash = hashStream(hash, mesh.positions, iVertex);
+		hash = hashStream(hash, mesh.normals, iVertex);
+		for (const Stream<geom::uv2> &texcoords : mesh.texcoords)
+			hash = hashStream(hash, texcoords, iVertex);
+		hash = hashStream(hash, mesh.colors, iVertex);
+		size_t slot = static_cast<size_t>(hash) & (tableSize - 1);
+		while (true)
+		{
+			const unsigned int first = table[slot];
+			if (first == invalid)
+			{
+				table[slot] = static_cast<unsigned int>(iVertex);
+				remap[iVertex] = uniqueCount++;
+				break;
+			}
+			bool equal = equalStream(mesh.positions, first, iVertex) && equalStream(mesh.normals, first, iVertex) && equalStream(mesh.colors, first, iVertex);
+			for (const Stream<geom::uv2> &texcoords : mesh.texcoords)
+				equal = equal && equalStream(texcoords, first, iVertex);
+			if (equal)
+			{
+				remap[iVertex] = remap[first];
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+	if (uniqueCount == vertexCount)
+		return;
+	// Duplicates are bitwise equal, writing all of them to their unique vertex is harmless.
+	remapVertices(mesh, remap, uniqueCount);
+}
+
+void optimizeVertexCache(Mesh &mesh)
+{
+	const size_t vertexCount = mesh.positions.size();
+	const size_t triangleCount = mesh.indices.size() / 3;
+	const unsigned int *indices = mesh.indices.data();
+	static const ForsythScores score;
+
+	// Triangles of each vertex, live ones first.
+	Buffer<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t iIndex = 0; iIndex < triangleCount * 3; iIndex++)
+		liveTriangles[indices[iIndex]]++;
+	Buffer<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+		offsets[iVertex + 1] = offsets[iVertex] + liveTriangles[iVertex];
+	Buffer<unsigned int> adjacency(triangleCount * 3);
+	{
+		Buffer<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t iIndex = 0; iIndex < triangleCount * 3; iIndex++)
+			adjacency[fill[indices[iIndex]]++] = static_cast<unsigned int>(iIndex / 3);
+	}
+
+	Buffer<unsigned int> cachePositions(vertexCount, invalid);
+	Buffer<float> vertexScores(vertexCount);
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+		vertexScores[iVertex] = score(invalid, liveTriangles[iVertex]);
+	Buffer<float> triangleScores(triangleCount);
+	Buffer<unsigned char> emitted(triangleCount, 0);
+	unsigned int best = invalid;
+	float bestScore = -1.f;
+	for (size_t iTriangle = 0; iTriangle < triangleCount; iTriangle++)
+	{
+		const unsigned int *triangle = &indices[iTriangle * 3];
+		triangleScores[iTriangle] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+		if (triangleScores[iTriangle] > bestScore)
+		{
+			bestScore = triangleScores[iTriangle];
+			best = static_cast<unsigned int>(iTriangle);
+		}
+	}
+
+	Buffer<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	unsigned int cache[forsythCacheSize + 3];
+	unsigned int cacheCount = 0;
+	size_t nextCandidate = 0;
+	while (output.size() < triangleCount * 3)
+	{
+		if (best == invalid)
+		{
+			// Nothing left around the cache, restart from the next triangle in input order.
+			while (emitted[nextCandidate])
+				nextCandidate++;
+			best = static_cast<unsigned int>(nextCandidate);
+		}
+		const unsigned int *triangle = &indices[best * 3];
+		emitted[best] = 1;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		// Remove the triangle from the live ones of its vertices.
+		for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+		{
+			const unsigned int vertex = triangle[iCorner];
+			unsigned int *live = &adjacency[offsets[vertex]];
+			unsigned int *last = live + liveTriangles[vertex] - 1;
+			for (unsigned int *it = live; it <= last; it++)
+			{
+				if (*it == best)
+				{
+					std::swap(*it, *last);
+					liveTriangles[vertex]--;
+					break;
+				}
+			}
+		}
+
+		// Move the triangle vertices to the front of the cache.
+		unsigned int newCache[forsythCacheSize + 3];
+		unsigned int newCount = 0;
+		for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+			if (std::find(newCache, newCache + newCount, triangle[iCorner]) == newCache + newCount)
+				newCache[newCount++] = triangle[iCorner];
+		for (unsigned int iCache = 0; iCache < cacheCount; iCache++)
+			if (std::find(newCache, newCache + newCount, cache[iCache]) == newCache + newCount)
+				newCache[newCount++] = cache[iCache];
+		for (unsigned int iCache = 0; iCache < newCount; iCache++)
+		{
+			const unsigned int vertex = newCache[iCache];
+			cachePositions[vertex] = (iCache < forsythCacheSize) ? iCache : invalid;
+			vertexScores[vertex] = score(cachePositions[vertex], liveTriangles[vertex]);
+		}
+
+		// Next triangle among the ones around the cache.
+		best = invalid;
+		bestScore = -1.f;
+		for (unsigned int iCache = 0; iCache < newCount; iCache++)
+		{
+			const unsigned int vertex = newCache[iCache];
+			for (unsigned int iLive = 0; iLive < liveTriangles[vertex]; iLive++)
+			{
+				const unsigned int iTriangle = adjacency[offsets[vertex] + iLive];
+				const unsigned int *corners = &indices[iTriangle * 3];
+				const float triangleScore = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+				triangleScores[iTriangle] = triangleScore;
+				if (triangleScore > bestScore)
+				{
+					bestScore = triangleScore;
+					best = iTriangle;
+				}
+			}
+		}
+		cacheCount = std::min(newCount, forsythCacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+	mesh.indices.own() = std::move(output);
+}
+
+void optimizeOverdraw(Mesh &mesh, float threshold)
+{
+	const size_t vertexCount = mesh.positions.size();
+	const size_t triangleCount = mesh.indices.size() / 3;
+	const unsigned int *indices = mesh.indices.data();
+	const unsigned int cacheSize = 16;
+	if (triangleCount == 0)
+		return;
+
+	// Hard boundaries, where the cache is fully missed: reordering there costs nothing.
+	Buffer<size_t> hardBoundaries;
+	{
+		FIFOCache cache(vertexCount, cacheSize);
+		for (size_t iTriangle = 0; iTriangle < triangleCount; iTriangle++)
+		{
+			unsigned int misses = 0;
+			for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+				misses += cache.access(indices[iTriangle * 3 + iCorner]) ? 1 : 0;
+			if (misses == 3)
+				hardBoundaries.push_back(iTriangle);
+		}
+		if (hardBoundaries.empty() || hardBoundaries[0] != 0)
+			hardBoundaries.insert(hardBoundaries.begin(), 0);
+		hardBoundaries.push_back(triangleCount);
+	}
+
+	// Soft boundaries, split a cluster as soon as its own ACMR is within the threshold of the whole one.
+	Buffer<size_t> boundaries;
+	{
+		FIFOCache cache(vertexCount, cacheSize);
+		for (size_t iHard = 0; iHard + 1 < hardBoundaries.size(); iHard++)
+		{
+			const size_t begin = hardBoundaries[iHard], end = hardBoundaries[iHard + 1];
+			cache.reset();
+			unsigned int misses = 0;
+			for (size_t iIndex = begin * 3; iIndex < end * 3; iIndex++)
+				misses += cache.access(indices[iIndex]) ? 1 : 0;
+			const float target = threshold * misses / (end - begin);
+
+			boundaries.push_back(begin);
+			cache.reset();
+			misses = 0;
+			size_t clusterBegin = begin;
+			for (size_t iTriangle = begin; iTriangle < end; iTriangle++)
+			{
+				for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+					misses += cache.access(indices[iTriangle * 3 + iCorner]) ? 1 : 0;
+				if (iTriangle + 1 < end && static_cast<float>(misses) / (iTriangle + 1 - clusterBegin) <= target)
+				{
+					clusterBegin = iTriangle + 1;
+					boundaries.push_back(clusterBegin);
+					cache.reset();
+					misses = 0;
+				}
+			}
+		}
+		boundaries.push_back(triangleCount);
+	}
+
+	// Sort clusters by how much they face away from the mesh center, outer ones first.
+	float meshCenter[3] = { 0.f, 0.f, 0.f };
+	for (size_t iIndex = 0; iIndex < triangleCount * 3; iIndex++)
+	{
+		const geom::point3 &position = mesh.positions[indices[iIndex]];
+		meshCenter[0] += position.x;
+		meshCenter[1] += position.y;
+		meshCenter[2] += position.z;
+	}
+	for (float &component : meshCenter)
+		component /= static_cast<float>(triangleCount * 3);
+	const size_t clusterCount = boundaries.size() - 1;
+	Buffer<float> sortKeys(clusterCount);
+	for (size_t iCluster = 0; iCluster < clusterCount; iCluster++)
+	{
+		float center[3] = { 0.f, 0.f, 0.f }, normal[3] = { 0.f, 0.f, 0.f };
+		for (size_t iTriangle = boundaries[iCluster]; iTriangle < boundaries[iCluster + 1]; iTriangle++)
+		{
+			const geom::point3 &p0 = mesh.positions[indices[iTriangle * 3 + 0]];
+			const geom::point3 &p1 = mesh.positions[indices[iTriangle * 3 + 1]];
+			const geom::point3 &p2 = mesh.positions[indices[iTriangle * 3 + 2]];
+			const float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			const float e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			// Area weighted
+			normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+			normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+			normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+			center[0] += p0.x + p1.x + p2.x;
+			center[1] += p0.y + p1.y + p2.y;
+			center[2] += p0.z + p1.z + p2.z;
+		}
+		const float count = static_cast<float>((boundaries[iCluster + 1] - boundaries[iCluster]) * 3);
+		const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float key = 0.f;
+		for (unsigned int iAxis = 0; iAxis < 3; iAxis++)
+			key += (center[iAxis] / count - meshCenter[iAxis]) * normal[iAxis];
+		sortKeys[iCluster] = (length > 0.f) ? key / length : 0.f;
+	}
+	Buffer<unsigned int> order(clusterCount);
+	for (size_t iCluster = 0; iCluster < clusterCount; iCluster++)
+		order[iCluster] = static_cast<unsigned int>(iCluster);
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int lhs, unsigned int rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+	Buffer<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	for (unsigned int iCluster : order)
+		output.insert(output.end(), indices + boundaries[iCluster] * 3, indices + boundaries[iCluster + 1] * 3);
+	mesh.indices.own() = std::move(output);
+}
+
+void optimizeVertexFetch(Mesh &mesh)
+{
+	Buffer<unsigned int> remap(mesh.positions.size(), invalid);
+	unsigned int count = 0;
+	for (unsigned int index : mesh.indices)
+		if (remap[index] == invalid)
+			remap[index] = count++;
+	remapVertices(mesh, remap, count);
+}
+
+void optimize(Mesh &mesh)
+{
+	deduplicateVertices(mesh);
+	optimizeVertexCache(mesh);
+	optimizeOverdraw(mesh);
+	optimizeVertexFetch(mesh);
+}
+
+void shrinkIndices(const unsigned int *indices, size_t indexCount, uint16_t *shortIndices)
+{
+	for (size_t iIndex = 0; iIndex < indexCount; iIndex++)
+		shortIndices[iIndex] = static_cast<uint16_t>(indices[iIndex]);
+}
+
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Model.h"
+
+#include <stdint.h>
+
+namespace engine {
+namespace world {
+
+// Mesh optimization, run at cook time or after loading.
+// Every pass keeps the triangles, only their order & the vertex order change.
+// Streams are converted to owned buffers when modified.
+
+struct VertexCacheStatistics {
+	unsigned int transforms;	// Vertex shader invocations
+	float acmr;	// Average cache miss ratio, transforms per triangle, 0.5 at best for grids
+	float atvr;	// Average transform to vertex ratio, 1 at best
+};
+
+struct VertexFetchStatistics {
+	size_t bytesFetched;	// Cache lines read from memory
+	float overfetch;		// Bytes fetched per vertex byte, 1 at best
+};
+
+// Simulate a FIFO post-transform cache.
+VertexCacheStatistics analyzeVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+// Simulate a small FIFO cache of 64 bytes lines on an interleaved vertex buffer.
+VertexFetchStatistics analyzeVertexFetch(const unsigned int *indices, size_t indexCount, size_t vertexCount, size_t vertexSize);
+
+// Merge the vertices whose attributes are all bitwise equal.
+void deduplicateVertices(Mesh &mesh);
+// Reorder the triangles for the post-transform cache, with Tom Forsyth's linear-speed algorithm.
+void optimizeVertexCache(Mesh &mesh);
+// Reorder clusters of triangles so that outer triangles are drawn first, while keeping the
+// cache efficiency within threshold times the current one. Run after optimizeVertexCache.
+void optimizeOverdraw(Mesh &mesh, float threshold = 1.05f);
+// Reorder the vertices in first use order, so that vertex fetches are mostly sequential.
+// Unused vertices are removed.
+void optimizeVertexFetch(Mesh &mesh);
+// Every pass above, in order.
+void optimize(Mesh &mesh);
+
+// Indices fit in 16 bits.
+inline bool hasShortIndices(size_t vertexCount) { return vertexCount <= 0x10000; }
+void shrinkIndices(const unsigned int *indices, size_t indexCount, uint16_t *shortIndices);
+
+}
+}
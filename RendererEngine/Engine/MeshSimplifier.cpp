@@ -0,0 +1,550 @@
+#include "MeshSimplifier.h"
+#include "Camera.h"
+
+#include "../Framework/JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+namespace engine {
+namespace world {
+
+namespace {
+
+const unsigned int invalid = ~0U;
+
+enum class VertexKind : uint8_t {
+	MANIFOLD,	// Inside a single attribute region
+	BORDER,		// On an open edge loop of the mesh
+	SEAM,		// On an edge loop between two attribute regions, with one vertex per side
+	LOCKED,		// Anything else, never collapsed
+};
+
+struct Vector {
+	double x, y, z;
+};
+
+Vector toVector(const geom::point3 &point) { return Vector{ point.x, point.y, point.z }; }
+Vector operator-(const Vector &lhs, const Vector &rhs) { return Vector{ lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z }; }
+double dot(const Vector &lhs, const Vector &rhs) { return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z; }
+Vector cross(const Vector &lhs, const Vector &rhs) { return Vector{ lhs.y * rhs.z - lhs.z * rhs.y, lhs.z * rhs.x - lhs.x * rhs.z, lhs.x * rhs.y - lhs.y * rhs.x }; }
+
+// Sum of weighted squared distances to planes, as the symmetric matrix A, the vector b & the
+// constant c of p.A.p + 2 b.p + c. Divided by the total weight, it is a mean squared distance.
+struct Quadric {
+	double a00, a11, a22, a01, a02, a12;
+	double b0, b1, b2;
+	double c;
+	double weight;
+
+	// Plane dot(normal, p) + distance = 0, with a unit normal.
+	static Quadric plane(const Vector &normal, double distance, double weight)
+	{
+		Quadric q;
+		q.a00 = weight * normal.x * normal.x;
+		q.a11 = weight * normal.y * normal.y;
+		q.a22 = weight * normal.z * normal.z;
+		q.a01 = weight * normal.x * normal.y;
+		q.a02 = weight * normal.x * normal.z;
+		q.a12 = weight * normal.y * normal.z;
+		q.b0 = weight * normal.x * distance;
+		q.b1 = weight * normal.y * distance;
+		q.b2 = weight * normal.z * distance;
+		q.c = weight * distance * distance;
+		q.weight = weight;
+		return q;
+	}
+	Quadric &operator+=(const Quadric &rhs)
+	{
+		a00 += rhs.a00; a11 += rhs.a11; a22 += rhs.a22;
+		a01 += rhs.a01; a02 += rhs.a02; a12 += rhs.a12;
+		b0 += rhs.b0; b1 += rhs.b1; b2 += rhs.b2;
+		c += rhs.c;
+		weight += rhs.weight;
+		return *this;
+	}
+	// Mean squared distance of the point to the planes.
+	double error(const Vector &p) const
+	{
+		const double rx = a00 * p.x + a01 * p.y + a02 * p.z + 2.0 * b0;
+		const double ry = a01 * p.x + a11 * p.y + a12 * p.z + 2.0 * b1;
+		const double rz = a02 * p.x + a12 * p.y + a22 * p.z + 2.0 * b2;
+		const double sum = rx * p.x + ry * p.y + rz * p.z + c;
+		return (weight > 0.0) ? std::fabs(sum) / weight : 0.0;
+	}
+};
+
+// Open edges are counted 10 times more than faces, so that borders & seams keep their shape.
+const double borderWeight = 10.0;
+
+// Vertices sharing a position, as a representative & a circular list per position.
+void linkWedges(const Mesh &mesh, Buffer<unsigned int> &remap, Buffer<unsigned int> &wedges)
+{
+	const size_t vertexCount = mesh.positions.size();
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize *= 2;
+	Buffer<unsigned int> table(tableSize, invalid);
+	remap.assign(vertexCount, invalid);
+	wedges.resize(vertexCount);
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+	{
+		const geom::point3 &position = mesh.positions[iVertex];
+		const float components[3] = { position.x, position.y, position.z };
+		// FNV-1a of the position bits
+		uint64_t hash = 14695981039346656037ULL;
+		const unsigned char *bytes = reinterpret_cast<const unsigned char*>(components);
+		for (size_t iByte = 0; iByte < sizeof(components); iByte++)
+			hash = (hash ^ bytes[iByte]) * 1099511628211ULL;
+		size_t slot = static_cast<size_t>(hash) & (tableSize - 1);
+		while (true)
+		{
+			const unsigned int first = table[slot];
+			if (first == invalid)
+			{
+				table[slot] = static_cast<unsigned int>(iVertex);
+				remap[iVertex] = static_cast<unsigned int>(iVertex);
+				wedges[iVertex] = static_cast<unsigned int>(iVertex);
+				break;
+			}
+			const geom::point3 &other = mesh.positions[first];
+			if (other.x == position.x && other.y == position.y && other.z == position.z)
+			{
+				remap[iVertex] = first;
+				wedges[iVertex] = wedges[first];
+				wedges[first] = static_cast<unsigned int>(iVertex);
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+}
+
+// Directed edges of the triangles, in compressed rows per start vertex.
+struct EdgeAdjacency {
+	Buffer<unsigned int> offsets;
+	Buffer<unsigned int> ends;
+	Buffer<unsigned int> triangles;	// Of each edge
+
+	void build(const unsigned int *indices, size_t indexCount, size_t vertexCount)
+	{
+		offsets.assign(vertexCount + 1, 0);
+		ends.resize(indexCount);
+		triangles.resize(indexCount);
+		for (size_t iIndex = 0; iIndex < indexCount; iIndex++)
+			offsets[indices[iIndex] + 1]++;
+		for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+			offsets[iVertex + 1] += offsets[iVertex];
+		Buffer<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t iTriangle = 0; iTriangle < indexCount / 3; iTriangle++)
+		{
+			for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+			{
+				const unsigned int start = indices[iTriangle * 3 + iCorner];
+				const unsigned int slot = fill[start]++;
+				ends[slot] = indices[iTriangle * 3 + (iCorner + 1) % 3];
+				triangles[slot] = static_cast<unsigned int>(iTriangle);
+			}
+		}
+	}
+	bool has(unsigned int start, unsigned int end) const
+	{
+		for (unsigned int iEdge = offsets[start]; iEdge < offsets[start + 1]; iEdge++)
+			if (ends[iEdge] == end)
+				return true;
+		return false;
+	}
+	// Exactly one open edge leaving & one entering the vertex, returned as its neighbors.
+	bool openLoop(unsigned int vertex, unsigned int &next, unsigned int &previous, const Buffer<unsigned int> &incoming, const Buffer<unsigned int> &incomingOffsets) const
+	{
+		next = previous = invalid;
+		unsigned int outCount = 0, inCount = 0;
+		for (unsigned int iEdge = offsets[vertex]; iEdge < offsets[vertex + 1]; iEdge++)
+		{
+			if (!has(ends[iEdge], vertex))
+			{
+				next = ends[iEdge];
+				outCount++;
+			}
+		}
+		for (unsigned int iEdge = incomingOffsets[vertex]; iEdge < incomingOffsets[vertex + 1]; iEdge++)
+		{
+			if (!has(vertex, incoming[iEdge]))
+			{
+				previous = incoming[iEdge];
+				inCount++;
+			}
+		}
+		return outCount == 1 && inCount == 1;
+	}
+};
+
+void classifyVertices(const unsigned int *indices, size_t indexCount, const Buffer<unsigned int> &remap, const Buffer<unsigned int> &wedges, Buffer<VertexKind> &kinds)
+{
+	const size_t vertexCount = remap.size();
+	EdgeAdjacency adjacency;
+	adjacency.build(indices, indexCount, vertexCount);
+	// Start vertices of the edges ending at each vertex.
+	Buffer<unsigned int> incomingOffsets(vertexCount + 1, 0), incoming(indexCount);
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+		for (unsigned int iEdge = adjacency.offsets[iVertex]; iEdge < adjacency.offsets[iVertex + 1]; iEdge++)
+			incomingOffsets[adjacency.ends[iEdge] + 1]++;
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+		incomingOffsets[iVertex + 1] += incomingOffsets[iVertex];
+	{
+		Buffer<unsigned int> fill(incomingOffsets.begin(), incomingOffsets.end() - 1);
+		for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+			for (unsigned int iEdge = adjacency.offsets[iVertex]; iEdge < adjacency.offsets[iVertex + 1]; iEdge++)
+				incoming[fill[adjacency.ends[iEdge]]++] = static_cast<unsigned int>(iVertex);
+	}
+
+	kinds.assign(vertexCount, VertexKind::LOCKED);
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+	{
+		const unsigned int vertex = static_cast<unsigned int>(iVertex);
+		unsigned int openCount = 0;
+		for (unsigned int iEdge = adjacency.offsets[vertex]; iEdge < adjacency.offsets[vertex + 1]; iEdge++)
+			openCount += adjacency.has(adjacency.ends[iEdge], vertex) ? 0 : 1;
+		for (unsigned int iEdge = incomingOffsets[vertex]; iEdge < incomingOffsets[vertex + 1]; iEdge++)
+			openCount += adjacency.has(vertex, incoming[iEdge]) ? 0 : 1;
+		const unsigned int sibling = wedges[vertex];
+		const bool unique = (sibling == vertex);
+		const bool pair = !unique && wedges[sibling] == vertex;
+		unsigned int next, previous;
+		if (unique && openCount == 0)
+		{
+			kinds[vertex] = VertexKind::MANIFOLD;
+		}
+		else if (unique)
+		{
+			if (adjacency.openLoop(vertex, next, previous, incoming, incomingOffsets))
+				kinds[vertex] = VertexKind::BORDER;
+		}
+		else if (pair)
+		{
+			// Both sides have a single open edge each way, mirroring each other.
+			unsigned int siblingNext, siblingPrevious;
+			if (adjacency.openLoop(vertex, next, previous, incoming, incomingOffsets) &&
+				adjacency.openLoop(sibling, siblingNext, siblingPrevious, incoming, incomingOffsets) &&
+				remap[next] == remap[siblingPrevious] && remap[previous] == remap[siblingNext])
+				kinds[vertex] = VertexKind::SEAM;
+		}
+	}
+	// A seam needs both sides to be collapsible together.
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+		if (kinds[iVertex] == VertexKind::SEAM && kinds[wedges[iVertex]] != VertexKind::SEAM)
+			kinds[iVertex] = VertexKind::LOCKED;
+}
+
+struct Collapse {
+	unsigned int from, to;
+	unsigned int fromSibling, toSibling;	// Other side of a seam, invalid otherwise
+	float error;
+};
+
+}
+
+float simplify(const Mesh &mesh, const unsigned int *indices, size_t indexCount, size_t targetIndexCount, float targetError, Buffer<unsigned int> &result)
+{
+	const size_t vertexCount = mesh.positions.size();
+	if (indexCount % 3 != 0)
+		throw std::runtime_error("Simplification needs a triangle list");
+	for (size_t iIndex = 0; iIndex < indexCount; iIndex++)
+		if (indices[iIndex] >= vertexCount)
+			throw std::runtime_error("Index out of the mesh vertices");
+	result.assign(indices, indices + indexCount);
+	if (indexCount <= targetIndexCount)
+		return 0.f;
+
+	Buffer<unsigned int> remap, wedges;
+	linkWedges(mesh, remap, wedges);
+	Buffer<VertexKind> kinds;
+	classifyVertices(indices, indexCount, remap, wedges, kinds);
+	auto position = [&](unsigned int vertex) { return toVector(mesh.positions[vertex]); };
+
+	// Quadrics of the faces & of the open edges, per position.
+	Buffer<Quadric> quadrics(vertexCount, Quadric{});
+	{
+		EdgeAdjacency adjacency;
+		adjacency.build(indices, indexCount, vertexCount);
+		for (size_t iTriangle = 0; iTriangle < indexCount / 3; iTriangle++)
+		{
+			const unsigned int *triangle = indices + iTriangle * 3;
+			const Vector p0 = position(triangle[0]), p1 = position(triangle[1]), p2 = position(triangle[2]);
+			Vector normal = cross(p1 - p0, p2 - p0);
+			const double length = std::sqrt(dot(normal, normal));
+			if (length == 0.0)
+				continue;
+			normal = Vector{ normal.x / length, normal.y / length, normal.z / length };
+			const Quadric face = Quadric::plane(normal, -dot(normal, p0), length * 0.5);
+			for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+				quadrics[remap[triangle[iCorner]]] += face;
+			for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+			{
+				const unsigned int start = triangle[iCorner], end = triangle[(iCorner + 1) % 3];
+				if (adjacency.has(end, start))
+					continue;
+				// Plane through the open edge, perpendicular to the face.
+				const Vector edge = position(end) - position(start);
+				const double edgeLength = std::sqrt(dot(edge, edge));
+				if (edgeLength == 0.0)
+					continue;
+				Vector side = cross(edge, normal);
+				side = Vector{ side.x / edgeLength, side.y / edgeLength, side.z / edgeLength };
+				const Quadric border = Quadric::plane(side, -dot(side, position(start)), edgeLength * edgeLength * borderWeight);
+				quadrics[remap[start]] += border;
+				quadrics[remap[end]] += border;
+			}
+		}
+	}
+
+	const double maxError = static_cast<double>(targetError) * targetError;
+	double resultError = 0.0;
+	EdgeAdjacency adjacency;
+	Buffer<Collapse> collapses;
+	Buffer<unsigned int> order;
+	Buffer<unsigned int> collapseRemap(vertexCount);
+	Buffer<bool> touched(vertexCount);
+	while (result.size() > targetIndexCount)
+	{
+		adjacency.build(result.data(), result.size(), vertexCount);
+		// Open in the current triangles, so that borders & seams follow the collapses.
+		auto isOpen = [&](unsigned int start, unsigned int end) {
+			return (adjacency.has(start, end) && !adjacency.has(end, start)) || (adjacency.has(end, start) && !adjacency.has(start, end));
+		};
+		// Other side of the seam edge from -> to, invalid if the collapse is not allowed.
+		auto seamSibling = [&](unsigned int from, unsigned int to, unsigned int &fromSibling, unsigned int &toSibling) {
+			fromSibling = wedges[from];
+			for (unsigned int candidate = wedges[to]; candidate != to; candidate = wedges[candidate])
+			{
+				if (isOpen(fromSibling, candidate))
+				{
+					toSibling = candidate;
+					return true;
+				}
+			}
+			return false;
+		};
+		auto canCollapse = [&](unsigned int from, unsigned int to, Collapse &collapse) {
+			collapse.from = from;
+			collapse.to = to;
+			collapse.fromSibling = collapse.toSibling = invalid;
+			switch (kinds[from])
+			{
+			case VertexKind::MANIFOLD:
+				return true;
+			case VertexKind::BORDER:
+				return (kinds[to] == VertexKind::BORDER || kinds[to] == VertexKind::LOCKED) && isOpen(from, to);
+			case VertexKind::SEAM:
+				return (kinds[to] == VertexKind::SEAM || kinds[to] == VertexKind::LOCKED) && isOpen(from, to) &&
+					seamSibling(from, to, collapse.fromSibling, collapse.toSibling);
+			default:
+				return false;
+			}
+		};
+
+		// Cheapest direction of every edge, once per edge.
+		collapses.clear();
+		for (size_t iIndex = 0; iIndex < result.size(); iIndex++)
+		{
+			const unsigned int i0 = result[iIndex];
+			const unsigned int i1 = result[(iIndex % 3 == 2) ? iIndex - 2 : iIndex + 1];
+			// The opposite edge, if any, is seen from the other triangle.
+			if (adjacency.has(i1, i0) && remap[i0] > remap[i1])
+				continue;
+			if (remap[i0] == remap[i1])
+				continue;
+			Collapse forward, backward;
+			const bool canForward = canCollapse(i0, i1, forward);
+			const bool canBackward = canCollapse(i1, i0, backward);
+			forward.error = canForward ? static_cast<float>(quadrics[remap[i0]].error(position(i1))) : HUGE_VALF;
+			backward.error = canBackward ? static_cast<float>(quadrics[remap[i1]].error(position(i0))) : HUGE_VALF;
+			if (canForward || canBackward)
+				collapses.push_back((forward.error <= backward.error) ? forward : backward);
+		}
+		if (collapses.empty())
+			break;
+		order.resize(collapses.size());
+		for (size_t iCollapse = 0; iCollapse < order.size(); iCollapse++)
+			order[iCollapse] = static_cast<unsigned int>(iCollapse);
+		std::sort(order.begin(), order.end(), [&](unsigned int lhs, unsigned int rhs) { return collapses[lhs].error < collapses[rhs].error; });
+
+		// A collapse removes about 2 triangles, do at most what reaches the target. Each position is
+		// in at most one collapse per pass, so that the flip checks see the final neighborhood.
+		const size_t goal = std::max<size_t>((result.size() - targetIndexCount) / 6, 1);
+		size_t collapsed = 0;
+		for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+			collapseRemap[iVertex] = static_cast<unsigned int>(iVertex);
+		std::fill(touched.begin(), touched.end(), false);
+		auto flips = [&](unsigned int from, unsigned int to) {
+			const Vector target = position(to);
+			for (unsigned int iEdge = adjacency.offsets[from]; iEdge < adjacency.offsets[from + 1]; iEdge++)
+			{
+				const unsigned int *triangle = result.data() + adjacency.triangles[iEdge] * 3;
+				unsigned int corner = 0;
+				bool removed = false;
+				for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+				{
+					removed = removed || (remap[triangle[iCorner]] == remap[to]);
+					corner = (triangle[iCorner] == from) ? iCorner : corner;
+				}
+				if (removed)
+					continue;
+				const Vector p0 = position(triangle[corner]);
+				const Vector p1 = position(triangle[(corner + 1) % 3]);
+				const Vector p2 = position(triangle[(corner + 2) % 3]);
+				const Vector before = cross(p1 - p0, p2 - p0);
+				const Vector after = cross(p1 - target, p2 - target);
+				// Flipped, or turned so much that the triangle becomes a sliver seen from its old side.
+				if (dot(before, after) <= 0.5 * std::sqrt(dot(before, before) * dot(after, after)))
+					return true;
+			}
+			return false;
+		};
+		for (unsigned int iOrder : order)
+		{
+			const Collapse &collapse = collapses[iOrder];
+			if (collapse.error > maxError || collapsed >= goal)
+				break;
+			const unsigned int from = remap[collapse.from], to = remap[collapse.to];
+			if (touched[from] || touched[to])
+				continue;
+			if (flips(collapse.from, collapse.to) || (collapse.fromSibling != invalid && flips(collapse.fromSibling, collapse.toSibling)))
+				continue;
+			collapseRemap[collapse.from] = collapse.to;
+			if (collapse.fromSibling != invalid)
+				collapseRemap[collapse.fromSibling] = collapse.toSibling;
+			quadrics[to] += quadrics[from];
+			// The triangles around the collapse changed, their other vertices wait for the next pass.
+			for (unsigned int vertex : { collapse.from, collapse.fromSibling })
+			{
+				if (vertex == invalid)
+					continue;
+				for (unsigned int iEdge = adjacency.offsets[vertex]; iEdge < adjacency.offsets[vertex + 1]; iEdge++)
+					for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+						touched[remap[result[adjacency.triangles[iEdge] * 3 + iCorner]]] = true;
+			}
+			touched[to] = true;
+			resultError = std::max(resultError, static_cast<double>(collapse.error));
+			collapsed++;
+		}
+		if (collapsed == 0)
+			break;
+
+		// Remove the triangles which became degenerate.
+		size_t written = 0;
+		for (size_t iTriangle = 0; iTriangle < result.size() / 3; iTriangle++)
+		{
+			const unsigned int i0 = collapseRemap[result[iTriangle * 3 + 0]];
+			const unsigned int i1 = collapseRemap[result[iTriangle * 3 + 1]];
+			const unsigned int i2 = collapseRemap[result[iTriangle * 3 + 2]];
+			if (i0 == i1 || i1 == i2 || i2 == i0)
+				continue;
+			result[written++] = i0;
+			result[written++] = i1;
+			result[written++] = i2;
+		}
+		result.resize(written);
+	}
+	return static_cast<float>(std::sqrt(resultError));
+}
+
+void generateLods(Mesh &mesh, const LodOptions &options)
+{
+	LodChain &lods = mesh.lods;
+	lods.levels.clear();
+	// Sphere around the bounding box, enough to measure distances.
+	geom::point3 minimum(0.f, 0.f, 0.f), maximum(0.f, 0.f, 0.f);
+	if (mesh.positions.size() > 0)
+		minimum = maximum = mesh.positions[0];
+	for (const geom::point3 &position : mesh.positions)
+	{
+		minimum = geom::point3(std::min(minimum.x, position.x), std::min(minimum.y, position.y), std::min(minimum.z, position.z));
+		maximum = geom::point3(std::max(maximum.x, position.x), std::max(maximum.y, position.y), std::max(maximum.z, position.z));
+	}
+	lods.center = geom::point3((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+	float radiusSquared = 0.f;
+	for (const geom::point3 &position : mesh.positions)
+	{
+		const float dx = position.x - lods.center.x, dy = position.y - lods.center.y, dz = position.z - lods.center.z;
+		radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+	}
+	lods.radius = std::sqrt(radiusSquared);
+
+	const float maxError = options.maxError * lods.radius;
+	const unsigned int *indices = mesh.indices.data();
+	size_t indexCount = mesh.indices.size();
+	float error = 0.f;
+	while (lods.levels.size() < options.maxLevels && indexCount / 3 > options.minTriangles)
+	{
+		const size_t target = static_cast<size_t>(indexCount / 3 * options.ratio) * 3;
+		Lod lod;
+		// Errors of successive levels add up, at worst.
+		lod.error = error + simplify(mesh, indices, indexCount, target, maxError - error, lod.indices);
+		// Levels which remove less than a quarter of what was asked are not worth their memory.
+		if (indexCount - lod.indices.size() < (indexCount - target) / 4)
+			break;
+		error = lod.error;
+		lods.levels.push_back(std::move(lod));
+		indices = lods.levels.back().indices.data();
+		indexCount = lods.levels.back().indices.size();
+	}
+}
+
+void generateLods(job::Scheduler &scheduler, Model &model, const LodOptions &options)
+{
+	Buffer<job::Handle> jobs;
+	for (Mesh &mesh : model.meshes)
+		jobs.push_back(scheduler.add([&mesh, &options]() { generateLods(mesh, options); }));
+	// Wait for every job before rethrowing, they reference the meshes.
+	std::exception_ptr error;
+	for (const job::Handle &handle : jobs)
+	{
+		try { scheduler.wait(handle); }
+		catch (...) { if (!error) error = std::current_exception(); }
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+unsigned int selectLod(const Mesh &mesh, const geom::mat4 &model, const Camera &camera, float viewportHeight, float threshold)
+{
+	const LodChain &lods = mesh.lods;
+	if (lods.levels.empty())
+		return 0;
+	// Largest axis scale of the model matrix.
+	float scaleSquared = 0.f;
+	for (unsigned int iAxis = 0; iAxis < 3; iAxis++)
+		scaleSquared = std::max(scaleSquared, model[iAxis][0] * model[iAxis][0] + model[iAxis][1] * model[iAxis][1] + model[iAxis][2] * model[iAxis][2]);
+	const float scale = std::sqrt(scaleSquared);
+	const geom::point3 &center = lods.center;
+	const float x = model[0][0] * center.x + model[1][0] * center.y + model[2][0] * center.z + model[3][0];
+	const float y = model[0][1] * center.x + model[1][1] * center.y + model[2][1] * center.z + model[3][1];
+	const float z = model[0][2] * center.x + model[1][2] * center.y + model[2][2] * center.z + model[3][2];
+	const geom::point3 eye = camera.position();
+	const float dx = x - eye.x, dy = y - eye.y, dz = z - eye.z;
+	// Closest point of the bounding sphere, the error could be anywhere on the mesh.
+	const float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - lods.radius * scale;
+	const float pixelsPerUnit = camera.pixelsPerUnit(distance, viewportHeight);
+	unsigned int level = 0;
+	while (level < lods.levels.size() && lods.levels[level].error * scale * pixelsPerUnit <= threshold)
+		level++;
+	return level;
+}
+
+void selectLods(const Model &model, const Camera &camera, float viewportHeight, float threshold, Buffer<unsigned int> &levels)
+{
+	levels.assign(model.nodes.size(), 0);
+	for (size_t iNode = 0; iNode < model.nodes.size(); iNode++)
+	{
+		const Mesh *mesh = model.nodes[iNode].mesh;
+		if (mesh != nullptr)
+			levels[iNode] = selectLod(*mesh, model.hierarchy.getModel(static_cast<unsigned int>(iNode)), camera, viewportHeight, threshold);
+	}
+}
+
+}
+}
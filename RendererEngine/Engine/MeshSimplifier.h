@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Model.h"
+
+namespace engine {
+
+struct Camera;
+
+namespace job {
+class Scheduler;
+}
+
+namespace world {
+
+// Mesh simplification by edge collapses ordered by quadric error, see "Surface Simplification
+// Using Quadric Error Metrics", Garland & Heckbert. Vertices are never moved nor created, collapses
+// move a vertex onto a neighbor so that the result is a new index buffer over the same vertices.
+//
+// Vertices on borders only collapse along their border, vertices on attribute seams only along
+// their seam & together with their other side, vertices where more than that meet are locked.
+
+// Collapse edges until at most targetIndexCount indices are left, or until the next collapse would
+// move the surface by more than targetError, in mesh units.
+// Return the error of the result, the largest distance of a collapse.
+float simplify(const Mesh &mesh, const unsigned int *indices, size_t indexCount, size_t targetIndexCount, float targetError, Buffer<unsigned int> &result);
+
+struct LodOptions {
+	float ratio = 0.5f;			// Triangles kept from one level to the next
+	unsigned int maxLevels = 8;
+	float maxError = 0.1f;		// Relative to the mesh radius
+	size_t minTriangles = 64;	// Stop under this count
+};
+
+// Build mesh.lods from the mesh indices, each level simplified from the previous one.
+// Stops early when a level would not remove enough triangles, so that levels are worth selecting.
+void generateLods(Mesh &mesh, const LodOptions &options = LodOptions());
+// Every mesh of the model, on jobs.
+void generateLods(job::Scheduler &scheduler, Model &model, const LodOptions &options = LodOptions());
+
+// Coarsest level whose error is at most threshold pixels on screen, 0 for the full mesh.
+// The model matrix places the mesh in the world, its largest scale scales the error.
+unsigned int selectLod(const Mesh &mesh, const geom::mat4 &model, const Camera &camera, float viewportHeight, float threshold = 1.f);
+// Level of each of the model nodes, 0 for nodes without mesh. The model hierarchy must be up to date.
+void selectLods(const Model &model, const Camera &camera, float viewportHeight, float threshold, Buffer<unsigned int> &levels);
+
+}
+}
@@ -0,0 +1,431 @@
+#include "Meshlet.h"
+
+#include "../Framework/JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+
+namespace engine {
+namespace world {
+
+void MeshletBounds::resize(size_t count)
+{
+	for (Buffer<float> *member : { &centerX, &centerY, &centerZ, &radius, &coneAxisX, &coneAxisY, &coneAxisZ, &coneCutoff })
+		member->resize(count);
+}
+
+namespace {
+
+const uint8_t notInMeshlet = 0xff;
+
+struct Vector {
+	float x, y, z;
+
+	float operator[](unsigned int axis) const { return (axis == 0) ? x : ((axis == 1) ? y : z); }
+};
+
+Vector toVector(const geom::point3 &point) { return Vector{ point.x, point.y, point.z }; }
+Vector operator-(const Vector &lhs, const Vector &rhs) { return Vector{ lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z }; }
+float dot(const Vector &lhs, const Vector &rhs) { return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z; }
+Vector cross(const Vector &lhs, const Vector &rhs) { return Vector{ lhs.y * rhs.z - lhs.z * rhs.y, lhs.z * rhs.x - lhs.x * rhs.z, lhs.x * rhs.y - lhs.y * rhs.x }; }
+
+// Ritter's sphere: start from the most distant pair of the extreme points along the axes, then grow.
+void boundingSphere(const Mesh &mesh, const unsigned int *vertices, size_t count, float center[3], float &radius)
+{
+	size_t minimum[3] = {}, maximum[3] = {};
+	for (size_t iVertex = 1; iVertex < count; iVertex++)
+	{
+		const Vector position = toVector(mesh.positions[vertices[iVertex]]);
+		for (unsigned int iAxis = 0; iAxis < 3; iAxis++)
+		{
+			if (position[iAxis] < toVector(mesh.positions[vertices[minimum[iAxis]]])[iAxis])
+				minimum[iAxis] = iVertex;
+			if (position[iAxis] > toVector(mesh.positions[vertices[maximum[iAxis]]])[iAxis])
+				maximum[iAxis] = iVertex;
+		}
+	}
+	unsigned int widest = 0;
+	float widestSquared = -1.f;
+	for (unsigned int iAxis = 0; iAxis < 3; iAxis++)
+	{
+		const Vector span = toVector(mesh.positions[vertices[maximum[iAxis]]]) - toVector(mesh.positions[vertices[minimum[iAxis]]]);
+		if (dot(span, span) > widestSquared)
+		{
+			widestSquared = dot(span, span);
+			widest = iAxis;
+		}
+	}
+	const Vector a = toVector(mesh.positions[vertices[minimum[widest]]]);
+	const Vector b = toVector(mesh.positions[vertices[maximum[widest]]]);
+	center[0] = (a.x + b.x) * 0.5f;
+	center[1] = (a.y + b.y) * 0.5f;
+	center[2] = (a.z + b.z) * 0.5f;
+	radius = std::sqrt(widestSquared) * 0.5f;
+	for (size_t iVertex = 0; iVertex < count; iVertex++)
+	{
+		const Vector offset = toVector(mesh.positions[vertices[iVertex]]) - Vector{ center[0], center[1], center[2] };
+		const float distance = std::sqrt(dot(offset, offset));
+		if (distance > radius)
+		{
+			// Move the center toward the point by half the overshoot.
+			const float grow = (distance - radius) * 0.5f;
+			radius += grow;
+			center[0] += offset.x / distance * grow;
+			center[1] += offset.y / distance * grow;
+			center[2] += offset.z / distance * grow;
+		}
+	}
+}
+
+void computeBounds(const Mesh &mesh, Meshlets &meshlets, size_t iMeshlet)
+{
+	const Meshlet &meshlet = meshlets.meshlets[iMeshlet];
+	const unsigned int *vertices = meshlets.vertices.data() + meshlet.vertexOffset;
+	const uint8_t *triangles = meshlets.triangles.data() + meshlet.triangleOffset;
+	MeshletBounds &bounds = meshlets.bounds;
+
+	float center[3], radius;
+	boundingSphere(mesh, vertices, meshlet.vertexCount, center, radius);
+	bounds.centerX[iMeshlet] = center[0];
+	bounds.centerY[iMeshlet] = center[1];
+	bounds.centerZ[iMeshlet] = center[2];
+	bounds.radius[iMeshlet] = radius;
+
+	// Axis as the mean of the unit normals, the cutoff follows from the widest normal.
+	Vector normals[maxMeshletTriangles];
+	unsigned int normalCount = 0;
+	Vector axis = {};
+	for (uint32_t iTriangle = 0; iTriangle < meshlet.triangleCount; iTriangle++)
+	{
+		const Vector a = toVector(mesh.positions[vertices[triangles[iTriangle * 3 + 0]]]);
+		const Vector b = toVector(mesh.positions[vertices[triangles[iTriangle * 3 + 1]]]);
+		const Vector c = toVector(mesh.positions[vertices[triangles[iTriangle * 3 + 2]]]);
+		const Vector normal = cross(b - a, c - a);
+		const float length = std::sqrt(dot(normal, normal));
+		if (length == 0.f)
+			continue; // Degenerate triangles are never visible
+		normals[normalCount] = Vector{ normal.x / length, normal.y / length, normal.z / length };
+		axis.x += normals[normalCount].x;
+		axis.y += normals[normalCount].y;
+		axis.z += normals[normalCount].z;
+		normalCount++;
+	}
+	const float axisLength = std::sqrt(dot(axis, axis));
+	float minimumDot = -1.f;
+	if (axisLength > 0.f)
+	{
+		axis = Vector{ axis.x / axisLength, axis.y / axisLength, axis.z / axisLength };
+		minimumDot = 1.f;
+		for (unsigned int iNormal = 0; iNormal < normalCount; iNormal++)
+			minimumDot = std::min(minimumDot, dot(normals[iNormal], axis));
+	}
+	bounds.coneAxisX[iMeshlet] = axis.x;
+	bounds.coneAxisY[iMeshlet] = axis.y;
+	bounds.coneAxisZ[iMeshlet] = axis.z;
+	// Cones of 90 degrees or more contain front faces from everywhere.
+	bounds.coneCutoff[iMeshlet] = (minimumDot <= 0.f) ? 1.f : std::sqrt(1.f - minimumDot * minimumDot);
+}
+
+}
+
+Meshlets buildMeshlets(const Mesh &mesh)
+{
+	const size_t vertexCount = mesh.positions.size();
+	const size_t triangleCount = mesh.indices.size() / 3;
+	if (mesh.indices.size() % 3 != 0)
+		throw std::runtime_error("Meshlets need a triangle list");
+	for (unsigned int index : mesh.indices)
+		if (index >= vertexCount)
+			throw std::runtime_error("Index out of the mesh vertices");
+
+	// Triangles of each vertex, in compressed rows.
+	Buffer<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	Buffer<unsigned int> adjacency(mesh.indices.size());
+	for (unsigned int index : mesh.indices)
+		adjacencyOffsets[index + 1]++;
+	for (size_t iVertex = 0; iVertex < vertexCount; iVertex++)
+		adjacencyOffsets[iVertex + 1] += adjacencyOffsets[iVertex];
+	{
+		Buffer<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t iIndex = 0; iIndex < mesh.indices.size(); iIndex++)
+			adjacency[fill[mesh.indices[iIndex]]++] = static_cast<unsigned int>(iIndex / 3);
+	}
+
+	Meshlets meshlets;
+	Buffer<bool> emitted(triangleCount, false);
+	Buffer<uint8_t> local(vertexCount, notInMeshlet);
+	Meshlet current = {};
+	float centroid[3] = {};	// Sum of the meshlet vertex positions
+
+	auto newVertices = [&](size_t iTriangle) {
+		unsigned int count = 0;
+		for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+			count += (local[mesh.indices[iTriangle * 3 + iCorner]] == notInMeshlet) ? 1 : 0;
+		// Repeated vertices in degenerate triangles are counted twice, which is conservative.
+		return count;
+	};
+	auto fits = [&](size_t iTriangle) {
+		return current.triangleCount < maxMeshletTriangles && current.vertexCount + newVertices(iTriangle) <= maxMeshletVertices;
+	};
+	auto flush = [&]() {
+		if (current.triangleCount == 0)
+			return;
+		for (uint32_t iVertex = 0; iVertex < current.vertexCount; iVertex++)
+			local[meshlets.vertices[current.vertexOffset + iVertex]] = notInMeshlet;
+		meshlets.meshlets.push_back(current);
+		current = Meshlet{};
+		current.vertexOffset = static_cast<uint32_t>(meshlets.vertices.size());
+		current.triangleOffset = static_cast<uint32_t>(meshlets.triangles.size());
+		centroid[0] = centroid[1] = centroid[2] = 0.f;
+	};
+	auto emit = [&](size_t iTriangle) {
+		for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+		{
+			const unsigned int vertex = mesh.indices[iTriangle * 3 + iCorner];
+			if (local[vertex] == notInMeshlet)
+			{
+				local[vertex] = static_cast<uint8_t>(current.vertexCount++);
+				meshlets.vertices.push_back(vertex);
+				centroid[0] += mesh.positions[vertex].x;
+				centroid[1] += mesh.positions[vertex].y;
+				centroid[2] += mesh.positions[vertex].z;
+			}
+			meshlets.triangles.push_back(local[vertex]);
+		}
+		current.triangleCount++;
+		emitted[iTriangle] = true;
+	};
+	// Best triangle around the vertices: fewest new vertices, then closest to the meshlet centroid.
+	auto bestAround = [&](const unsigned int *vertices, size_t count) {
+		size_t best = triangleCount;
+		unsigned int bestNew = 4;
+		float bestDistance = HUGE_VALF;
+		const Vector mean = { centroid[0] / current.vertexCount, centroid[1] / current.vertexCount, centroid[2] / current.vertexCount };
+		for (size_t iVertex = 0; iVertex < count; iVertex++)
+		{
+			const unsigned int vertex = vertices[iVertex];
+			for (unsigned int iAdjacent = adjacencyOffsets[vertex]; iAdjacent < adjacencyOffsets[vertex + 1]; iAdjacent++)
+			{
+				const unsigned int iTriangle = adjacency[iAdjacent];
+				if (emitted[iTriangle] || !fits(iTriangle))
+					continue;
+				const unsigned int added = newVertices(iTriangle);
+				if (added > bestNew)
+					continue;
+				Vector center = {};
+				for (unsigned int iCorner = 0; iCorner < 3; iCorner++)
+				{
+					const geom::point3 &position = mesh.positions[mesh.indices[iTriangle * 3 + iCorner]];
+					center.x += position.x / 3.f;
+					center.y += position.y / 3.f;
+					center.z += position.z / 3.f;
+				}
+				const Vector offset = center - mean;
+				const float distance = dot(offset, offset);
+				if (added < bestNew || distance < bestDistance)
+				{
+					best = iTriangle;
+					bestNew = added;
+					bestDistance = distance;
+				}
+			}
+		}
+		return best;
+	};
+
+	size_t seed = 0; // Triangles before it are emitted
+	size_t last = triangleCount;
+	while (true)
+	{
+		size_t next = triangleCount;
+		if (last != triangleCount)
+		{
+			// Grow around the last triangle first, then around the whole meshlet.
+			const unsigned int corners[3] = { mesh.indices[last * 3], mesh.indices[last * 3 + 1], mesh.indices[last * 3 + 2] };
+			next = bestAround(corners, 3);
+			if (next == triangleCount)
+				next = bestAround(meshlets.vertices.data() + current.vertexOffset, current.vertexCount);
+		}
+		if (next == triangleCount)
+		{
+			// Disconnected, continue with the next triangle in order, which is close after optimizeVertexCache.
+			while (seed < triangleCount && emitted[seed])
+				seed++;
+			if (seed == triangleCount)
+				break;
+			next = seed;
+			if (!fits(next))
+				flush();
+		}
+		emit(next);
+		last = next;
+		if (current.triangleCount == maxMeshletTriangles || current.vertexCount == maxMeshletVertices)
+		{
+			flush();
+			last = triangleCount;
+		}
+	}
+	flush();
+
+	meshlets.bounds.resize(meshlets.meshlets.size());
+	for (size_t iMeshlet = 0; iMeshlet < meshlets.meshlets.size(); iMeshlet++)
+		computeBounds(mesh, meshlets, iMeshlet);
+	return meshlets;
+}
+
+namespace {
+
+// Planes pointing inside, normalized so that the distance to a sphere center is in mesh units.
+struct CullingPlanes {
+	float x[6], y[6], z[6], w[6];
+};
+
+CullingPlanes extractPlanes(const geom::mat4 &viewProjection)
+{
+	// Gribb & Hartmann, planes are combinations of the matrix rows.
+	CullingPlanes planes;
+	auto row = [&](unsigned int iRow, float out[4]) {
+		for (unsigned int iCol = 0; iCol < 4; iCol++)
+			out[iCol] = viewProjection[iCol][iRow];
+	};
+	float rows[4][4];
+	for (unsigned int iRow = 0; iRow < 4; iRow++)
+		row(iRow, rows[iRow]);
+	for (unsigned int iPlane = 0; iPlane < 6; iPlane++)
+	{
+		const float sign = (iPlane % 2 == 0) ? 1.f : -1.f;
+		const float *axis = rows[iPlane / 2];
+		float plane[4];
+		for (unsigned int iComponent = 0; iComponent < 4; iComponent++)
+			plane[iComponent] = rows[3][iComponent] + sign * axis[iComponent];
+		const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		const float scale = (length > 0.f) ? 1.f / length : 0.f;
+		planes.x[iPlane] = plane[0] * scale;
+		planes.y[iPlane] = plane[1] * scale;
+		planes.z[iPlane] = plane[2] * scale;
+		planes.w[iPlane] = plane[3] * scale;
+	}
+	return planes;
+}
+
+void cullRange(const Meshlets &meshlets, const CullingPlanes &planes, const Vector &camera, size_t begin, size_t end, Buffer<uint32_t> &visible, MeshletCullingStatistics &statistics)
+{
+	const MeshletBounds &bounds = meshlets.bounds;
+	for (size_t iMeshlet = begin; iMeshlet < end; iMeshlet++)
+	{
+		const float x = bounds.centerX[iMeshlet], y = bounds.centerY[iMeshlet], z = bounds.centerZ[iMeshlet];
+		const float radius = bounds.radius[iMeshlet];
+		bool inside = true;
+		for (unsigned int iPlane = 0; iPlane < 6; iPlane++)
+			inside &= (planes.x[iPlane] * x + planes.y[iPlane] * y + planes.z[iPlane] * z + planes.w[iPlane] >= -radius);
+		if (!inside)
+		{
+			statistics.frustumCulled++;
+			continue;
+		}
+		const float dx = x - camera.x, dy = y - camera.y, dz = z - camera.z;
+		const float along = dx * bounds.coneAxisX[iMeshlet] + dy * bounds.coneAxisY[iMeshlet] + dz * bounds.coneAxisZ[iMeshlet];
+		if (along >= bounds.coneCutoff[iMeshlet] * std::sqrt(dx * dx + dy * dy + dz * dz) + radius)
+		{
+			statistics.coneCulled++;
+			continue;
+		}
+		visible.push_back(static_cast<uint32_t>(iMeshlet));
+		statistics.visibleTriangles += meshlets.meshlets[iMeshlet].triangleCount;
+	}
+}
+
+MeshletCullingStatistics initStatistics(const Meshlets &meshlets)
+{
+	MeshletCullingStatistics statistics = {};
+	statistics.meshlets = meshlets.meshlets.size();
+	statistics.triangles = meshlets.triangles.size() / 3;
+	return statistics;
+}
+
+}
+
+MeshletCullingStatistics cullMeshlets(const Meshlets &meshlets, const geom::mat4 &viewProjection, const geom::point3 &camera, Buffer<uint32_t> &visible)
+{
+	MeshletCullingStatistics statistics = initStatistics(meshlets);
+	const size_t first = visible.size();
+	cullRange(meshlets, extractPlanes(viewProjection), toVector(camera), 0, meshlets.meshlets.size(), visible, statistics);
+	statistics.visibleMeshlets = visible.size() - first;
+	return statistics;
+}
+
+MeshletCullingStatistics cullMeshlets(job::Scheduler &scheduler, const Meshlets &meshlets, const geom::mat4 &viewProjection, const geom::point3 &camera, Buffer<uint32_t> &visible)
+{
+	// Ranges large enough to amortize a job, a few per thread to balance the uneven ones.
+	const size_t count = meshlets.meshlets.size();
+	const size_t rangeSize = std::max<size_t>(1024, count / ((scheduler.threadCount() + 1) * 4) + 1);
+	const size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+	const CullingPlanes planes = extractPlanes(viewProjection);
+	const Vector eye = toVector(camera);
+	Buffer<Buffer<uint32_t>> rangeVisible(rangeCount);
+	Buffer<MeshletCullingStatistics> rangeStatistics(rangeCount, MeshletCullingStatistics{});
+	Buffer<job::Handle> jobs;
+	for (size_t iRange = 0; iRange < rangeCount; iRange++)
+	{
+		jobs.push_back(scheduler.add([&, iRange]() {
+			cullRange(meshlets, planes, eye, iRange * rangeSize, std::min(count, (iRange + 1) * rangeSize), rangeVisible[iRange], rangeStatistics[iRange]);
+		}));
+	}
+	// Wait for every job before rethrowing, they reference the buffers above.
+	std::exception_ptr error;
+	for (const job::Handle &handle : jobs)
+	{
+		try { scheduler.wait(handle); }
+		catch (...) { if (!error) error = std::current_exception(); }
+	}
+	if (error)
+		std::rethrow_exception(error);
+
+	MeshletCullingStatistics statistics = initStatistics(meshlets);
+	for (size_t iRange = 0; iRange < rangeCount; iRange++)
+	{
+		visible.insert(visible.end(), rangeVisible[iRange].begin(), rangeVisible[iRange].end());
+		statistics.visibleMeshlets += rangeVisible[iRange].size();
+		statistics.frustumCulled += rangeStatistics[iRange].frustumCulled;
+		statistics.coneCulled += rangeStatistics[iRange].coneCulled;
+		statistics.visibleTriangles += rangeStatistics[iRange].visibleTriangles;
+	}
+	return statistics;
+}
+
+void benchmarkMeshlets(job::Scheduler &scheduler, const Mesh &mesh, const geom::mat4 &viewProjection, const geom::point3 &camera, unsigned int iterations, double &buildTime, double &serialTime, double &parallelTime)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	const Meshlets meshlets = buildMeshlets(mesh);
+	auto end = std::chrono::high_resolution_clock::now();
+	buildTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+	Buffer<uint32_t> serial, parallel;
+	serial.reserve(meshlets.meshlets.size());
+	parallel.reserve(meshlets.meshlets.size());
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int iIteration = 0; iIteration < iterations; iIteration++)
+	{
+		serial.clear();
+		cullMeshlets(meshlets, viewProjection, camera, serial);
+	}
+	end = std::chrono::high_resolution_clock::now();
+	serialTime = std::chrono::duration<double, std::milli>(end - start).count() / std::max(iterations, 1U);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int iIteration = 0; iIteration < iterations; iIteration++)
+	{
+		parallel.clear();
+		cullMeshlets(scheduler, meshlets, viewProjection, camera, parallel);
+	}
+	end = std::chrono::high_resolution_clock::now();
+	parallelTime = std::chrono::duration<double, std::milli>(end - start).count() / std::max(iterations, 1U);
+	if (serial != parallel)
+		throw std::logic_error("Serial & parallel culling differ");
+}
+
+}
+}
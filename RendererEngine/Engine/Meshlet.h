@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Model.h"
+
+#include <stdint.h>
+
+namespace engine {
+
+namespace job {
+class Scheduler;
+}
+
+namespace world {
+
+// Clusters of triangles small enough to be culled & drawn as a unit.
+// Limits of the common mesh shader sizes: 124 triangles keep the local indices within 372 bytes.
+static const unsigned int maxMeshletVertices = 64;
+static const unsigned int maxMeshletTriangles = 124;
+
+struct Meshlet {
+	uint32_t vertexOffset;		// Into Meshlets::vertices
+	uint32_t triangleOffset;	// Into Meshlets::triangles, 3 local indices per triangle
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+
+// Culling data, an array per member so that the culling loop streams only what it reads.
+// The cone contains every triangle normal of the meshlet. A meshlet is backfacing from every
+// point p where dot(normalize(center - p), coneAxis) >= coneCutoff, with the radius as margin.
+struct MeshletBounds {
+	Buffer<float> centerX, centerY, centerZ, radius;	// Bounding sphere
+	Buffer<float> coneAxisX, coneAxisY, coneAxisZ;
+	Buffer<float> coneCutoff;	// Sine of the cone half angle, 1 when the cone is too wide to cull
+
+	size_t size() const { return radius.size(); }
+	void resize(size_t count);
+};
+
+struct Meshlets {
+	Buffer<Meshlet> meshlets;
+	Buffer<unsigned int> vertices;	// Mesh vertex of each meshlet vertex
+	Buffer<uint8_t> triangles;		// Meshlet vertex of each triangle corner
+	MeshletBounds bounds;
+};
+
+// Split the triangles into meshlets, growing each one through adjacent triangles that add the fewest
+// vertices so that meshlets are compact & their bounds tight. Run after optimizeVertexCache.
+Meshlets buildMeshlets(const Mesh &mesh);
+
+struct MeshletCullingStatistics {
+	size_t meshlets, visibleMeshlets;
+	size_t frustumCulled, coneCulled;	// Meshlets
+	size_t triangles, visibleTriangles;
+};
+
+// Append the index of every meshlet intersecting the frustum & not backfacing, in meshlet order.
+// viewProjection & camera are in mesh space, that is with the model matrix applied.
+MeshletCullingStatistics cullMeshlets(const Meshlets &meshlets, const geom::mat4 &viewProjection, const geom::point3 &camera, Buffer<uint32_t> &visible);
+// Same result, with ranges of meshlets culled by jobs.
+MeshletCullingStatistics cullMeshlets(job::Scheduler &scheduler, const Meshlets &meshlets, const geom::mat4 &viewProjection, const geom::point3 &camera, Buffer<uint32_t> &visible);
+
+// Return the time in milliseconds to build the meshlets of the mesh, and to cull them
+// serially & with jobs, averaged over the iterations.
+void benchmarkMeshlets(job::Scheduler &scheduler, const Mesh &mesh, const geom::mat4 &viewProjection, const geom::point3 &camera, unsigned int iterations, double &buildTime, double &serialTime, double &parallelTime);
+
+}
+}
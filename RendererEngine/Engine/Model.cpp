@@ -1,5 +1,9 @@
 #include "Model.h"
 
+#include "../Framework/JobSystem.h"
+
+#include <algorithm>
+#include <exception>
 
 namespace engine {
 
@@ -21,8 +25,159 @@ bool Node::isRoot() const
 	return parent == nullptr;
 }
 
+void Hierarchy::build(const Buffer<Node> &nodes)
+{
+	const unsigned int count = static_cast<unsigned int>(nodes.size());
+	// Children lists, stored as first child / next sibling to avoid allocations per node.
+	Buffer<unsigned int> firstChild(count, invalid);
+	Buffer<unsigned int> nextSibling(count, invalid);
+	Buffer<unsigned int> roots;
+	for (unsigned int iNode = count; iNode-- > 0;)
+	{
+		if (nodes[iNode].isRoot())
+		{
+			roots.push_back(iNode);
+			continue;
+		}
+		unsigned int parent = static_cast<unsigned int>(nodes[iNode].parent - nodes.data());
+		nextSibling[iNode] = firstChild[parent];
+		firstChild[parent] = iNode;
+	}
+
+	parents.resize(count);
+	subtreeSizes.resize(count);
+	locals.resize(count);
+	worlds.resize(count);
+	dirty.assign(count, 1);
+	flatIndices.resize(count);
+	nodeIndices.resize(count);
+
+	// Depth first traversal, roots in the order of Model::nodes.
+	Buffer<unsigned int> stack(roots.begin(), roots.end());
+	unsigned int flat = 0;
+	while (!stack.empty())
+	{
+		unsigned int iNode = stack.back();
+		stack.pop_back();
+		flatIndices[iNode] = flat;
+		nodeIndices[flat] = iNode;
+		locals[flat] = nodes[iNode].transform;
+		parents[flat] = nodes[iNode].isRoot() ? invalid : flatIndices[nodes[iNode].parent - nodes.data()];
+		flat++;
+		// Push in reverse so that the first child is processed first.
+		unsigned int childCount = 0;
+		for (unsigned int iChild = firstChild[iNode]; iChild != invalid; iChild = nextSibling[iChild])
+		{
+			stack.push_back(iChild);
+			childCount++;
+		}
+		std::reverse(stack.end() - childCount, stack.end());
+	}
+	// Subtree sizes, children are always after their parent.
+	for (unsigned int iFlat = 0; iFlat < count; iFlat++)
+		subtreeSizes[iFlat] = 1;
+	for (unsigned int iFlat = count; iFlat-- > 0;)
+		if (parents[iFlat] != invalid)
+			subtreeSizes[parents[iFlat]] += subtreeSizes[iFlat];
+}
+
+void Hierarchy::setTransform(unsigned int node, const geom::mat4 &transform)
+{
+	unsigned int iFlat = flatIndices[node];
+	locals[iFlat] = transform;
+	dirty[iFlat] = 1;
+}
+
+void Hierarchy::update()
+{
+	updateRange(0, size());
+}
+
+void Hierarchy::update(job::Scheduler &scheduler)
+{
+	const unsigned int count = size();
+	const unsigned int minNodesPerJob = 4096;
+	const unsigned int jobCount = std::min<unsigned int>(scheduler.threadCount() + 1, count / minNodesPerJob);
+	if (jobCount <= 1)
+	{
+		updateRange(0, count);
+		return;
+	}
+	// Subtrees are contiguous & independent once the world transform of their parent is known.
+	// Walk the nodes in order: a subtree small enough is appended to the current range & skipped,
+	// a larger one has its root updated here, then its children are walked. Consecutive small
+	// subtrees are merged in ranges of roughly rangeSize nodes, each updated by a job.
+	Buffer<job::Handle> jobs;
+	Buffer<unsigned int> splitRoots;	// Updated here, their flags are read by the jobs
+	const unsigned int rangeSize = (count + jobCount - 1) / jobCount;
+	unsigned int begin = 0, end = 0;
+	auto flush = [&]() {
+		if (end > begin)
+			jobs.push_back(scheduler.add([this, begin, end]() { updateRange(begin, end); }));
+	};
+	for (unsigned int iFlat = 0; iFlat < count;)
+	{
+		const unsigned int subtreeSize = subtreeSizes[iFlat];
+		if (subtreeSize > rangeSize)
+		{
+			flush();
+			begin = end = iFlat + 1;
+			updateNode(iFlat);
+			splitRoots.push_back(iFlat);
+			iFlat++;
+			continue;
+		}
+		if (end - begin + subtreeSize > rangeSize)
+		{
+			flush();
+			begin = iFlat;
+		}
+		end = iFlat + subtreeSize;
+		iFlat = end;
+	}
+	flush();
+	// Wait for every job before rethrowing, they write the transforms.
+	std::exception_ptr error;
+	for (const job::Handle &handle : jobs)
+	{
+		try { scheduler.wait(handle); }
+		catch (...) { if (!error) error = std::current_exception(); }
+	}
+	for (unsigned int iFlat : splitRoots)
+		dirty[iFlat] = 0;
+	if (error)
+		std::rethrow_exception(error);
+}
 
+void Hierarchy::updateNode(unsigned int node)
+{
+	const unsigned int parent = parents[node];
+	if (parent == invalid)
+	{
+		if (dirty[node])
+			worlds[node] = locals[node];
+		return;
+	}
+	// Parent was processed before, propagate its dirty flag down.
+	if (dirty[parent])
+		dirty[node] = 1;
+	if (dirty[node])
+		worlds[node] = worlds[parent] * locals[node];
 }
 
+void Hierarchy::updateRange(unsigned int begin, unsigned int end)
+{
+	for (unsigned int iFlat = begin; iFlat < end; iFlat++)
+		updateNode(iFlat);
+	// Flags are only read from inside the range, clear them once all children are done.
+	std::fill(dirty.begin() + begin, dirty.begin() + end, 0);
 }
 
+const geom::mat4 &Hierarchy::getModel(unsigned int node) const
+{
+	return worlds[flatIndices[node]];
+}
+
+}
+
+}
@@ -2,13 +2,47 @@
 
 #include "Config.h"
 
+#include "../Framework/MappedFile.h"
+
+#include <string>
+
 namespace engine {
+
+namespace job {
+class Scheduler;
+}
+
 namespace world {
 
+// Contiguous elements, either viewed in memory kept alive by the Model (mapped files),
+// or owned when the source data had to be converted.
+template <typename T>
+struct Stream {
+	Stream() : m_view(nullptr), m_size(0) {}
+
+	// Reference external elements, no copy.
+	void view(const T *data, size_t size) { m_storage.clear(); m_view = data; m_size = size; }
+	// Switch to owned elements.
+	Buffer<T> &own() { m_view = nullptr; m_size = 0; return m_storage; }
+	bool isView() const { return m_view != nullptr; }
+
+	const T *data() const { return (m_view != nullptr) ? m_view : m_storage.data(); }
+	size_t size() const { return (m_view != nullptr) ? m_size : m_storage.size(); }
+	const T &operator[](size_t index) const { return data()[index]; }
+	const T *begin() const { return data(); }
+	const T *end() const { return data() + size(); }
+private:
+	const T *m_view;
+	size_t m_size;
+	Buffer<T> m_storage;
+};
+
 struct Texture {
 	unsigned int ID;
 	Buffer<unsigned char> bytes;
 	unsigned int width, height, components;
+	std::string path; // Source image, bytes are empty until decoded
+	Stream<unsigned char> encoded; // Source image embedded in the model when path is empty, PNG or JPEG
 };
 
 struct TextureHDR {
@@ -31,13 +65,27 @@ struct Material {
 	float roughness;
 };
 
+// Coarser triangle list over the vertices of a mesh.
+struct Lod {
+	Buffer<unsigned int> indices;
+	float error;	// Distance to the full detail surface, in mesh units
+};
+
+// Levels of detail of a mesh, see generateLods.
+struct LodChain {
+	Buffer<Lod> levels;		// Coarser & coarser, the mesh indices are the level 0 and are not stored
+	geom::point3 center;	// Bounding sphere of the mesh, to measure the error on screen
+	float radius = 0.f;
+};
+
 struct Mesh {
 	Material *material;
-	Buffer<geom::point3> positions;
-	Buffer<geom::norm3> normals;
-	Buffer<geom::uv2> texcoords[static_cast<unsigned int>(TextureType::NB_TEXTURE_TYPE)];
-	Buffer<geom::color32> colors;
-	Buffer<unsigned int> indices;
+	Stream<geom::point3> positions;
+	Stream<geom::norm3> normals;
+	Stream<geom::uv2> texcoords[static_cast<unsigned int>(TextureType::NB_TEXTURE_TYPE)];
+	Stream<geom::color32> colors;
+	Stream<unsigned int> indices;
+	LodChain lods;
 
 	bool hasNormals() const { return normals.size() > 0; }
 	bool hasTexcoords(TextureType type) const { return texcoords[static_cast<unsigned int>(type)].size() > 0; }
@@ -52,11 +100,43 @@ struct Node {
 	Node *parent;			// Parent of the node
 
 	// Get the model matrix computed from parents nodes.
+	// Walk the whole parent chain, use Hierarchy when updating many nodes.
 	geom::mat4 getModel() const;
 	// Is it a root node ?
 	bool isRoot() const;
 };
 
+// Flattened node hierarchy.
+// Nodes are stored depth first, parent before child, so that a subtree is a
+// contiguous range and world transforms are computed in one linear pass.
+struct Hierarchy {
+	static const unsigned int invalid = ~0U;
+
+	// Build from nodes linked with parent pointers.
+	void build(const Buffer<Node> &nodes);
+	// Set the local transform of a node and mark its subtree as dirty.
+	void setTransform(unsigned int node, const geom::mat4 &transform);
+	// Compute the world transforms of every dirty subtree.
+	void update();
+	// Same result, with ranges of subtrees updated by jobs. Subtrees too large for a job, at any
+	// depth, have their root updated first & their children subtrees split in turn.
+	void update(job::Scheduler &scheduler);
+
+	const geom::mat4 &getModel(unsigned int node) const;
+	unsigned int size() const { return static_cast<unsigned int>(locals.size()); }
+
+	Buffer<unsigned int> parents;		// Flattened index of the parent, invalid for roots
+	Buffer<unsigned int> subtreeSizes;	// Number of nodes in the subtree, including itself
+	Buffer<geom::mat4> locals;			// Local transforms
+	Buffer<geom::mat4> worlds;			// World transforms
+	Buffer<unsigned char> dirty;		// Local transform changed since last update
+	Buffer<unsigned int> flatIndices;	// Flattened index of each Model::nodes
+	Buffer<unsigned int> nodeIndices;	// Model::nodes index of each flattened node
+private:
+	void updateNode(unsigned int node);
+	void updateRange(unsigned int begin, unsigned int end);
+};
+
 struct Model {
 	Buffer<Texture> textures;
 	Buffer<TextureHDR> texturesHDR;
@@ -64,6 +144,11 @@ struct Model {
 	Buffer<Mesh> meshes;
 
 	Buffer<Node> nodes;
+	Hierarchy hierarchy;
+
+	// Storage viewed by the mesh streams.
+	Buffer<io::MappedFile> files;
+	Buffer<Buffer<unsigned char>> blobs;
 };
 
 }
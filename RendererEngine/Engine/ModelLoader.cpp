@@ -1,34 +1,860 @@
 #include "ModelLoader.h"
 #include "Config.h"
+#include "GLTF.h"
 
+#include "../Framework/Image.h"
+#include "../Framework/MappedFile.h"
 #include "../Framework/json.h"
 
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+
 namespace engine {
 namespace world {
 
+// Bytes of a glTF buffer, owned by the model.
+struct Span {
+	const unsigned char *data;
+	size_t size;
+};
+
+// Accessor resolved to its bytes.
+struct Source {
+	const unsigned char *data;	// First element, null if the accessor has no buffer view
+	size_t stride;
+	size_t count;
+	gltf::ComponentType componentType;
+	unsigned int components;
+	bool normalized;
+};
+
+static size_t componentSize(gltf::ComponentType type)
+{
+	switch (type)
+	{
+	case gltf::ComponentType::BYTE:
+	case gltf::ComponentType::UNSIGNED_BYTE:
+		return 1;
+	case gltf::ComponentType::SHORT:
+	case gltf::ComponentType::UNSIGNED_SHORT:
+		return 2;
+	case gltf::ComponentType::UNSIGNED_INT:
+	case gltf::ComponentType::FLOAT:
+		return 4;
+	default:
+		throw std::runtime_error("Invalid component type");
+	}
+}
+
+static unsigned int componentCount(gltf::AccessorType type)
+{
+	switch (type)
+	{
+	case gltf::AccessorType::SCALAR: return 1;
+	case gltf::AccessorType::VEC2: return 2;
+	case gltf::AccessorType::VEC3: return 3;
+	case gltf::AccessorType::VEC4: return 4;
+	case gltf::AccessorType::MAT2: return 4;
+	case gltf::AccessorType::MAT3: return 9;
+	case gltf::AccessorType::MAT4: return 16;
+	default: return 0;
+	}
+}
+
+static Buffer<unsigned char> decodeBase64(std::string_view str)
+{
+	auto decode = [](char c) -> int {
+		if (c >= 'A' && c <= 'Z') return c - 'A';
+		if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+		if (c >= '0' && c <= '9') return c - '0' + 52;
+		if (c == '+') return 62;
+		if (c == '/') return 63;
+		return -1;
+	};
+	Buffer<unsigned char> bytes;
+	bytes.reserve(str.size() / 4 * 3);
+	uint32_t bits = 0;
+	unsigned int count = 0;
+	for (char c : str)
+	{
+		if (c == '=')
+			break;
+		const int value = decode(c);
+		if (value < 0)
+			throw std::runtime_error("Invalid base64 data");
+		bits = (bits << 6) | static_cast<uint32_t>(value);
+		if (++count == 4)
+		{
+			bytes.push_back(static_cast<unsigned char>(bits >> 16));
+			bytes.push_back(static_cast<unsigned char>(bits >> 8));
+			bytes.push_back(static_cast<unsigned char>(bits));
+			bits = 0;
+			count = 0;
+		}
+	}
+	if (count == 2)
+		bytes.push_back(static_cast<unsigned char>(bits >> 4));
+	else if (count == 3)
+	{
+		bytes.push_back(static_cast<unsigned char>(bits >> 10));
+		bytes.push_back(static_cast<unsigned char>(bits >> 2));
+	}
+	return bytes;
+}
+
+// Map external buffers, decode embedded ones. Storage is kept alive by the model.
+static Span loadBuffer(Model &model, const gltf::Buffer &buffer, const std::string &directory, const Span &binary)
+{
+	const std::string_view uri = buffer.uri;
+	if (uri.empty())
+	{
+		// GLB binary chunk, may be padded
+		if (binary.data == nullptr || binary.size < buffer.byteLength)
+			throw std::runtime_error("Missing GLB binary chunk");
+		return Span{ binary.data, buffer.byteLength };
+	}
+	if (uri.substr(0, 5) == "data:")
+	{
+		const size_t comma = uri.find(',');
+		if (comma == std::string_view::npos || uri.substr(0, comma).find(";base64") == std::string_view::npos)
+			throw std::runtime_error("Unsupported data uri");
+		model.blobs.push_back(decodeBase64(uri.substr(comma + 1)));
+		const Buffer<unsigned char> &blob = model.blobs.back();
+		if (blob.size() < buffer.byteLength)
+			throw std::runtime_error("Buffer too small");
+		return Span{ blob.data(), buffer.byteLength };
+	}
+	const std::string path = directory + buffer.uri;
+	io::MappedFile file(path.c_str());
+	if (!file.isOpen())
+		throw std::runtime_error("Could not open " + path);
+	if (file.size() < buffer.byteLength)
+		throw std::runtime_error("Buffer too small " + path);
+	// Mapping address does not change when the file is moved.
+	const Span span{ file.data(), buffer.byteLength };
+	model.files.push_back(std::move(file));
+	return span;
+}
+
+static Source resolve(const gltf::Document &document, const Buffer<Span> &buffers, int index)
+{
+	if (index < 0 || static_cast<size_t>(index) >= document.accessors.size())
+		throw std::runtime_error("Invalid accessor");
+	const gltf::Accessor &accessor = document.accessors[index];
+	Source source;
+	source.data = nullptr;
+	source.count = accessor.count;
+	source.componentType = accessor.componentType;
+	source.components = componentCount(accessor.type);
+	source.normalized = accessor.normalized;
+	const size_t elementSize = componentSize(accessor.componentType) * source.components;
+	source.stride = elementSize;
+	if (accessor.bufferView == gltf::invalid)
+		return source; // Zeros
+	if (accessor.bufferView < 0 || static_cast<size_t>(accessor.bufferView) >= document.bufferViews.size())
+		throw std::runtime_error("Invalid buffer view");
+	const gltf::BufferView &view = document.bufferViews[accessor.bufferView];
+	if (view.buffer < 0 || static_cast<size_t>(view.buffer) >= buffers.size())
+		throw std::runtime_error("Invalid buffer");
+	const Span &buffer = buffers[view.buffer];
+	if (view.byteOffset > buffer.size || view.byteLength > buffer.size - view.byteOffset)
+		throw std::runtime_error("Buffer view out of bounds");
+	if (view.byteStride != 0)
+		source.stride = view.byteStride;
+	if (source.count > 0 && (accessor.byteOffset > view.byteLength ||
+		(source.count - 1) * source.stride + elementSize > view.byteLength - accessor.byteOffset))
+		throw std::runtime_error("Accessor out of bounds");
+	source.data = buffer.data + view.byteOffset + accessor.byteOffset;
+	return source;
+}
+
+static double readComponent(io::BinaryReader &reader, gltf::ComponentType type, bool normalized)
+{
+	switch (type)
+	{
+	case gltf::ComponentType::BYTE: {
+		const double value = reader.read<int8_t>();
+		return normalized ? std::fmax(value / 127.0, -1.0) : value;
+	}
+	case gltf::ComponentType::UNSIGNED_BYTE: {
+		const double value = reader.read<uint8_t>();
+		return normalized ? value / 255.0 : value;
+	}
+	case gltf::ComponentType::SHORT: {
+		const double value = reader.read<int16_t>();
+		return normalized ? std::fmax(value / 32767.0, -1.0) : value;
+	}
+	case gltf::ComponentType::UNSIGNED_SHORT: {
+		const double value = reader.read<uint16_t>();
+		return normalized ? value / 65535.0 : value;
+	}
+	case gltf::ComponentType::UNSIGNED_INT:
+		return reader.read<uint32_t>();
+	case gltf::ComponentType::FLOAT:
+		return reader.read<float>();
+	default:
+		throw std::runtime_error("Invalid component type");
+	}
+}
+
+// View the accessor in place when it is tightly packed with the layout of T,
+// convert it into owned elements otherwise.
+template <typename T, typename Convert>
+static void load(Stream<T> &stream, const Source &source, gltf::ComponentType type, unsigned int components, Convert convert)
+{
+	if (source.data != nullptr && source.componentType == type && source.components == components &&
+		source.stride == sizeof(T) && reinterpret_cast<uintptr_t>(source.data) % alignof(T) == 0)
+	{
+		stream.view(reinterpret_cast<const T*>(source.data), source.count);
+		return;
+	}
+	Buffer<T> &values = stream.own();
+	values.resize(source.count);
+	if (source.count == 0)
+		return;
+	const double zero[4] = { 0.0, 0.0, 0.0, 0.0 };
+	if (source.data == nullptr)
+	{
+		for (T &value : values)
+			value = convert(zero);
+		return;
+	}
+	const size_t elementSize = componentSize(source.componentType) * source.components;
+	io::BinaryReader reader(source.data, (source.count - 1) * source.stride + elementSize);
+	for (size_t iElement = 0; iElement < source.count; iElement++)
+	{
+		reader.seek(iElement * source.stride);
+		double value[4] = { 0.0, 0.0, 0.0, 1.0 };
+		for (unsigned int iComponent = 0; iComponent < source.components && iComponent < 4; iComponent++)
+			value[iComponent] = readComponent(reader, source.componentType, source.normalized);
+		values[iElement] = convert(value);
+	}
+}
+
+static geom::mat4 transform(const gltf::Node &node)
+{
+	if (node.hasMatrix)
+	{
+		const float *m = node.matrix; // Column major
+		return geom::mat4(
+			geom::col4(m[0], m[1], m[2], m[3]),
+			geom::col4(m[4], m[5], m[6], m[7]),
+			geom::col4(m[8], m[9], m[10], m[11]),
+			geom::col4(m[12], m[13], m[14], m[15])
+		);
+	}
+	return geom::mat4::TRS(
+		geom::vec3(node.translation[0], node.translation[1], node.translation[2]),
+		geom::quat(node.rotation[0], node.rotation[1], node.rotation[2], node.rotation[3]),
+		geom::vec3(node.scale[0], node.scale[1], node.scale[2])
+	);
+}
+
+// Document & buffers shared by the loading stages, buffer storage is kept alive by the model.
+struct Scene {
+	gltf::Document document;
+	Buffer<Span> buffers;
+	Buffer<const gltf::Primitive*> primitives;	// Source of each model mesh
+	Buffer<Material*> materials;				// Material of each model mesh
+};
+
+static std::string directoryOf(std::string_view path)
+{
+	const size_t separator = path.find_last_of("/\\");
+	return std::string(path.substr(0, (separator == std::string_view::npos) ? 0 : separator + 1));
+}
+
+// Everything but vertex data & texels. Meshes are left empty, nodes reference them already.
+static void prepare(Model &model, Scene &scene, std::string_view json, const std::string &directory, const Span &binary)
+{
+	scene.document = gltf::parse(json);
+	const gltf::Document &document = scene.document;
+
+	// Buffers, only touched pages of mapped files will be read.
+	scene.buffers.reserve(document.buffers.size());
+	for (const gltf::Buffer &buffer : document.buffers)
+		scene.buffers.push_back(loadBuffer(model, buffer, directory, binary));
+
+	// Textures, decoded later from their path or their bytes embedded in a buffer view or a data uri.
+	model.textures.resize(document.textures.size());
+	for (size_t iTexture = 0; iTexture < document.textures.size(); iTexture++)
+	{
+		Texture &texture = model.textures[iTexture];
+		texture.ID = 0;
+		texture.width = texture.height = texture.components = 0;
+		const int source = document.textures[iTexture].source;
+		if (source < 0 || static_cast<size_t>(source) >= document.images.size())
+			continue;
+		const gltf::Image &image = document.images[source];
+		if (image.bufferView >= 0)
+		{
+			if (static_cast<size_t>(image.bufferView) >= document.bufferViews.size())
+				throw std::runtime_error("Invalid image buffer view");
+			const gltf::BufferView &view = document.bufferViews[image.bufferView];
+			if (view.buffer < 0 || static_cast<size_t>(view.buffer) >= scene.buffers.size() || view.byteOffset + view.byteLength > scene.buffers[view.buffer].size)
+				throw std::runtime_error("Image out of its buffer");
+			texture.encoded.view(scene.buffers[view.buffer].data + view.byteOffset, view.byteLength);
+		}
+		else if (image.uri.compare(0, 5, "data:") == 0)
+		{
+			const std::string_view uri = image.uri;
+			const size_t comma = uri.find(',');
+			if (comma == std::string_view::npos || uri.substr(0, comma).find(";base64") == std::string_view::npos)
+				throw std::runtime_error("Unsupported data uri");
+			model.blobs.push_back(decodeBase64(uri.substr(comma + 1)));
+			texture.encoded.view(model.blobs.back().data(), model.blobs.back().size());
+		}
+		else if (!image.uri.empty())
+		{
+			texture.path = directory + image.uri;
+		}
+	}
+
+	// Materials
+	auto getTexture = [&](const gltf::TextureInfo &info) -> Texture* {
+		if (info.index < 0 || static_cast<size_t>(info.index) >= model.textures.size())
+			return nullptr;
+		return &model.textures[info.index];
+	};
+	model.materials.resize(document.materials.size());
+	for (size_t iMaterial = 0; iMaterial < document.materials.size(); iMaterial++)
+	{
+		const gltf::Material &source = document.materials[iMaterial];
+		Material &material = model.materials[iMaterial];
+		material.texture[static_cast<unsigned int>(TextureType::ALBEDO)] = getTexture(source.baseColorTexture);
+		material.texture[static_cast<unsigned int>(TextureType::NORMAL)] = getTexture(source.normalTexture);
+		material.texture[static_cast<unsigned int>(TextureType::METALLICNESS)] = getTexture(source.metallicRoughnessTexture);
+		material.color = geom::colorHDR(source.baseColorFactor[0], source.baseColorFactor[1], source.baseColorFactor[2], source.baseColorFactor[3]);
+		material.metallicness = source.metallicFactor;
+		material.roughness = source.roughnessFactor;
+	}
+
+	// Meshes, one per triangle primitive. Other modes are not supported by the renderers.
+	const int triangles = 4;
+	Buffer<size_t> firstMesh(document.meshes.size() + 1, 0);
+	for (size_t iMesh = 0; iMesh < document.meshes.size(); iMesh++)
+	{
+		for (const gltf::Primitive &primitive : document.meshes[iMesh].primitives)
+		{
+			if (primitive.mode != triangles)
+				continue;
+			Material *material = nullptr;
+			if (primitive.material >= 0 && static_cast<size_t>(primitive.material) < document.materials.size())
+				material = &model.materials[primitive.material];
+			scene.primitives.push_back(&primitive);
+			scene.materials.push_back(material);
+		}
+		firstMesh[iMesh + 1] = scene.primitives.size();
+	}
+	model.meshes.resize(scene.primitives.size());
+	for (size_t iMesh = 0; iMesh < model.meshes.size(); iMesh++)
+		model.meshes[iMesh].material = scene.materials[iMesh];
+
+	// Nodes, primitives after the first one of a mesh are attached to extra child nodes.
+	size_t nodeCount = document.nodes.size();
+	for (const gltf::Node &node : document.nodes)
+	{
+		if (node.mesh < 0 || static_cast<size_t>(node.mesh) >= document.meshes.size())
+			continue;
+		const size_t meshCount = firstMesh[node.mesh + 1] - firstMesh[node.mesh];
+		nodeCount += (meshCount > 1) ? meshCount - 1 : 0;
+	}
+	model.nodes.resize(nodeCount);
+	for (Node &node : model.nodes)
+	{
+		node.mesh = nullptr;
+		node.parent = nullptr;
+		node.transform = geom::mat4::identity();
+	}
+	size_t iExtra = document.nodes.size();
+	for (size_t iNode = 0; iNode < document.nodes.size(); iNode++)
+	{
+		const gltf::Node &source = document.nodes[iNode];
+		Node &node = model.nodes[iNode];
+		node.transform = transform(source);
+		for (int child : source.children)
+		{
+			if (child < 0 || static_cast<size_t>(child) >= document.nodes.size() || model.nodes[child].parent != nullptr)
+				throw std::runtime_error("Invalid node hierarchy");
+			model.nodes[child].parent = &node;
+		}
+		if (source.mesh < 0 || static_cast<size_t>(source.mesh) >= document.meshes.size())
+			continue;
+		for (size_t iMesh = firstMesh[source.mesh]; iMesh < firstMesh[source.mesh + 1]; iMesh++)
+		{
+			if (iMesh == firstMesh[source.mesh])
+			{
+				node.mesh = &model.meshes[iMesh];
+				continue;
+			}
+			Node &extra = model.nodes[iExtra++];
+			extra.mesh = &model.meshes[iMesh];
+			extra.parent = &node;
+		}
+	}
+	model.hierarchy.build(model.nodes);
+	model.hierarchy.update();
+}
+
+// Vertex data of a mesh, only reads the scene so that meshes can be loaded concurrently.
+static void loadMesh(Mesh &mesh, const Scene &scene, size_t index)
+{
+	const gltf::Document &document = scene.document;
+	const Buffer<Span> &buffers = scene.buffers;
+	const gltf::Primitive &primitive = *scene.primitives[index];
+	mesh.material = scene.materials[index];
+	const gltf::Material *material = nullptr;
+	if (primitive.material >= 0 && static_cast<size_t>(primitive.material) < document.materials.size())
+		material = &document.materials[primitive.material];
+	auto attribute = [&](gltf::Attribute attribute) { return primitive.attributes[static_cast<unsigned int>(attribute)]; };
+
+	const int position = attribute(gltf::Attribute::POSITION);
+	if (position == gltf::invalid)
+		throw std::runtime_error("Primitive without positions");
+	const Source positions = resolve(document, buffers, position);
+	load(mesh.positions, positions, gltf::ComponentType::FLOAT, 3, [](const double *v) {
+		return geom::point3(static_cast<float>(v[0]), static_cast<float>(v[1]), static_cast<float>(v[2]));
+	});
+	if (attribute(gltf::Attribute::NORMAL) != gltf::invalid)
+	{
+		load(mesh.normals, resolve(document, buffers, attribute(gltf::Attribute::NORMAL)), gltf::ComponentType::FLOAT, 3, [](const double *v) {
+			return geom::norm3(static_cast<float>(v[0]), static_cast<float>(v[1]), static_cast<float>(v[2]));
+		});
+	}
+	// Texture coordinates used by each texture of the material, sets shared by several textures are views of the same data.
+	const gltf::TextureInfo *infos[static_cast<unsigned int>(TextureType::NB_TEXTURE_TYPE)] = {
+		material ? &material->baseColorTexture : nullptr,
+		material ? &material->normalTexture : nullptr,
+		material ? &material->metallicRoughnessTexture : nullptr,
+	};
+	for (unsigned int iType = 0; iType < static_cast<unsigned int>(TextureType::NB_TEXTURE_TYPE); iType++)
+	{
+		const int set = (infos[iType] != nullptr) ? infos[iType]->texCoord : 0;
+		const int texcoord = (set == 0) ? attribute(gltf::Attribute::TEXCOORD_0) : (set == 1) ? attribute(gltf::Attribute::TEXCOORD_1) : gltf::invalid;
+		if (texcoord == gltf::invalid)
+			continue;
+		load(mesh.texcoords[iType], resolve(document, buffers, texcoord), gltf::ComponentType::FLOAT, 2, [](const double *v) {
+			return geom::uv2(static_cast<float>(v[0]), static_cast<float>(v[1]));
+		});
+	}
+	if (attribute(gltf::Attribute::COLOR_0) != gltf::invalid)
+	{
+		Source colors = resolve(document, buffers, attribute(gltf::Attribute::COLOR_0));
+		// Float colors are in [0, 1], integer ones are normalized.
+		colors.normalized = true;
+		load(mesh.colors, colors, gltf::ComponentType::UNSIGNED_BYTE, 4, [](const double *v) {
+			auto unorm = [](double value) { return static_cast<uint8_t>(std::lround(std::fmin(std::fmax(value, 0.0), 1.0) * 255.0)); };
+			return geom::color32(unorm(v[0]), unorm(v[1]), unorm(v[2]), unorm(v[3]));
+		});
+	}
+	if (primitive.indices != gltf::invalid)
+	{
+		load(mesh.indices, resolve(document, buffers, primitive.indices), gltf::ComponentType::UNSIGNED_INT, 1, [](const double *v) {
+			return static_cast<unsigned int>(v[0]);
+		});
+	}
+	else
+	{
+		// Non indexed, vertices are read in order.
+		Buffer<unsigned int> &indices = mesh.indices.own();
+		indices.resize(positions.count);
+		for (size_t iIndex = 0; iIndex < indices.size(); iIndex++)
+			indices[iIndex] = static_cast<unsigned int>(iIndex);
+	}
+	for (unsigned int index : mesh.indices)
+		if (index >= mesh.positions.size())
+			throw std::runtime_error("Index out of bounds");
+}
+
 Model ModelLoader::loadGLTF(const char * path)
 {
-	std::ifstream file(path, std::ios::binary | std::ios::ate);
-	std::string str;
-	str.resize((size_t)file.tellg());
-	file.seekg(0);
-	file.read(&str[0], str.size());
-	return parseGLTF(str);
+	// Mapped, so that huge manifests are streamed by the parser instead of copied.
+	io::MappedFile file(path);
+	if (!file.isOpen())
+		throw std::runtime_error("Could not open " + std::string(path));
+	const std::string directory = directoryOf(path);
+	Model model;
+	if (gltf::isBinary(file.data(), file.size()))
+	{
+		// JSON & BIN chunks are read in place, the mapping is kept alive by the model.
+		const gltf::Container container = gltf::split(file.data(), file.size());
+		model.files.push_back(std::move(file));
+		parseGLTF(model, container.json, directory, container.binary, container.binarySize);
+	}
+	else
+	{
+		parseGLTF(model, file.string(), directory, nullptr, 0);
+	}
+	return model;
 }
 
 Model ModelLoader::loadGLTF(const std::string &bytes)
 {
-	return parseGLTF(bytes);
+	Model model;
+	const unsigned char *data = reinterpret_cast<const unsigned char*>(bytes.data());
+	if (gltf::isBinary(data, bytes.size()))
+	{
+		const gltf::Container container = gltf::split(data, bytes.size());
+		model.blobs.emplace_back(container.binary, container.binary + container.binarySize);
+		const Buffer<unsigned char> &binary = model.blobs.back();
+		parseGLTF(model, container.json, std::string(), binary.data(), binary.size());
+	}
+	else
+	{
+		parseGLTF(model, bytes, std::string(), nullptr, 0);
+	}
+	return model;
 }
 
-Model ModelLoader::parseGLTF(const std::string &bytes)
+Texture ModelLoader::loadTexture(const char * path)
 {
-	json::Parser parser;
-	json::JSON json = parser(bytes);
-	//std::cout << json << std::endl;
-	return Model();
+	io::Image image = io::Image::load(path);
+	if (image.isHDR())
+		throw std::runtime_error("HDR image loaded as texture " + std::string(path));
+	Texture texture;
+	texture.ID = 0;
+	texture.bytes = std::move(image.pixels);
+	texture.width = image.width;
+	texture.height = image.height;
+	texture.components = image.components;
+	texture.path = path;
+	return texture;
 }
 
+TextureHDR ModelLoader::loadTextureHDR(const char * path)
+{
+	io::Image image = io::Image::load(path);
+	if (!image.isHDR())
+		throw std::runtime_error("LDR image loaded as HDR texture " + std::string(path));
+	TextureHDR texture;
+	texture.ID = 0;
+	texture.bytes = std::move(image.pixelsHDR);
+	texture.width = image.width;
+	texture.height = image.height;
+	texture.components = image.components;
+	return texture;
+}
+
+void ModelLoader::parseGLTF(Model &model, std::string_view json, const std::string &directory, const unsigned char *binary, size_t binarySize)
+{
+	Scene scene;
+	prepare(model, scene, json, directory, Span{ binary, binarySize });
+	for (size_t iMesh = 0; iMesh < model.meshes.size(); iMesh++)
+		loadMesh(model.meshes[iMesh], scene, iMesh);
+}
+
+std::shared_ptr<AsyncModel> ModelLoader::loadGLTFAsync(job::Scheduler &scheduler, const std::string &path)
+{
+	std::shared_ptr<AsyncModel> async = std::make_shared<AsyncModel>();
+	// Job failures are reported by the model, as nothing waits on the jobs.
+	auto guard = [async](auto function) {
+		return [async, function]() {
+			try { function(); }
+			catch (...) { async->fail(std::current_exception()); }
+		};
+	};
+	std::shared_ptr<io::MappedFile> file = std::make_shared<io::MappedFile>();
+	job::Handle read = scheduler.add(guard([file, path]() {
+		if (!file->open(path.c_str()))
+			throw std::runtime_error("Could not open " + path);
+	}));
+	scheduler.add(guard([&scheduler, async, guard, file, path]() {
+		if (!file->isOpen())
+			return;
+		std::unique_ptr<Model> model = std::make_unique<Model>();
+		std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+		const std::string directory = directoryOf(path);
+		if (gltf::isBinary(file->data(), file->size()))
+		{
+			const gltf::Container container = gltf::split(file->data(), file->size());
+			prepare(*model, *scene, container.json, directory, Span{ container.binary, container.binarySize });
+			model->files.push_back(std::move(*file));
+		}
+		else
+		{
+			// The manifest is not referenced once parsed.
+			prepare(*model, *scene, file->string(), directory, Span{ nullptr, 0 });
+			file->close();
+		}
+		// Placeholders until decoded.
+		for (Texture &texture : model->textures)
+		{
+			texture.bytes.assign(4, 255);
+			texture.width = texture.height = 1;
+			texture.components = 4;
+		}
+		// Sources of the textures, embedded bytes are kept alive by the model.
+		Buffer<std::string> paths;
+		Buffer<Span> encoded;
+		for (const Texture &texture : model->textures)
+		{
+			paths.push_back(texture.path);
+			encoded.push_back(Span{ texture.encoded.data(), texture.encoded.size() });
+		}
+		const size_t meshCount = model->meshes.size();
+		// Staged before any part, so that update() publishes the model first.
+		async->stage(std::move(model));
+
+		std::vector<job::Handle> jobs;
+		for (size_t iMesh = 0; iMesh < meshCount; iMesh++)
+		{
+			jobs.push_back(scheduler.add(guard([async, scene, iMesh]() {
+				Mesh mesh;
+				loadMesh(mesh, *scene, iMesh);
+				async->stage(iMesh, std::move(mesh));
+			})));
+		}
+		for (size_t iTexture = 0; iTexture < paths.size(); iTexture++)
+		{
+			if (paths[iTexture].empty() && encoded[iTexture].size == 0)
+				continue;
+			jobs.push_back(scheduler.add(guard([async, iTexture, path = paths[iTexture], bytes = encoded[iTexture]]() {
+				io::Image image = path.empty() ? io::Image::load(bytes.data, bytes.size) : io::Image::load(path.c_str());
+				if (!image.isHDR())
+					async->stage(iTexture, std::move(image));
+			})));
+		}
+		scheduler.add([async]() { async->finish(); }, jobs);
+	}), { read });
+	return async;
+}
+
+AsyncModel::AsyncModel() :
+	m_parsed(false),
+	m_loaded(false),
+	m_finished(false)
+{
+}
+
+bool AsyncModel::update()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_error)
+		std::rethrow_exception(m_error);
+	if (m_staged != nullptr)
+	{
+		// Vectors are moved, pointers between parts stay valid.
+		m_model = std::move(*m_staged);
+		m_staged.reset();
+		// World transforms are ready before the model is read.
+		m_model.hierarchy.update();
+		m_parsed = true;
+	}
+	for (std::pair<size_t, Mesh> &staged : m_stagedMeshes)
+		m_model.meshes[staged.first] = std::move(staged.second);
+	m_stagedMeshes.clear();
+	for (std::pair<size_t, io::Image> &staged : m_stagedImages)
+	{
+		Texture &texture = m_model.textures[staged.first];
+		texture.bytes = std::move(staged.second.pixels);
+		texture.width = staged.second.width;
+		texture.height = staged.second.height;
+		texture.components = staged.second.components;
+	}
+	m_stagedImages.clear();
+	m_loaded = m_finished;
+	return m_loaded;
+}
+
+void AsyncModel::stage(std::unique_ptr<Model> model)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_staged = std::move(model);
+}
+
+void AsyncModel::stage(size_t mesh, Mesh &&data)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stagedMeshes.emplace_back(mesh, std::move(data));
+}
+
+void AsyncModel::stage(size_t texture, io::Image &&image)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stagedImages.emplace_back(texture, std::move(image));
+}
+
+void AsyncModel::fail(std::exception_ptr error)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_error)
+		m_error = error;
+}
+
+void AsyncModel::finish()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_finished = true;
+}
+
+// Grid of vertices in the xz plane, 2 triangles per cell.
+static void generateGrid(size_t triangles, Buffer<float> &positions, Buffer<float> &normals, Buffer<float> &texcoords, Buffer<uint32_t> &indices)
+{
+	const size_t cells = static_cast<size_t>(std::ceil(std::sqrt(triangles / 2.0)));
+	const size_t side = cells + 1;
+	positions.resize(side * side * 3);
+	normals.resize(side * side * 3);
+	texcoords.resize(side * side * 2);
+	for (size_t z = 0; z < side; z++)
+	{
+		for (size_t x = 0; x < side; x++)
+		{
+			const size_t vertex = z * side + x;
+			const float u = static_cast<float>(x) / cells;
+			const float v = static_cast<float>(z) / cells;
+			positions[vertex * 3 + 0] = u * 2.f - 1.f;
+			positions[vertex * 3 + 1] = 0.f;
+			positions[vertex * 3 + 2] = v * 2.f - 1.f;
+			normals[vertex * 3 + 0] = 0.f;
+			normals[vertex * 3 + 1] = 1.f;
+			normals[vertex * 3 + 2] = 0.f;
+			texcoords[vertex * 2 + 0] = u;
+			texcoords[vertex * 2 + 1] = v;
+		}
+	}
+	indices.resize(cells * cells * 6);
+	uint32_t *index = indices.data();
+	for (size_t z = 0; z < cells; z++)
+	{
+		for (size_t x = 0; x < cells; x++)
+		{
+			const uint32_t v0 = static_cast<uint32_t>(z * side + x);
+			const uint32_t v1 = v0 + 1;
+			const uint32_t v2 = v0 + static_cast<uint32_t>(side);
+			const uint32_t v3 = v2 + 1;
+			*index++ = v0; *index++ = v2; *index++ = v1;
+			*index++ = v1; *index++ = v2; *index++ = v3;
+		}
+	}
 }
 
-}
\ No newline at end of file
+void benchmarkGLB(const std::string &directory, size_t triangles, double &gltfTime, double &glbTime)
+{
+	Buffer<float> positions, normals, texcoords;
+	Buffer<uint32_t> indices;
+	generateGrid(triangles, positions, normals, texcoords, indices);
+	const int64_t vertexCount = static_cast<int64_t>(positions.size() / 3);
+	const size_t sizes[] = {
+		positions.size() * sizeof(float),
+		normals.size() * sizeof(float),
+		texcoords.size() * sizeof(float),
+		indices.size() * sizeof(uint32_t),
+	};
+	const void *datas[] = { positions.data(), normals.data(), texcoords.data(), indices.data() };
+	size_t binarySize = 0;
+	for (size_t size : sizes)
+		binarySize += size;
+
+	// Manifest, the buffer uri is only set for the .gltf
+	auto manifest = [&](const char *uri) {
+		json::JSON document;
+		json::Arena &arena = document.arena();
+		json::Object buffer;
+		buffer.add(arena, "byteLength", static_cast<int64_t>(binarySize));
+		if (uri != nullptr)
+			buffer.add(arena, "uri", uri);
+		json::Array bufferViews, accessors;
+		const char *types[] = { "VEC3", "VEC3", "VEC2", "SCALAR" };
+		const int64_t componentTypes[] = { 5126, 5126, 5126, 5125 };
+		const int64_t counts[] = { vertexCount, vertexCount, vertexCount, static_cast<int64_t>(indices.size()) };
+		size_t offset = 0;
+		for (unsigned int iView = 0; iView < 4; iView++)
+		{
+			json::Object view;
+			view.add(arena, "buffer", 0);
+			view.add(arena, "byteOffset", static_cast<int64_t>(offset));
+			view.add(arena, "byteLength", static_cast<int64_t>(sizes[iView]));
+			bufferViews.add(arena, view);
+			json::Object accessor;
+			accessor.add(arena, "bufferView", static_cast<int>(iView));
+			accessor.add(arena, "componentType", componentTypes[iView]);
+			accessor.add(arena, "count", counts[iView]);
+			accessor.add(arena, "type", types[iView]);
+			accessors.add(arena, accessor);
+			offset += sizes[iView];
+		}
+		json::Object attributes;
+		attributes.add(arena, "POSITION", 0);
+		attributes.add(arena, "NORMAL", 1);
+		attributes.add(arena, "TEXCOORD_0", 2);
+		json::Object primitive;
+		primitive.add(arena, "attributes", attributes);
+		primitive.add(arena, "indices", 3);
+		json::Object mesh;
+		mesh.add(arena, "primitives", json::Array(arena, { primitive }));
+		json::Object node;
+		node.add(arena, "mesh", 0);
+		json::Object &root = document;
+		root.add(arena, "buffers", json::Array(arena, { buffer }));
+		root.add(arena, "bufferViews", bufferViews);
+		root.add(arena, "accessors", accessors);
+		root.add(arena, "meshes", json::Array(arena, { mesh }));
+		root.add(arena, "nodes", json::Array(arena, { node }));
+		std::string str;
+		{
+			json::Writer writer(str);
+			json::Serializer serializer(false);
+			serializer(document, writer);
+		}
+		return str;
+	};
+	// Whole file from its chunks, closed before throwing on any failure.
+	struct Chunk { const void *data; size_t size; };
+	auto write = [](const std::string &path, std::initializer_list<Chunk> chunks) {
+		FILE *file = std::fopen(path.c_str(), "wb");
+		if (file == nullptr)
+			throw std::runtime_error("Could not open " + path);
+		bool written = true;
+		for (const Chunk &chunk : chunks)
+			written = written && std::fwrite(chunk.data, 1, chunk.size, file) == chunk.size;
+		if (std::fclose(file) != 0 || !written)
+			throw std::runtime_error("Could not write " + path);
+	};
+
+	// .gltf + .bin
+	const std::string gltfPath = directory + "benchmark.gltf";
+	const std::string binPath = directory + "benchmark.bin";
+	const std::string glbPath = directory + "benchmark.glb";
+	write(binPath, { { datas[0], sizes[0] }, { datas[1], sizes[1] }, { datas[2], sizes[2] }, { datas[3], sizes[3] } });
+	const std::string gltfManifest = manifest("benchmark.bin");
+	write(gltfPath, { { gltfManifest.data(), gltfManifest.size() } });
+
+	// .glb, chunks are padded to 4 bytes, with spaces for JSON.
+	std::string glbManifest = manifest(nullptr);
+	glbManifest.resize((glbManifest.size() + 3) & ~size_t(3), ' ');
+	const size_t paddedBinarySize = (binarySize + 3) & ~size_t(3);
+	const uint32_t header[] = {
+		0x46546C67, 2, static_cast<uint32_t>(12 + 8 + glbManifest.size() + 8 + paddedBinarySize),
+		static_cast<uint32_t>(glbManifest.size()), 0x4E4F534A,
+	};
+	const uint32_t binaryHeader[] = { static_cast<uint32_t>(paddedBinarySize), 0x004E4942 };
+	const char padding[3] = {};
+	write(glbPath, {
+		{ header, sizeof(header) }, { glbManifest.data(), glbManifest.size() }, { binaryHeader, sizeof(binaryHeader) },
+		{ datas[0], sizes[0] }, { datas[1], sizes[1] }, { datas[2], sizes[2] }, { datas[3], sizes[3] },
+		{ padding, paddedBinarySize - binarySize },
+	});
+
+	// Load & touch every vertex, so that mapped pages are actually read.
+	auto measure = [](const std::string &path) {
+		auto start = std::chrono::high_resolution_clock::now();
+		ModelLoader loader;
+		Model model = loader.loadGLTF(path.c_str());
+		float sum = 0.f;
+		for (const geom::point3 &position : model.meshes[0].positions)
+			sum += position.x;
+		auto end = std::chrono::high_resolution_clock::now();
+		if (sum != sum)
+			throw std::runtime_error("Invalid benchmark data");
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+	gltfTime = measure(gltfPath);
+	glbTime = measure(glbPath);
+}
+
+}
+
+}
@@ -2,19 +2,79 @@
 
 #include "Model.h"
 
+#include "../Framework/Image.h"
+#include "../Framework/JobSystem.h"
+
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
 namespace engine {
 
 namespace world {
 
+// Model loaded by jobs. Loaded parts are staged by the jobs, then published by update()
+// on the thread using the model, so that the model is never written while being read.
+class AsyncModel {
+public:
+	AsyncModel();
+
+	// Publish the parts loaded since the last call and rethrow loading errors.
+	// Return true once every part is published.
+	bool update();
+
+	// Empty until parsed. Meshes are then empty and textures 1x1 white until loaded.
+	Model &model() { return m_model; }
+	bool isParsed() const { return m_parsed; }
+	bool isLoaded() const { return m_loaded; }
+private:
+	friend struct ModelLoader;
+	void stage(std::unique_ptr<Model> model);
+	void stage(size_t mesh, Mesh &&data);
+	void stage(size_t texture, io::Image &&image);
+	void fail(std::exception_ptr error);
+	void finish();
+private:
+	Model m_model;
+	bool m_parsed;
+	bool m_loaded;
+
+	std::mutex m_mutex; // Protect staged parts
+	std::unique_ptr<Model> m_staged;
+	Buffer<std::pair<size_t, Mesh>> m_stagedMeshes;
+	Buffer<std::pair<size_t, io::Image>> m_stagedImages;
+	std::exception_ptr m_error;
+	bool m_finished;
+};
+
 struct ModelLoader {
 
+	// Load a .gltf or .glb file, detected from its header.
+	// Vertex & index buffers are mapped and viewed in place when their layout allows it.
 	Model loadGLTF(const char * path);
+	// Load a .gltf or .glb file content, the GLB binary chunk is copied as the bytes are not owned.
+	// External buffers are loaded relative to the working directory.
 	Model loadGLTF(const std::string &bytes);
+	// Load a .gltf or .glb file with jobs: file read, then parse, then a job per mesh & texture.
+	// Return immediately, the model is filled by AsyncModel::update() as jobs complete.
+	std::shared_ptr<AsyncModel> loadGLTFAsync(job::Scheduler &scheduler, const std::string &path);
+
+	// Decode a PNG or JPEG file, throw for HDR files.
+	Texture loadTexture(const char * path);
+	// Decode a Radiance HDR file, throw for other files.
+	TextureHDR loadTextureHDR(const char * path);
 
 private:
-	Model parseGLTF(const std::string &bytes);
+	// Binary is the GLB BIN chunk, used by the buffer without uri.
+	void parseGLTF(Model &model, std::string_view json, const std::string &directory, const unsigned char *binary, size_t binarySize);
 };
 
+// Write a generated grid of at least the given number of triangles as .gltf + .bin and as .glb
+// in the directory, then return the time in milliseconds to load each of them.
+void benchmarkGLB(const std::string &directory, size_t triangles, double &gltfTime, double &glbTime);
+
 }
 
 }
@@ -0,0 +1,684 @@
+#include "Package.h"
+#include "MeshOptimizer.h"
+#include "ModelLoader.h"
+
+#include "../Framework/Image.h"
+#include "../Framework/JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace engine {
+namespace pack {
+
+namespace {
+
+// --- Texture cooking
+
+struct Level {
+	unsigned int width, height;
+	Buffer<unsigned char> bytes;
+};
+
+struct CookedTexture {
+	Format format;
+	Buffer<Level> levels;
+};
+
+// --- Mesh cooking
+
+struct CookedMesh {
+	VertexFormat format;
+	VertexBounds bounds;
+	size_t vertexCount;
+	Buffer<unsigned char> bytes;
+};
+
+CookedMesh cookMesh(const world::Mesh &mesh, const VertexFormat &format)
+{
+	Buffer<Vertex> vertices(mesh.positions.size());
+	interleave(mesh, vertices.data());
+	CookedMesh cooked;
+	cooked.format = format.fit(mesh);
+	cooked.bounds = VertexBounds::compute(vertices.data(), vertices.size());
+	cooked.vertexCount = vertices.size();
+	cooked.bytes.resize(vertices.size() * VertexLayout(cooked.format).stride);
+	encode(vertices.data(), vertices.size(), cooked.format, cooked.bounds, cooked.bytes.data());
+	return cooked;
+}
+
+Buffer<unsigned char> expandRGBA(const unsigned char *pixels, unsigned int width, unsigned int height, unsigned int components)
+{
+	const size_t count = static_cast<size_t>(width) * height;
+	Buffer<unsigned char> rgba(count * 4);
+	for (size_t iPixel = 0; iPixel < count; iPixel++)
+	{
+		const unsigned char *src = pixels + iPixel * components;
+		unsigned char *dst = &rgba[iPixel * 4];
+		switch (components)
+		{
+		case 1: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = 255; break;
+		case 2: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = src[1]; break;
+		case 3: dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255; break;
+		default: std::memcpy(dst, src, 4); break;
+		}
+	}
+	return rgba;
+}
+
+// Box filter, odd edges are clamped.
+Level downsample(const Level &level)
+{
+	Level half;
+	half.width = std::max(level.width / 2, 1U);
+	half.height = std::max(level.height / 2, 1U);
+	half.bytes.resize(static_cast<size_t>(half.width) * half.height * 4);
+	for (unsigned int y = 0; y < half.height; y++)
+	{
+		const unsigned int y0 = std::min(y * 2, level.height - 1), y1 = std::min(y * 2 + 1, level.height - 1);
+		for (unsigned int x = 0; x < half.width; x++)
+		{
+			const unsigned int x0 = std::min(x * 2, level.width - 1), x1 = std::min(x * 2 + 1, level.width - 1);
+			const unsigned char *p00 = &level.bytes[(static_cast<size_t>(y0) * level.width + x0) * 4];
+			const unsigned char *p01 = &level.bytes[(static_cast<size_t>(y0) * level.width + x1) * 4];
+			const unsigned char *p10 = &level.bytes[(static_cast<size_t>(y1) * level.width + x0) * 4];
+			const unsigned char *p11 = &level.bytes[(static_cast<size_t>(y1) * level.width + x1) * 4];
+			unsigned char *dst = &half.bytes[(static_cast<size_t>(y) * half.width + x) * 4];
+			for (unsigned int c = 0; c < 4; c++)
+				dst[c] = static_cast<unsigned char>((p00[c] + p01[c] + p10[c] + p11[c] + 2) >> 2);
+		}
+	}
+	return half;
+}
+
+uint16_t pack565(const int color[3])
+{
+	return static_cast<uint16_t>(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+}
+
+void unpack565(uint16_t value, int color[3])
+{
+	const int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Endpoints from the inset bounding box of the block, then the nearest of the 4 interpolated colors.
+// Always 4 colors mode (color0 > color1), as required by BC3.
+void compressColorBlock(const unsigned char block[16][4], unsigned char *out)
+{
+	int minColor[3] = { 255, 255, 255 }, maxColor[3] = { 0, 0, 0 };
+	for (unsigned int iPixel = 0; iPixel < 16; iPixel++)
+	{
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			minColor[c] = std::min<int>(minColor[c], block[iPixel][c]);
+			maxColor[c] = std::max<int>(maxColor[c], block[iPixel][c]);
+		}
+	}
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		const int inset = (maxColor[c] - minColor[c]) >> 4;
+		minColor[c] += inset;
+		maxColor[c] -= inset;
+	}
+	uint16_t color0 = pack565(maxColor), color1 = pack565(minColor);
+	uint32_t indices = 0;
+	if (color0 < color1)
+		std::swap(color0, color1);
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		unpack565(color0, palette[0]);
+		unpack565(color1, palette[1]);
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (unsigned int iPixel = 0; iPixel < 16; iPixel++)
+		{
+			unsigned int best = 0;
+			int bestDistance = INT32_MAX;
+			for (unsigned int iColor = 0; iColor < 4; iColor++)
+			{
+				int distance = 0;
+				for (unsigned int c = 0; c < 3; c++)
+				{
+					const int delta = block[iPixel][c] - palette[iColor][c];
+					distance += delta * delta;
+				}
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = iColor;
+				}
+			}
+			indices |= best << (iPixel * 2);
+		}
+	}
+	out[0] = static_cast<unsigned char>(color0);
+	out[1] = static_cast<unsigned char>(color0 >> 8);
+	out[2] = static_cast<unsigned char>(color1);
+	out[3] = static_cast<unsigned char>(color1 >> 8);
+	for (unsigned int iByte = 0; iByte < 4; iByte++)
+		out[4 + iByte] = static_cast<unsigned char>(indices >> (iByte * 8));
+}
+
+// 8 alphas mode (alpha0 > alpha1) between the block extremes.
+void compressAlphaBlock(const unsigned char block[16][4], unsigned char *out)
+{
+	int minAlpha = 255, maxAlpha = 0;
+	for (unsigned int iPixel = 0; iPixel < 16; iPixel++)
+	{
+		minAlpha = std::min<int>(minAlpha, block[iPixel][3]);
+		maxAlpha = std::max<int>(maxAlpha, block[iPixel][3]);
+	}
+	uint64_t indices = 0;
+	if (maxAlpha != minAlpha)
+	{
+		int palette[8] = { maxAlpha, minAlpha };
+		for (int iAlpha = 1; iAlpha < 7; iAlpha++)
+			palette[iAlpha + 1] = ((7 - iAlpha) * maxAlpha + iAlpha * minAlpha) / 7;
+		for (unsigned int iPixel = 0; iPixel < 16; iPixel++)
+		{
+			uint64_t best = 0;
+			int bestDistance = INT32_MAX;
+			for (unsigned int iAlpha = 0; iAlpha < 8; iAlpha++)
+			{
+				const int distance = std::abs(block[iPixel][3] - palette[iAlpha]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = iAlpha;
+				}
+			}
+			indices |= best << (iPixel * 3);
+		}
+	}
+	out[0] = static_cast<unsigned char>(maxAlpha);
+	out[1] = static_cast<unsigned char>(minAlpha);
+	for (unsigned int iByte = 0; iByte < 6; iByte++)
+		out[2 + iByte] = static_cast<unsigned char>(indices >> (iByte * 8));
+}
+
+Buffer<unsigned char> compress(const Level &level, Format format)
+{
+	const size_t blockSize = (format == Format::BC1) ? 8 : 16;
+	const unsigned int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+	Buffer<unsigned char> bytes(static_cast<size_t>(blocksX) * blocksY * blockSize);
+	unsigned char *out = bytes.data();
+	unsigned char block[16][4];
+	for (unsigned int by = 0; by < blocksY; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksX; bx++)
+		{
+			// Pixels out of the level are clamped, small mips are a single block.
+			for (unsigned int iPixel = 0; iPixel < 16; iPixel++)
+			{
+				const unsigned int x = std::min(bx * 4 + iPixel % 4, level.width - 1);
+				const unsigned int y = std::min(by * 4 + iPixel / 4, level.height - 1);
+				std::memcpy(block[iPixel], &level.bytes[(static_cast<size_t>(y) * level.width + x) * 4], 4);
+			}
+			if (format == Format::BC3)
+			{
+				compressAlphaBlock(block, out);
+				out += 8;
+			}
+			compressColorBlock(block, out);
+			out += 8;
+		}
+	}
+	return bytes;
+}
+
+CookedTexture cookTexture(const world::Texture &texture, bool compressed)
+{
+	unsigned int width = texture.width, height = texture.height, components = texture.components;
+	const unsigned char *pixels = texture.bytes.data();
+	io::Image image;
+	if (texture.bytes.empty())
+	{
+		// Embedded images have no path, decoded from the bytes of their buffer view or data uri.
+		image = texture.path.empty() ? io::Image::load(texture.encoded.data(), texture.encoded.size()) : io::Image::load(texture.path.c_str());
+		if (image.isHDR())
+			throw std::runtime_error("HDR image cannot be cooked as texture " + texture.path);
+		width = image.width;
+		height = image.height;
+		components = image.components;
+		pixels = image.pixels.data();
+	}
+	if (width == 0 || height == 0 || components == 0 || components > 4)
+		throw std::runtime_error("Invalid texture " + texture.path);
+	CookedTexture cooked;
+	Level level;
+	level.width = width;
+	level.height = height;
+	level.bytes = expandRGBA(pixels, width, height, components);
+	bool opaque = true;
+	for (size_t iPixel = 3; iPixel < level.bytes.size() && opaque; iPixel += 4)
+		opaque = (level.bytes[iPixel] == 255);
+	cooked.format = !compressed ? Format::RGBA8 : (opaque ? Format::BC1 : Format::BC3);
+	while (true)
+	{
+		Level next = (level.width > 1 || level.height > 1) ? downsample(level) : Level();
+		const bool last = next.bytes.empty();
+		if (compressed)
+			level.bytes = compress(level, cooked.format);
+		cooked.levels.push_back(std::move(level));
+		if (last)
+			break;
+		level = std::move(next);
+	}
+	return cooked;
+}
+
+// --- Package writing
+
+uint64_t align(uint64_t offset)
+{
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+template <typename T>
+int32_t indexOf(const T *element, const Buffer<T> &elements)
+{
+	return (element != nullptr) ? static_cast<int32_t>(element - elements.data()) : -1;
+}
+
+struct Writer {
+	explicit Writer(const char *path) : m_path(path), m_offset(0)
+	{
+		m_file = std::fopen(path, "wb");
+		if (m_file == nullptr)
+			throw std::runtime_error("Could not open " + m_path);
+	}
+	// Only closes the file if finish was not reached, on errors.
+	~Writer()
+	{
+		if (m_file != nullptr)
+			std::fclose(m_file);
+	}
+
+	void write(const void *data, size_t size)
+	{
+		if (std::fwrite(data, 1, size, m_file) != size)
+			throw std::runtime_error("Could not write " + m_path);
+		m_offset += size;
+	}
+	template <typename T>
+	void write(const Buffer<T> &elements) { write(elements.data(), elements.size() * sizeof(T)); }
+	// Close the file, buffered writes may only fail here.
+	void finish()
+	{
+		FILE *file = m_file;
+		m_file = nullptr;
+		if (std::fclose(file) != 0)
+			throw std::runtime_error("Could not write " + m_path);
+	}
+	// Pad up to the offset computed by the layout.
+	void seek(uint64_t offset)
+	{
+		static const unsigned char zeros[alignment] = {};
+		if (offset < m_offset || offset - m_offset > alignment)
+			throw std::logic_error("Package layout mismatch");
+		write(zeros, static_cast<size_t>(offset - m_offset));
+	}
+private:
+	std::string m_path;
+	FILE *m_file;
+	uint64_t m_offset;
+};
+
+void writeIndices(Writer &writer, const unsigned int *indices, size_t count, uint32_t indexSize)
+{
+	if (indexSize == 2)
+	{
+		Buffer<uint16_t> shortIndices(count);
+		world::shrinkIndices(indices, count, shortIndices.data());
+		writer.write(shortIndices);
+	}
+	else
+	{
+		writer.write(indices, count * sizeof(uint32_t));
+	}
+}
+
+}
+
+void cook(job::Scheduler &scheduler, const world::Model &model, const char *path, const CookOptions &options)
+{
+	// Vertices & textures are converted by jobs, then written in order.
+	Buffer<CookedMesh> meshes(model.meshes.size());
+	Buffer<CookedTexture> textures(model.textures.size());
+	Buffer<job::Handle> jobs;
+	for (size_t iMesh = 0; iMesh < model.meshes.size(); iMesh++)
+		jobs.push_back(scheduler.add([&, iMesh]() { meshes[iMesh] = cookMesh(model.meshes[iMesh], options.vertexFormat); }));
+	for (size_t iTexture = 0; iTexture < model.textures.size(); iTexture++)
+		jobs.push_back(scheduler.add([&, iTexture]() { textures[iTexture] = cookTexture(model.textures[iTexture], options.compressTextures); }));
+	// Wait for every job before rethrowing, they reference the buffers above.
+	std::exception_ptr error;
+	for (const job::Handle &handle : jobs)
+	{
+		try { scheduler.wait(handle); }
+		catch (...) { if (!error) error = std::current_exception(); }
+	}
+	if (error)
+		std::rethrow_exception(error);
+
+	// Tables
+	Buffer<MeshEntry> meshEntries(model.meshes.size());
+	Buffer<TextureEntry> textureEntries(model.textures.size());
+	Buffer<LevelEntry> levelEntries;
+	Buffer<MaterialEntry> materialEntries(model.materials.size());
+	Buffer<NodeEntry> nodeEntries(model.nodes.size());
+	Buffer<LodEntry> lodEntries;
+	for (size_t iTexture = 0; iTexture < textures.size(); iTexture++)
+	{
+		TextureEntry &entry = textureEntries[iTexture];
+		entry.width = textures[iTexture].levels[0].width;
+		entry.height = textures[iTexture].levels[0].height;
+		entry.format = textures[iTexture].format;
+		entry.firstLevel = static_cast<uint32_t>(levelEntries.size());
+		entry.levelCount = static_cast<uint32_t>(textures[iTexture].levels.size());
+		entry.reserved = 0;
+		for (const Level &level : textures[iTexture].levels)
+			levelEntries.push_back(LevelEntry{ 0, level.bytes.size(), level.width, level.height });
+	}
+	for (size_t iMaterial = 0; iMaterial < model.materials.size(); iMaterial++)
+	{
+		const world::Material &material = model.materials[iMaterial];
+		MaterialEntry &entry = materialEntries[iMaterial];
+		for (unsigned int iType = 0; iType < static_cast<unsigned int>(world::TextureType::NB_TEXTURE_TYPE); iType++)
+			entry.textures[iType] = indexOf(material.texture[iType], model.textures);
+		for (unsigned int iComponent = 0; iComponent < 4; iComponent++)
+			entry.color[iComponent] = material.color[iComponent];
+		entry.metallicness = material.metallicness;
+		entry.roughness = material.roughness;
+	}
+	for (size_t iNode = 0; iNode < model.nodes.size(); iNode++)
+	{
+		const world::Node &node = model.nodes[iNode];
+		NodeEntry &entry = nodeEntries[iNode];
+		entry.parent = indexOf(node.parent, model.nodes);
+		entry.mesh = indexOf(node.mesh, model.meshes);
+		for (unsigned int iCol = 0; iCol < 4; iCol++)
+			for (unsigned int iRow = 0; iRow < 4; iRow++)
+				entry.transform[iCol * 4 + iRow] = node.transform[iCol][iRow];
+	}
+
+	// Layout
+	Header header = {};
+	header.magic = magic;
+	header.version = version;
+	header.meshCount = static_cast<uint32_t>(meshEntries.size());
+	header.textureCount = static_cast<uint32_t>(textureEntries.size());
+	header.levelCount = static_cast<uint32_t>(levelEntries.size());
+	header.materialCount = static_cast<uint32_t>(materialEntries.size());
+	header.nodeCount = static_cast<uint32_t>(nodeEntries.size());
+	for (size_t iMesh = 0; iMesh < model.meshes.size(); iMesh++)
+	{
+		const world::LodChain &lods = model.meshes[iMesh].lods;
+		MeshEntry &entry = meshEntries[iMesh];
+		entry.firstLod = static_cast<uint32_t>(lodEntries.size());
+		entry.lodCount = static_cast<uint32_t>(lods.levels.size());
+		entry.lodCenter[0] = lods.center.x;
+		entry.lodCenter[1] = lods.center.y;
+		entry.lodCenter[2] = lods.center.z;
+		entry.lodRadius = lods.radius;
+		for (const world::Lod &lod : lods.levels)
+			lodEntries.push_back(LodEntry{ 0, static_cast<uint32_t>(lod.indices.size()), lod.error });
+	}
+	header.lodCount = static_cast<uint32_t>(lodEntries.size());
+	uint64_t offset = align(sizeof(Header));
+	header.meshes = offset;
+	offset = align(offset + meshEntries.size() * sizeof(MeshEntry));
+	header.textures = offset;
+	offset = align(offset + textureEntries.size() * sizeof(TextureEntry));
+	header.levels = offset;
+	offset = align(offset + levelEntries.size() * sizeof(LevelEntry));
+	header.materials = offset;
+	offset = align(offset + materialEntries.size() * sizeof(MaterialEntry));
+	header.nodes = offset;
+	offset = align(offset + nodeEntries.size() * sizeof(NodeEntry));
+	header.lods = offset;
+	offset = align(offset + lodEntries.size() * sizeof(LodEntry));
+	for (size_t iMesh = 0; iMesh < model.meshes.size(); iMesh++)
+	{
+		const world::Mesh &mesh = model.meshes[iMesh];
+		MeshEntry &entry = meshEntries[iMesh];
+		entry.vertexCount = static_cast<uint32_t>(meshes[iMesh].vertexCount);
+		entry.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		entry.material = indexOf(static_cast<const world::Material*>(mesh.material), model.materials);
+		entry.indexSize = world::hasShortIndices(meshes[iMesh].vertexCount) ? 2 : 4;
+		entry.format = meshes[iMesh].format;
+		entry.stride = VertexLayout(entry.format).stride;
+		entry.bounds = meshes[iMesh].bounds;
+		entry.vertices = offset;
+		offset = align(offset + meshes[iMesh].bytes.size());
+		entry.indices = offset;
+		offset = align(offset + static_cast<uint64_t>(mesh.indices.size()) * entry.indexSize);
+		for (uint32_t iLod = 0; iLod < entry.lodCount; iLod++)
+		{
+			LodEntry &lod = lodEntries[entry.firstLod + iLod];
+			lod.indices = offset;
+			offset = align(offset + static_cast<uint64_t>(lod.indexCount) * entry.indexSize);
+		}
+	}
+	for (LevelEntry &level : levelEntries)
+	{
+		level.offset = offset;
+		offset = align(offset + level.size);
+	}
+	header.size = offset;
+
+	Writer writer(path);
+	writer.write(&header, sizeof(Header));
+	writer.seek(header.meshes);
+	writer.write(meshEntries);
+	writer.seek(header.textures);
+	writer.write(textureEntries);
+	writer.seek(header.levels);
+	writer.write(levelEntries);
+	writer.seek(header.materials);
+	writer.write(materialEntries);
+	writer.seek(header.nodes);
+	writer.write(nodeEntries);
+	writer.seek(header.lods);
+	writer.write(lodEntries);
+	for (size_t iMesh = 0; iMesh < model.meshes.size(); iMesh++)
+	{
+		writer.seek(meshEntries[iMesh].vertices);
+		writer.write(meshes[iMesh].bytes);
+		const world::Mesh &mesh = model.meshes[iMesh];
+		const MeshEntry &entry = meshEntries[iMesh];
+		writer.seek(entry.indices);
+		writeIndices(writer, mesh.indices.data(), mesh.indices.size(), entry.indexSize);
+		for (uint32_t iLod = 0; iLod < entry.lodCount; iLod++)
+		{
+			const Buffer<unsigned int> &indices = mesh.lods.levels[iLod].indices;
+			writer.seek(lodEntries[entry.firstLod + iLod].indices);
+			writeIndices(writer, indices.data(), indices.size(), entry.indexSize);
+		}
+	}
+	size_t iLevel = 0;
+	for (const CookedTexture &texture : textures)
+	{
+		for (const Level &level : texture.levels)
+		{
+			writer.seek(levelEntries[iLevel++].offset);
+			writer.write(level.bytes);
+		}
+	}
+	writer.seek(header.size);
+	writer.finish();
+}
+
+Package::Package(const char *path)
+{
+	open(path);
+}
+
+void Package::open(const char *path)
+{
+	io::MappedFile file(path);
+	if (!file.isOpen())
+		throw std::runtime_error("Could not open " + std::string(path));
+	const uint64_t size = file.size();
+	auto invalid = [&]() { return std::runtime_error("Invalid package " + std::string(path)); };
+	// Range of count elements, aligned & inside the file.
+	auto check = [&](uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t elementAlignment) {
+		if (offset % elementAlignment != 0 || offset > size || count > (size - offset) / elementSize)
+			throw invalid();
+	};
+	if (size < sizeof(Header))
+		throw invalid();
+	const Header *header = reinterpret_cast<const Header*>(file.data());
+	if (header->magic != magic)
+		throw invalid();
+	if (header->version != version)
+		throw std::runtime_error("Package " + std::string(path) + " has version " + std::to_string(header->version) + " instead of " + std::to_string(version) + ", cook it again");
+	if (header->size != size)
+		throw invalid();
+	check(header->meshes, header->meshCount, sizeof(MeshEntry), alignof(MeshEntry));
+	check(header->textures, header->textureCount, sizeof(TextureEntry), alignof(TextureEntry));
+	check(header->levels, header->levelCount, sizeof(LevelEntry), alignof(LevelEntry));
+	check(header->materials, header->materialCount, sizeof(MaterialEntry), alignof(MaterialEntry));
+	check(header->nodes, header->nodeCount, sizeof(NodeEntry), alignof(NodeEntry));
+	check(header->lods, header->lodCount, sizeof(LodEntry), alignof(LodEntry));
+	auto table = [&](uint64_t offset) { return file.data() + offset; };
+	const MeshEntry *meshes = reinterpret_cast<const MeshEntry*>(table(header->meshes));
+	const TextureEntry *textures = reinterpret_cast<const TextureEntry*>(table(header->textures));
+	const LevelEntry *levels = reinterpret_cast<const LevelEntry*>(table(header->levels));
+	const MaterialEntry *materials = reinterpret_cast<const MaterialEntry*>(table(header->materials));
+	const NodeEntry *nodes = reinterpret_cast<const NodeEntry*>(table(header->nodes));
+	const LodEntry *lods = reinterpret_cast<const LodEntry*>(table(header->lods));
+
+	// Ranges & indices only, the data itself is left to the GPU.
+	auto inside = [](int32_t index, uint32_t count) { return index >= -1 && index < static_cast<int64_t>(count); };
+	for (uint32_t iMesh = 0; iMesh < header->meshCount; iMesh++)
+	{
+		if (!meshes[iMesh].format.isValid() || meshes[iMesh].stride != VertexLayout(meshes[iMesh].format).stride)
+			throw invalid();
+		check(meshes[iMesh].vertices, meshes[iMesh].vertexCount, meshes[iMesh].stride, 4);
+		if (meshes[iMesh].indexSize != 2 && meshes[iMesh].indexSize != 4)
+			throw invalid();
+		check(meshes[iMesh].indices, meshes[iMesh].indexCount, meshes[iMesh].indexSize, meshes[iMesh].indexSize);
+		if (!inside(meshes[iMesh].material, header->materialCount))
+			throw invalid();
+		if (meshes[iMesh].firstLod > header->lodCount || meshes[iMesh].lodCount > header->lodCount - meshes[iMesh].firstLod)
+			throw invalid();
+		for (uint32_t iLod = 0; iLod < meshes[iMesh].lodCount; iLod++)
+		{
+			const LodEntry &lod = lods[meshes[iMesh].firstLod + iLod];
+			check(lod.indices, lod.indexCount, meshes[iMesh].indexSize, meshes[iMesh].indexSize);
+		}
+	}
+	for (uint32_t iTexture = 0; iTexture < header->textureCount; iTexture++)
+	{
+		const TextureEntry &texture = textures[iTexture];
+		if (texture.format > Format::BC3 || texture.levelCount == 0 || texture.firstLevel > header->levelCount || texture.levelCount > header->levelCount - texture.firstLevel)
+			throw invalid();
+	}
+	for (uint32_t iLevel = 0; iLevel < header->levelCount; iLevel++)
+		check(levels[iLevel].offset, levels[iLevel].size, 1, 1);
+	for (uint32_t iMaterial = 0; iMaterial < header->materialCount; iMaterial++)
+		for (int32_t texture : materials[iMaterial].textures)
+			if (!inside(texture, header->textureCount))
+				throw invalid();
+	for (uint32_t iNode = 0; iNode < header->nodeCount; iNode++)
+		if (!inside(nodes[iNode].parent, header->nodeCount) || !inside(nodes[iNode].mesh, header->meshCount))
+			throw invalid();
+
+	m_file = std::move(file);
+	m_header = header;
+	m_meshes = meshes;
+	m_textures = textures;
+	m_levels = levels;
+	m_materials = materials;
+	m_nodes = nodes;
+	m_lods = lods;
+}
+
+void benchmarkPackage(job::Scheduler &scheduler, const std::string &gltfPath, const std::string &packagePath, double &gltfTime, double &packageTime)
+{
+	// Sum 8 bytes at a time, so that every page is read like an upload would.
+	auto touch = [](const unsigned char *data, size_t size) {
+		uint64_t sum = 0;
+		size_t iByte = 0;
+		for (; iByte + 8 <= size; iByte += 8)
+		{
+			uint64_t value;
+			std::memcpy(&value, data + iByte, 8);
+			sum += value;
+		}
+		for (; iByte < size; iByte++)
+			sum += data[iByte];
+		return sum;
+	};
+	uint64_t sum = 0;
+
+	// glTF, with the conversions needed before an upload.
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		world::ModelLoader loader;
+		world::Model model = loader.loadGLTF(gltfPath.c_str());
+		std::vector<std::string> paths;
+		for (const world::Texture &texture : model.textures)
+		{
+			if (texture.path.empty())
+			{
+				const io::Image image = io::Image::load(texture.encoded.data(), texture.encoded.size());
+				sum += touch(image.pixels.data(), image.pixels.size());
+			}
+			else
+			{
+				paths.push_back(texture.path);
+			}
+		}
+		Buffer<io::Image> images = io::Image::load(scheduler, paths);
+		for (const io::Image &image : images)
+			sum += touch(image.pixels.data(), image.pixels.size());
+		for (const world::Mesh &mesh : model.meshes)
+		{
+			const CookedMesh cooked = cookMesh(mesh, VertexFormat::compressed());
+			sum += touch(cooked.bytes.data(), cooked.bytes.size());
+			sum += touch(reinterpret_cast<const unsigned char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	gltfTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	{
+		Package package(packagePath.c_str());
+		for (uint32_t iMesh = 0; iMesh < package.header().meshCount; iMesh++)
+		{
+			const MeshEntry &mesh = package.mesh(iMesh);
+			sum += touch(static_cast<const unsigned char*>(package.vertices(mesh)), static_cast<size_t>(mesh.vertexCount) * mesh.stride);
+			sum += touch(static_cast<const unsigned char*>(package.indices(mesh)), static_cast<size_t>(mesh.indexCount) * mesh.indexSize);
+		}
+		for (uint32_t iTexture = 0; iTexture < package.header().textureCount; iTexture++)
+		{
+			const TextureEntry &texture = package.texture(iTexture);
+			for (uint32_t iLevel = 0; iLevel < texture.levelCount; iLevel++)
+			{
+				const LevelEntry &level = package.level(texture, iLevel);
+				sum += touch(package.data(level), static_cast<size_t>(level.size));
+			}
+		}
+	}
+	end = std::chrono::high_resolution_clock::now();
+	packageTime = std::chrono::duration<double, std::milli>(end - start).count();
+	if (sum == 0)
+		throw std::runtime_error("Empty benchmark data");
+}
+
+}
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Model.h"
+#include "VertexFormat.h"
+
+#include "../Framework/MappedFile.h"
+
+#include <stdint.h>
+#include <string>
+
+namespace engine {
+
+namespace job {
+class Scheduler;
+}
+
+// Cooked package, a binary file holding a model in its GPU layout so that it is
+// mapped & uploaded as is. Written by the Cooker tool, see cook().
+//
+// Layout: Header, then the tables, then the data. Everything is little endian and
+// every data range is aligned to 16 bytes.
+namespace pack {
+
+static const uint32_t magic = 0x4B415052; // "RPAK"
+// Increased on every layout change, packages of other versions must be cooked again.
+static const uint32_t version = 4;
+static const uint64_t alignment = 16;
+
+enum class Format : uint32_t {
+	RGBA8,
+	BC1, // RGB, 8 bytes per 4x4 block
+	BC3, // RGBA, 16 bytes per 4x4 block
+};
+
+struct Header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;	// Of the whole file
+	uint32_t meshCount, textureCount, levelCount, materialCount, nodeCount, lodCount;
+	uint64_t meshes, textures, levels, materials, nodes, lods; // Table offsets
+};
+
+struct MeshEntry {
+	uint64_t vertices;	// Offset of the vertices, stride bytes each
+	uint64_t indices;	// Offset of the triangle list
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	int32_t material;	// -1 if none
+	uint32_t indexSize;	// 2 when every index fits in an uint16_t, 4 otherwise
+	VertexFormat format;
+	uint32_t stride;
+	VertexBounds bounds;
+	uint32_t firstLod;	// Into the lod table, the indices above are the full detail
+	uint32_t lodCount;
+	float lodCenter[3];	// Bounding sphere, see world::LodChain
+	float lodRadius;
+};
+
+// Coarser triangle list over the vertices of its mesh, with the mesh index size.
+struct LodEntry {
+	uint64_t indices;
+	uint32_t indexCount;
+	float error;	// In mesh units
+};
+
+// Mip level, largest first.
+struct LevelEntry {
+	uint64_t offset;
+	uint64_t size;
+	uint32_t width, height;
+};
+
+struct TextureEntry {
+	uint32_t width, height;
+	Format format;
+	uint32_t firstLevel;	// Into the level table
+	uint32_t levelCount;
+	uint32_t reserved;
+};
+
+struct MaterialEntry {
+	int32_t textures[static_cast<unsigned int>(world::TextureType::NB_TEXTURE_TYPE)]; // -1 if none
+	float color[4];
+	float metallicness;
+	float roughness;
+};
+
+struct NodeEntry {
+	int32_t parent;	// -1 for roots
+	int32_t mesh;	// -1 if none
+	float transform[16]; // Column major local transform
+};
+
+struct CookOptions {
+	bool compressTextures = true;
+	// Fitted to each mesh, see VertexFormat::fit.
+	VertexFormat vertexFormat = VertexFormat::compressed();
+};
+
+// Write the model as a package. Meshes are written in their current order, optimize them first,
+// with their vertices encoded in the options vertex format, 16 bits indices when they fit and
+// their levels of detail. Textures without bytes are decoded from their path or embedded bytes,
+// then every texture is mipped & compressed to BC1, or BC3 if it has alpha, by a job.
+// Uncompressed textures are kept as RGBA8 mips.
+// Throw std::runtime_error if a texture or the file fails.
+void cook(job::Scheduler &scheduler, const world::Model &model, const char *path, const CookOptions &options = CookOptions());
+
+// Read only view of a mapped package.
+// Only the header & the ranges are validated on open, nothing is parsed nor copied.
+class Package {
+public:
+	Package() = default;
+	// Throw std::runtime_error on invalid files or files of another version.
+	explicit Package(const char *path);
+
+	void open(const char *path);
+	bool isOpen() const { return m_file.isOpen(); }
+	size_t size() const { return m_file.size(); }
+
+	const Header &header() const { return *m_header; }
+	const MeshEntry &mesh(size_t index) const { return m_meshes[index]; }
+	const TextureEntry &texture(size_t index) const { return m_textures[index]; }
+	const LevelEntry &level(const TextureEntry &texture, size_t level) const { return m_levels[texture.firstLevel + level]; }
+	const MaterialEntry &material(size_t index) const { return m_materials[index]; }
+	const NodeEntry &node(size_t index) const { return m_nodes[index]; }
+	const LodEntry &lod(const MeshEntry &mesh, size_t level) const { return m_lods[mesh.firstLod + level]; }
+
+	const void *vertices(const MeshEntry &mesh) const { return at<void>(mesh.vertices); }
+	const void *indices(const MeshEntry &mesh) const { return at<void>(mesh.indices); }
+	const void *indices(const LodEntry &lod) const { return at<void>(lod.indices); }
+	const unsigned char *data(const LevelEntry &level) const { return m_file.data() + level.offset; }
+private:
+	template <typename T>
+	const T *at(uint64_t offset) const { return reinterpret_cast<const T*>(m_file.data() + offset); }
+private:
+	io::MappedFile m_file;
+	const Header *m_header = nullptr;
+	const MeshEntry *m_meshes = nullptr;
+	const TextureEntry *m_textures = nullptr;
+	const LevelEntry *m_levels = nullptr;
+	const MaterialEntry *m_materials = nullptr;
+	const NodeEntry *m_nodes = nullptr;
+	const LodEntry *m_lods = nullptr;
+};
+
+// Return the time in milliseconds to load the glTF model and decode its textures,
+// and to open the package cooked from it, touching every byte it would upload.
+void benchmarkPackage(job::Scheduler &scheduler, const std::string &gltfPath, const std::string &packagePath, double &gltfTime, double &packageTime);
+
+}
+
+}
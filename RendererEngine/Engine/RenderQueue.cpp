@@ -0,0 +1,226 @@
+#include "RenderQueue.h"
+
+#include "../Framework/JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+namespace engine {
+
+uint64_t sortKey(DrawPass pass, uint32_t program, uint32_t material, uint32_t mesh, float depth)
+{
+	const uint64_t passBits = static_cast<uint64_t>(pass) & 0xF;
+	const uint64_t programBits = std::min<uint32_t>(program, 0xFFF);
+	const uint64_t materialBits = std::min<uint32_t>(material, 0xFFFF);
+	const uint64_t meshBits = std::min<uint32_t>(mesh, 0xFFFF);
+	// NaN is the camera.
+	const float clamped = (depth > 0.f) ? std::min(depth, 1.f) : 0.f;
+	const uint64_t depthBits = static_cast<uint64_t>(clamped * 65535.f + 0.5f);
+	if (pass == DrawPass::BLENDED)
+		return passBits << 60 | (0xFFFF - depthBits) << 44 | programBits << 32 | materialBits << 16 | meshBits;
+	return passBits << 60 | programBits << 48 | materialBits << 32 | meshBits << 16 | depthBits;
+}
+
+DrawState drawState(uint64_t key)
+{
+	DrawState state;
+	state.pass = static_cast<DrawPass>(key >> 60);
+	if (state.pass == DrawPass::BLENDED)
+	{
+		state.program = static_cast<uint32_t>(key >> 32) & 0xFFF;
+		state.material = static_cast<uint32_t>(key >> 16) & 0xFFFF;
+		state.mesh = static_cast<uint32_t>(key) & 0xFFFF;
+	}
+	else
+	{
+		state.program = static_cast<uint32_t>(key >> 48) & 0xFFF;
+		state.material = static_cast<uint32_t>(key >> 32) & 0xFFFF;
+		state.mesh = static_cast<uint32_t>(key >> 16) & 0xFFFF;
+	}
+	return state;
+}
+
+void sortPackets(Buffer<DrawPacket> &packets)
+{
+	if (packets.size() < 2)
+		return;
+	// Histograms of every byte in a single read.
+	size_t counts[8][256] = {};
+	for (const DrawPacket &packet : packets)
+		for (unsigned int iByte = 0; iByte < 8; iByte++)
+			counts[iByte][(packet.key >> (iByte * 8)) & 0xFF]++;
+	Buffer<DrawPacket> sorted(packets.size());
+	for (unsigned int iByte = 0; iByte < 8; iByte++)
+	{
+		const unsigned int shift = iByte * 8;
+		size_t *offsets = counts[iByte];
+		// Pass, program & the high bits of indices are mostly the same in every key.
+		if (offsets[(packets[0].key >> shift) & 0xFF] == packets.size())
+			continue;
+		size_t offset = 0;
+		for (unsigned int iDigit = 0; iDigit < 256; iDigit++)
+		{
+			const size_t count = offsets[iDigit];
+			offsets[iDigit] = offset;
+			offset += count;
+		}
+		for (const DrawPacket &packet : packets)
+			sorted[offsets[(packet.key >> shift) & 0xFF]++] = packet;
+		packets.swap(sorted);
+	}
+}
+
+void buildRenderQueue(job::Scheduler &scheduler, size_t count, const std::function<void(size_t, size_t, Buffer<DrawPacket>&)> &build, Buffer<DrawPacket> &packets)
+{
+	packets.clear();
+	if (count == 0)
+		return;
+	// Ranges large enough to amortize a job, a few per thread to balance the uneven ones.
+	const size_t rangeSize = std::max<size_t>(4096, count / ((scheduler.threadCount() + 1) * 4) + 1);
+	const size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+	Buffer<Buffer<DrawPacket>> queues(rangeCount);
+	Buffer<job::Handle> jobs;
+	for (size_t iRange = 0; iRange < rangeCount; iRange++)
+	{
+		jobs.push_back(scheduler.add([&, iRange]() {
+			build(iRange * rangeSize, std::min(count, (iRange + 1) * rangeSize), queues[iRange]);
+			sortPackets(queues[iRange]);
+		}));
+	}
+	// Wait for every job before rethrowing, they reference the queues above.
+	std::exception_ptr error;
+	for (const job::Handle &handle : jobs)
+	{
+		try { scheduler.wait(handle); }
+		catch (...) { if (!error) error = std::current_exception(); }
+	}
+	if (error)
+		std::rethrow_exception(error);
+
+	// Merge neighbor queues until one is left. Ties keep the range order, as the serial sort does.
+	auto less = [](const DrawPacket &lhs, const DrawPacket &rhs) { return lhs.key < rhs.key; };
+	while (queues.size() > 1)
+	{
+		Buffer<Buffer<DrawPacket>> merged((queues.size() + 1) / 2);
+		for (size_t iQueue = 0; iQueue + 1 < queues.size(); iQueue += 2)
+		{
+			const Buffer<DrawPacket> &lhs = queues[iQueue], &rhs = queues[iQueue + 1];
+			Buffer<DrawPacket> &out = merged[iQueue / 2];
+			out.resize(lhs.size() + rhs.size());
+			std::merge(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), out.begin(), less);
+		}
+		if (queues.size() % 2 == 1)
+			merged.back() = std::move(queues.back());
+		queues = std::move(merged);
+	}
+	packets = std::move(queues[0]);
+}
+
+StateChanges countStateChanges(const Buffer<DrawPacket> &packets)
+{
+	StateChanges changes = {};
+	DrawState previous = {};
+	for (size_t iPacket = 0; iPacket < packets.size(); iPacket++)
+	{
+		const DrawState state = drawState(packets[iPacket].key);
+		const bool first = (iPacket == 0);
+		changes.passes += (first || state.pass != previous.pass) ? 1 : 0;
+		changes.programs += (first || state.program != previous.program) ? 1 : 0;
+		changes.materials += (first || state.material != previous.material) ? 1 : 0;
+		changes.meshes += (first || state.mesh != previous.mesh) ? 1 : 0;
+		previous = state;
+	}
+	return changes;
+}
+
+RenderQueueBenchmark benchmarkRenderQueue(job::Scheduler &scheduler, size_t drawCount, unsigned int iterations)
+{
+	struct Draw {
+		DrawPass pass;
+		uint32_t program, material, mesh;
+		float depth;
+	};
+	// A tenth of blended draws, scattered like a scene traversal would.
+	std::mt19937 random(42);
+	Buffer<Draw> draws(drawCount);
+	for (Draw &draw : draws)
+	{
+		draw.pass = (random() % 10 == 0) ? DrawPass::BLENDED : DrawPass::SOLID;
+		draw.program = random() % 8;
+		draw.material = random() % 512;
+		draw.mesh = random() % 2048;
+		draw.depth = static_cast<float>(random() % 65536) / 65535.f;
+	}
+	auto build = [&draws](size_t begin, size_t end, Buffer<DrawPacket> &queue) {
+		for (size_t iDraw = begin; iDraw < end; iDraw++)
+		{
+			const Draw &draw = draws[iDraw];
+			queue.push_back(DrawPacket{ sortKey(draw.pass, draw.program, draw.material, draw.mesh, draw.depth), static_cast<uint32_t>(iDraw) });
+		}
+	};
+	const unsigned int count = std::max(iterations, 1U);
+	RenderQueueBenchmark result = {};
+	Buffer<DrawPacket> unsorted, serial, parallel;
+	build(0, drawCount, unsorted);
+	result.unsorted = countStateChanges(unsorted);
+	serial.reserve(drawCount);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int iIteration = 0; iIteration < count; iIteration++)
+	{
+		serial.clear();
+		build(0, drawCount, serial);
+		sortPackets(serial);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	result.serialTime = std::chrono::duration<double, std::milli>(end - start).count() / count;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int iIteration = 0; iIteration < count; iIteration++)
+		buildRenderQueue(scheduler, drawCount, build, parallel);
+	end = std::chrono::high_resolution_clock::now();
+	result.parallelTime = std::chrono::duration<double, std::milli>(end - start).count() / count;
+	if (serial.size() != parallel.size() || !std::equal(serial.begin(), serial.end(), parallel.begin(), [](const DrawPacket &lhs, const DrawPacket &rhs) { return lhs.key == rhs.key && lhs.draw == rhs.draw; }))
+		throw std::logic_error("Serial & parallel render queues differ");
+	result.sorted = countStateChanges(serial);
+
+	// What a renderer does with the queue: a command per draw, a state command on transitions.
+	struct Command {
+		uint32_t type;	// 0 draw, 1 + the state field otherwise
+		uint32_t value;
+	};
+	Buffer<Command> commands;
+	commands.reserve(drawCount * 5);
+	auto submit = [&](const Buffer<DrawPacket> &packets) {
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int iIteration = 0; iIteration < count; iIteration++)
+		{
+			commands.clear();
+			DrawState previous = {};
+			for (size_t iPacket = 0; iPacket < packets.size(); iPacket++)
+			{
+				const DrawState state = drawState(packets[iPacket].key);
+				const bool first = (iPacket == 0);
+				if (first || state.pass != previous.pass)
+					commands.push_back(Command{ 1, static_cast<uint32_t>(state.pass) });
+				if (first || state.program != previous.program)
+					commands.push_back(Command{ 2, state.program });
+				if (first || state.material != previous.material)
+					commands.push_back(Command{ 3, state.material });
+				if (first || state.mesh != previous.mesh)
+					commands.push_back(Command{ 4, state.mesh });
+				commands.push_back(Command{ 0, packets[iPacket].draw });
+				previous = state;
+			}
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / count;
+	};
+	result.unsortedSubmitTime = submit(unsorted);
+	result.sortedSubmitTime = submit(serial);
+	return result;
+}
+
+}
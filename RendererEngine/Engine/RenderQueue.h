@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Config.h"
+
+#include <functional>
+#include <stdint.h>
+
+namespace engine {
+
+namespace job {
+class Scheduler;
+}
+
+// Draws sorted by a 64 bits key, so that consecutive draws share their states and a renderer
+// changes a state only on transitions.
+//
+// Solid key, from the most significant bits: pass 4, program 12, material 16, mesh 16, depth 16.
+// Solid draws are sorted by state then front to back. Blended draws must be back to front
+// whatever their state, so the depth comes right after the pass: pass 4, inverted depth 16,
+// program 12, material 16, mesh 16.
+enum class DrawPass : uint8_t {
+	SOLID,
+	BLENDED,
+};
+
+struct DrawPacket {
+	uint64_t key;
+	uint32_t draw;	// Index of the draw in the data of the caller
+};
+
+// Indices past the field size share the largest value, they are drawn in order but not grouped.
+// Depth is in [0, 1], 0 being the camera.
+uint64_t sortKey(DrawPass pass, uint32_t program, uint32_t material, uint32_t mesh, float depth);
+
+struct DrawState {
+	DrawPass pass;
+	uint32_t program, material, mesh;
+};
+DrawState drawState(uint64_t key);
+
+// LSD radix sort by key, stable. Bytes equal in every key are skipped.
+void sortPackets(Buffer<DrawPacket> &packets);
+
+// Build the packets of count draws by ranges on jobs, each range in its own queue sorted by
+// its job, then merge the queues. build(begin, end, queue) appends the packets of a range.
+void buildRenderQueue(job::Scheduler &scheduler, size_t count, const std::function<void(size_t, size_t, Buffer<DrawPacket>&)> &build, Buffer<DrawPacket> &packets);
+
+// Transitions when drawing the packets in order, the first packet sets every state.
+struct StateChanges {
+	size_t passes, programs, materials, meshes;
+};
+StateChanges countStateChanges(const Buffer<DrawPacket> &packets);
+
+struct RenderQueueBenchmark {
+	StateChanges unsorted, sorted;
+	double serialTime;		// Build & sort on the calling thread
+	double parallelTime;	// Build & sort with jobs
+	// Walk the packets & encode a command per draw, a state command per transition
+	double unsortedSubmitTime, sortedSubmitTime;
+};
+
+// Random draws over a few programs, many materials & meshes, averaged over the iterations. Times in milliseconds.
+RenderQueueBenchmark benchmarkRenderQueue(job::Scheduler &scheduler, size_t drawCount, unsigned int iterations);
+
+}
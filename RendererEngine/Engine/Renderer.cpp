@@ -1,15 +1,545 @@
 #include "Renderer.h"
+#include "MeshSimplifier.h"
+#include "RendererMesh.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
 
 namespace engine {
 
+namespace {
+
+// Vertex attributes are the pack::VertexAttribute locations, then the draw of the instance.
+const GLuint drawIDLocation = pack::VertexAttribute::COUNT;
+// Binding of the instance table in the VAO, the vertex arena being binding 0.
+const GLuint instanceBinding = 1;
+
+// Positions are dequantized by the model matrix of the draw, normals are octahedral.
+// The draw ID is read from a per instance attribute at base instance + instance, so that GL 4.4
+// is enough without gl_DrawID, and nodes sharing a mesh level are instances of one command.
+const char *vertexShader = R"(#version 440 core
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 normal;
+layout(location = 2) in vec2 texcoord;
+layout(location = 3) in vec4 color;
+layout(location = 4) in uint drawID;
+
+layout(std140, binding = 0) uniform Frame {
+	mat4 viewProjection;
+};
+
+struct Draw {
+	mat4 model;
+	mat3 normal;
+	uint material;
+};
+
+layout(std430, binding = 0) readonly buffer Draws {
+	Draw draws[];
+};
+
+struct Material {
+	vec4 color;
+};
+
+layout(std430, binding = 1) readonly buffer Materials {
+	Material materials[];
+};
+
+out vec3 vNormal;
+out vec4 vColor;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+void main()
+{
+	Draw draw = draws[drawID];
+	gl_Position = viewProjection * (draw.model * vec4(position.xyz, 1.0));
+	vNormal = draw.normal * decodeOctahedral(normal);
+	vColor = materials[draw.material].color * color;
+}
+)";
+
+const char *fragmentShader = R"(#version 440 core
+in vec3 vNormal;
+in vec4 vColor;
+
+out vec4 fragColor;
+
+const vec3 toLight = normalize(vec3(0.3, 1.0, 0.5));
+
+void main()
+{
+	float diffuse = max(dot(normalize(vNormal), toLight), 0.0);
+	fragColor = vec4(vColor.rgb * (0.2 + 0.8 * diffuse), vColor.a);
+}
+)";
+
+// std140
+struct FrameUniforms {
+	float viewProjection[16];
+};
+
+// std430, checked against the program blocks. A mat3 has vec4 columns, the struct is 16 bytes aligned.
+struct DrawData {
+	float model[16];
+	float normal[12];
+	uint32_t material;
+	uint32_t padding[3];
+};
+
+struct MaterialData {
+	float color[4];
+};
+
+// Layout read by glMultiDrawElementsIndirect.
+struct DrawCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+void store(const geom::mat4 &matrix, float *out)
+{
+	for (unsigned int iCol = 0; iCol < 4; iCol++)
+		for (unsigned int iRow = 0; iRow < 4; iRow++)
+			out[iCol * 4 + iRow] = matrix[iCol][iRow];
+}
+
+#if defined(_DEBUG)
+// World transform of a node from the hierarchy, against the walk of its parent chain.
+void checkWorld(const world::Model &model, size_t node, const geom::mat4 &world)
+{
+	const geom::mat4 expected = model.nodes[node].getModel();
+	for (unsigned int iCol = 0; iCol < 4; iCol++)
+		for (unsigned int iRow = 0; iRow < 4; iRow++)
+			if (std::abs(world[iCol][iRow] - expected[iCol][iRow]) > 1e-4f * (1.f + std::abs(expected[iCol][iRow])))
+				throw std::logic_error("Stale world transform of node " + std::to_string(node) + ", update the hierarchy before Renderer::prepare");
+}
+#endif
+
+// Throw if the block or the member does not have the layout of the CPU side.
+void checkMember(const ProgramBlock *block, const char *name, size_t offset, size_t arrayStride)
+{
+	if (block == nullptr)
+		throw std::runtime_error("Renderer program has no block for " + std::string(name));
+	const ProgramBlockMember *member = block->member(name);
+	// Members unused by the shaders are not active, they have no layout to check.
+	if (member == nullptr)
+		return;
+	if (static_cast<size_t>(member->offset) != offset || static_cast<size_t>(member->arrayStride) != arrayStride)
+		throw std::runtime_error("Layout mismatch of " + block->name + " " + member->name);
+}
+
+size_t align(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void PersistentBuffer::create(size_t size)
+{
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &buffer);
+	if (!buffer)
+		throw std::runtime_error("Could not gen buffer");
+	// Any target does, the buffer is bound where it is used.
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+	data = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	if (data == nullptr)
+	{
+		destroy();
+		throw std::runtime_error("Could not map buffer");
+	}
+	this->size = size;
+}
+
+void PersistentBuffer::grow(size_t size, size_t used)
+{
+	PersistentBuffer grown;
+	grown.create(std::max(size, this->size * 2));
+	if (used > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, grown.buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	// Commands in flight keep the old storage alive until they complete.
+	destroy();
+	*this = grown;
+}
 
-Renderer::Renderer()
+void PersistentBuffer::destroy()
 {
+	// Deleting unmaps.
+	if (buffer)
+		glDeleteBuffers(1, &buffer);
+	buffer = 0;
+	data = nullptr;
+	size = 0;
 }
 
+Renderer::Renderer(ProgramCache *cache) :
+	lodThreshold(1.f),
+	m_vao(0),
+	m_stride(pack::VertexLayout(pack::VertexFormat::compressed()).stride),
+	m_model(nullptr),
+	m_vertexCount(0),
+	m_indexCount(0),
+	m_frameBinding(0),
+	m_drawBinding(0),
+	m_materialBinding(0),
+	m_drawCapacity(0),
+	m_materialCapacity(0),
+	m_frameSize(0),
+	m_materialOffset(0),
+	m_drawOffset(0),
+	m_instanceOffset(0),
+	m_commandOffset(0),
+	m_fences(),
+	m_frame(0),
+	m_drawCount(0),
+	m_commandCount(0),
+	m_statistics()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major < 4 || (major == 4 && minor < 4))
+		throw std::runtime_error("Renderer requires GL 4.4");
+	// Checked at the end, the driver may compile while the VAO is set.
+	const ShaderSource sources[] = {
+		{ GL_VERTEX_SHADER, vertexShader },
+		{ GL_FRAGMENT_SHADER, fragmentShader },
+	};
+	m_program.build(sources, sizeof(sources) / sizeof(sources[0]), cache);
+
+	// Formats are set once, buffers are bound again when they grow.
+	glGenVertexArrays(1, &m_vao);
+	if (!m_vao)
+		throw std::runtime_error("Could not gen VAO");
+	glBindVertexArray(m_vao);
+	const pack::VertexLayout layout(pack::VertexFormat::compressed());
+	for (uint32_t iAttribute = 0; iAttribute < layout.count; iAttribute++)
+	{
+		const pack::VertexAttribute &attribute = layout.attributes[iAttribute];
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribFormat(attribute.location, attribute.components, glType(attribute.type), attribute.isNormalized() ? GL_TRUE : GL_FALSE, attribute.offset);
+		glVertexAttribBinding(attribute.location, 0);
+	}
+	glEnableVertexAttribArray(drawIDLocation);
+	glVertexAttribIFormat(drawIDLocation, 1, GL_UNSIGNED_INT, 0);
+	glVertexAttribBinding(drawIDLocation, instanceBinding);
+	glVertexBindingDivisor(instanceBinding, 1);
+	glBindVertexArray(0);
+
+	if (!m_program.wait())
+		throw std::runtime_error("Could not build renderer program: " + m_program.log);
+	// Bindings are the ones of the shaders, the CPU structures must match their packing.
+	const ProgramBlock *frame = m_program.uniformBlock("Frame");
+	checkMember(frame, "viewProjection", offsetof(FrameUniforms, viewProjection), 0);
+	const ProgramBlock *draws = m_program.storageBlock("Draws");
+	checkMember(draws, "draws[0].model", offsetof(DrawData, model), sizeof(DrawData));
+	checkMember(draws, "draws[0].normal", offsetof(DrawData, normal), sizeof(DrawData));
+	checkMember(draws, "draws[0].material", offsetof(DrawData, material), sizeof(DrawData));
+	const ProgramBlock *materials = m_program.storageBlock("Materials");
+	checkMember(materials, "materials[0].color", offsetof(MaterialData, color), sizeof(MaterialData));
+	if (static_cast<size_t>(frame->dataSize) > sizeof(FrameUniforms))
+		throw std::runtime_error("Layout mismatch of Frame");
+	m_frameBinding = frame->binding;
+	m_drawBinding = draws->binding;
+	m_materialBinding = materials->binding;
+}
 
 Renderer::~Renderer()
 {
+	for (GLsync fence : m_fences)
+		if (fence != nullptr)
+			glDeleteSync(fence);
+	m_vertices.destroy();
+	m_indices.destroy();
+	m_frames.destroy();
+	if (m_vao)
+		glDeleteVertexArrays(1, &m_vao);
+}
+
+void Renderer::commit(const RenderingSession &session)
+{
+	if (session.model != m_model)
+	{
+		// Frames in flight still read the arena.
+		for (unsigned int iFrame = 0; iFrame < frameCount; iFrame++)
+			waitFrame(iFrame);
+		m_model = session.model;
+		m_meshes.clear();
+		m_vertexCount = 0;
+		m_indexCount = 0;
+	}
+	if (m_model == nullptr)
+		return;
+	const pack::VertexFormat format = pack::VertexFormat::compressed();
+	m_meshes.resize(m_model->meshes.size(), ArenaMesh{ -1, Buffer<Level>(), geom::mat4::identity() });
+	for (size_t iMesh = 0; iMesh < m_model->meshes.size(); iMesh++)
+	{
+		const world::Mesh &mesh = m_model->meshes[iMesh];
+		ArenaMesh &arenaMesh = m_meshes[iMesh];
+		if (arenaMesh.baseVertex >= 0 || mesh.indices.size() == 0)
+			continue;
+		size_t indexCount = mesh.indices.size();
+		for (const world::Lod &lod : mesh.lods.levels)
+			indexCount += lod.indices.size();
+		reserveVertices(m_vertexCount + mesh.positions.size());
+		reserveIndices(m_indexCount + indexCount);
+
+		// Written straight into the mapping, past everything a frame may read.
+		Buffer<pack::Vertex> vertices(mesh.positions.size());
+		pack::interleave(mesh, vertices.data());
+		const pack::VertexBounds bounds = pack::VertexBounds::compute(vertices.data(), vertices.size());
+		pack::encode(vertices.data(), vertices.size(), format, bounds, m_vertices.data + m_vertexCount * m_stride);
+		arenaMesh.baseVertex = static_cast<int32_t>(m_vertexCount);
+		arenaMesh.positionTransform = bounds.positionTransform(format);
+		m_vertexCount += vertices.size();
+		auto append = [&](const unsigned int *indices, size_t count) {
+			arenaMesh.levels.push_back(Level{ static_cast<uint32_t>(m_indexCount), static_cast<uint32_t>(count) });
+			std::memcpy(m_indices.data + m_indexCount * sizeof(uint32_t), indices, count * sizeof(uint32_t));
+			m_indexCount += count;
+		};
+		append(mesh.indices.data(), mesh.indices.size());
+		for (const world::Lod &lod : mesh.lods.levels)
+			append(lod.indices.data(), lod.indices.size());
+	}
+}
+
+void Renderer::prepare(const RenderingSession &session)
+{
+	waitFrame(m_frame);
+	m_drawCount = 0;
+	m_commandCount = 0;
+	m_draws.clear();
+	m_packets.clear();
+	m_batches.clear();
+	m_statistics.drawCalls = 0;
+	m_statistics.draws = 0;
+	m_statistics.commands = 0;
+	m_statistics.triangles = 0;
+	if (m_model == nullptr)
+		return;
+	// The last material is the default one, of meshes without material.
+	const size_t materialCount = m_model->materials.size() + 1;
+	reserveFrames(m_model->nodes.size(), materialCount);
+
+	// Every block of the frame is written in its region, no glUniform.
+	unsigned char *region = m_frames.data + m_frame * m_frameSize;
+	FrameUniforms uniforms;
+	const geom::mat4 view = session.camera.view();
+	store(session.camera.perspective() * view, uniforms.viewProjection);
+	std::memcpy(region, &uniforms, sizeof(FrameUniforms));
+	MaterialData *materials = reinterpret_cast<MaterialData*>(region + m_materialOffset);
+	for (size_t iMaterial = 0; iMaterial < materialCount; iMaterial++)
+	{
+		MaterialData material;
+		for (unsigned int iComponent = 0; iComponent < 4; iComponent++)
+			material.color[iComponent] = (iMaterial < m_model->materials.size()) ? m_model->materials[iMaterial].color[iComponent] : 1.f;
+		materials[iMaterial] = material;
+	}
+	DrawData *draws = reinterpret_cast<DrawData*>(region + m_drawOffset);
+	uint32_t *instances = reinterpret_cast<uint32_t*>(region + m_instanceOffset);
+	DrawCommand *commands = reinterpret_cast<DrawCommand*>(region + m_commandOffset);
+	const world::Hierarchy &hierarchy = m_model->hierarchy;
+	for (size_t iNode = 0; iNode < m_model->nodes.size(); iNode++)
+	{
+		const world::Mesh *mesh = m_model->nodes[iNode].mesh;
+		if (mesh == nullptr)
+			continue;
+		const ArenaMesh &arenaMesh = m_meshes[mesh - m_model->meshes.data()];
+		if (arenaMesh.baseVertex < 0)
+			continue;
+		const geom::mat4 &model = hierarchy.getModel(static_cast<unsigned int>(iNode));
+#if defined(_DEBUG)
+		checkWorld(*m_model, iNode, model);
+#endif
+		const unsigned int lod = world::selectLod(*mesh, model, session.camera, static_cast<float>(session.height), lodThreshold);
+		const Level &level = arenaMesh.levels[std::min<size_t>(lod, arenaMesh.levels.size() - 1)];
+
+		// Written whole, the mapping is write only.
+		DrawData draw = {};
+		store(model * arenaMesh.positionTransform, draw.model);
+		// Inverse transpose, stored transposed.
+		const geom::mat4 inverse = geom::mat4::inverse(model);
+		for (unsigned int iCol = 0; iCol < 3; iCol++)
+			for (unsigned int iRow = 0; iRow < 3; iRow++)
+				draw.normal[iCol * 4 + iRow] = inverse[iRow][iCol];
+		const uint32_t material = (mesh->material != nullptr) ? static_cast<uint32_t>(mesh->material - m_model->materials.data()) : static_cast<uint32_t>(materialCount - 1);
+		draw.material = material;
+		draws[m_drawCount] = draw;
+
+		// Draw data stays in node order, the instance table of the sorted commands points to it.
+		// Depth of the node origin, as meshes are not sorted per triangle.
+		const float alpha = (mesh->material != nullptr) ? mesh->material->color[3] : 1.f;
+		const DrawPass pass = (alpha < 1.f) ? DrawPass::BLENDED : DrawPass::SOLID;
+		const float viewDepth = (view * model)[3][2];
+		const float depth = (viewDepth - session.camera.pnear) / (session.camera.pfar - session.camera.pnear);
+		const uint32_t meshIndex = static_cast<uint32_t>(mesh - m_model->meshes.data());
+		m_packets.push_back(DrawPacket{ sortKey(pass, 0, material, meshIndex, depth), static_cast<uint32_t>(m_drawCount) });
+		m_draws.push_back(Draw{ level, arenaMesh.baseVertex });
+		m_drawCount++;
+		m_statistics.triangles += level.indexCount / 3;
+	}
+	sortPackets(m_packets);
+	DrawPass previousPass = DrawPass::SOLID;
+	for (size_t iPacket = 0; iPacket < m_packets.size(); iPacket++)
+	{
+		const DrawPacket &packet = m_packets[iPacket];
+		const Draw &draw = m_draws[packet.draw];
+		instances[iPacket] = packet.draw;
+		// A single program for now, so the pass is the only GL state.
+		const DrawPass pass = drawState(packet.key).pass;
+		if (m_batches.empty() || previousPass != pass)
+		{
+			m_batches.push_back(Batch{ pass, m_commandCount, 0 });
+			previousPass = pass;
+		}
+		else
+		{
+			// Consecutive packets of the same mesh level are instances of the previous command.
+			const Draw &previous = m_draws[m_packets[iPacket - 1].draw];
+			if (previous.baseVertex == draw.baseVertex && previous.level.firstIndex == draw.level.firstIndex)
+			{
+				commands[m_commandCount - 1].instanceCount++;
+				continue;
+			}
+		}
+		commands[m_commandCount] = DrawCommand{ draw.level.indexCount, 1, draw.level.firstIndex, draw.baseVertex, static_cast<GLuint>(iPacket) };
+		m_commandCount++;
+		m_batches.back().count++;
+	}
+	m_statistics.draws = m_drawCount;
+	m_statistics.commands = m_commandCount;
 }
 
-}
\ No newline at end of file
+void Renderer::render(const RenderingSession &)
+{
+	if (m_drawCount == 0)
+		return;
+	const size_t region = m_frame * m_frameSize;
+	m_program.use();
+	glBindVertexArray(m_vao);
+	glBindBufferRange(GL_UNIFORM_BUFFER, m_frameBinding, m_frames.buffer, region, sizeof(FrameUniforms));
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, m_materialBinding, m_frames.buffer, region + m_materialOffset, (m_model->materials.size() + 1) * sizeof(MaterialData));
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, m_drawBinding, m_frames.buffer, region + m_drawOffset, m_drawCount * sizeof(DrawData));
+	glBindVertexBuffer(instanceBinding, m_frames.buffer, region + m_instanceOffset, sizeof(uint32_t));
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_frames.buffer);
+	for (const Batch &batch : m_batches)
+	{
+		// Batches are split on pass transitions, so every batch changes the state.
+		if (batch.pass == DrawPass::BLENDED)
+		{
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+		}
+		else
+		{
+			glDisable(GL_BLEND);
+			glDepthMask(GL_TRUE);
+		}
+		const size_t offset = region + m_commandOffset + batch.first * sizeof(DrawCommand);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(offset), static_cast<GLsizei>(batch.count), 0);
+	}
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+	m_program.doNotUse();
+	m_statistics.drawCalls = m_batches.size();
+}
+
+void Renderer::finish(const RenderingSession &)
+{
+	if (m_fences[m_frame] != nullptr)
+		glDeleteSync(m_fences[m_frame]);
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_frame = (m_frame + 1) % frameCount;
+}
+
+void Renderer::waitFrame(unsigned int frame)
+{
+	GLsync &fence = m_fences[frame];
+	if (fence == nullptr)
+		return;
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		m_statistics.fenceWaits++;
+		// Flush, the fence may still be in the command queue.
+		do {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+	if (result == GL_WAIT_FAILED)
+		throw std::runtime_error("Could not wait for frame");
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void Renderer::reserveVertices(size_t count)
+{
+	if (count * m_stride <= m_vertices.size)
+		return;
+	m_vertices.grow(count * m_stride, m_vertexCount * m_stride);
+	glBindVertexArray(m_vao);
+	glBindVertexBuffer(0, m_vertices.buffer, 0, m_stride);
+	glBindVertexArray(0);
+}
+
+void Renderer::reserveIndices(size_t count)
+{
+	if (count * sizeof(uint32_t) <= m_indices.size)
+		return;
+	m_indices.grow(count * sizeof(uint32_t), m_indexCount * sizeof(uint32_t));
+	// The element buffer is part of the VAO.
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices.buffer);
+	glBindVertexArray(0);
+}
+
+void Renderer::reserveFrames(size_t drawCount, size_t materialCount)
+{
+	if (drawCount <= m_drawCapacity && materialCount <= m_materialCapacity)
+		return;
+	// Every region is laid out again.
+	for (unsigned int iFrame = 0; iFrame < frameCount; iFrame++)
+		waitFrame(iFrame);
+	m_drawCapacity = std::max(drawCount, m_drawCapacity * 2);
+	m_materialCapacity = std::max(materialCount, m_materialCapacity * 2);
+	GLint uniformAlignment = 0, storageAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+	m_materialOffset = align(sizeof(FrameUniforms), storageAlignment);
+	m_drawOffset = align(m_materialOffset + m_materialCapacity * sizeof(MaterialData), storageAlignment);
+	m_instanceOffset = align(m_drawOffset + m_drawCapacity * sizeof(DrawData), sizeof(uint32_t));
+	m_commandOffset = align(m_instanceOffset + m_drawCapacity * sizeof(uint32_t), sizeof(GLuint));
+	m_frameSize = align(m_commandOffset + m_drawCapacity * sizeof(DrawCommand), std::max(uniformAlignment, storageAlignment));
+	m_frames.destroy();
+	m_frames.create(m_frameSize * frameCount);
+}
+
+}
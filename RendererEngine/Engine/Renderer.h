@@ -1,21 +1,131 @@
 #pragma once
 
 #include "RenderingSession.h"
+#include "RendererProgram.h"
+#include "RenderQueue.h"
 
+#include <stdint.h>
 
 namespace engine {
 
+// Buffer mapped once for its whole life. Coherent, so that CPU writes are seen by the
+// commands issued after them without flush. The CPU must not write what the GPU still reads.
+struct PersistentBuffer {
+	GLuint buffer = 0;
+	unsigned char *data = nullptr;
+	size_t size = 0;
+
+	void create(size_t size);
+	// Create again with at least size bytes, the GPU copies the first used bytes.
+	void grow(size_t size, size_t used);
+	void destroy();
+};
+
+// Counters of the last prepared frame.
+struct RendererStatistics {
+	size_t drawCalls;	// GL draw calls, 1 per pass whatever the number of meshes & nodes
+	size_t draws;		// Nodes with an uploaded mesh
+	size_t commands;	// Indirect commands, consecutive draws of a mesh level being instances of one
+	size_t triangles;
+	size_t fenceWaits;	// Frames which had to wait for the GPU to release their region, since creation
+};
+
+// GL 4.4 renderer of a RenderingSession.
+// Every mesh is encoded in pack::VertexFormat::compressed() into one vertex & index arena, so that
+// the nodes of a pass are drawn by a single glMultiDrawElementsIndirect, their levels of detail included.
+// Commands are sorted by their RenderQueue key, solid draws front to back then blended draws
+// back to front, and pass states are set on transitions only.
+// Per frame uniforms, materials, node transforms, instances & commands are written in one of
+// frameCount regions of a persistently mapped buffer, a region is written again once the fence of
+// its last frame is signaled. Blocks are bound where the program reflection finds them.
 class Renderer
 {
 public:
-	Renderer();
+	static const unsigned int frameCount = 3;
+
+	// Require a current GL 4.4 context, throw std::runtime_error otherwise.
+	// The program binary is loaded from the cache if not null, stored in it otherwise.
+	explicit Renderer(ProgramCache *cache = nullptr);
+	Renderer(const Renderer &) = delete;
+	Renderer &operator=(const Renderer &) = delete;
 	~Renderer();
 
+	// Upload the meshes of the session model which are not in the arena yet. Empty meshes are
+	// skipped until they are loaded. A session with another model empties the arena.
 	void commit(const RenderingSession &session);
 
+	// Wait for the region of the frame, then write the uniforms, the data of every node & their sorted commands.
 	void prepare(const RenderingSession &session);
+	// Draw every node with the prepared frame.
 	void render(const RenderingSession &session);
+	// Fence the region of the frame & move to the next one.
 	void finish(const RenderingSession &session);
+
+	const RendererStatistics &statistics() const { return m_statistics; }
+
+	float lodThreshold;	// Screen space error of the selected levels of detail, in pixels
+private:
+	// Range of a mesh level in the index arena.
+	struct Level {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+	// Indices of a prepared draw, until its command is written in sorted order.
+	struct Draw {
+		Level level;
+		int32_t baseVertex;
+	};
+	// Consecutive commands of a pass.
+	struct Batch {
+		DrawPass pass;
+		size_t first;
+		size_t count;
+	};
+	struct ArenaMesh {
+		int32_t baseVertex;		// -1 until uploaded
+		Buffer<Level> levels;	// The full mesh first
+		geom::mat4 positionTransform;
+	};
+	void waitFrame(unsigned int frame);
+	void reserveVertices(size_t count);
+	void reserveIndices(size_t count);
+	void reserveFrames(size_t drawCount, size_t materialCount);
+private:
+	Program m_program;
+	GLuint m_vao;
+	uint32_t m_stride;
+
+	// Arena, allocated linearly & grown by copy.
+	const world::Model *m_model;
+	Buffer<ArenaMesh> m_meshes;
+	PersistentBuffer m_vertices;
+	PersistentBuffer m_indices;
+	size_t m_vertexCount;
+	size_t m_indexCount;
+
+	// Bindings of the program blocks
+	GLuint m_frameBinding;
+	GLuint m_drawBinding;
+	GLuint m_materialBinding;
+
+	// Frames
+	PersistentBuffer m_frames;
+	size_t m_drawCapacity;
+	size_t m_materialCapacity;
+	size_t m_frameSize;			// Of a region
+	size_t m_materialOffset;	// In a region
+	size_t m_drawOffset;		// In a region
+	size_t m_instanceOffset;	// In a region, draw index per instance in command order
+	size_t m_commandOffset;		// In a region
+	GLsync m_fences[frameCount];
+	unsigned int m_frame;
+	size_t m_drawCount;
+	size_t m_commandCount;
+	Buffer<Draw> m_draws;
+	Buffer<DrawPacket> m_packets;
+	Buffer<Batch> m_batches;
+
+	RendererStatistics m_statistics;
 };
 
-}
\ No newline at end of file
+}
@@ -1,59 +1,101 @@
 #include "RendererMesh.h"
+#include "MeshOptimizer.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 
 namespace engine {
 
-RendererMesh::RendererMesh(const world::Mesh &mesh)
+GLenum glType(pack::AttributeType type)
 {
-	/*glGenVertexArrays(1, &vao);
-	if (!vao)
-		throw std::runtime_error("Could not gen VAO");
-	glBindVertexArray(vao);
-
-	glGenBuffers(1, &vboArrayBuffer);
-	if (!vboArrayBuffer)
+	switch (type)
 	{
-		glDeleteVertexArrays(1, &vao);
-		throw std::runtime_error("Could not gen VBO");
+	case pack::AttributeType::FLOAT: return GL_FLOAT;
+	case pack::AttributeType::HALF: return GL_HALF_FLOAT;
+	case pack::AttributeType::UNORM16: return GL_UNSIGNED_SHORT;
+	case pack::AttributeType::SNORM16: return GL_SHORT;
+	case pack::AttributeType::UNORM8: return GL_UNSIGNED_BYTE;
+	default: throw std::runtime_error("Unknown attribute type");
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, vboArrayBuffer);
-	glBufferData(GL_ARRAY_BUFFER, mesh.positions.size() * sizeof(geom::point3), &vertices[0], GL_STATIC_DRAW);
+}
 
-	glGenBuffers(1, &vboElementArrayBuffer);
-	if (!vboElementArrayBuffer)
+RendererMesh::RendererMesh(const world::Mesh &mesh, const pack::VertexFormat &format) :
+	vboArrayBuffer(0),
+	vboElementArrayBuffer(0),
+	vao(0),
+	indexType(GL_UNSIGNED_INT),
+	format(pack::VertexFormat::uncompressed()),
+	positionTransform(geom::mat4::identity())
+{
+	Buffer<pack::Vertex> vertices(mesh.positions.size());
+	pack::interleave(mesh, vertices.data());
+	const pack::VertexFormat fitted = format.fit(mesh);
+	const pack::VertexBounds bounds = pack::VertexBounds::compute(vertices.data(), vertices.size());
+	Buffer<unsigned char> encoded(vertices.size() * pack::VertexLayout(fitted).stride);
+	pack::encode(vertices.data(), vertices.size(), fitted, bounds, encoded.data());
+	positionTransform = bounds.positionTransform(fitted);
+	Buffer<const void*> indices;
+	Buffer<size_t> indexCounts;
+	indices.push_back(mesh.indices.data());
+	indexCounts.push_back(mesh.indices.size());
+	for (const world::Lod &lod : mesh.lods.levels)
 	{
-		glDeleteVertexArrays(1, &vao);
-		glDeleteBuffers(1, &vboArrayBuffer);
-		throw std::runtime_error("Could not gen VBO");
+		indices.push_back(lod.indices.data());
+		indexCounts.push_back(lod.indices.size());
 	}
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboElementArrayBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * 3 * sizeof(unsigned int), &triangles[0], GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(POSITION);
-	glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offset(POSITION));
-	//if (m_has[Attributes::NORMAL])
-	//{
-	glEnableVertexAttribArray(NORMAL);
-	glVertexAttribPointer(NORMAL, 3, GL_FLOAT, GL_TRUE, sizeof(Vertex), offset(NORMAL));
-	//}
-	//if (m_has[Attributes::COLOR])
-	//{
-	glEnableVertexAttribArray(COLOR);
-	glVertexAttribPointer(COLOR, 4, GL_FLOAT, GL_TRUE, sizeof(Vertex), offset(COLOR));
-	//}
-
-	for (GLuint att = Attributes::TEXCOORD0; att < NB_ATTRIBUTES; att++)
+	if (world::hasShortIndices(vertices.size()))
 	{
-		//if (m_has[att])
-		//{
-		glEnableVertexAttribArray(att);
-		glVertexAttribPointer(att, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offset(static_cast<Attributes>(att)));
-		//}
+		Buffer<Buffer<uint16_t>> shortIndices(indices.size());
+		for (size_t iLevel = 0; iLevel < indices.size(); iLevel++)
+		{
+			shortIndices[iLevel].resize(indexCounts[iLevel]);
+			world::shrinkIndices(static_cast<const unsigned int*>(indices[iLevel]), indexCounts[iLevel], shortIndices[iLevel].data());
+			indices[iLevel] = shortIndices[iLevel].data();
+		}
+		upload(encoded.data(), vertices.size(), fitted, indices.data(), indexCounts.data(), indices.size(), GL_UNSIGNED_SHORT);
 	}
+	else
+	{
+		upload(encoded.data(), vertices.size(), fitted, indices.data(), indexCounts.data(), indices.size(), GL_UNSIGNED_INT);
+	}
+}
 
-	glBindVertexArray(0);
+RendererMesh::RendererMesh(const pack::Package &package, size_t mesh) :
+	vboArrayBuffer(0),
+	vboElementArrayBuffer(0),
+	vao(0),
+	indexType(GL_UNSIGNED_INT),
+	format(pack::VertexFormat::uncompressed()),
+	positionTransform(geom::mat4::identity())
+{
+	const pack::MeshEntry &entry = package.mesh(mesh);
+	positionTransform = entry.bounds.positionTransform(entry.format);
+	Buffer<const void*> indices;
+	Buffer<size_t> indexCounts;
+	indices.push_back(package.indices(entry));
+	indexCounts.push_back(entry.indexCount);
+	for (uint32_t iLod = 0; iLod < entry.lodCount; iLod++)
+	{
+		const pack::LodEntry &lod = package.lod(entry, iLod);
+		indices.push_back(package.indices(lod));
+		indexCounts.push_back(lod.indexCount);
+	}
+	upload(package.vertices(entry), entry.vertexCount, entry.format, indices.data(), indexCounts.data(), indices.size(), (entry.indexSize == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+}
 
-	return true;*/
+RendererMesh::RendererMesh(const pack::Vertex *vertices, size_t vertexCount, const uint32_t *indices, size_t indexCount) :
+	vboArrayBuffer(0),
+	vboElementArrayBuffer(0),
+	vao(0),
+	indexType(GL_UNSIGNED_INT),
+	format(pack::VertexFormat::uncompressed()),
+	positionTransform(geom::mat4::identity())
+{
+	// pack::Vertex is the uncompressed layout.
+	const void *levelIndices = indices;
+	upload(vertices, vertexCount, pack::VertexFormat::uncompressed(), &levelIndices, &indexCount, 1, GL_UNSIGNED_INT);
 }
 
 RendererMesh::~RendererMesh()
@@ -66,5 +108,68 @@ RendererMesh::~RendererMesh()
 		glDeleteBuffers(1, &vboElementArrayBuffer);
 }
 
+void RendererMesh::draw(unsigned int lod) const
+{
+	const Level &level = levels[std::min<size_t>(lod, levels.size() - 1)];
+	// Attributes which are not stored read the current generic value, which is not part of the VAO.
+	if (format.normal == pack::VertexFormat::Normal::NONE)
+		glVertexAttrib3f(NORMAL, 0.f, 0.f, 1.f);
+	if (format.texcoord == pack::VertexFormat::Texcoord::NONE)
+		glVertexAttrib2f(TEXCOORD, 0.f, 0.f);
+	if (format.color == pack::VertexFormat::Color::NONE)
+		glVertexAttrib4f(COLOR, 1.f, 1.f, 1.f, 1.f);
+	glBindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, level.indexCount, indexType, reinterpret_cast<const void*>(static_cast<uintptr_t>(level.offset)));
+	glBindVertexArray(0);
+}
+
+void RendererMesh::upload(const void *vertices, size_t vertexCount, const pack::VertexFormat &format, const void *const *indices, const size_t *indexCounts, size_t levelCount, GLenum indexType)
+{
+	glGenVertexArrays(1, &vao);
+	if (!vao)
+		throw std::runtime_error("Could not gen VAO");
+	glBindVertexArray(vao);
 
-}
\ No newline at end of file
+	glGenBuffers(1, &vboArrayBuffer);
+	glGenBuffers(1, &vboElementArrayBuffer);
+	if (!vboArrayBuffer || !vboElementArrayBuffer)
+	{
+		glBindVertexArray(0);
+		glDeleteBuffers(1, &vboArrayBuffer);
+		glDeleteBuffers(1, &vboElementArrayBuffer);
+		glDeleteVertexArrays(1, &vao);
+		throw std::runtime_error("Could not gen VBO");
+	}
+	// The bytes are read once by the driver, no intermediate copy is made.
+	glBindBuffer(GL_ARRAY_BUFFER, vboArrayBuffer);
+	const pack::VertexLayout layout(format);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * layout.stride, vertices, GL_STATIC_DRAW);
+	// Levels are packed one after the other, every offset stays aligned to the index size.
+	const size_t indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+	levels.resize(levelCount);
+	size_t size = 0;
+	for (size_t iLevel = 0; iLevel < levelCount; iLevel++)
+	{
+		levels[iLevel] = Level{ static_cast<GLsizei>(indexCounts[iLevel]), size };
+		size += indexCounts[iLevel] * indexSize;
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboElementArrayBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+	for (size_t iLevel = 0; iLevel < levelCount; iLevel++)
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, levels[iLevel].offset, indexCounts[iLevel] * indexSize, indices[iLevel]);
+	this->indexType = indexType;
+	this->format = format;
+
+	for (uint32_t iAttribute = 0; iAttribute < layout.count; iAttribute++)
+	{
+		const pack::VertexAttribute &attribute = layout.attributes[iAttribute];
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location, attribute.components, glType(attribute.type), attribute.isNormalized() ? GL_TRUE : GL_FALSE, layout.stride, reinterpret_cast<const void*>(static_cast<uintptr_t>(attribute.offset)));
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+}
@@ -2,16 +2,53 @@
 
 #include "Config.h"
 #include "Model.h"
+#include "Package.h"
 
 namespace engine {
 
+// GL type of a vertex attribute, read normalized when VertexAttribute::isNormalized.
+GLenum glType(pack::AttributeType type);
+
+// Interleaved vertex buffer in a pack::VertexFormat & 16 or 32 bits index buffer.
+// The index buffer holds the full mesh followed by its levels of detail.
 struct RendererMesh
 {
-	RendererMesh(const world::Mesh &mesh);
+	enum Attribute : GLuint {
+		POSITION = pack::VertexAttribute::POSITION,
+		NORMAL = pack::VertexAttribute::NORMAL,
+		TEXCOORD = pack::VertexAttribute::TEXCOORD,
+		COLOR = pack::VertexAttribute::COLOR,
+	};
+
+	// Range of a level in the index buffer.
+	struct Level {
+		GLsizei indexCount;
+		size_t offset;	// In bytes
+	};
+
+	// Encode the mesh streams in the format fitted to the mesh, then upload them with 16 bits indices when they fit.
+	RendererMesh(const world::Mesh &mesh, const pack::VertexFormat &format = pack::VertexFormat::compressed());
+	// Upload a cooked mesh straight from the package mapping.
+	RendererMesh(const pack::Package &package, size_t mesh);
+	// Upload full precision vertices.
+	RendererMesh(const pack::Vertex *vertices, size_t vertexCount, const uint32_t *indices, size_t indexCount);
+	RendererMesh(const RendererMesh &) = delete;
+	RendererMesh &operator=(const RendererMesh &) = delete;
 	~RendererMesh();
+
+	// Draw a level of detail, see world::selectLod. Levels past the coarsest draw the coarsest.
+	void draw(unsigned int lod = 0) const;
+
 	GLuint vboArrayBuffer;
 	GLuint vboElementArrayBuffer;
 	GLuint vao;
+	Buffer<Level> levels;	// The full mesh first
+	GLenum indexType;	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	pack::VertexFormat format;
+	geom::mat4 positionTransform;	// Applied before the model matrix, to dequantize positions
+private:
+	// One index list per level, all of indexType.
+	void upload(const void *vertices, size_t vertexCount, const pack::VertexFormat &format, const void *const *indices, const size_t *indexCounts, size_t levelCount, GLenum indexType);
 };
 
 }
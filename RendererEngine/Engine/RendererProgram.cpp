@@ -1,8 +1,190 @@
 #include "RendererProgram.h"
 
+#include "../Framework/MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 
 namespace engine {
 
+namespace {
+
+// FNV-1a
+const uint64_t hashSeed = 14695981039346656037ULL;
+
+uint64_t hash(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *bytes = static_cast<const unsigned char*>(data);
+	for (size_t iByte = 0; iByte < size; iByte++)
+		hash = (hash ^ bytes[iByte]) * 1099511628211ULL;
+	return hash;
+}
+
+uint64_t hash(uint64_t value, const char *string)
+{
+	// Terminator included, so that consecutive strings do not hash as their concatenation.
+	return (string != nullptr) ? hash(value, string, std::strlen(string) + 1) : hash(value, "", 1);
+}
+
+// Header of a cache file, followed by the binary.
+struct CacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t binaryFormat;
+	uint32_t binarySize;
+	uint64_t checksum;	// Of the binary
+};
+const char cacheMagic[4] = { 'R', 'P', 'B', 'C' };
+const uint32_t cacheVersion = 1;
+
+std::string programLog(GLuint programID)
+{
+	GLint length = 0;
+	glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &length);
+	if (length <= 0)
+		return std::string();
+	// The length includes the NULL character
+	Buffer<GLchar> log(length);
+	glGetProgramInfoLog(programID, length, &length, log.data());
+	return std::string(log.data(), length);
+}
+
+std::string shaderLog(GLuint shaderID)
+{
+	GLint length = 0;
+	glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &length);
+	if (length <= 0)
+		return std::string();
+	Buffer<GLchar> log(length);
+	glGetShaderInfoLog(shaderID, length, &length, log.data());
+	return std::string(log.data(), length);
+}
+
+}
+
+bool enableParallelShaderCompile()
+{
+	// Let the driver pick the thread count.
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else if (GLEW_ARB_parallel_shader_compile)
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	else
+		return false;
+	return true;
+}
+
+ProgramCache::ProgramCache(const char *directory) :
+	hits(0),
+	misses(0),
+	m_directory(directory),
+	m_driver(hashSeed),
+	m_enabled(false)
+{
+	m_driver = hash(m_driver, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+	m_driver = hash(m_driver, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+	m_driver = hash(m_driver, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	m_enabled = (formatCount > 0);
+}
+
+uint64_t ProgramCache::key(const ShaderSource *sources, size_t count) const
+{
+	uint64_t value = hash(m_driver, &cacheVersion, sizeof(cacheVersion));
+	for (size_t iSource = 0; iSource < count; iSource++)
+	{
+		const uint32_t shaderType = sources[iSource].shaderType;
+		value = hash(value, &shaderType, sizeof(shaderType));
+		value = hash(value, sources[iSource].source);
+	}
+	return value;
+}
+
+bool ProgramCache::load(GLuint programID, uint64_t key)
+{
+	if (!m_enabled)
+		return false;
+	io::MappedFile file;
+	if (!file.open(path(key).c_str()))
+	{
+		misses++;
+		return false;
+	}
+	CacheHeader header;
+	if (file.size() < sizeof(CacheHeader))
+	{
+		misses++;
+		return false;
+	}
+	std::memcpy(&header, file.data(), sizeof(CacheHeader));
+	const unsigned char *binary = file.data() + sizeof(CacheHeader);
+	if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion || header.key != key ||
+		header.binarySize != file.size() - sizeof(CacheHeader) || header.checksum != hash(hashSeed, binary, header.binarySize))
+	{
+		misses++;
+		return false;
+	}
+	glProgramBinary(programID, header.binaryFormat, binary, header.binarySize);
+	// The driver may reject a binary of another build even with the same strings.
+	GLint linked = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		misses++;
+		return false;
+	}
+	hits++;
+	return true;
+}
+
+bool ProgramCache::store(GLuint programID, uint64_t key)
+{
+	if (!m_enabled)
+		return false;
+	GLint size = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0)
+		return false;
+	Buffer<unsigned char> binary(size);
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(programID, size, &size, &binaryFormat, binary.data());
+	CacheHeader header;
+	std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.key = key;
+	header.binaryFormat = binaryFormat;
+	header.binarySize = static_cast<uint32_t>(size);
+	header.checksum = hash(hashSeed, binary.data(), size);
+
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+	// Written aside then renamed, so that a crash does not leave a truncated binary.
+	const std::string finalPath = path(key);
+	const std::string temporaryPath = finalPath + ".tmp";
+	FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	const bool written = std::fwrite(&header, sizeof(CacheHeader), 1, file) == 1 && std::fwrite(binary.data(), 1, size, file) == static_cast<size_t>(size);
+	std::fclose(file);
+	if (!written)
+	{
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	std::filesystem::rename(temporaryPath, finalPath, error);
+	return !error;
+}
+
+std::string ProgramCache::path(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(m_directory) / name).string();
+}
 
 
 Shader::Shader() : 
@@ -27,15 +209,10 @@ bool Shader::compile(const char * shader, GLenum shaderType)
 	glGetShaderiv(this->shaderID, GL_COMPILE_STATUS, &isCompiled);
 	if (isCompiled == GL_FALSE)
 	{
-		GLint maxLength = 0;
-		glGetShaderiv(this->shaderID, GL_INFO_LOG_LENGTH, &maxLength);
-
-		// The maxLength includes the NULL character
-		Buffer<GLchar> errorLog(maxLength);
-		glGetShaderInfoLog(this->shaderID, maxLength, &maxLength, &errorLog[0]);
-		std::string str(errorLog.begin(), errorLog.end());
+		this->log = shaderLog(this->shaderID);
 		// Exit with failure.
 		glDeleteShader(this->shaderID); // Don't leak the shader.
+		this->shaderID = 0;
 		return false;
 	}
 	return true;
@@ -47,12 +224,16 @@ bool Shader::isOk() const
 }
 
 Program::Program() :
-	programID(glCreateProgram())
+	programID(glCreateProgram()),
+	m_cache(nullptr),
+	m_key(0)
 {
 }
 
 Program::~Program()
 {
+	for (GLuint shaderID : m_shaders)
+		glDeleteShader(shaderID);
 	if (this->programID)
 		glDeleteProgram(this->programID);
 }
@@ -79,38 +260,80 @@ bool Program::link()
 	glGetProgramiv(this->programID, GL_LINK_STATUS, &linked);
 	if (linked == GL_FALSE)
 	{
-		GLint maxLength = 0;
-		glGetProgramiv(this->programID, GL_INFO_LOG_LENGTH, &maxLength);
-
-		// The maxLength includes the NULL character
-		std::vector<GLchar> errorLog(maxLength);
-		glGetProgramInfoLog(this->programID, maxLength, &maxLength, &errorLog[0]);
-		std::string str(errorLog.begin(), errorLog.end());
+		this->log = programLog(this->programID);
 		// Exit with failure.
 		glDeleteProgram(this->programID); // Don't leak the program.
+		this->programID = 0;
 		return false;
 	}
-	// Always detach shaders after a successful link.
-	/*for (auto it = m_shaders.begin(); it != m_shaders.end(); it++)
-	{
-	GL::Shader *shader = it->second;
-	glDetachShader(m_programID, shader->getID());
-	// TODO need to delete it ? https://www.khronos.org/opengl/wiki/Shader_Compilation
-	delete shader;
-	}
-	m_shaders.clear();*/
-
-	// get uniforms locations
-	use();
-	//for (int i = 0; i < NB_MATRIX_UNIFORMS; i++)
-	//	m_matrixUniformsID[i] = glGetUniformLocation(m_programID, matrixUniformsNames(static_cast<MatrixUniform>(i)));
-	doNotUse();
+	// Data goes through blocks, not uniform locations.
+	reflect();
 
 	glValidateProgram(this->programID);
 
 	return isValid();
 }
 
+void Program::build(const ShaderSource *sources, size_t count, ProgramCache *cache)
+{
+	m_cache = cache;
+	m_key = (cache != nullptr) ? cache->key(sources, count) : 0;
+	if (cache != nullptr && cache->load(this->programID, m_key))
+	{
+		// Linked already, nothing to store.
+		m_cache = nullptr;
+		return;
+	}
+	// Status queries would wait for the driver threads, they are left to wait().
+	for (size_t iSource = 0; iSource < count; iSource++)
+	{
+		const GLuint shaderID = glCreateShader(sources[iSource].shaderType);
+		glShaderSource(shaderID, 1, &sources[iSource].source, NULL);
+		glCompileShader(shaderID);
+		glAttachShader(this->programID, shaderID);
+		m_shaders.push_back(shaderID);
+	}
+	if (cache != nullptr)
+		glProgramParameteri(this->programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(this->programID);
+}
+
+bool Program::isReady() const
+{
+	if (m_shaders.empty() || !(GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile))
+		return true;
+	GLint completed = GL_FALSE;
+	glGetProgramiv(this->programID, GL_COMPLETION_STATUS_KHR, &completed);
+	return (completed == GL_TRUE);
+}
+
+bool Program::wait()
+{
+	GLint linked = GL_FALSE;
+	glGetProgramiv(this->programID, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		this->log.clear();
+		for (GLuint shaderID : m_shaders)
+			this->log += shaderLog(shaderID);
+		this->log += programLog(this->programID);
+	}
+	// The program keeps its binary.
+	for (GLuint shaderID : m_shaders)
+	{
+		glDetachShader(this->programID, shaderID);
+		glDeleteShader(shaderID);
+	}
+	m_shaders.clear();
+	if (linked == GL_FALSE)
+		return false;
+	if (m_cache != nullptr)
+		m_cache->store(this->programID, m_key);
+	m_cache = nullptr;
+	reflect();
+	return true;
+}
+
 bool Program::isValid() const
 {
 	GLint isValid;
@@ -118,6 +341,74 @@ bool Program::isValid() const
 	return (isValid == GL_TRUE);
 }
 
+const ProgramBlockMember *ProgramBlock::member(const char *name) const
+{
+	for (const ProgramBlockMember &member : members)
+		if (member.name == name)
+			return &member;
+	return nullptr;
+}
+
+const ProgramBlock *Program::uniformBlock(const char *name) const
+{
+	for (const ProgramBlock &block : uniformBlocks)
+		if (block.name == name)
+			return &block;
+	return nullptr;
+}
+
+const ProgramBlock *Program::storageBlock(const char *name) const
+{
+	for (const ProgramBlock &block : storageBlocks)
+		if (block.name == name)
+			return &block;
+	return nullptr;
+}
+
+void Program::reflect()
+{
+	auto resourceName = [this](GLenum interface, GLuint index) {
+		GLint length = 0;
+		const GLenum property = GL_NAME_LENGTH;
+		glGetProgramResourceiv(this->programID, interface, index, 1, &property, 1, nullptr, &length);
+		// The length includes the NULL character
+		Buffer<GLchar> name(std::max(length, 1));
+		glGetProgramResourceName(this->programID, interface, index, length, &length, name.data());
+		return std::string(name.data(), length);
+	};
+	auto reflectBlocks = [&](GLenum blockInterface, GLenum variableInterface, GLenum strideProperty, Buffer<ProgramBlock> &blocks) {
+		blocks.clear();
+		GLint blockCount = 0;
+		glGetProgramInterfaceiv(this->programID, blockInterface, GL_ACTIVE_RESOURCES, &blockCount);
+		for (GLint iBlock = 0; iBlock < blockCount; iBlock++)
+		{
+			const GLenum blockProperties[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES };
+			GLint blockValues[3] = {};
+			glGetProgramResourceiv(this->programID, blockInterface, iBlock, 3, blockProperties, 3, nullptr, blockValues);
+			ProgramBlock block;
+			block.name = resourceName(blockInterface, iBlock);
+			block.binding = static_cast<GLuint>(blockValues[0]);
+			block.dataSize = blockValues[1];
+			Buffer<GLint> variables(blockValues[2]);
+			if (!variables.empty())
+			{
+				const GLenum property = GL_ACTIVE_VARIABLES;
+				glGetProgramResourceiv(this->programID, blockInterface, iBlock, 1, &property, static_cast<GLsizei>(variables.size()), nullptr, variables.data());
+			}
+			for (GLint variable : variables)
+			{
+				const GLenum variableProperties[] = { GL_OFFSET, strideProperty };
+				GLint variableValues[2] = {};
+				glGetProgramResourceiv(this->programID, variableInterface, variable, 2, variableProperties, 2, nullptr, variableValues);
+				block.members.push_back(ProgramBlockMember{ resourceName(variableInterface, variable), variableValues[0], variableValues[1] });
+			}
+			blocks.push_back(std::move(block));
+		}
+	};
+	reflectBlocks(GL_UNIFORM_BLOCK, GL_UNIFORM, GL_ARRAY_STRIDE, uniformBlocks);
+	reflectBlocks(GL_SHADER_STORAGE_BLOCK, GL_BUFFER_VARIABLE, GL_TOP_LEVEL_ARRAY_STRIDE, storageBlocks);
+}
+
 void Program::use()
 {
 	glUseProgram(this->programID);
@@ -2,6 +2,9 @@
 
 #include "Config.h"
 
+#include <stdint.h>
+#include <string>
+
 namespace engine {
 
 // GL_VERTEX_SHADER,
@@ -15,12 +18,67 @@ struct Shader {
 	Shader();
 	~Shader();
 
+	// Return false & fill the log on error.
 	bool compile(const char *shader, GLenum shaderType);
 
 	bool isOk() const;
 
 	GLenum shaderType;
 	GLuint shaderID;
+	std::string log;
+};
+
+struct ShaderSource {
+	GLenum shaderType;
+	const char *source;
+};
+
+// Active variable of a block, as laid out by the driver.
+struct ProgramBlockMember {
+	std::string name;	// Members of an array of structures are named after its first element, as "draws[0].model"
+	GLint offset;
+	GLint arrayStride;	// Of the top level array for a storage block, 0 if not an array
+};
+
+// Active uniform or shader storage block, queried after link so that the CPU side layout can be
+// checked against the std140 & std430 packing of the driver.
+struct ProgramBlock {
+	std::string name;
+	GLuint binding;
+	GLint dataSize;		// Of a storage block, one element of its unsized array
+	Buffer<ProgramBlockMember> members;
+
+	// Return nullptr if the member is not active.
+	const ProgramBlockMember *member(const char *name) const;
+};
+
+// Let the driver compile & link on its own threads with GL_KHR_parallel_shader_compile, so that
+// programs built one after the other compile concurrently. Return false if it is not supported.
+bool enableParallelShaderCompile();
+
+// Linked program binaries stored on disk, a file per program in the directory.
+// The key hashes the sources with the GL vendor, renderer & version strings, so that a driver
+// update misses. Files have a checksum, corrupted or rejected binaries are built again from source.
+class ProgramCache
+{
+public:
+	// Require a current GL context. The cache does nothing if the driver has no binary format.
+	ProgramCache(const char *directory);
+
+	uint64_t key(const ShaderSource *sources, size_t count) const;
+	// Return false if the binary is missing, corrupted or rejected by the driver.
+	bool load(GLuint programID, uint64_t key);
+	// Return false if the binary could not be written, the program still works.
+	bool store(GLuint programID, uint64_t key);
+
+	bool isEnabled() const { return m_enabled; }
+	size_t hits, misses;
+private:
+	std::string path(uint64_t key) const;
+private:
+	std::string m_directory;
+	uint64_t m_driver;	// Hash of the driver strings
+	bool m_enabled;
 };
 
 class Program
@@ -31,16 +89,40 @@ public:
 
 	bool attach(const Shader &shader);
 
+	// Return false & fill the log on error.
 	bool link();
 
+	// Start building the program from the sources, or load its binary if the cache has it.
+	// Nothing is checked until wait(), so that the driver can compile in the background.
+	void build(const ShaderSource *sources, size_t count, ProgramCache *cache = nullptr);
+	// Return true when wait() would not block. Always true without parallel compile.
+	bool isReady() const;
+	// Finish the build & store the binary in the cache. Return false & fill the log on error.
+	bool wait();
+
 	bool isValid() const;
 
+	// Return nullptr if the block is not active.
+	const ProgramBlock *uniformBlock(const char *name) const;
+	const ProgramBlock *storageBlock(const char *name) const;
+
 	void use();
 	void doNotUse();
 
 	GLuint programID;
 	Shader vertexShader;
 	Shader geometryShader;
+	std::string log;
+	// Filled by a successful link or build
+	Buffer<ProgramBlock> uniformBlocks;
+	Buffer<ProgramBlock> storageBlocks;
+private:
+	void reflect();
+private:
+	// Pending build
+	Buffer<GLuint> m_shaders;
+	ProgramCache *m_cache;
+	uint64_t m_key;
 
 };
 
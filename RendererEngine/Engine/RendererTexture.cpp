@@ -0,0 +1,96 @@
+#include "RendererTexture.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace engine {
+
+static GLsizei levelCount(unsigned int width, unsigned int height)
+{
+	GLsizei count = 1;
+	for (unsigned int size = std::max(width, height); size > 1; size /= 2)
+		count++;
+	return count;
+}
+
+static GLuint generate()
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	if (!texture)
+		throw std::runtime_error("Could not gen texture");
+	glBindTexture(GL_TEXTURE_2D, texture);
+	return texture;
+}
+
+static void setSampling(GLsizei levels)
+{
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+RendererTexture::RendererTexture(const world::Texture &source) :
+	texture(generate())
+{
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	static const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	if (source.components == 0 || source.components > 4)
+	{
+		glDeleteTextures(1, &texture);
+		throw std::runtime_error("Invalid texture components");
+	}
+	const GLsizei levels = levelCount(source.width, source.height);
+	glTexStorage2D(GL_TEXTURE_2D, levels, internalFormats[source.components - 1], source.width, source.height);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, source.width, source.height, formats[source.components - 1], GL_UNSIGNED_BYTE, source.bytes.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	setSampling(levels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+RendererTexture::RendererTexture(const pack::Package &package, size_t index) :
+	texture(generate())
+{
+	const pack::TextureEntry &entry = package.texture(index);
+	GLenum internalFormat = GL_RGBA8;
+	switch (entry.format)
+	{
+	case pack::Format::BC1: internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+	case pack::Format::BC3: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+	default: break;
+	}
+	const GLsizei levels = static_cast<GLsizei>(entry.levelCount);
+	glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, entry.width, entry.height);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (GLsizei iLevel = 0; iLevel < levels; iLevel++)
+	{
+		// Mips are stored in their final format, the driver only copies them.
+		const pack::LevelEntry &level = package.level(entry, iLevel);
+		if (entry.format == pack::Format::RGBA8)
+			glTexSubImage2D(GL_TEXTURE_2D, iLevel, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, package.data(level));
+		else
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, iLevel, 0, 0, level.width, level.height, internalFormat, static_cast<GLsizei>(level.size), package.data(level));
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	setSampling(levels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+RendererTexture::~RendererTexture()
+{
+	if (texture)
+		glDeleteTextures(1, &texture);
+}
+
+void RendererTexture::bind(GLuint unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Config.h"
+#include "Model.h"
+#include "Package.h"
+
+namespace engine {
+
+// Immutable 2D texture with a full mip chain.
+struct RendererTexture
+{
+	// Upload 8 bits components, then generate the mips.
+	RendererTexture(const world::Texture &source);
+	// Upload the cooked mips, compressed or not, straight from the package mapping.
+	RendererTexture(const pack::Package &package, size_t texture);
+	RendererTexture(const RendererTexture &) = delete;
+	RendererTexture &operator=(const RendererTexture &) = delete;
+	~RendererTexture();
+
+	void bind(GLuint unit) const;
+
+	GLuint texture;
+};
+
+}
@@ -7,8 +7,9 @@ namespace engine {
 
 struct RenderingSession
 {
-	world::Model model;
+	const world::Model *model;	// Drawn model, owned by the application. Its hierarchy must be up to date
 	Camera camera;
+	unsigned int width, height;	// Viewport, in pixels
 	// Tree
 	// Light
 	// Sun
@@ -0,0 +1,424 @@
+#include "VertexFormat.h"
+#include "math/half.h"
+#include "math/half.inl"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace engine {
+namespace pack {
+
+void interleave(const world::Mesh &mesh, Vertex *vertices)
+{
+	const world::Stream<geom::uv2> &texcoords = mesh.texcoords[static_cast<unsigned int>(world::TextureType::ALBEDO)];
+	const bool hasTexcoords = mesh.hasTexcoords(world::TextureType::ALBEDO);
+	for (size_t iVertex = 0; iVertex < mesh.positions.size(); iVertex++)
+	{
+		Vertex &vertex = vertices[iVertex];
+		const geom::point3 &position = mesh.positions[iVertex];
+		vertex.position[0] = position.x;
+		vertex.position[1] = position.y;
+		vertex.position[2] = position.z;
+		if (mesh.hasNormals())
+		{
+			const geom::norm3 &normal = mesh.normals[iVertex];
+			vertex.normal[0] = normal.x;
+			vertex.normal[1] = normal.y;
+			vertex.normal[2] = normal.z;
+		}
+		else
+		{
+			vertex.normal[0] = 0.f;
+			vertex.normal[1] = 0.f;
+			vertex.normal[2] = 1.f;
+		}
+		vertex.texcoord[0] = hasTexcoords ? texcoords[iVertex].u : 0.f;
+		vertex.texcoord[1] = hasTexcoords ? texcoords[iVertex].v : 0.f;
+		for (unsigned int iComponent = 0; iComponent < 4; iComponent++)
+			vertex.color[iComponent] = mesh.hasColors() ? mesh.colors[iVertex][iComponent] : 255;
+	}
+}
+
+VertexFormat VertexFormat::uncompressed()
+{
+	return VertexFormat{ Position::FLOAT, Normal::FLOAT, Texcoord::FLOAT, Color::UNORM8 };
+}
+
+VertexFormat VertexFormat::compressed()
+{
+	return VertexFormat{ Position::UNORM16, Normal::OCTAHEDRAL, Texcoord::HALF, Color::UNORM8 };
+}
+
+VertexFormat VertexFormat::fit(const world::Mesh &mesh) const
+{
+	VertexFormat format = *this;
+	if (!mesh.hasNormals())
+		format.normal = Normal::NONE;
+	if (!mesh.hasTexcoords(world::TextureType::ALBEDO))
+		format.texcoord = Texcoord::NONE;
+	if (!mesh.hasColors())
+		format.color = Color::NONE;
+	return format;
+}
+
+bool VertexFormat::isValid() const
+{
+	return position <= Position::UNORM16 && normal <= Normal::OCTAHEDRAL && texcoord <= Texcoord::UNORM16 && color <= Color::UNORM8;
+}
+
+VertexLayout::VertexLayout(const VertexFormat &format) :
+	count(0),
+	stride(0)
+{
+	auto add = [this](uint32_t location, uint32_t components, AttributeType type, uint32_t size) {
+		attributes[count++] = VertexAttribute{ location, components, type, stride };
+		stride += size;
+	};
+	switch (format.position)
+	{
+	case VertexFormat::Position::FLOAT: add(VertexAttribute::POSITION, 3, AttributeType::FLOAT, 12); break;
+	case VertexFormat::Position::UNORM16: add(VertexAttribute::POSITION, 4, AttributeType::UNORM16, 8); break;
+	}
+	switch (format.normal)
+	{
+	case VertexFormat::Normal::NONE: break;
+	case VertexFormat::Normal::FLOAT: add(VertexAttribute::NORMAL, 3, AttributeType::FLOAT, 12); break;
+	case VertexFormat::Normal::OCTAHEDRAL: add(VertexAttribute::NORMAL, 2, AttributeType::SNORM16, 4); break;
+	}
+	switch (format.texcoord)
+	{
+	case VertexFormat::Texcoord::NONE: break;
+	case VertexFormat::Texcoord::FLOAT: add(VertexAttribute::TEXCOORD, 2, AttributeType::FLOAT, 8); break;
+	case VertexFormat::Texcoord::HALF: add(VertexAttribute::TEXCOORD, 2, AttributeType::HALF, 4); break;
+	case VertexFormat::Texcoord::UNORM16: add(VertexAttribute::TEXCOORD, 2, AttributeType::UNORM16, 4); break;
+	}
+	switch (format.color)
+	{
+	case VertexFormat::Color::NONE: break;
+	case VertexFormat::Color::UNORM8: add(VertexAttribute::COLOR, 4, AttributeType::UNORM8, 4); break;
+	}
+}
+
+VertexBounds VertexBounds::compute(const Vertex *vertices, size_t count)
+{
+	float minimum[5], maximum[5];
+	std::fill(minimum, minimum + 5, (count > 0) ? HUGE_VALF : 0.f);
+	std::fill(maximum, maximum + 5, (count > 0) ? -HUGE_VALF : 0.f);
+	for (size_t iVertex = 0; iVertex < count; iVertex++)
+	{
+		const float values[5] = {
+			vertices[iVertex].position[0], vertices[iVertex].position[1], vertices[iVertex].position[2],
+			vertices[iVertex].texcoord[0], vertices[iVertex].texcoord[1],
+		};
+		for (unsigned int iValue = 0; iValue < 5; iValue++)
+		{
+			minimum[iValue] = std::min(minimum[iValue], values[iValue]);
+			maximum[iValue] = std::max(maximum[iValue], values[iValue]);
+		}
+	}
+	VertexBounds bounds;
+	// Flat extents keep a unit scale, so that encoding never divides by zero.
+	auto scale = [&](unsigned int iValue) { return (maximum[iValue] > minimum[iValue]) ? maximum[iValue] - minimum[iValue] : 1.f; };
+	for (unsigned int iAxis = 0; iAxis < 3; iAxis++)
+	{
+		bounds.positionOffset[iAxis] = minimum[iAxis];
+		bounds.positionScale[iAxis] = scale(iAxis);
+	}
+	for (unsigned int iAxis = 0; iAxis < 2; iAxis++)
+	{
+		bounds.texcoordOffset[iAxis] = minimum[3 + iAxis];
+		bounds.texcoordScale[iAxis] = scale(3 + iAxis);
+	}
+	return bounds;
+}
+
+geom::mat4 VertexBounds::positionTransform(const VertexFormat &format) const
+{
+	if (format.position != VertexFormat::Position::UNORM16)
+		return geom::mat4::identity();
+	return geom::mat4::translate(geom::vec3(positionOffset[0], positionOffset[1], positionOffset[2])) *
+		geom::mat4::scale(geom::vec3(positionScale[0], positionScale[1], positionScale[2]));
+}
+
+namespace {
+
+uint16_t encodeUnorm16(float value, float offset, float scale)
+{
+	const float normalized = (value - offset) / scale;
+	return static_cast<uint16_t>(std::lround(std::min(std::max(normalized, 0.f), 1.f) * 65535.f));
+}
+
+float decodeUnorm16(uint16_t value, float offset, float scale)
+{
+	return offset + scale * (value / 65535.f);
+}
+
+float signNotZero(float value)
+{
+	return (value >= 0.f) ? 1.f : -1.f;
+}
+
+}
+
+// See "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.
+void encodeOctahedral(const float normal[3], int16_t encoded[2])
+{
+	const float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	float x = (length > 0.f) ? normal[0] / length : 0.f;
+	float y = (length > 0.f) ? normal[1] / length : 0.f;
+	if (length > 0.f && normal[2] < 0.f)
+	{
+		// Fold the lower hemisphere over the diagonals.
+		const float foldedX = (1.f - std::fabs(y)) * signNotZero(x);
+		const float foldedY = (1.f - std::fabs(x)) * signNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+	encoded[0] = static_cast<int16_t>(std::lround(std::min(std::max(x, -1.f), 1.f) * 32767.f));
+	encoded[1] = static_cast<int16_t>(std::lround(std::min(std::max(y, -1.f), 1.f) * 32767.f));
+}
+
+void decodeOctahedral(const int16_t encoded[2], float normal[3])
+{
+	// snorm16 as read by the GPU
+	float x = std::max(encoded[0] / 32767.f, -1.f);
+	float y = std::max(encoded[1] / 32767.f, -1.f);
+	const float z = 1.f - std::fabs(x) - std::fabs(y);
+	if (z < 0.f)
+	{
+		const float unfoldedX = (1.f - std::fabs(y)) * signNotZero(x);
+		const float unfoldedY = (1.f - std::fabs(x)) * signNotZero(y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+	const float length = std::sqrt(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+void encode(const Vertex *vertices, size_t count, const VertexFormat &format, const VertexBounds &bounds, void *output)
+{
+	const VertexLayout layout(format);
+	unsigned char *bytes = static_cast<unsigned char*>(output);
+	for (size_t iVertex = 0; iVertex < count; iVertex++, bytes += layout.stride)
+	{
+		const Vertex &vertex = vertices[iVertex];
+		unsigned char *out = bytes;
+		if (format.position == VertexFormat::Position::FLOAT)
+		{
+			std::memcpy(out, vertex.position, 12);
+			out += 12;
+		}
+		else
+		{
+			const uint16_t position[4] = {
+				encodeUnorm16(vertex.position[0], bounds.positionOffset[0], bounds.positionScale[0]),
+				encodeUnorm16(vertex.position[1], bounds.positionOffset[1], bounds.positionScale[1]),
+				encodeUnorm16(vertex.position[2], bounds.positionOffset[2], bounds.positionScale[2]),
+				65535,
+			};
+			std::memcpy(out, position, 8);
+			out += 8;
+		}
+		if (format.normal == VertexFormat::Normal::FLOAT)
+		{
+			std::memcpy(out, vertex.normal, 12);
+			out += 12;
+		}
+		else if (format.normal == VertexFormat::Normal::OCTAHEDRAL)
+		{
+			int16_t normal[2];
+			encodeOctahedral(vertex.normal, normal);
+			std::memcpy(out, normal, 4);
+			out += 4;
+		}
+		if (format.texcoord == VertexFormat::Texcoord::FLOAT)
+		{
+			std::memcpy(out, vertex.texcoord, 8);
+			out += 8;
+		}
+		else if (format.texcoord == VertexFormat::Texcoord::HALF)
+		{
+			const uint16_t texcoord[2] = { geom::half(vertex.texcoord[0]).bits(), geom::half(vertex.texcoord[1]).bits() };
+			std::memcpy(out, texcoord, 4);
+			out += 4;
+		}
+		else if (format.texcoord == VertexFormat::Texcoord::UNORM16)
+		{
+			const uint16_t texcoord[2] = {
+				encodeUnorm16(vertex.texcoord[0], bounds.texcoordOffset[0], bounds.texcoordScale[0]),
+				encodeUnorm16(vertex.texcoord[1], bounds.texcoordOffset[1], bounds.texcoordScale[1]),
+			};
+			std::memcpy(out, texcoord, 4);
+			out += 4;
+		}
+		if (format.color == VertexFormat::Color::UNORM8)
+			std::memcpy(out, vertex.color, 4);
+	}
+}
+
+void decode(const void *input, size_t count, const VertexFormat &format, const VertexBounds &bounds, Vertex *vertices)
+{
+	const VertexLayout layout(format);
+	const unsigned char *bytes = static_cast<const unsigned char*>(input);
+	for (size_t iVertex = 0; iVertex < count; iVertex++, bytes += layout.stride)
+	{
+		Vertex &vertex = vertices[iVertex];
+		const unsigned char *in = bytes;
+		if (format.position == VertexFormat::Position::FLOAT)
+		{
+			std::memcpy(vertex.position, in, 12);
+			in += 12;
+		}
+		else
+		{
+			uint16_t position[4];
+			std::memcpy(position, in, 8);
+			for (unsigned int iAxis = 0; iAxis < 3; iAxis++)
+				vertex.position[iAxis] = decodeUnorm16(position[iAxis], bounds.positionOffset[iAxis], bounds.positionScale[iAxis]);
+			in += 8;
+		}
+		if (format.normal == VertexFormat::Normal::FLOAT)
+		{
+			std::memcpy(vertex.normal, in, 12);
+			in += 12;
+		}
+		else if (format.normal == VertexFormat::Normal::OCTAHEDRAL)
+		{
+			int16_t normal[2];
+			std::memcpy(normal, in, 4);
+			decodeOctahedral(normal, vertex.normal);
+			in += 4;
+		}
+		else
+		{
+			vertex.normal[0] = 0.f;
+			vertex.normal[1] = 0.f;
+			vertex.normal[2] = 1.f;
+		}
+		if (format.texcoord == VertexFormat::Texcoord::FLOAT)
+		{
+			std::memcpy(vertex.texcoord, in, 8);
+			in += 8;
+		}
+		else if (format.texcoord == VertexFormat::Texcoord::HALF)
+		{
+			uint16_t texcoord[2];
+			std::memcpy(texcoord, in, 4);
+			vertex.texcoord[0] = geom::half::fromBits(texcoord[0]);
+			vertex.texcoord[1] = geom::half::fromBits(texcoord[1]);
+			in += 4;
+		}
+		else if (format.texcoord == VertexFormat::Texcoord::UNORM16)
+		{
+			uint16_t texcoord[2];
+			std::memcpy(texcoord, in, 4);
+			vertex.texcoord[0] = decodeUnorm16(texcoord[0], bounds.texcoordOffset[0], bounds.texcoordScale[0]);
+			vertex.texcoord[1] = decodeUnorm16(texcoord[1], bounds.texcoordOffset[1], bounds.texcoordScale[1]);
+			in += 4;
+		}
+		else
+		{
+			vertex.texcoord[0] = 0.f;
+			vertex.texcoord[1] = 0.f;
+		}
+		if (format.color == VertexFormat::Color::UNORM8)
+			std::memcpy(vertex.color, in, 4);
+		else
+			std::fill(vertex.color, vertex.color + 4, static_cast<uint8_t>(255));
+	}
+}
+
+VertexError maxVertexError(const VertexFormat &format, const VertexBounds &bounds)
+{
+	VertexError error = {};
+	if (format.position == VertexFormat::Position::UNORM16)
+	{
+		// Half a step per axis, plus the float rounding of the decode.
+		float squared = 0.f;
+		for (unsigned int iAxis = 0; iAxis < 3; iAxis++)
+		{
+			const float axis = bounds.positionScale[iAxis] / 131070.f + (std::fabs(bounds.positionOffset[iAxis]) + bounds.positionScale[iAxis]) * 1e-6f;
+			squared += axis * axis;
+		}
+		error.position = std::sqrt(squared);
+	}
+	if (format.normal == VertexFormat::Normal::OCTAHEDRAL)
+	{
+		// Half a step in the octahedron maps to at most about 3 times the step on the sphere.
+		error.normal = 1.5f / 32767.f * 3.f;
+	}
+	if (format.texcoord == VertexFormat::Texcoord::HALF)
+	{
+		// Relative rounding of 2^-11, and 2^-25 absolute for subnormals.
+		float squared = 0.f;
+		for (unsigned int iAxis = 0; iAxis < 2; iAxis++)
+		{
+			const float magnitude = std::max(std::fabs(bounds.texcoordOffset[iAxis]), std::fabs(bounds.texcoordOffset[iAxis] + bounds.texcoordScale[iAxis]));
+			const float axis = magnitude / 2048.f + 1.f / 33554432.f;
+			squared += axis * axis;
+		}
+		error.texcoord = std::sqrt(squared);
+	}
+	else if (format.texcoord == VertexFormat::Texcoord::UNORM16)
+	{
+		float squared = 0.f;
+		for (unsigned int iAxis = 0; iAxis < 2; iAxis++)
+		{
+			const float axis = bounds.texcoordScale[iAxis] / 131070.f + (std::fabs(bounds.texcoordOffset[iAxis]) + bounds.texcoordScale[iAxis]) * 1e-6f;
+			squared += axis * axis;
+		}
+		error.texcoord = std::sqrt(squared);
+	}
+	return error;
+}
+
+VertexError measureVertexError(const Vertex *vertices, size_t count, const VertexFormat &format)
+{
+	const VertexBounds bounds = VertexBounds::compute(vertices, count);
+	const VertexLayout layout(format);
+	Buffer<unsigned char> encoded(count * layout.stride);
+	Buffer<Vertex> decoded(count);
+	encode(vertices, count, format, bounds, encoded.data());
+	decode(encoded.data(), count, format, bounds, decoded.data());
+
+	// Attributes which are not stored are not measured.
+	VertexError error = {};
+	for (size_t iVertex = 0; iVertex < count; iVertex++)
+	{
+		const Vertex &vertex = vertices[iVertex], &result = decoded[iVertex];
+		const float dx = vertex.position[0] - result.position[0];
+		const float dy = vertex.position[1] - result.position[1];
+		const float dz = vertex.position[2] - result.position[2];
+		error.position = std::max(error.position, std::sqrt(dx * dx + dy * dy + dz * dz));
+		if (format.normal != VertexFormat::Normal::NONE)
+		{
+			const float length = std::sqrt(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+			const float resultLength = std::sqrt(result.normal[0] * result.normal[0] + result.normal[1] * result.normal[1] + result.normal[2] * result.normal[2]);
+			if (length > 0.f && resultLength > 0.f)
+			{
+				// Angle from the cross product, accurate for small angles.
+				const float cx = vertex.normal[1] * result.normal[2] - vertex.normal[2] * result.normal[1];
+				const float cy = vertex.normal[2] * result.normal[0] - vertex.normal[0] * result.normal[2];
+				const float cz = vertex.normal[0] * result.normal[1] - vertex.normal[1] * result.normal[0];
+				const float dot = vertex.normal[0] * result.normal[0] + vertex.normal[1] * result.normal[1] + vertex.normal[2] * result.normal[2];
+				error.normal = std::max(error.normal, std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot));
+			}
+		}
+		if (format.texcoord != VertexFormat::Texcoord::NONE)
+		{
+			const float du = vertex.texcoord[0] - result.texcoord[0];
+			const float dv = vertex.texcoord[1] - result.texcoord[1];
+			error.texcoord = std::max(error.texcoord, std::sqrt(du * du + dv * dv));
+		}
+		if (format.color != VertexFormat::Color::NONE)
+			for (unsigned int iComponent = 0; iComponent < 4; iComponent++)
+				error.color = std::max<unsigned int>(error.color, std::abs(vertex.color[iComponent] - result.color[iComponent]));
+	}
+	return error;
+}
+
+}
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Model.h"
+
+#include <stdint.h>
+
+namespace engine {
+namespace pack {
+
+// Interleaved vertex at full precision, converted from the mesh streams then encoded.
+struct Vertex {
+	float position[3];
+	float normal[3];
+	float texcoord[2];
+	uint8_t color[4];
+};
+static_assert(sizeof(Vertex) == 36, "Vertex layout is stored in packages");
+
+// Interleave the mesh streams, missing attributes get default values.
+void interleave(const world::Mesh &mesh, Vertex *vertices);
+
+// Encoding of each attribute in the vertex buffer. NONE attributes are not stored
+// and read as their default value, see VertexLayout.
+struct VertexFormat {
+	enum class Position : uint8_t {
+		FLOAT,		// 12 bytes
+		UNORM16,	// 8 bytes, relative to the mesh bounds, see VertexBounds. w is 1
+	};
+	enum class Normal : uint8_t {
+		NONE,		// (0, 0, 1)
+		FLOAT,		// 12 bytes
+		OCTAHEDRAL,	// 4 bytes, octahedral mapping in 2 snorm16, see decodeOctahedral
+	};
+	enum class Texcoord : uint8_t {
+		NONE,		// (0, 0)
+		FLOAT,		// 8 bytes
+		HALF,		// 4 bytes
+		UNORM16,	// 4 bytes, relative to the mesh bounds, see VertexBounds
+	};
+	enum class Color : uint8_t {
+		NONE,		// White
+		UNORM8,		// 4 bytes, sRGB color32
+	};
+
+	Position position;
+	Normal normal;
+	Texcoord texcoord;
+	Color color;
+
+	// 36 bytes per vertex
+	static VertexFormat uncompressed();
+	// 20 bytes per vertex, 16 without colors
+	static VertexFormat compressed();
+	// Drop the attributes the mesh does not have.
+	VertexFormat fit(const world::Mesh &mesh) const;
+	// Every enum is in range, for formats read from files.
+	bool isValid() const;
+};
+
+enum class AttributeType : uint8_t {
+	FLOAT,
+	HALF,
+	UNORM16,
+	SNORM16,
+	UNORM8,
+};
+
+struct VertexAttribute {
+	enum Location : uint32_t {
+		POSITION,
+		NORMAL,
+		TEXCOORD,
+		COLOR,
+		COUNT
+	};
+	uint32_t location;
+	uint32_t components;
+	AttributeType type;
+	uint32_t offset;
+
+	// Integer types are read as normalized floats.
+	bool isNormalized() const { return type == AttributeType::UNORM16 || type == AttributeType::SNORM16 || type == AttributeType::UNORM8; }
+};
+
+// Interleaved attributes of a format, to describe the vertex input to GL or Vulkan.
+struct VertexLayout {
+	explicit VertexLayout(const VertexFormat &format);
+
+	VertexAttribute attributes[VertexAttribute::COUNT];
+	uint32_t count;		// Stored attributes
+	uint32_t stride;	// 4 bytes aligned
+};
+
+// Dequantization of the normalized attributes: value = offset + scale * normalized.
+// The position one is folded into the model matrix, see positionTransform.
+struct VertexBounds {
+	float positionOffset[3];
+	float positionScale[3];
+	float texcoordOffset[2];
+	float texcoordScale[2];
+
+	static VertexBounds compute(const Vertex *vertices, size_t count);
+	// Transform from the position attribute to mesh space, identity unless positions are normalized.
+	geom::mat4 positionTransform(const VertexFormat &format) const;
+};
+
+// Encode vertices into stride bytes each.
+void encode(const Vertex *vertices, size_t count, const VertexFormat &format, const VertexBounds &bounds, void *output);
+// Decode back to full precision, as the GPU & shaders would.
+void decode(const void *input, size_t count, const VertexFormat &format, const VertexBounds &bounds, Vertex *vertices);
+
+void encodeOctahedral(const float normal[3], int16_t encoded[2]);
+void decodeOctahedral(const int16_t encoded[2], float normal[3]);
+
+// Largest errors of an encode & decode round trip.
+struct VertexError {
+	float position;		// Distance, in mesh units
+	float normal;		// Angle, in radians
+	float texcoord;		// Distance, in texture units
+	unsigned int color;	// Largest component difference
+};
+
+// Error bounds a format guarantees for the given bounds.
+VertexError maxVertexError(const VertexFormat &format, const VertexBounds &bounds);
+// Encode then decode the vertices and return the largest errors, which are within maxVertexError.
+VertexError measureVertexError(const Vertex *vertices, size_t count, const VertexFormat &format);
+
+}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "VertexFormat.h"
+
+#include <vulkan\vulkan.h>
+#include <stdexcept>
+#include <vector>
+
+namespace engine {
+namespace pack {
+
+// Vulkan vertex input of a VertexLayout. Header only, so that the engine does not depend on Vulkan.
+// Unlike GL, attributes which are not stored have no default value: the pipeline must not declare them.
+
+inline VkFormat vkFormat(AttributeType type, uint32_t components)
+{
+	static const VkFormat formats[][4] = {
+		{ VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+		{ VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT },
+		{ VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16A16_UNORM },
+		{ VK_FORMAT_R16_SNORM, VK_FORMAT_R16G16_SNORM, VK_FORMAT_R16G16B16_SNORM, VK_FORMAT_R16G16B16A16_SNORM },
+		{ VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM },
+	};
+	const size_t iType = static_cast<size_t>(type);
+	if (iType >= sizeof(formats) / sizeof(formats[0]) || components == 0 || components > 4)
+		throw std::runtime_error("No Vulkan format for attribute");
+	return formats[iType][components - 1];
+}
+
+struct VulkanVertexInput {
+	VkVertexInputBindingDescription binding;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+
+	// Ready to be used while the input is alive.
+	VkPipelineVertexInputStateCreateInfo createInfo() const
+	{
+		VkPipelineVertexInputStateCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		info.vertexBindingDescriptionCount = 1;
+		info.pVertexBindingDescriptions = &binding;
+		info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+		info.pVertexAttributeDescriptions = attributes.data();
+		return info;
+	}
+};
+
+// Attribute locations match the GL ones, see VertexAttribute::Location.
+inline VulkanVertexInput vkVertexInput(const VertexFormat &format, uint32_t binding = 0)
+{
+	const VertexLayout layout(format);
+	VulkanVertexInput input;
+	input.binding.binding = binding;
+	input.binding.stride = layout.stride;
+	input.binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	for (uint32_t iAttribute = 0; iAttribute < layout.count; iAttribute++)
+	{
+		const VertexAttribute &attribute = layout.attributes[iAttribute];
+		VkVertexInputAttributeDescription description;
+		description.location = attribute.location;
+		description.binding = binding;
+		description.format = vkFormat(attribute.type, attribute.components);
+		description.offset = attribute.offset;
+		input.attributes.push_back(description);
+	}
+	return input;
+}
+
+}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "scientific.h"
+#include "point3.h"
+#include "vec3.h"
+
+namespace geometry {
+
+template <typename T>
+struct mat4;
+template <typename T>
+struct ray;
+template <typename T, size_t N>
+struct rayPacket;
+
+// Axis aligned bounding box
+template <typename T>
+struct aabb {
+	point3<T> min;
+	point3<T> max;
+
+	aabb();
+	explicit aabb(const point3<T> &min, const point3<T> &max);
+
+	// Empty box, including anything in it will make it valid.
+	static aabb empty();
+	static aabb transform(const mat4<T> &mat, const aabb &box);
+
+	void include(const point3<T> &point);
+	void include(const aabb &box);
+
+	bool valid() const;
+	bool contains(const point3<T> &point) const;
+	bool overlap(const aabb &box) const;
+
+	point3<T> center() const;
+	vec3<T> extent() const;
+
+	// Slab test. Return the entry & exit distances of the ray, clamped to [tMin, tMax].
+	bool intersect(const ray<T> &ray, T &tMin, T &tMax) const;
+	// Slab test of N rays at once. Entry & exit distances are written for
+	// every ray, bit i of the returned mask is set if ray i hit the box.
+	template <size_t N>
+	uint32_t intersect(const rayPacket<T, N> &packet, T *tMin, T *tMax) const;
+};
+
+}
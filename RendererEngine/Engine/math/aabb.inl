@@ -0,0 +1,170 @@
+#include "aabb.h"
+#include "point3.h"
+#include "vec3.h"
+#include "mat4.h"
+#include "ray.h"
+
+#include <limits>
+
+namespace geometry {
+
+template <typename T>
+inline aabb<T>::aabb()
+{
+}
+
+template <typename T>
+inline aabb<T>::aabb(const point3<T> &min, const point3<T> &max) :
+	min(min), max(max)
+{
+}
+
+template <typename T>
+inline aabb<T> aabb<T>::empty()
+{
+	return aabb(
+		point3<T>(std::numeric_limits<T>::max()),
+		point3<T>(std::numeric_limits<T>::lowest())
+	);
+}
+
+template <typename T>
+inline aabb<T> aabb<T>::transform(const mat4<T> &mat, const aabb &box)
+{
+	// Arvo's method, project the extent on each axis of the transform.
+	aabb out(point3<T>(mat[3].x, mat[3].y, mat[3].z), point3<T>(mat[3].x, mat[3].y, mat[3].z));
+	for (size_t iCol = 0; iCol < 3; iCol++)
+	{
+		for (size_t iRow = 0; iRow < 3; iRow++)
+		{
+			T a = mat[iCol][iRow] * box.min[iCol];
+			T b = mat[iCol][iRow] * box.max[iCol];
+			out.min[iRow] += geometry::min(a, b);
+			out.max[iRow] += geometry::max(a, b);
+		}
+	}
+	return out;
+}
+
+template <typename T>
+inline void aabb<T>::include(const point3<T> &point)
+{
+	for (size_t i = 0; i < 3; i++)
+	{
+		min[i] = geometry::min(min[i], point[i]);
+		max[i] = geometry::max(max[i], point[i]);
+	}
+}
+
+template <typename T>
+inline void aabb<T>::include(const aabb &box)
+{
+	include(box.min);
+	include(box.max);
+}
+
+template <typename T>
+inline bool aabb<T>::valid() const
+{
+	return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+}
+
+template <typename T>
+inline bool aabb<T>::contains(const point3<T> &point) const
+{
+	return
+		point.x >= min.x && point.x <= max.x &&
+		point.y >= min.y && point.y <= max.y &&
+		point.z >= min.z && point.z <= max.z;
+}
+
+template <typename T>
+inline bool aabb<T>::overlap(const aabb &box) const
+{
+	return
+		min.x <= box.max.x && max.x >= box.min.x &&
+		min.y <= box.max.y && max.y >= box.min.y &&
+		min.z <= box.max.z && max.z >= box.min.z;
+}
+
+template <typename T>
+inline point3<T> aabb<T>::center() const
+{
+	return point3<T>(
+		(min.x + max.x) / T(2),
+		(min.y + max.y) / T(2),
+		(min.z + max.z) / T(2)
+	);
+}
+
+template <typename T>
+inline vec3<T> aabb<T>::extent() const
+{
+	return vec3<T>(max.x - min.x, max.y - min.y, max.z - min.z);
+}
+
+template <typename T>
+inline bool aabb<T>::intersect(const ray<T> &ray, T &tMin, T &tMax) const
+{
+	for (size_t i = 0; i < 3; i++)
+	{
+		// Parallel to the slab, 0 * inf would be NaN when the origin is on one of its planes.
+		if (ray.direction[i] == T(0))
+		{
+			if (ray.origin[i] < min[i] || ray.origin[i] > max[i])
+				return false;
+			continue;
+		}
+		const T invD = T(1) / ray.direction[i];
+		T t0 = (min[i] - ray.origin[i]) * invD;
+		T t1 = (max[i] - ray.origin[i]) * invD;
+		if (invD < T(0))
+		{
+			T tmp = t0;
+			t0 = t1;
+			t1 = tmp;
+		}
+		tMin = geometry::max(t0, tMin);
+		tMax = geometry::min(t1, tMax);
+		if (tMax < tMin)
+			return false;
+	}
+	return true;
+}
+
+template <typename T>
+template <size_t N>
+inline uint32_t aabb<T>::intersect(const rayPacket<T, N> &packet, T *tMin, T *tMax) const
+{
+	static_assert(N <= 32, "Packet too big for the hit mask");
+	uint32_t mask = 0;
+	const T infinity = std::numeric_limits<T>::infinity();
+	// Clip to a slab. A zero direction gives NaN, 0 * inf, when the origin is on one of the planes:
+	// the ray is then inside the slab, which bounds nothing. Selects keep the loop branchless.
+	auto clip = [infinity](T t0, T t1, T &tNear, T &tFar) {
+		const bool inside = (t0 != t0) || (t1 != t1);
+		tNear = geometry::max(tNear, inside ? -infinity : geometry::min(t0, t1));
+		tFar = geometry::min(tFar, inside ? infinity : geometry::max(t0, t1));
+	};
+	// Branchless, every lane go through the same instructions.
+	for (size_t i = 0; i < N; i++)
+	{
+		const T tx0 = (min.x - packet.ox[i]) * packet.idx[i];
+		const T tx1 = (max.x - packet.ox[i]) * packet.idx[i];
+		const T ty0 = (min.y - packet.oy[i]) * packet.idy[i];
+		const T ty1 = (max.y - packet.oy[i]) * packet.idy[i];
+		const T tz0 = (min.z - packet.oz[i]) * packet.idz[i];
+		const T tz1 = (max.z - packet.oz[i]) * packet.idz[i];
+		T tNear = tMin[i];
+		T tFar = tMax[i];
+		clip(tx0, tx1, tNear, tFar);
+		clip(ty0, ty1, tNear, tFar);
+		clip(tz0, tz1, tNear, tFar);
+		tMin[i] = tNear;
+		tMax[i] = tFar;
+		mask |= static_cast<uint32_t>(tNear <= tFar) << i;
+	}
+	return mask;
+}
+
+}
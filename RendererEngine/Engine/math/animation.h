@@ -0,0 +1,50 @@
+#pragma once
+
+#include "scientific.h"
+#include "quat.h"
+#include "dualquat.h"
+
+namespace geometry {
+
+namespace anim {
+
+// Batched interpolation of count rotation pairs with the same factor.
+// Loops are branchless so the compiler can vectorize them.
+template <typename T>
+void nlerp(const quat<T> *from, const quat<T> *to, T t, quat<T> *out, size_t count);
+// Trigonometry free slerp, absolute error below 1e-5.
+// from "A Fast and Accurate Algorithm for Computing SLERP", David Eberly
+template <typename T>
+void slerp(const quat<T> *from, const quat<T> *to, T t, quat<T> *out, size_t count);
+
+// Keyframe track storage shared by a group of joints.
+// Keys are stored keyframe by keyframe : keys[iKey * trackCount + iTrack]
+// so that two consecutive keyframes of every track are contiguous in memory.
+template <typename T>
+struct RotationTrack {
+	const T *times;			// Time of each keyframe, sorted
+	const quat<T> *keys;	// Rotations, keyCount * trackCount
+	size_t keyCount;		// Number of keyframes
+	size_t trackCount;		// Number of joints animated by the track
+};
+
+enum class Interpolation {
+	NLERP,
+	SLERP
+};
+
+// Find the keyframe right before time, clamped to the track.
+template <typename T>
+size_t findKeyframe(const T *times, size_t keyCount, T time);
+
+// Sample every joint of the track at time and write trackCount rotations in out.
+template <typename T>
+void sample(const RotationTrack<T> &track, T time, Interpolation interpolation, quat<T> *out);
+
+// Dual quaternion linear blending of count rigid transforms.
+template <typename T>
+dualquat<T> blend(const dualquat<T> *transforms, const T *weights, size_t count);
+
+}
+
+}
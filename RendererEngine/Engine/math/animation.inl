@@ -0,0 +1,143 @@
+#include "animation.h"
+#include "quat.h"
+#include "dualquat.h"
+
+namespace geometry {
+
+namespace anim {
+
+template <typename T>
+inline void nlerp(const quat<T> *from, const quat<T> *to, T t, quat<T> *out, size_t count)
+{
+	const T d = T(1) - t;
+	for (size_t i = 0; i < count; i++)
+	{
+		const quat<T> &a = from[i];
+		const quat<T> &b = to[i];
+		const T dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+		const T bt = (dot < T(0)) ? -t : t;
+		const T x = a.x * d + b.x * bt;
+		const T y = a.y * d + b.y * bt;
+		const T z = a.z * d + b.z * bt;
+		const T w = a.w * d + b.w * bt;
+		const T invNorm = T(1) / sqrt(x * x + y * y + z * z + w * w);
+		out[i].x = x * invNorm;
+		out[i].y = y * invNorm;
+		out[i].z = z * invNorm;
+		out[i].w = w * invNorm;
+	}
+}
+
+template <typename T>
+inline void slerp(const quat<T> *from, const quat<T> *to, T t, quat<T> *out, size_t count)
+{
+	// Coefficients of the polynomial approximation
+	// u[i] = 1 / (i * (2i + 1)), v[i] = i / (2i + 1), i in [1, 8]
+	const T onePlusMu = T(1.90110745351730037);
+	const T u[8] = {
+		T(1) / T(1 * 3), T(1) / T(2 * 5), T(1) / T(3 * 7), T(1) / T(4 * 9),
+		T(1) / T(5 * 11), T(1) / T(6 * 13), T(1) / T(7 * 15), onePlusMu / T(8 * 17)
+	};
+	const T v[8] = {
+		T(1) / T(3), T(2) / T(5), T(3) / T(7), T(4) / T(9),
+		T(5) / T(11), T(6) / T(13), T(7) / T(15), onePlusMu * T(8) / T(17)
+	};
+	// The factors only depend on t, compute them once for the whole batch
+	const T d = T(1) - t;
+	const T sqrT = t * t;
+	const T sqrD = d * d;
+	T uT[8], uD[8];
+	for (size_t k = 0; k < 8; k++)
+	{
+		uT[k] = u[k] * sqrT - v[k];
+		uD[k] = u[k] * sqrD - v[k];
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		const quat<T> &a = from[i];
+		const quat<T> &b = to[i];
+		T x = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+		const T sign = (x < T(0)) ? T(-1) : T(1);
+		x *= sign;
+		const T xm1 = x - T(1);
+		T cT = T(1);
+		T cD = T(1);
+		for (size_t k = 8; k-- > 0;)
+		{
+			cT = T(1) + uT[k] * xm1 * cT;
+			cD = T(1) + uD[k] * xm1 * cD;
+		}
+		cT *= sign * t;
+		cD *= d;
+		out[i].x = a.x * cD + b.x * cT;
+		out[i].y = a.y * cD + b.y * cT;
+		out[i].z = a.z * cD + b.z * cT;
+		out[i].w = a.w * cD + b.w * cT;
+	}
+}
+
+template <typename T>
+inline size_t findKeyframe(const T *times, size_t keyCount, T time)
+{
+	if (keyCount < 2 || time <= times[0])
+		return 0;
+	if (time >= times[keyCount - 1])
+		return keyCount - 2;
+	// Binary search for the last key with times[key] <= time
+	size_t first = 0;
+	size_t last = keyCount - 1;
+	while (last - first > 1)
+	{
+		size_t middle = (first + last) / 2;
+		if (times[middle] <= time)
+			first = middle;
+		else
+			last = middle;
+	}
+	return first;
+}
+
+template <typename T>
+inline void sample(const RotationTrack<T> &track, T time, Interpolation interpolation, quat<T> *out)
+{
+	if (track.keyCount == 0)
+		return;
+	if (track.keyCount == 1)
+	{
+		for (size_t i = 0; i < track.trackCount; i++)
+			out[i] = track.keys[i];
+		return;
+	}
+	const size_t key = findKeyframe(track.times, track.keyCount, time);
+	const T t = clamp<T>((time - track.times[key]) / (track.times[key + 1] - track.times[key]), T(0), T(1));
+	const quat<T> *from = track.keys + key * track.trackCount;
+	const quat<T> *to = from + track.trackCount;
+	switch (interpolation)
+	{
+	case Interpolation::NLERP:
+		nlerp(from, to, t, out, track.trackCount);
+		break;
+	case Interpolation::SLERP:
+		slerp(from, to, t, out, track.trackCount);
+		break;
+	}
+}
+
+template <typename T>
+inline dualquat<T> blend(const dualquat<T> *transforms, const T *weights, size_t count)
+{
+	if (count == 0)
+		return dualquat<T>::identity();
+	dualquat<T> out = transforms[0] * weights[0];
+	for (size_t i = 1; i < count; i++)
+	{
+		// Keep every rotation in the same hemisphere as the first one
+		T sign = (quat<T>::dot(transforms[0].real, transforms[i].real) < T(0)) ? T(-1) : T(1);
+		out += transforms[i] * (sign * weights[i]);
+	}
+	return dualquat<T>::normalize(out);
+}
+
+}
+
+}
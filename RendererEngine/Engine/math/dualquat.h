@@ -0,0 +1,50 @@
+#pragma once
+
+#include "scientific.h"
+#include "quat.h"
+
+namespace geometry {
+
+template <typename T>
+struct vec3;
+template <typename T>
+struct point3;
+template <typename T>
+struct mat4;
+
+// Dual quaternion representing a rigid transform (rotation & translation, no scale).
+// https://www.cs.utah.edu/~ladislav/kavan07skinning/kavan07skinning.pdf
+template <typename T>
+struct dualquat {
+	quat<T> real; // Rotation
+	quat<T> dual; // Translation, as 0.5 * t * real
+
+	dualquat();
+	explicit dualquat(const quat<T> &real, const quat<T> &dual);
+	explicit dualquat(const quat<T> &rotation, const vec3<T> &translation);
+	explicit dualquat(const mat4<T> &mat);
+
+	quat<T> rotation() const;
+	vec3<T> translation() const;
+
+	static dualquat identity();
+	static dualquat conjuguate(const dualquat &dq);
+	static dualquat normalize(const dualquat &dq);
+	// Screw linear interpolation, following the shortest path : constant rotation
+	// & translation speed along the screw axis of the relative transform.
+	static dualquat sclerp(const dualquat &from, const dualquat &to, T t);
+
+	dualquat operator*(T scalar) const;
+	dualquat &operator*=(T scalar);
+
+	dualquat operator*(const dualquat &rhs) const;
+	dualquat &operator*=(const dualquat &rhs);
+
+	dualquat operator+(const dualquat &rhs) const;
+	dualquat &operator+=(const dualquat &rhs);
+
+	point3<T> operator*(const point3<T> &rhs) const;
+	vec3<T> operator*(const vec3<T> &rhs) const;
+};
+
+}
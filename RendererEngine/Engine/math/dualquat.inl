@@ -0,0 +1,159 @@
+#include "dualquat.h"
+#include "quat.h"
+#include "vec3.h"
+#include "point3.h"
+#include "mat4.h"
+
+namespace geometry {
+
+template <typename T>
+inline dualquat<T>::dualquat()
+{
+}
+
+template <typename T>
+inline dualquat<T>::dualquat(const quat<T> &real, const quat<T> &dual) :
+	real(real), dual(dual)
+{
+}
+
+template <typename T>
+inline dualquat<T>::dualquat(const quat<T> &rotation, const vec3<T> &translation) :
+	real(rotation),
+	dual(quat<T>(translation.x, translation.y, translation.z, T(0)) * rotation * T(0.5))
+{
+}
+
+template <typename T>
+inline dualquat<T>::dualquat(const mat4<T> &mat) :
+	dualquat(quat<T>::normalize(quat<T>(mat)), vec3<T>(mat[3].x, mat[3].y, mat[3].z))
+{
+}
+
+template <typename T>
+inline quat<T> dualquat<T>::rotation() const
+{
+	return real;
+}
+
+template <typename T>
+inline vec3<T> dualquat<T>::translation() const
+{
+	quat<T> t = dual * quat<T>::conjuguate(real) * T(2);
+	return vec3<T>(t.x, t.y, t.z);
+}
+
+template <typename T>
+inline dualquat<T> dualquat<T>::identity()
+{
+	return dualquat(quat<T>::identity(), quat<T>(T(0), T(0), T(0), T(0)));
+}
+
+template <typename T>
+inline dualquat<T> dualquat<T>::conjuguate(const dualquat &dq)
+{
+	return dualquat(quat<T>::conjuguate(dq.real), quat<T>::conjuguate(dq.dual));
+}
+
+template <typename T>
+inline dualquat<T> dualquat<T>::normalize(const dualquat &dq)
+{
+	T n = dq.real.norm();
+	quat<T> real = dq.real * (T(1) / n);
+	quat<T> dual = dq.dual * (T(1) / n);
+	// Enforce orthogonality of the dual part with the real part
+	return dualquat(real, dual - real * quat<T>::dot(real, dual));
+}
+
+template <typename T>
+inline dualquat<T> dualquat<T>::sclerp(const dualquat &from, const dualquat &to, T t)
+{
+	// from * (conj(from) * to)^t, the power of the relative transform scales
+	// the angle & the translation along its screw axis.
+	T sign = (quat<T>::dot(from.real, to.real) < T(0)) ? T(-1) : T(1);
+	dualquat diff = conjuguate(from) * (to * sign);
+	vec3<T> v(diff.real.x, diff.real.y, diff.real.z);
+	T sinHalfAngle = v.norm();
+	// No rotation, pure translation
+	if (sinHalfAngle < T(1e-6))
+		return normalize(from * dualquat(quat<T>::identity(), diff.dual * t));
+	radian<T> halfAngle = arctan2(sinHalfAngle, diff.real.w);
+	vec3<T> axis = v / sinHalfAngle;
+	// Half the translation along the axis & moment of the axis.
+	T halfPitch = -diff.dual.w / sinHalfAngle;
+	vec3<T> moment = (vec3<T>(diff.dual.x, diff.dual.y, diff.dual.z) - axis * (halfPitch * diff.real.w)) / sinHalfAngle;
+	// Raise to the power t
+	halfAngle = radian<T>(halfAngle() * t);
+	halfPitch *= t;
+	T s = sin(halfAngle);
+	T c = cos(halfAngle);
+	vec3<T> r = axis * s;
+	vec3<T> d = moment * s + axis * (halfPitch * c);
+	dualquat power(quat<T>(r.x, r.y, r.z, c), quat<T>(d.x, d.y, d.z, -halfPitch * s));
+	return normalize(from * power);
+}
+
+template <typename T>
+inline dualquat<T> dualquat<T>::operator*(T scalar) const
+{
+	dualquat out(*this);
+	out *= scalar;
+	return out;
+}
+
+template <typename T>
+inline dualquat<T> &dualquat<T>::operator*=(T scalar)
+{
+	real *= scalar;
+	dual *= scalar;
+	return *this;
+}
+
+template <typename T>
+inline dualquat<T> dualquat<T>::operator*(const dualquat &rhs) const
+{
+	dualquat out(*this);
+	out *= rhs;
+	return out;
+}
+
+template <typename T>
+inline dualquat<T> &dualquat<T>::operator*=(const dualquat &rhs)
+{
+	dual = real * rhs.dual + dual * rhs.real;
+	real = real * rhs.real;
+	return *this;
+}
+
+template <typename T>
+inline dualquat<T> dualquat<T>::operator+(const dualquat &rhs) const
+{
+	dualquat out(*this);
+	out += rhs;
+	return out;
+}
+
+template <typename T>
+inline dualquat<T> &dualquat<T>::operator+=(const dualquat &rhs)
+{
+	real += rhs.real;
+	dual += rhs.dual;
+	return *this;
+}
+
+template <typename T>
+inline point3<T> dualquat<T>::operator*(const point3<T> &rhs) const
+{
+	quat<T> r = real;
+	vec3<T> p = r * vec3<T>(rhs) + translation();
+	return point3<T>(p);
+}
+
+template <typename T>
+inline vec3<T> dualquat<T>::operator*(const vec3<T> &rhs) const
+{
+	quat<T> r = real;
+	return r * rhs;
+}
+
+}
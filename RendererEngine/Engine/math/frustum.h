@@ -0,0 +1,35 @@
+#pragma once
+
+#include "scientific.h"
+#include "plane.h"
+
+namespace geometry {
+
+template <typename T>
+struct mat4;
+template <typename T>
+struct aabb;
+
+template <typename T>
+struct frustum {
+	enum Side {
+		LEFT,
+		RIGHT,
+		BOTTOM,
+		TOP,
+		ZNEAR,
+		ZFAR,
+		SIDE_COUNT
+	};
+	plane<T> planes[SIDE_COUNT]; // Normals are pointing inside
+
+	frustum();
+	// Extract planes from a projection * view matrix (clip space z in [-w, w])
+	explicit frustum(const mat4<T> &viewProjection);
+
+	bool contains(const point3<T> &point) const;
+	// Conservative test, some boxes outside near the corners are reported as visible.
+	bool intersect(const aabb<T> &box) const;
+};
+
+}
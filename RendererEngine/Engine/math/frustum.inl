@@ -0,0 +1,57 @@
+#include "frustum.h"
+#include "plane.h"
+#include "mat4.h"
+#include "aabb.h"
+#include "vec4.h"
+
+namespace geometry {
+
+template <typename T>
+inline frustum<T>::frustum()
+{
+}
+
+template <typename T>
+inline frustum<T>::frustum(const mat4<T> &m)
+{
+	// Gribb & Hartmann, planes are combinations of the matrix rows.
+	const vec4<T> row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const vec4<T> row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const vec4<T> row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const vec4<T> row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	planes[LEFT] = plane<T>::normalize(plane<T>(row3 + row0));
+	planes[RIGHT] = plane<T>::normalize(plane<T>(row3 - row0));
+	planes[BOTTOM] = plane<T>::normalize(plane<T>(row3 + row1));
+	planes[TOP] = plane<T>::normalize(plane<T>(row3 - row1));
+	planes[ZNEAR] = plane<T>::normalize(plane<T>(row3 + row2));
+	planes[ZFAR] = plane<T>::normalize(plane<T>(row3 - row2));
+}
+
+template <typename T>
+inline bool frustum<T>::contains(const point3<T> &point) const
+{
+	for (size_t i = 0; i < SIDE_COUNT; i++)
+		if (planes[i].signedDistance(point) < T(0))
+			return false;
+	return true;
+}
+
+template <typename T>
+inline bool frustum<T>::intersect(const aabb<T> &box) const
+{
+	for (size_t i = 0; i < SIDE_COUNT; i++)
+	{
+		// Test the corner the furthest along the plane normal
+		const plane<T> &p = planes[i];
+		const point3<T> positive(
+			p.normal.x >= T(0) ? box.max.x : box.min.x,
+			p.normal.y >= T(0) ? box.max.y : box.min.y,
+			p.normal.z >= T(0) ? box.max.z : box.min.z
+		);
+		if (p.signedDistance(positive) < T(0))
+			return false;
+	}
+	return true;
+}
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gpu.h"
+#include "half.h"
 #include "scientific.h"
 #include "angle.h"
 #include "color4.h"
@@ -13,12 +14,21 @@
 #include "mat3.h"
 #include "mat4.h"
 #include "quat.h"
+#include "dualquat.h"
+#include "animation.h"
+#include "sequence.h"
+#include "ray.h"
+#include "aabb.h"
+#include "plane.h"
+#include "frustum.h"
 #include "print.h"
 
 namespace geometry {
 
 using quatf = quat<float>;
 using quatd = quat<double>;
+using dualquatf = dualquat<float>;
+using dualquatd = dualquat<double>;
 
 using uv2f = uv2<float>;
 using uv2d = uv2<double>;
@@ -48,12 +58,24 @@ using col4d = col4<double>;
 using mat4f = mat4<float>;
 using mat4d = mat4<double>;
 
+using rayf = ray<float>;
+using rayd = ray<double>;
+using rayPacket4f = rayPacket<float, 4>;
+using rayPacket8f = rayPacket<float, 8>;
+using aabbf = aabb<float>;
+using aabbd = aabb<double>;
+using planef = plane<float>;
+using planed = plane<double>;
+using frustumf = frustum<float>;
+using frustumd = frustum<double>;
+
 using degreef = degree<float>;
 using radianf = radian<float>;
 
 }
 
 #include "gpu.inl"
+#include "half.inl"
 #include "scientific.inl"
 #include "angle.inl"
 #include "color4.inl"
@@ -65,4 +87,11 @@ using radianf = radian<float>;
 #include "uv2.inl"
 #include "mat3.inl"
 #include "mat4.inl"
-#include "quat.inl"
\ No newline at end of file
+#include "quat.inl"
+#include "dualquat.inl"
+#include "animation.inl"
+#include "sequence.inl"
+#include "ray.inl"
+#include "aabb.inl"
+#include "plane.inl"
+#include "frustum.inl"
\ No newline at end of file
@@ -4,13 +4,18 @@
 
 namespace geometry {
 
+// IEEE 754 binary16, as read by GPUs for half float vertex attributes & textures.
 struct half {
 	half() : data(0) {}
-	half(float value) : data(value) {}
+	// Round to nearest even, overflow to infinity.
+	half(float value);
 
-	operator float() { return data; }
+	operator float() const;
+
+	uint16_t bits() const { return data; }
+	static half fromBits(uint16_t bits);
 private:
 	uint16_t data;
 };
 
-}
\ No newline at end of file
+}
@@ -2,6 +2,95 @@
 
 #include "half.h"
 
+#include <cstring>
+
 namespace geometry {
 
-}
\ No newline at end of file
+inline half::half(float value)
+{
+	uint32_t f;
+	std::memcpy(&f, &value, sizeof(float));
+	const uint32_t sign = (f >> 16) & 0x8000;
+	const uint32_t absolute = f & 0x7FFFFFFF;
+	if (absolute >= 0x7F800000)
+	{
+		// Inf or NaN, NaN stays quiet
+		data = static_cast<uint16_t>(sign | 0x7C00 | ((absolute > 0x7F800000) ? 0x200 : 0));
+	}
+	else if (absolute >= 0x477FF000)
+	{
+		// Rounds above the largest half
+		data = static_cast<uint16_t>(sign | 0x7C00);
+	}
+	else if (absolute < 0x38800000)
+	{
+		// Subnormal half, shift the mantissa with its implicit bit then round to nearest even.
+		const uint32_t exponent = absolute >> 23;
+		if (exponent < 102)
+		{
+			data = static_cast<uint16_t>(sign);
+			return;
+		}
+		const uint32_t mantissa = (absolute & 0x7FFFFF) | 0x800000;
+		const uint32_t shift = 126 - exponent;
+		uint32_t result = mantissa >> shift;
+		const uint32_t remainder = mantissa & ((1U << shift) - 1);
+		const uint32_t halfway = 1U << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (result & 1)))
+			result++;
+		data = static_cast<uint16_t>(sign | result);
+	}
+	else
+	{
+		// Normal, rebias the exponent and round the 13 dropped bits to nearest even.
+		const uint32_t rebiased = absolute - 0x38000000;
+		uint32_t result = rebiased >> 13;
+		const uint32_t remainder = rebiased & 0x1FFF;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+			result++;
+		data = static_cast<uint16_t>(sign | result);
+	}
+}
+
+inline half::operator float() const
+{
+	const uint32_t sign = static_cast<uint32_t>(data & 0x8000) << 16;
+	const uint32_t exponent = (data >> 10) & 0x1F;
+	uint32_t mantissa = data & 0x3FF;
+	uint32_t f;
+	if (exponent == 0x1F)
+	{
+		f = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent != 0)
+	{
+		f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	else if (mantissa == 0)
+	{
+		f = sign;
+	}
+	else
+	{
+		// Subnormal half, normalized in float.
+		uint32_t e = 113;
+		while ((mantissa & 0x400) == 0)
+		{
+			mantissa <<= 1;
+			e--;
+		}
+		f = sign | (e << 23) | ((mantissa & 0x3FF) << 13);
+	}
+	float value;
+	std::memcpy(&value, &f, sizeof(float));
+	return value;
+}
+
+inline half half::fromBits(uint16_t bits)
+{
+	half value;
+	value.data = bits;
+	return value;
+}
+
+}
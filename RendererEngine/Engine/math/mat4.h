@@ -11,6 +11,8 @@ template <typename T>
 struct vec3;
 template <typename T>
 struct quat;
+template <typename T>
+struct dualquat;
 
 template <typename T>
 struct col4 {
@@ -41,6 +43,7 @@ struct mat4 {
 	mat4(T value);
 	mat4(col4<T> x, col4<T> y, col4<T> z, col4<T> w);
 	mat4(const quat<T> &quat);
+	explicit mat4(const dualquat<T> &dq);
 
 	col4<T> &operator[](size_t index);
 	const col4<T> &operator[](size_t index) const;
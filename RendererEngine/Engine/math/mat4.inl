@@ -3,6 +3,7 @@
 #include "point3.h"
 #include "vec3.h"
 #include "quat.h"
+#include "dualquat.h"
 
 namespace geometry {
 
@@ -86,34 +87,39 @@ inline mat4<T>::mat4(const quat<T> & quat)
 	T sqz = quat.z*quat.z;
 
 	T invs = 1 / (sqx + sqy + sqz + sqw);
-	return mat4<T>(
-		col4<T>(
-			(sqx - sqy - sqz + sqw)*invs,
-			T(2) * (quat.x*quat.y + quat.z*quat.w)*invs,
-			T(2) * (quat.x*quat.z - quat.y*quat.w)*invs,
-			T(0)
-		),
-		col4<T>(
-			T(2) * (quat.x*quat.y - quat.z*quat.w)*invs,
-			(-sqx + sqy - sqz + sqw)*invs,
-			T(2) * (quat.y*quat.z + quat.x*quat.w)*invs,
-			T(0)
-		),
-		col4<T>(
-			T(2) * (quat.x*quat.z + quat.y*quat.w)*invs,
-			T(2) * (quat.y*quat.z - quat.x*quat.w)*invs,
-			(-sqx - sqy + sqz + sqw)*invs,
-			T(0)
-		),
-		col4<T>(
-			T(0),
-			T(0),
-			T(0),
-			T(1)
-		)
+	cols[0] = col4<T>(
+		(sqx - sqy - sqz + sqw)*invs,
+		T(2) * (quat.x*quat.y + quat.z*quat.w)*invs,
+		T(2) * (quat.x*quat.z - quat.y*quat.w)*invs,
+		T(0)
+	);
+	cols[1] = col4<T>(
+		T(2) * (quat.x*quat.y - quat.z*quat.w)*invs,
+		(-sqx + sqy - sqz + sqw)*invs,
+		T(2) * (quat.y*quat.z + quat.x*quat.w)*invs,
+		T(0)
+	);
+	cols[2] = col4<T>(
+		T(2) * (quat.x*quat.z + quat.y*quat.w)*invs,
+		T(2) * (quat.y*quat.z - quat.x*quat.w)*invs,
+		(-sqx - sqy + sqz + sqw)*invs,
+		T(0)
+	);
+	cols[3] = col4<T>(
+		T(0),
+		T(0),
+		T(0),
+		T(1)
 	);
 }
 
+template <typename T>
+inline mat4<T>::mat4(const dualquat<T> &dq) :
+	mat4(dq.real)
+{
+	cols[3] = col4<T>(dq.translation(), T(1));
+}
+
 template <typename T>
 inline col4<T> & mat4<T>::operator[](size_t index)
 {
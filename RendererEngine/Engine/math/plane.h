@@ -0,0 +1,29 @@
+#pragma once
+
+#include "scientific.h"
+#include "norm3.h"
+#include "point3.h"
+
+namespace geometry {
+
+template <typename T>
+struct vec4;
+
+// Plane defined as dot(normal, p) + distance = 0
+template <typename T>
+struct plane {
+	norm3<T> normal;
+	T distance;
+
+	plane();
+	explicit plane(const norm3<T> &normal, T distance);
+	explicit plane(const norm3<T> &normal, const point3<T> &point);
+	explicit plane(const vec4<T> &coefficients);
+
+	// Signed distance of the point to the plane, positive on the normal side.
+	T signedDistance(const point3<T> &point) const;
+
+	static plane normalize(const plane &p);
+};
+
+}
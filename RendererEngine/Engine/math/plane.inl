@@ -0,0 +1,44 @@
+#include "plane.h"
+#include "norm3.h"
+#include "point3.h"
+#include "vec4.h"
+
+namespace geometry {
+
+template <typename T>
+inline plane<T>::plane()
+{
+}
+
+template <typename T>
+inline plane<T>::plane(const norm3<T> &normal, T distance) :
+	normal(normal), distance(distance)
+{
+}
+
+template <typename T>
+inline plane<T>::plane(const norm3<T> &normal, const point3<T> &point) :
+	normal(normal), distance(-(normal.x * point.x + normal.y * point.y + normal.z * point.z))
+{
+}
+
+template <typename T>
+inline plane<T>::plane(const vec4<T> &coefficients) :
+	normal(coefficients.x, coefficients.y, coefficients.z), distance(coefficients.w)
+{
+}
+
+template <typename T>
+inline T plane<T>::signedDistance(const point3<T> &point) const
+{
+	return normal.x * point.x + normal.y * point.y + normal.z * point.z + distance;
+}
+
+template <typename T>
+inline plane<T> plane<T>::normalize(const plane &p)
+{
+	T n = p.normal.norm();
+	return plane(p.normal / n, p.distance / n);
+}
+
+}
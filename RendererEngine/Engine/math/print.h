@@ -9,6 +9,7 @@
 #include "mat3.h"
 #include "mat4.h"
 #include "quat.h"
+#include "dualquat.h"
 
 #include <iostream>
 
@@ -57,6 +58,12 @@ inline std::ostream& operator <<(std::ostream& os, const quat<T>& vec)
 	return os;
 }
 template <typename T>
+inline std::ostream& operator <<(std::ostream& os, const dualquat<T>& vec)
+{
+	os << "dualquat(" << vec.real << ", " << vec.dual << ")";
+	return os;
+}
+template <typename T>
 inline std::ostream& operator <<(std::ostream& os, const col3<T>& vec)
 {
 	os << "mat3::col(" << vec[0] << ", " << vec[1] << ", " << vec[2] << ")";
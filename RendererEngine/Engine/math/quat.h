@@ -5,6 +5,9 @@
 
 namespace geometry {
 
+template <typename T>
+struct mat4;
+
 template <typename T>
 struct quat {
 	union {
@@ -15,6 +18,7 @@ struct quat {
 	};
 	quat();
 	explicit quat(T x, T y, T z, T w);
+	explicit quat(const mat4<T> &mat);
 
 	T &operator[](size_t index);
 	const T &operator[](size_t index) const;
@@ -25,6 +29,11 @@ struct quat {
 	static quat conjuguate(const quat &quaternion);
 	static quat normalize(const quat &quaternion);
 	static quat axis(const vec3<T> &axis, const radian<T> &angle);
+	static T dot(const quat &lhs, const quat &rhs);
+	// Normalized linear interpolation, following the shortest path.
+	static quat nlerp(const quat &from, const quat &to, T t);
+	// Spherical linear interpolation, following the shortest path.
+	static quat slerp(const quat &from, const quat &to, T t);
 
 	quat operator*(float scalar) const;
 	quat &operator*=(float scalar);
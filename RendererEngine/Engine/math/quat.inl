@@ -1,4 +1,5 @@
 #include "quat.h"
+#include "mat4.h"
 
 namespace geometry {
 
@@ -13,6 +14,49 @@ inline quat<T>::quat(T x, T y, T z, T w) :
 {
 }
 
+template <typename T>
+inline quat<T>::quat(const mat4<T> &mat)
+{
+	// Remove scale from the basis so TRS matrices can be converted too.
+	const vec3<T> c0 = vec3<T>::normalize(vec3<T>(mat[0].x, mat[0].y, mat[0].z));
+	const vec3<T> c1 = vec3<T>::normalize(vec3<T>(mat[1].x, mat[1].y, mat[1].z));
+	const vec3<T> c2 = vec3<T>::normalize(vec3<T>(mat[2].x, mat[2].y, mat[2].z));
+	// Pick the biggest diagonal term for numerical stability (Shepperd's method)
+	T trace = c0.x + c1.y + c2.z;
+	if (trace > T(0))
+	{
+		T s = T(0.5) / sqrt(trace + T(1));
+		w = T(0.25) / s;
+		x = (c1.z - c2.y) * s;
+		y = (c2.x - c0.z) * s;
+		z = (c0.y - c1.x) * s;
+	}
+	else if (c0.x > c1.y && c0.x > c2.z)
+	{
+		T s = T(2) * sqrt(T(1) + c0.x - c1.y - c2.z);
+		w = (c1.z - c2.y) / s;
+		x = T(0.25) * s;
+		y = (c1.x + c0.y) / s;
+		z = (c2.x + c0.z) / s;
+	}
+	else if (c1.y > c2.z)
+	{
+		T s = T(2) * sqrt(T(1) + c1.y - c0.x - c2.z);
+		w = (c2.x - c0.z) / s;
+		x = (c1.x + c0.y) / s;
+		y = T(0.25) * s;
+		z = (c2.y + c1.z) / s;
+	}
+	else
+	{
+		T s = T(2) * sqrt(T(1) + c2.z - c0.x - c1.y);
+		w = (c0.y - c1.x) / s;
+		x = (c2.x + c0.z) / s;
+		y = (c2.y + c1.z) / s;
+		z = T(0.25) * s;
+	}
+}
+
 template <typename T>
 inline T & quat<T>::operator[](size_t index)
 {
@@ -72,6 +116,40 @@ inline quat<T> quat<T>::axis(const vec3<T> & axis, const radian<T> & angle)
 	);
 }
 
+template <typename T>
+inline T quat<T>::dot(const quat & lhs, const quat & rhs)
+{
+	return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z + lhs.w * rhs.w;
+}
+
+template <typename T>
+inline quat<T> quat<T>::nlerp(const quat & from, const quat & to, T t)
+{
+	// Flip the target if needed to interpolate along the shortest arc
+	T sign = (dot(from, to) < T(0)) ? T(-1) : T(1);
+	return normalize(from * (T(1) - t) + to * (sign * t));
+}
+
+template <typename T>
+inline quat<T> quat<T>::slerp(const quat & from, const quat & to, T t)
+{
+	T cosTheta = dot(from, to);
+	T sign = T(1);
+	if (cosTheta < T(0))
+	{
+		cosTheta = -cosTheta;
+		sign = T(-1);
+	}
+	// Quaternions are too close, sin(theta) is near 0. Fallback to nlerp.
+	if (cosTheta > T(0.9995))
+		return normalize(from * (T(1) - t) + to * (sign * t));
+	radian<T> theta = arccos(cosTheta);
+	T sinTheta = sin(theta);
+	T a = sin(radian<T>((T(1) - t) * theta())) / sinTheta;
+	T b = sin(radian<T>(t * theta())) / sinTheta;
+	return from * a + to * (sign * b);
+}
+
 template <typename T>
 inline quat<T> quat<T>::operator*(float scalar) const
 {
@@ -101,10 +179,11 @@ inline quat<T> quat<T>::operator*(const quat & rhs) const
 template <typename T>
 inline quat<T> & quat<T>::operator*=(const quat & rhs)
 {
-	x =  x * rhs.w + y * rhs.z - z * rhs.y + w * rhs.x;
-	y = -x * rhs.z + y * rhs.w + z * rhs.x + w * rhs.y;
-	z =  x * rhs.y - y * rhs.x + z * rhs.w + w * rhs.z;
-	w = -x * rhs.x - y * rhs.y - z * rhs.z + w * rhs.w;
+	quat lhs(*this);
+	x =  lhs.x * rhs.w + lhs.y * rhs.z - lhs.z * rhs.y + lhs.w * rhs.x;
+	y = -lhs.x * rhs.z + lhs.y * rhs.w + lhs.z * rhs.x + lhs.w * rhs.y;
+	z =  lhs.x * rhs.y - lhs.y * rhs.x + lhs.z * rhs.w + lhs.w * rhs.z;
+	w = -lhs.x * rhs.x - lhs.y * rhs.y - lhs.z * rhs.z + lhs.w * rhs.w;
 	return *this;
 }
 
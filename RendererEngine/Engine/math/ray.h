@@ -0,0 +1,37 @@
+#pragma once
+
+#include "scientific.h"
+#include "point3.h"
+#include "vec3.h"
+
+namespace geometry {
+
+template <typename T>
+struct ray {
+	point3<T> origin;
+	vec3<T> direction;
+
+	ray();
+	explicit ray(const point3<T> &origin, const vec3<T> &direction);
+
+	// Point at distance t along the ray
+	point3<T> operator()(T t) const;
+};
+
+// Packet of N rays stored as SoA so that traversal loops vectorize.
+// Inverse direction is precomputed for slab tests.
+template <typename T, size_t N>
+struct rayPacket {
+	alignas(32) T ox[N], oy[N], oz[N];		// Origins
+	alignas(32) T dx[N], dy[N], dz[N];		// Directions
+	alignas(32) T idx[N], idy[N], idz[N];	// Inverse directions
+
+	rayPacket();
+
+	void set(size_t index, const ray<T> &ray);
+	ray<T> get(size_t index) const;
+
+	static constexpr size_t size() { return N; }
+};
+
+}
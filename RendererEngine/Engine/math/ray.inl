@@ -0,0 +1,56 @@
+#include "ray.h"
+#include "point3.h"
+#include "vec3.h"
+
+namespace geometry {
+
+template <typename T>
+inline ray<T>::ray()
+{
+}
+
+template <typename T>
+inline ray<T>::ray(const point3<T> &origin, const vec3<T> &direction) :
+	origin(origin), direction(direction)
+{
+}
+
+template <typename T>
+inline point3<T> ray<T>::operator()(T t) const
+{
+	return point3<T>(
+		origin.x + direction.x * t,
+		origin.y + direction.y * t,
+		origin.z + direction.z * t
+	);
+}
+
+template <typename T, size_t N>
+inline rayPacket<T, N>::rayPacket()
+{
+}
+
+template <typename T, size_t N>
+inline void rayPacket<T, N>::set(size_t index, const ray<T> &r)
+{
+	ox[index] = r.origin.x;
+	oy[index] = r.origin.y;
+	oz[index] = r.origin.z;
+	dx[index] = r.direction.x;
+	dy[index] = r.direction.y;
+	dz[index] = r.direction.z;
+	idx[index] = T(1) / r.direction.x;
+	idy[index] = T(1) / r.direction.y;
+	idz[index] = T(1) / r.direction.z;
+}
+
+template <typename T, size_t N>
+inline ray<T> rayPacket<T, N>::get(size_t index) const
+{
+	return ray<T>(
+		point3<T>(ox[index], oy[index], oz[index]),
+		vec3<T>(dx[index], dy[index], dz[index])
+	);
+}
+
+}
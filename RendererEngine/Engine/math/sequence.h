@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "scientific.h"
+
+namespace geometry {
+
+template <typename T>
+struct vec2;
+
+namespace sample {
+
+// Low discrepancy sequences. All of them are mirrored in GLSL in
+// ProceduralRenderer/data/shaders/sampling.h and must stay bit exact.
+
+uint32_t reverseBits(uint32_t value);
+// Integer hash, used to derive per pixel seeds
+uint32_t hash(uint32_t value);
+uint32_t hashCombine(uint32_t seed, uint32_t value);
+
+// First two dimensions of the Sobol sequence.
+template <typename T>
+vec2<T> sobol(uint32_t index);
+// Owen scrambled Sobol, from "Practical Hash-based Owen Scrambling", Brent Burley
+// Each seed gives a different, decorrelated, sequence with the same stratification.
+template <typename T>
+vec2<T> sobolOwen(uint32_t index, uint32_t seed);
+// R2 sequence, from "The Unreasonable Effectiveness of Quasirandom Sequences", Martin Roberts
+template <typename T>
+vec2<T> r2(uint32_t index);
+
+// Compute a tileable blue noise texture of size * size values in [0, 1) using void and cluster.
+// from "The void-and-cluster method for dither array generation", Robert Ulichney
+template <typename T>
+void blueNoise(uint32_t size, T *out);
+
+}
+
+}
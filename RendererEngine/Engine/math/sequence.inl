@@ -0,0 +1,207 @@
+#include "sequence.h"
+#include "vec2.h"
+
+#include <cmath>
+#include <vector>
+
+namespace geometry {
+
+namespace sample {
+
+inline uint32_t reverseBits(uint32_t value)
+{
+	value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+	value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+	value = ((value >> 4) & 0x0F0F0F0Fu) | ((value & 0x0F0F0F0Fu) << 4);
+	value = ((value >> 8) & 0x00FF00FFu) | ((value & 0x00FF00FFu) << 8);
+	return (value >> 16) | (value << 16);
+}
+
+inline uint32_t hash(uint32_t value)
+{
+	// PCG hash
+	uint32_t state = value * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+inline uint32_t hashCombine(uint32_t seed, uint32_t value)
+{
+	return seed ^ (value + (seed << 6) + (seed >> 2));
+}
+
+// Laine & Karras permutation, only higher bits are affected by lower bits.
+inline uint32_t laineKarrasPermutation(uint32_t value, uint32_t seed)
+{
+	value += seed;
+	value ^= value * 0x6c50b47cu;
+	value ^= value * 0xb82f1e52u;
+	value ^= value * 0xc7afe638u;
+	value ^= value * 0x8d22f6e6u;
+	return value;
+}
+
+inline uint32_t nestedUniformScramble(uint32_t value, uint32_t seed)
+{
+	return reverseBits(laineKarrasPermutation(reverseBits(value), seed));
+}
+
+inline uint32_t sobol0(uint32_t index)
+{
+	return reverseBits(index);
+}
+
+inline uint32_t sobol1(uint32_t index)
+{
+	uint32_t result = 0;
+	for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		if (index & 1u)
+			result ^= v;
+	return result;
+}
+
+// Map to [0, 1) keeping only the bits the float mantissa can hold
+template <typename T>
+inline T toUnit(uint32_t value)
+{
+	return T(value >> 8) / T(1u << 24);
+}
+
+template <typename T>
+inline vec2<T> sobol(uint32_t index)
+{
+	return vec2<T>(toUnit<T>(sobol0(index)), toUnit<T>(sobol1(index)));
+}
+
+template <typename T>
+inline vec2<T> sobolOwen(uint32_t index, uint32_t seed)
+{
+	// Shuffle the sequence order, then scramble each dimension
+	index = nestedUniformScramble(index, seed);
+	return vec2<T>(
+		toUnit<T>(nestedUniformScramble(sobol0(index), hashCombine(seed, 0u))),
+		toUnit<T>(nestedUniformScramble(sobol1(index), hashCombine(seed, 1u)))
+	);
+}
+
+template <typename T>
+inline vec2<T> r2(uint32_t index)
+{
+	// Fixed point 0.32 arithmetic, wraps exactly like fract() and never loses precision.
+	const uint32_t alpha0 = 3242174889u; // 1 / g * 2^32
+	const uint32_t alpha1 = 2447445414u; // 1 / g^2 * 2^32
+	return vec2<T>(
+		toUnit<T>(0x80000000u + alpha0 * index),
+		toUnit<T>(0x80000000u + alpha1 * index)
+	);
+}
+
+template <typename T>
+inline void blueNoise(uint32_t size, T *out)
+{
+	const uint32_t count = size * size;
+	const float sigma = 1.5f;
+	// Toroidal gaussian filter precomputed for every offset
+	std::vector<float> filter(count);
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			float dx = static_cast<float>(min(x, size - x));
+			float dy = static_cast<float>(min(y, size - y));
+			filter[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+		}
+	}
+	std::vector<uint8_t> pattern(count, 0);
+	std::vector<float> energy(count, 0.f);
+	auto splat = [&](uint32_t index, float sign) {
+		const uint32_t px = index % size;
+		const uint32_t py = index / size;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			const float *row = &filter[((y + size - py) % size) * size];
+			for (uint32_t x = 0; x < size; x++)
+				energy[y * size + x] += sign * row[(x + size - px) % size];
+		}
+	};
+	// Highest energy among pixels set to value
+	auto tightestCluster = [&](uint8_t value) {
+		uint32_t best = 0;
+		float bestEnergy = -1e30f;
+		for (uint32_t i = 0; i < count; i++)
+			if (pattern[i] == value && energy[i] > bestEnergy)
+				bestEnergy = energy[best = i];
+		return best;
+	};
+	// Lowest energy among empty pixels
+	auto largestVoid = [&]() {
+		uint32_t best = 0;
+		float bestEnergy = 1e30f;
+		for (uint32_t i = 0; i < count; i++)
+			if (pattern[i] == 0 && energy[i] < bestEnergy)
+				bestEnergy = energy[best = i];
+		return best;
+	};
+	// Initial random pattern covering 10% of the pixels
+	const uint32_t initialCount = max(count / 10u, 1u);
+	for (uint32_t i = 0; i < initialCount; i++)
+	{
+		uint32_t index = hash(i) % count;
+		while (pattern[index])
+			index = (index + 1) % count;
+		pattern[index] = 1;
+		splat(index, 1.f);
+	}
+	// Move points from tightest clusters to largest voids until stable
+	while (true)
+	{
+		uint32_t cluster = tightestCluster(1);
+		pattern[cluster] = 0;
+		splat(cluster, -1.f);
+		uint32_t hole = largestVoid();
+		pattern[hole] = 1;
+		splat(hole, 1.f);
+		if (hole == cluster)
+			break;
+	}
+	const std::vector<uint8_t> prototype = pattern;
+	const std::vector<float> prototypeEnergy = energy;
+	// Phase 1 : rank the initial points by removing tightest clusters
+	uint32_t rank = initialCount;
+	while (rank > 0)
+	{
+		uint32_t cluster = tightestCluster(1);
+		pattern[cluster] = 0;
+		splat(cluster, -1.f);
+		out[cluster] = static_cast<T>(--rank);
+	}
+	// Phase 2 : fill the largest voids up to half the pixels
+	pattern = prototype;
+	energy = prototypeEnergy;
+	rank = initialCount;
+	while (rank < count / 2)
+	{
+		uint32_t hole = largestVoid();
+		pattern[hole] = 1;
+		splat(hole, 1.f);
+		out[hole] = static_cast<T>(rank++);
+	}
+	// Phase 3 : empty pixels are now the minority, use their energy instead
+	std::fill(energy.begin(), energy.end(), 0.f);
+	for (uint32_t i = 0; i < count; i++)
+		if (pattern[i] == 0)
+			splat(i, 1.f);
+	while (rank < count)
+	{
+		uint32_t cluster = tightestCluster(0);
+		pattern[cluster] = 1;
+		splat(cluster, -1.f);
+		out[cluster] = static_cast<T>(rank++);
+	}
+	for (uint32_t i = 0; i < count; i++)
+		out[i] = (out[i] + T(0.5)) / T(count);
+}
+
+}
+
+}
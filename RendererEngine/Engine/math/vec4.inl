@@ -129,7 +129,7 @@ inline vec4<T> & operator/=(vec4<T> & lhs, T rhs)
 template <typename T>
 inline vec4<T> operator+(const vec4<T> &lhs, const vec4<T> &rhs)
 {
-	return vec4<T>(lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z);
+	return vec4<T>(lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z, lhs.w + rhs.w);
 }
 
 template <typename T>
@@ -0,0 +1,174 @@
+#include "Culling.h"
+
+#include <cmath>
+
+namespace vk {
+
+namespace {
+
+uint32_t nextPowerOfTwo(uint32_t value)
+{
+	uint32_t power = 1;
+	while (power < value)
+		power *= 2;
+	return power;
+}
+
+bool outsideFrustum(const CullInstance &instance, const CullView &view)
+{
+	for (unsigned int iPlane = 0; iPlane < 6; iPlane++)
+	{
+		const float *plane = view.planes[iPlane];
+		const float distance = plane[0] * instance.center[0] + plane[1] * instance.center[1] + plane[2] * instance.center[2] + plane[3];
+		if (distance < -instance.radius)
+			return true;
+	}
+	return false;
+}
+
+// Behind the pyramid if the nearest depth of the box around the sphere is farther than every depth
+// of the texels under its screen rectangle. Instances crossing the camera plane or the borders of
+// the pyramid view are never occluded, nothing is known about them.
+bool occluded(const CullInstance &instance, const CullView &view, const DepthPyramid &pyramid)
+{
+	const float *m = view.pyramidViewProjection;
+	float minX = 1.f, minY = 1.f, maxX = -1.f, maxY = -1.f, minZ = 1.f;
+	for (unsigned int iCorner = 0; iCorner < 8; iCorner++)
+	{
+		const float x = instance.center[0] + ((iCorner & 1) ? instance.radius : -instance.radius);
+		const float y = instance.center[1] + ((iCorner & 2) ? instance.radius : -instance.radius);
+		const float z = instance.center[2] + ((iCorner & 4) ? instance.radius : -instance.radius);
+		const float clipX = m[0] * x + m[4] * y + m[8] * z + m[12];
+		const float clipY = m[1] * x + m[5] * y + m[9] * z + m[13];
+		const float clipZ = m[2] * x + m[6] * y + m[10] * z + m[14];
+		const float clipW = m[3] * x + m[7] * y + m[11] * z + m[15];
+		if (clipW <= 0.f)
+			return false;
+		minX = std::min(minX, clipX / clipW);
+		minY = std::min(minY, clipY / clipW);
+		maxX = std::max(maxX, clipX / clipW);
+		maxY = std::max(maxY, clipY / clipW);
+		minZ = std::min(minZ, clipZ / clipW);
+	}
+	if (minX < -1.f || minY < -1.f || maxX > 1.f || maxY > 1.f)
+		return false;
+	// Depth texels of the rectangle, then the level where it spans two texels at most.
+	const uint32_t width = static_cast<uint32_t>(view.depthSize[0]);
+	const uint32_t height = static_cast<uint32_t>(view.depthSize[1]);
+	const uint32_t x0 = std::min(static_cast<uint32_t>((minX * 0.5f + 0.5f) * view.depthSize[0]), width - 1);
+	const uint32_t y0 = std::min(static_cast<uint32_t>((minY * 0.5f + 0.5f) * view.depthSize[1]), height - 1);
+	const uint32_t x1 = std::min(static_cast<uint32_t>((maxX * 0.5f + 0.5f) * view.depthSize[0]), width - 1);
+	const uint32_t y1 = std::min(static_cast<uint32_t>((maxY * 0.5f + 0.5f) * view.depthSize[1]), height - 1);
+	uint32_t level = 0;
+	while ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)
+		level++;
+	if (level >= view.pyramidLevels)
+		return false;
+	const float farthest = std::max(
+		std::max(pyramid.texel(level, x0 >> level, y0 >> level), pyramid.texel(level, x1 >> level, y0 >> level)),
+		std::max(pyramid.texel(level, x0 >> level, y1 >> level), pyramid.texel(level, x1 >> level, y1 >> level))
+	);
+	return minZ > farthest;
+}
+
+}
+
+CullView makeCullView(const geometry::mat4f &viewProjection, const geometry::mat4f &pyramidViewProjection, uint32_t depthWidth, uint32_t depthHeight, uint32_t pyramidLevels, uint32_t instanceCount)
+{
+	CullView view;
+	const geometry::frustumf frustum(viewProjection);
+	for (unsigned int iPlane = 0; iPlane < 6; iPlane++)
+	{
+		view.planes[iPlane][0] = frustum.planes[iPlane].normal.x;
+		view.planes[iPlane][1] = frustum.planes[iPlane].normal.y;
+		view.planes[iPlane][2] = frustum.planes[iPlane].normal.z;
+		view.planes[iPlane][3] = frustum.planes[iPlane].distance;
+	}
+	for (unsigned int iCol = 0; iCol < 4; iCol++)
+		for (unsigned int iRow = 0; iRow < 4; iRow++)
+			view.pyramidViewProjection[iCol * 4 + iRow] = pyramidViewProjection[iCol][iRow];
+	view.depthSize[0] = static_cast<float>(depthWidth);
+	view.depthSize[1] = static_cast<float>(depthHeight);
+	view.pyramidLevels = pyramidLevels;
+	view.instanceCount = instanceCount;
+	return view;
+}
+
+void depthPyramidSize(uint32_t depthWidth, uint32_t depthHeight, uint32_t &width, uint32_t &height)
+{
+	width = nextPowerOfTwo(depthWidth);
+	height = nextPowerOfTwo(depthHeight);
+}
+
+uint32_t depthPyramidLevels(uint32_t depthWidth, uint32_t depthHeight)
+{
+	uint32_t width, height;
+	depthPyramidSize(depthWidth, depthHeight, width, height);
+	uint32_t levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(width / 2, 1U);
+		height = std::max(height / 2, 1U);
+		levels++;
+	}
+	return levels;
+}
+
+void buildDepthPyramid(const float *depth, uint32_t width, uint32_t height, DepthPyramid &pyramid)
+{
+	depthPyramidSize(width, height, pyramid.width, pyramid.height);
+	pyramid.levels.resize(depthPyramidLevels(width, height));
+	std::vector<float> &base = pyramid.levels[0];
+	base.resize(pyramid.width * pyramid.height);
+	for (uint32_t y = 0; y < pyramid.height; y++)
+		for (uint32_t x = 0; x < pyramid.width; x++)
+			base[y * pyramid.width + x] = depth[std::min(y, height - 1) * width + std::min(x, width - 1)];
+	for (uint32_t iLevel = 1; iLevel < pyramid.levels.size(); iLevel++)
+	{
+		const uint32_t sourceWidth = pyramid.levelWidth(iLevel - 1);
+		const uint32_t sourceHeight = pyramid.levelHeight(iLevel - 1);
+		const uint32_t levelWidth = pyramid.levelWidth(iLevel);
+		const uint32_t levelHeight = pyramid.levelHeight(iLevel);
+		std::vector<float> &level = pyramid.levels[iLevel];
+		level.resize(levelWidth * levelHeight);
+		for (uint32_t y = 0; y < levelHeight; y++)
+		{
+			for (uint32_t x = 0; x < levelWidth; x++)
+			{
+				// A side of one texel halves no more.
+				const uint32_t sx0 = std::min(x * 2, sourceWidth - 1), sx1 = std::min(x * 2 + 1, sourceWidth - 1);
+				const uint32_t sy0 = std::min(y * 2, sourceHeight - 1), sy1 = std::min(y * 2 + 1, sourceHeight - 1);
+				level[y * levelWidth + x] = std::max(
+					std::max(pyramid.texel(iLevel - 1, sx0, sy0), pyramid.texel(iLevel - 1, sx1, sy0)),
+					std::max(pyramid.texel(iLevel - 1, sx0, sy1), pyramid.texel(iLevel - 1, sx1, sy1))
+				);
+			}
+		}
+	}
+}
+
+CullStatistics cullInstances(const CullInstance *instances, const CullView &view, const DepthPyramid *pyramid, std::vector<DrawIndexedCommand> &commands)
+{
+	CullStatistics statistics = {};
+	statistics.instances = view.instanceCount;
+	commands.clear();
+	for (uint32_t iInstance = 0; iInstance < view.instanceCount; iInstance++)
+	{
+		const CullInstance &instance = instances[iInstance];
+		if (outsideFrustum(instance, view))
+		{
+			statistics.frustumCulled++;
+			continue;
+		}
+		if (pyramid != nullptr && view.pyramidLevels > 0 && occluded(instance, view, *pyramid))
+		{
+			statistics.occlusionCulled++;
+			continue;
+		}
+		commands.push_back(DrawIndexedCommand{ instance.indexCount, 1, instance.firstIndex, instance.vertexOffset, instance.firstInstance });
+		statistics.visible++;
+	}
+	return statistics;
+}
+
+}
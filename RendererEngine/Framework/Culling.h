@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "../Engine/math/geometry.h"
+
+namespace vk {
+
+// Instance culling on the GPU by cull.comp, see CullingStage. This header has the layouts shared
+// with the shaders & a CPU reference of them, so that cull results are testable without a GPU.
+//
+// An instance is visible if its bounding sphere intersects the frustum of the current view and is
+// not behind the depth pyramid of the previous frame. Visible instances are compacted into draw
+// commands, in no particular order on the GPU, in instance order on the CPU.
+
+// std430, 32 bytes.
+struct CullInstance {
+	float center[3];		// World space bounding sphere
+	float radius;
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;	// Copied to the command, indexes the per instance data of the draw
+};
+
+// Same layout as VkDrawIndexedIndirectCommand.
+struct DrawIndexedCommand {
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+// Storage buffer of cull.comp, the same in std140 & std430.
+struct CullView {
+	float planes[6][4];				// Frustum of the current view, normals pointing inside
+	float pyramidViewProjection[16];// View projection the pyramid depth was rendered with, column major
+	float depthSize[2];				// Of the depth the pyramid was built from, in texels
+	uint32_t pyramidLevels;			// 0 skips the occlusion test, as on the first frame
+	uint32_t instanceCount;
+};
+
+// Depth is clip z / w as stored by the depth buffer, smaller is nearer.
+// Planes are of clip z in [-w, w], a near plane behind the one of a [0, w] projection, which is conservative.
+CullView makeCullView(const geometry::mat4f &viewProjection, const geometry::mat4f &pyramidViewProjection, uint32_t depthWidth, uint32_t depthHeight, uint32_t pyramidLevels, uint32_t instanceCount);
+
+// Level 0 is the depth padded to powers of two by repeating its edges, so that every level halves
+// exactly like image mips. Each texel of a level is the farthest of the two by two texels under it,
+// a texel (x, y) of level i covers the depth texels [x << i, (x + 1) << i).
+struct DepthPyramid {
+	uint32_t width, height;	// Of level 0
+	std::vector<std::vector<float>> levels;
+
+	uint32_t levelWidth(uint32_t level) const { return (std::max)(width >> level, 1U); }
+	uint32_t levelHeight(uint32_t level) const { return (std::max)(height >> level, 1U); }
+	float texel(uint32_t level, uint32_t x, uint32_t y) const { return levels[level][y * levelWidth(level) + x]; }
+};
+// Size of the level 0 of a depth, the next powers of two.
+void depthPyramidSize(uint32_t depthWidth, uint32_t depthHeight, uint32_t &width, uint32_t &height);
+// Levels down to a single texel.
+uint32_t depthPyramidLevels(uint32_t depthWidth, uint32_t depthHeight);
+// Reference of depthPyramid.comp, depth is width x height rows.
+void buildDepthPyramid(const float *depth, uint32_t width, uint32_t height, DepthPyramid &pyramid);
+
+struct CullStatistics {
+	uint32_t instances;
+	uint32_t frustumCulled;
+	uint32_t occlusionCulled;
+	uint32_t visible;
+};
+
+// Reference of cull.comp. The pyramid is ignored when view.pyramidLevels is 0.
+// Clear the commands, then append one per visible instance.
+CullStatistics cullInstances(const CullInstance *instances, const CullView &view, const DepthPyramid *pyramid, std::vector<DrawIndexedCommand> &commands);
+
+}
@@ -1,13 +1,1624 @@
 #include "Image.h"
 
+#include "JobSystem.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define IMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace engine {
 namespace io {
 
+namespace {
+
+uint32_t readBE32(const unsigned char *p)
+{
+	return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+uint16_t readBE16(const unsigned char *p)
+{
+	return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+// --- Inflate (RFC 1950 & 1951)
+
+// LSB first bit stream, reads zeros past the end and remembers it.
+struct BitStream {
+	const unsigned char *data;
+	const unsigned char *end;
+	uint64_t bits;
+	unsigned int count;
+	unsigned int overrun; // Bytes of zeros in bits
+
+	BitStream(const unsigned char *data, size_t size) : data(data), end(data + size), bits(0), count(0), overrun(0) {}
+
+	void refill()
+	{
+		if (end - data >= 8)
+		{
+			// Whole bytes are added, bits of the next partial byte are the same as when it is added later.
+			uint64_t word;
+			std::memcpy(&word, data, 8);
+			bits |= word << count;
+			data += (63 - count) >> 3;
+			count |= 56;
+			return;
+		}
+		while (count <= 56)
+		{
+			if (data < end)
+				bits |= static_cast<uint64_t>(*data++) << count;
+			else
+				overrun++;
+			count += 8;
+		}
+	}
+	unsigned int peek(unsigned int n) { refill(); return static_cast<unsigned int>(bits & ((uint64_t(1) << n) - 1)); }
+	void consume(unsigned int n) { bits >>= n; count -= n; }
+	unsigned int read(unsigned int n) { const unsigned int value = peek(n); consume(n); return value; }
+	// Drop the bits up to the next byte and give back the buffered bytes.
+	void align()
+	{
+		consume(count % 8);
+		const unsigned int buffered = count / 8;
+		if (buffered < overrun)
+			throw std::runtime_error("Truncated deflate stream");
+		data -= buffered - overrun;
+		bits = 0;
+		count = 0;
+		overrun = 0;
+	}
+	void check() const
+	{
+		if (overrun * 8 > count)
+			throw std::runtime_error("Truncated deflate stream");
+	}
+};
+
+// Canonical Huffman code, codes up to fastBits long are decoded with a single lookup.
+struct Huffman {
+	static const unsigned int fastBits = 10;
+	uint16_t fast[1 << fastBits];	// length << 9 | symbol, 0 if longer than fastBits
+	uint16_t counts[16];			// Codes of each length
+	uint16_t symbols[288];			// Sorted by code
+
+	void build(const unsigned char *lengths, unsigned int count)
+	{
+		std::memset(fast, 0, sizeof(fast));
+		std::memset(counts, 0, sizeof(counts));
+		for (unsigned int iSymbol = 0; iSymbol < count; iSymbol++)
+			counts[lengths[iSymbol]]++;
+		counts[0] = 0;
+		uint16_t offsets[16];
+		unsigned int nextCode[16];
+		unsigned int code = 0;
+		offsets[0] = 0;
+		for (unsigned int length = 1; length < 16; length++)
+		{
+			code = (code + counts[length - 1]) << 1;
+			offsets[length] = offsets[length - 1] + counts[length - 1];
+			nextCode[length] = code;
+			if (code + counts[length] > (1U << length))
+				throw std::runtime_error("Invalid huffman code");
+		}
+		for (unsigned int iSymbol = 0; iSymbol < count; iSymbol++)
+		{
+			const unsigned int length = lengths[iSymbol];
+			if (length == 0)
+				continue;
+			symbols[offsets[length]++] = static_cast<uint16_t>(iSymbol);
+			const unsigned int assigned = nextCode[length]++;
+			if (length > fastBits)
+				continue;
+			// Stream is LSB first, codes are MSB first.
+			unsigned int reversed = 0;
+			for (unsigned int iBit = 0; iBit < length; iBit++)
+				reversed |= ((assigned >> iBit) & 1) << (length - 1 - iBit);
+			for (unsigned int index = reversed; index < (1U << fastBits); index += 1U << length)
+				fast[index] = static_cast<uint16_t>((length << 9) | iSymbol);
+		}
+	}
+
+	unsigned int decode(BitStream &stream) const
+	{
+		const unsigned int entry = fast[stream.peek(fastBits)];
+		if (entry != 0)
+		{
+			stream.consume(entry >> 9);
+			return entry & 511;
+		}
+		// Walk the lengths, the first code of a length is just after the last of the previous one.
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		for (unsigned int length = 1; length < 16; length++)
+		{
+			code |= static_cast<int>((stream.bits >> (length - 1)) & 1);
+			const int count = counts[length];
+			if (code - first < count)
+			{
+				stream.consume(length);
+				return symbols[index + code - first];
+			}
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+		throw std::runtime_error("Invalid huffman code");
+	}
+};
+
+const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Decompress a zlib stream into output, which must hold exactly the decompressed size.
+void inflate(const unsigned char *data, size_t size, unsigned char *output, size_t outputSize)
+{
+	if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20) != 0)
+		throw std::runtime_error("Invalid zlib header");
+	BitStream stream(data + 2, size - 2);
+	unsigned char *out = output;
+	unsigned char *const outEnd = output + outputSize;
+	Huffman literals, distances;
+	bool last = false;
+	while (!last)
+	{
+		last = stream.read(1) != 0;
+		const unsigned int type = stream.read(2);
+		if (type == 0)
+		{
+			stream.align();
+			if (stream.end - stream.data < 4)
+				throw std::runtime_error("Truncated deflate stream");
+			const unsigned int length = stream.data[0] | (stream.data[1] << 8);
+			const unsigned int complement = stream.data[2] | (stream.data[3] << 8);
+			stream.data += 4;
+			if ((length ^ 0xFFFF) != complement)
+				throw std::runtime_error("Invalid stored block");
+			if (static_cast<size_t>(stream.end - stream.data) < length || static_cast<size_t>(outEnd - out) < length)
+				throw std::runtime_error("Invalid stored block");
+			std::memcpy(out, stream.data, length);
+			stream.data += length;
+			out += length;
+			continue;
+		}
+		unsigned char lengths[288 + 32];
+		if (type == 1)
+		{
+			std::memset(lengths, 8, 144);
+			std::memset(lengths + 144, 9, 112);
+			std::memset(lengths + 256, 7, 24);
+			std::memset(lengths + 280, 8, 8);
+			literals.build(lengths, 288);
+			std::memset(lengths, 5, 30);
+			distances.build(lengths, 30);
+		}
+		else if (type == 2)
+		{
+			const unsigned int literalCount = stream.read(5) + 257;
+			const unsigned int distanceCount = stream.read(5) + 1;
+			const unsigned int codeCount = stream.read(4) + 4;
+			static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			unsigned char codeLengths[19] = {};
+			for (unsigned int iCode = 0; iCode < codeCount; iCode++)
+				codeLengths[order[iCode]] = static_cast<unsigned char>(stream.read(3));
+			Huffman codes;
+			codes.build(codeLengths, 19);
+			unsigned int count = 0;
+			while (count < literalCount + distanceCount)
+			{
+				const unsigned int symbol = codes.decode(stream);
+				if (symbol < 16)
+				{
+					lengths[count++] = static_cast<unsigned char>(symbol);
+					continue;
+				}
+				unsigned int repeat;
+				unsigned char value = 0;
+				if (symbol == 16)
+				{
+					if (count == 0)
+						throw std::runtime_error("Invalid code lengths");
+					value = lengths[count - 1];
+					repeat = stream.read(2) + 3;
+				}
+				else if (symbol == 17)
+					repeat = stream.read(3) + 3;
+				else
+					repeat = stream.read(7) + 11;
+				if (count + repeat > literalCount + distanceCount)
+					throw std::runtime_error("Invalid code lengths");
+				std::memset(lengths + count, value, repeat);
+				count += repeat;
+			}
+			literals.build(lengths, literalCount);
+			distances.build(lengths + literalCount, distanceCount);
+		}
+		else
+		{
+			throw std::runtime_error("Invalid deflate block");
+		}
+		while (true)
+		{
+			const unsigned int symbol = literals.decode(stream);
+			if (symbol < 256)
+			{
+				if (out == outEnd)
+					throw std::runtime_error("Deflate output overflow");
+				*out++ = static_cast<unsigned char>(symbol);
+				continue;
+			}
+			if (symbol == 256)
+				break;
+			if (symbol > 285)
+				throw std::runtime_error("Invalid length code");
+			const unsigned int length = lengthBase[symbol - 257] + stream.read(lengthExtra[symbol - 257]);
+			const unsigned int distanceCode = distances.decode(stream);
+			if (distanceCode >= 30)
+				throw std::runtime_error("Invalid distance code");
+			const size_t distance = distanceBase[distanceCode] + stream.read(distanceExtra[distanceCode]);
+			if (distance > static_cast<size_t>(out - output) || length > static_cast<size_t>(outEnd - out))
+				throw std::runtime_error("Invalid deflate match");
+			const unsigned char *from = out - distance;
+			if (distance >= 8 && static_cast<size_t>(outEnd - out) >= length + 8)
+			{
+				// 8 bytes at a time, may write past the match but not past the output.
+				for (unsigned int iByte = 0; iByte < length; iByte += 8)
+				{
+					uint64_t word;
+					std::memcpy(&word, from + iByte, 8);
+					std::memcpy(out + iByte, &word, 8);
+				}
+			}
+			else if (distance == 1)
+			{
+				std::memset(out, *from, length);
+			}
+			else
+			{
+				// Overlapping, repeats the last bytes.
+				for (unsigned int iByte = 0; iByte < length; iByte++)
+					out[iByte] = from[iByte];
+			}
+			out += length;
+		}
+		stream.check();
+	}
+	if (out != outEnd)
+		throw std::runtime_error("Truncated image data");
+}
+
+// --- PNG
+
+struct Png {
+	uint32_t width, height;
+	unsigned int depth, colorType, channels, components;
+	bool interlaced;
+	uint8_t palette[256][4];
+	Buffer<std::pair<const unsigned char*, size_t>> chunks; // IDAT
+
+	// Bytes of a filtered row of width pixels, without the filter type.
+	size_t rowSize(uint32_t width) const { return (static_cast<size_t>(width) * channels * depth + 7) / 8; }
+};
+
+const unsigned char pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+void parsePng(const unsigned char *data, size_t size, Png &png)
+{
+	const unsigned char *p = data + 8;
+	const unsigned char *end = data + size;
+	bool header = false;
+	bool transparency = false;
+	for (unsigned int iEntry = 0; iEntry < 256; iEntry++)
+	{
+		png.palette[iEntry][0] = png.palette[iEntry][1] = png.palette[iEntry][2] = 0;
+		png.palette[iEntry][3] = 255;
+	}
+	while (true)
+	{
+		if (end - p < 12)
+			throw std::runtime_error("Truncated PNG");
+		const uint32_t length = readBE32(p);
+		const uint32_t type = readBE32(p + 4);
+		const unsigned char *chunk = p + 8;
+		if (length > static_cast<size_t>(end - chunk) - 4)
+			throw std::runtime_error("Truncated PNG");
+		p = chunk + length + 4; // CRC is not checked
+		if (!header && type != 0x49484452)
+			throw std::runtime_error("PNG without header");
+		switch (type)
+		{
+		case 0x49484452: // IHDR
+			if (length < 13)
+				throw std::runtime_error("Invalid PNG header");
+			png.width = readBE32(chunk);
+			png.height = readBE32(chunk + 4);
+			png.depth = chunk[8];
+			png.colorType = chunk[9];
+			if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] > 1)
+				throw std::runtime_error("Unsupported PNG method");
+			png.interlaced = chunk[12] == 1;
+			if (png.width == 0 || png.height == 0 || png.width > (1U << 24) || png.height > (1U << 24))
+				throw std::runtime_error("Invalid PNG size");
+			switch (png.colorType)
+			{
+			case 0: png.channels = 1; break;
+			case 2: png.channels = 3; break;
+			case 3: png.channels = 1; break;
+			case 4: png.channels = 2; break;
+			case 6: png.channels = 4; break;
+			default: throw std::runtime_error("Invalid PNG color type");
+			}
+			if ((png.depth != 1 && png.depth != 2 && png.depth != 4 && png.depth != 8 && png.depth != 16) ||
+				(png.colorType == 3 && png.depth == 16) || (png.colorType != 0 && png.colorType != 3 && png.depth < 8))
+				throw std::runtime_error("Invalid PNG bit depth");
+			png.components = png.channels;
+			header = true;
+			break;
+		case 0x504C5445: // PLTE
+			if (length % 3 != 0 || length > 256 * 3)
+				throw std::runtime_error("Invalid PNG palette");
+			for (uint32_t iEntry = 0; iEntry < length / 3; iEntry++)
+				std::memcpy(png.palette[iEntry], chunk + iEntry * 3, 3);
+			break;
+		case 0x74524E53: // tRNS, color keys of gray & RGB images are ignored
+			if (png.colorType == 3)
+			{
+				if (length > 256)
+					throw std::runtime_error("Invalid PNG transparency");
+				for (uint32_t iEntry = 0; iEntry < length; iEntry++)
+					png.palette[iEntry][3] = chunk[iEntry];
+				transparency = true;
+			}
+			break;
+		case 0x49444154: // IDAT
+			png.chunks.emplace_back(chunk, length);
+			break;
+		case 0x49454E44: // IEND
+			if (png.chunks.empty())
+				throw std::runtime_error("PNG without data");
+			if (png.colorType == 3)
+				png.components = transparency ? 4 : 3;
+			return;
+		default:
+			if ((type & 0x20000000) == 0)
+				throw std::runtime_error("Unsupported critical PNG chunk");
+			break;
+		}
+	}
+}
+
+// Undo the filter of a row. out may be cur, prev is the previous unfiltered row.
+void unfilterScalar(unsigned int filter, const unsigned char *cur, const unsigned char *prev, unsigned char *out, size_t size, size_t bpp)
+{
+	switch (filter)
+	{
+	case 0:
+		if (out != cur)
+			std::memcpy(out, cur, size);
+		break;
+	case 1:
+		for (size_t i = 0; i < bpp; i++)
+			out[i] = cur[i];
+		for (size_t i = bpp; i < size; i++)
+			out[i] = static_cast<unsigned char>(cur[i] + out[i - bpp]);
+		break;
+	case 2:
+		for (size_t i = 0; i < size; i++)
+			out[i] = static_cast<unsigned char>(cur[i] + prev[i]);
+		break;
+	case 3:
+		for (size_t i = 0; i < bpp; i++)
+			out[i] = static_cast<unsigned char>(cur[i] + (prev[i] >> 1));
+		for (size_t i = bpp; i < size; i++)
+			out[i] = static_cast<unsigned char>(cur[i] + ((out[i - bpp] + prev[i]) >> 1));
+		break;
+	case 4:
+		for (size_t i = 0; i < size; i++)
+		{
+			const int a = (i >= bpp) ? out[i - bpp] : 0;
+			const int b = prev[i];
+			const int c = (i >= bpp) ? prev[i - bpp] : 0;
+			const int pa = std::abs(b - c);
+			const int pb = std::abs(a - c);
+			const int pc = std::abs(a + b - 2 * c);
+			const int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+			out[i] = static_cast<unsigned char>(cur[i] + predictor);
+		}
+		break;
+	default:
+		throw std::runtime_error("Invalid PNG filter");
+	}
+}
+
+#if defined(IMAGE_SSE2)
+// A pixel of up to 8 bytes in the low lanes, built from whole loads so that the stores
+// of the previous pixel are forwarded.
+template <size_t bpp>
+inline __m128i loadPixel(const unsigned char *p)
+{
+	if constexpr (bpp == 3)
+	{
+		uint16_t low;
+		std::memcpy(&low, p, 2);
+		return _mm_cvtsi32_si128(static_cast<int>(low | (static_cast<uint32_t>(p[2]) << 16)));
+	}
+	else if constexpr (bpp == 4)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, 4);
+		return _mm_cvtsi32_si128(static_cast<int>(value));
+	}
+	else if constexpr (bpp == 6)
+	{
+		uint32_t low;
+		uint16_t high;
+		std::memcpy(&low, p, 4);
+		std::memcpy(&high, p + 4, 2);
+		return _mm_cvtsi64_si128(static_cast<long long>(low | (static_cast<uint64_t>(high) << 32)));
+	}
+	else
+	{
+		return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+	}
+}
+
+template <size_t bpp>
+inline void storePixel(unsigned char *p, __m128i pixel)
+{
+	if constexpr (bpp == 3 || bpp == 4)
+	{
+		const uint32_t value = static_cast<uint32_t>(_mm_cvtsi128_si32(pixel));
+		std::memcpy(p, &value, bpp == 3 ? 2 : 4);
+		if (bpp == 3)
+			p[2] = static_cast<unsigned char>(value >> 16);
+	}
+	else if constexpr (bpp == 6)
+	{
+		const uint64_t value = static_cast<uint64_t>(_mm_cvtsi128_si64(pixel));
+		const uint32_t low = static_cast<uint32_t>(value);
+		const uint16_t high = static_cast<uint16_t>(value >> 32);
+		std::memcpy(p, &low, 4);
+		std::memcpy(p + 4, &high, 2);
+	}
+	else
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), pixel);
+	}
+}
+
+inline __m128i abs16(__m128i x)
+{
+	return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+// Pixels depend on their left neighbour, so Sub, Average & Paeth are vectorized across
+// the bytes of a pixel.
+template <size_t bpp>
+void unfilterPixels(unsigned int filter, const unsigned char *cur, const unsigned char *prev, unsigned char *out, size_t size)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask = _mm_set1_epi16(0xFF);
+	__m128i a = zero;
+	__m128i c = zero;
+	switch (filter)
+	{
+	case 1:
+		for (size_t i = 0; i < size; i += bpp)
+		{
+			a = _mm_add_epi8(a, loadPixel<bpp>(cur + i));
+			storePixel<bpp>(out + i, a);
+		}
+		break;
+	case 3:
+		for (size_t i = 0; i < size; i += bpp)
+		{
+			const __m128i x = _mm_unpacklo_epi8(loadPixel<bpp>(cur + i), zero);
+			const __m128i b = _mm_unpacklo_epi8(loadPixel<bpp>(prev + i), zero);
+			a = _mm_and_si128(_mm_add_epi16(x, _mm_srli_epi16(_mm_add_epi16(a, b), 1)), mask);
+			storePixel<bpp>(out + i, _mm_packus_epi16(a, a));
+		}
+		break;
+	case 4:
+		for (size_t i = 0; i < size; i += bpp)
+		{
+			const __m128i x = _mm_unpacklo_epi8(loadPixel<bpp>(cur + i), zero);
+			const __m128i b = _mm_unpacklo_epi8(loadPixel<bpp>(prev + i), zero);
+			const __m128i bc = _mm_sub_epi16(b, c);
+			const __m128i ac = _mm_sub_epi16(a, c);
+			const __m128i pa = abs16(bc);
+			const __m128i pb = abs16(ac);
+			const __m128i pc = abs16(_mm_add_epi16(bc, ac));
+			// a if pa is the smallest, then b if pb is, c otherwise
+			const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			const __m128i useA = _mm_cmpeq_epi16(smallest, pa);
+			const __m128i useB = _mm_cmpeq_epi16(smallest, pb);
+			const __m128i bOrC = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+			const __m128i predictor = _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, bOrC));
+			a = _mm_and_si128(_mm_add_epi16(x, predictor), mask);
+			c = b;
+			storePixel<bpp>(out + i, _mm_packus_epi16(a, a));
+		}
+		break;
+	}
+}
+
+void unfilter(unsigned int filter, const unsigned char *cur, const unsigned char *prev, unsigned char *out, size_t size, size_t bpp)
+{
+	if (filter == 2)
+	{
+		// Up is independent across the row.
+		size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_add_epi8(x, b));
+		}
+		for (; i < size; i++)
+			out[i] = static_cast<unsigned char>(cur[i] + prev[i]);
+		return;
+	}
+	if (filter != 1 && filter != 3 && filter != 4)
+	{
+		unfilterScalar(filter, cur, prev, out, size, bpp);
+		return;
+	}
+	switch (bpp)
+	{
+	case 3: unfilterPixels<3>(filter, cur, prev, out, size); break;
+	case 4: unfilterPixels<4>(filter, cur, prev, out, size); break;
+	case 6: unfilterPixels<6>(filter, cur, prev, out, size); break;
+	case 8: unfilterPixels<8>(filter, cur, prev, out, size); break;
+	default: unfilterScalar(filter, cur, prev, out, size, bpp); break;
+	}
+}
+#else
+void unfilter(unsigned int filter, const unsigned char *cur, const unsigned char *prev, unsigned char *out, size_t size, size_t bpp)
+{
+	unfilterScalar(filter, cur, prev, out, size, bpp);
+}
+#endif
+
+// Unfiltered row to 8 bit components.
+void convertPng(const Png &png, const unsigned char *row, unsigned char *out, uint32_t width)
+{
+	if (png.depth == 16)
+	{
+		// Most significant byte
+		const size_t count = static_cast<size_t>(width) * png.channels;
+		for (size_t i = 0; i < count; i++)
+			out[i] = row[i * 2];
+		return;
+	}
+	if (png.depth == 8 && png.colorType != 3)
+	{
+		std::memcpy(out, row, static_cast<size_t>(width) * png.channels);
+		return;
+	}
+	const unsigned int mask = (1U << png.depth) - 1;
+	const unsigned int scale = (png.colorType == 3) ? 1 : 255 / mask;
+	for (uint32_t x = 0; x < width; x++)
+	{
+		const size_t bit = static_cast<size_t>(x) * png.depth;
+		const unsigned int value = (row[bit / 8] >> (8 - png.depth - bit % 8)) & mask;
+		if (png.colorType == 3)
+		{
+			std::memcpy(out, png.palette[value], png.components);
+			out += png.components;
+		}
+		else
+		{
+			*out++ = static_cast<unsigned char>(value * scale);
+		}
+	}
+}
+
+void decodePng(const unsigned char *data, size_t size, unsigned char *pixels)
+{
+	Png png;
+	parsePng(data, size, png);
+
+	// Zlib stream split over IDAT chunks, read in place when there is only one.
+	Buffer<unsigned char> joined;
+	const unsigned char *stream = png.chunks[0].first;
+	size_t streamSize = png.chunks[0].second;
+	if (png.chunks.size() > 1)
+	{
+		for (const std::pair<const unsigned char*, size_t> &chunk : png.chunks)
+			joined.insert(joined.end(), chunk.first, chunk.first + chunk.second);
+		stream = joined.data();
+		streamSize = joined.size();
+	}
+
+	// Adam7 passes, a single pass covering the image when not interlaced.
+	struct Pass { uint32_t x, y, dx, dy; };
+	static const Pass adam7[7] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+	static const Pass full = { 0, 0, 1, 1 };
+	const Pass *passes = png.interlaced ? adam7 : &full;
+	const unsigned int passCount = png.interlaced ? 7 : 1;
+	size_t rawSize = 0;
+	for (unsigned int iPass = 0; iPass < passCount; iPass++)
+	{
+		const uint32_t width = (png.width - passes[iPass].x + passes[iPass].dx - 1) / passes[iPass].dx;
+		const uint32_t height = (png.height - passes[iPass].y + passes[iPass].dy - 1) / passes[iPass].dy;
+		if (png.width > passes[iPass].x && png.height > passes[iPass].y)
+			rawSize += height * (png.rowSize(width) + 1);
+	}
+	Buffer<unsigned char> raw(rawSize);
+	inflate(stream, streamSize, raw.data(), raw.size());
+
+	// 8 bit rows are unfiltered straight into the pixels, others in place then converted.
+	const size_t bpp = std::max<size_t>(1, png.channels * png.depth / 8);
+	const bool direct = !png.interlaced && png.depth == 8 && png.colorType != 3;
+	const size_t stride = static_cast<size_t>(png.width) * png.components;
+	const Buffer<unsigned char> zeros(png.rowSize(png.width), 0);
+	Buffer<unsigned char> converted(png.interlaced ? stride : 0);
+	unsigned char *row = raw.data();
+	for (unsigned int iPass = 0; iPass < passCount; iPass++)
+	{
+		const Pass &pass = passes[iPass];
+		if (png.width <= pass.x || png.height <= pass.y)
+			continue;
+		const uint32_t width = (png.width - pass.x + pass.dx - 1) / pass.dx;
+		const uint32_t height = (png.height - pass.y + pass.dy - 1) / pass.dy;
+		const size_t rowSize = png.rowSize(width);
+		const unsigned char *prev = zeros.data();
+		for (uint32_t y = 0; y < height; y++)
+		{
+			const unsigned int filter = row[0];
+			unsigned char *cur = row + 1;
+			unsigned char *out = direct ? pixels + y * stride : cur;
+			unfilter(filter, cur, prev, out, rowSize, bpp);
+			prev = out;
+			row += rowSize + 1;
+			if (direct)
+				continue;
+			if (!png.interlaced)
+			{
+				convertPng(png, out, pixels + y * stride, width);
+				continue;
+			}
+			convertPng(png, out, converted.data(), width);
+			unsigned char *line = pixels + (static_cast<size_t>(pass.y) + static_cast<size_t>(y) * pass.dy) * stride;
+			for (uint32_t x = 0; x < width; x++)
+				std::memcpy(line + (pass.x + static_cast<size_t>(x) * pass.dx) * png.components, converted.data() + static_cast<size_t>(x) * png.components, png.components);
+		}
+	}
+}
+
+// --- JPEG (baseline & extended huffman sequential)
+
+const uint8_t zigzag[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// MSB first entropy coded segment, stuffed bytes removed. Reads zeros once a marker is reached.
+struct JpegBits {
+	const unsigned char *data;
+	const unsigned char *end;
+	uint32_t bits;
+	int count;
+	bool marker;
+
+	void reset(const unsigned char *from)
+	{
+		data = from;
+		bits = 0;
+		count = 0;
+		marker = false;
+	}
+	void refill()
+	{
+		while (count <= 24)
+		{
+			unsigned int byte = 0;
+			if (!marker && data < end)
+			{
+				byte = *data;
+				if (byte == 0xFF)
+				{
+					const unsigned int next = (data + 1 < end) ? data[1] : 0xD9;
+					if (next == 0x00)
+						data += 2;
+					else
+					{
+						marker = true;
+						byte = 0;
+					}
+				}
+				else
+				{
+					data++;
+				}
+			}
+			bits |= byte << (24 - count);
+			count += 8;
+		}
+	}
+	void consume(int n) { bits <<= n; count -= n; }
+	// Signed value of n bits.
+	int receive(int n)
+	{
+		if (n == 0)
+			return 0;
+		refill();
+		const int value = static_cast<int>(bits >> (32 - n));
+		consume(n);
+		return (value < (1 << (n - 1))) ? value - (1 << n) + 1 : value;
+	}
+};
+
+struct JpegHuffman {
+	static const unsigned int fastBits = 9;
+	uint8_t fast[1 << fastBits];	// Index of the symbol, 255 if longer than fastBits
+	uint8_t values[256];
+	uint8_t sizes[257];
+	uint32_t maxCode[18];			// Left aligned on 16 bits, exclusive
+	int delta[17];					// Index of the symbol minus its code
+
+	void build(const unsigned char *counts, const unsigned char *symbols, unsigned int total)
+	{
+		unsigned int k = 0;
+		for (unsigned int length = 1; length <= 16; length++)
+			for (unsigned int i = 0; i < counts[length - 1]; i++)
+				sizes[k++] = static_cast<uint8_t>(length);
+		sizes[k] = 0;
+		std::memcpy(values, symbols, total);
+		uint16_t codes[256];
+		unsigned int code = 0;
+		k = 0;
+		for (unsigned int length = 1; length <= 16; length++)
+		{
+			delta[length] = static_cast<int>(k) - static_cast<int>(code);
+			while (sizes[k] == length)
+				codes[k++] = static_cast<uint16_t>(code++);
+			if (code > (1U << length))
+				throw std::runtime_error("Invalid JPEG huffman table");
+			maxCode[length] = code << (16 - length);
+			code <<= 1;
+		}
+		maxCode[17] = 0xFFFFFFFF;
+		std::memset(fast, 255, sizeof(fast));
+		for (unsigned int i = 0; i < k; i++)
+		{
+			if (sizes[i] > fastBits)
+				continue;
+			const unsigned int first = codes[i] << (fastBits - sizes[i]);
+			for (unsigned int j = 0; j < (1U << (fastBits - sizes[i])); j++)
+				fast[first + j] = static_cast<uint8_t>(i);
+		}
+	}
+
+	unsigned int decode(JpegBits &bits) const
+	{
+		bits.refill();
+		const unsigned int k = fast[bits.bits >> (32 - fastBits)];
+		if (k != 255)
+		{
+			bits.consume(sizes[k]);
+			return values[k];
+		}
+		const uint32_t top = bits.bits >> 16;
+		unsigned int length = fastBits + 1;
+		while (top >= maxCode[length])
+			length++;
+		if (length == 17)
+			throw std::runtime_error("Invalid JPEG huffman code");
+		const int index = static_cast<int>(bits.bits >> (32 - length)) + delta[length];
+		if (index < 0 || index >= 256)
+			throw std::runtime_error("Invalid JPEG huffman code");
+		bits.consume(length);
+		return values[index];
+	}
+};
+
+struct JpegComponent {
+	unsigned int id, h, v, quantization;
+	unsigned int dc, ac;
+	int prediction;
+	unsigned int blocksX, blocksY;	// Blocks covering the component, padded to whole MCUs
+	size_t stride;
+	Buffer<unsigned char> plane;
+};
+
+struct Jpeg {
+	uint32_t width, height;
+	unsigned int hMax, vMax, mcusX, mcusY;
+	unsigned int restartInterval;
+	bool rgb;	// Adobe files without color transform
+	uint16_t quantization[4][64];
+	JpegHuffman dc[4], ac[4];
+	Buffer<JpegComponent> components;
+};
+
+inline unsigned char clamp8(int value)
+{
+	return static_cast<unsigned char>(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+inline int clamp16(int value)
+{
+	return value < -32768 ? -32768 : value > 32767 ? 32767 : value;
+}
+
+// Integer IDCT of dequantized coefficients, the classic separable jidctint formulation
+// with 12 bits of fraction. Intermediate values are clamped to 16 bits so that corrupted
+// coefficients cannot overflow.
+void idct(const int *in, unsigned char *out, size_t stride)
+{
+	auto f2f = [](float x) { return static_cast<int>(x * 4096.f + 0.5f); };
+	int values[64];
+	struct Odd { int t0, t1, t2, t3; };
+	struct Even { int x0, x1, x2, x3; };
+	auto pass = [&](int s0, int s1, int s2, int s3, int s4, int s5, int s6, int s7, Even &even, Odd &odd) {
+		int p1 = (s2 + s6) * f2f(0.5411961f);
+		const int t2 = p1 + s6 * f2f(-1.847759065f);
+		const int t3 = p1 + s2 * f2f(0.765366865f);
+		const int t0 = (s0 + s4) * 4096;
+		const int t1 = (s0 - s4) * 4096;
+		even.x0 = t0 + t3;
+		even.x3 = t0 - t3;
+		even.x1 = t1 + t2;
+		even.x2 = t1 - t2;
+		int o0 = s7, o1 = s5, o2 = s3, o3 = s1;
+		int p3 = o0 + o2;
+		int p4 = o1 + o3;
+		p1 = o0 + o3;
+		int p2 = o1 + o2;
+		const int p5 = (p3 + p4) * f2f(1.175875602f);
+		o0 *= f2f(0.298631336f);
+		o1 *= f2f(2.053119869f);
+		o2 *= f2f(3.072711026f);
+		o3 *= f2f(1.501321110f);
+		p1 = p5 + p1 * f2f(-0.899976223f);
+		p2 = p5 + p2 * f2f(-2.562915447f);
+		p3 *= f2f(-1.961570560f);
+		p4 *= f2f(-0.390180644f);
+		odd.t3 = o3 + p1 + p4;
+		odd.t2 = o2 + p2 + p3;
+		odd.t1 = o1 + p2 + p4;
+		odd.t0 = o0 + p1 + p3;
+	};
+	// Columns
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		const int *d = in + i;
+		int *v = values + i;
+		if (d[8] == 0 && d[16] == 0 && d[24] == 0 && d[32] == 0 && d[40] == 0 && d[48] == 0 && d[56] == 0)
+		{
+			const int dc = clamp16(d[0] * 4);
+			for (unsigned int j = 0; j < 8; j++)
+				v[j * 8] = dc;
+			continue;
+		}
+		Even even;
+		Odd odd;
+		pass(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56], even, odd);
+		even.x0 += 512; even.x1 += 512; even.x2 += 512; even.x3 += 512;
+		v[0] = clamp16((even.x0 + odd.t3) >> 10);
+		v[56] = clamp16((even.x0 - odd.t3) >> 10);
+		v[8] = clamp16((even.x1 + odd.t2) >> 10);
+		v[48] = clamp16((even.x1 - odd.t2) >> 10);
+		v[16] = clamp16((even.x2 + odd.t1) >> 10);
+		v[40] = clamp16((even.x2 - odd.t1) >> 10);
+		v[24] = clamp16((even.x3 + odd.t0) >> 10);
+		v[32] = clamp16((even.x3 - odd.t0) >> 10);
+	}
+	// Rows, with rounding & the +128 level shift folded in
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		const int *v = values + i * 8;
+		unsigned char *o = out + i * stride;
+		Even even;
+		Odd odd;
+		pass(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], even, odd);
+		const int bias = 65536 + (128 << 17);
+		even.x0 += bias; even.x1 += bias; even.x2 += bias; even.x3 += bias;
+		o[0] = clamp8((even.x0 + odd.t3) >> 17);
+		o[7] = clamp8((even.x0 - odd.t3) >> 17);
+		o[1] = clamp8((even.x1 + odd.t2) >> 17);
+		o[6] = clamp8((even.x1 - odd.t2) >> 17);
+		o[2] = clamp8((even.x2 + odd.t1) >> 17);
+		o[5] = clamp8((even.x2 - odd.t1) >> 17);
+		o[3] = clamp8((even.x3 + odd.t0) >> 17);
+		o[4] = clamp8((even.x3 - odd.t0) >> 17);
+	}
+}
+
+void decodeBlock(Jpeg &jpeg, JpegBits &bits, JpegComponent &component, unsigned char *out)
+{
+	int coefficients[64] = {};
+	const uint16_t *quantization = jpeg.quantization[component.quantization];
+	const unsigned int size = jpeg.dc[component.dc].decode(bits);
+	if (size > 16)
+		throw std::runtime_error("Invalid JPEG DC coefficient");
+	component.prediction = clamp16(component.prediction + bits.receive(static_cast<int>(size)));
+	coefficients[0] = clamp16(component.prediction * quantization[0]);
+	const JpegHuffman &ac = jpeg.ac[component.ac];
+	for (unsigned int k = 1; k < 64;)
+	{
+		const unsigned int rs = ac.decode(bits);
+		const unsigned int run = rs >> 4;
+		const unsigned int s = rs & 15;
+		if (s == 0)
+		{
+			if (run != 15)
+				break; // End of block
+			k += 16;
+			continue;
+		}
+		k += run;
+		if (k > 63)
+			throw std::runtime_error("Invalid JPEG AC coefficient");
+		coefficients[zigzag[k]] = clamp16(bits.receive(static_cast<int>(s)) * quantization[k]);
+		k++;
+	}
+	idct(coefficients, out, component.stride);
+}
+
+void decodeScan(Jpeg &jpeg, JpegBits &bits, const Buffer<JpegComponent*> &scan)
+{
+	for (JpegComponent *component : scan)
+		component->prediction = 0;
+	unsigned int restart = jpeg.restartInterval;
+	auto nextUnit = [&](bool last) {
+		if (jpeg.restartInterval == 0 || --restart != 0 || last)
+			return;
+		// Restart marker, entropy coding starts over.
+		const unsigned char *p = bits.data;
+		while (p + 1 < bits.end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7))
+			p++;
+		if (p + 1 >= bits.end)
+			throw std::runtime_error("Missing JPEG restart marker");
+		bits.reset(p + 2);
+		for (JpegComponent *component : scan)
+			component->prediction = 0;
+		restart = jpeg.restartInterval;
+	};
+	if (scan.size() == 1)
+	{
+		// Non interleaved, blocks of the component only, without MCU padding.
+		JpegComponent &component = *scan[0];
+		const unsigned int blocksX = ((jpeg.width * component.h + jpeg.hMax - 1) / jpeg.hMax + 7) / 8;
+		const unsigned int blocksY = ((jpeg.height * component.v + jpeg.vMax - 1) / jpeg.vMax + 7) / 8;
+		for (unsigned int by = 0; by < blocksY; by++)
+		{
+			for (unsigned int bx = 0; bx < blocksX; bx++)
+			{
+				decodeBlock(jpeg, bits, component, component.plane.data() + by * 8 * component.stride + bx * 8);
+				nextUnit(by + 1 == blocksY && bx + 1 == blocksX);
+			}
+		}
+		return;
+	}
+	for (unsigned int my = 0; my < jpeg.mcusY; my++)
+	{
+		for (unsigned int mx = 0; mx < jpeg.mcusX; mx++)
+		{
+			for (JpegComponent *component : scan)
+			{
+				for (unsigned int by = 0; by < component->v; by++)
+				{
+					for (unsigned int bx = 0; bx < component->h; bx++)
+					{
+						const size_t x = (mx * component->h + bx) * 8;
+						const size_t y = (my * component->v + by) * 8;
+						decodeBlock(jpeg, bits, *component, component->plane.data() + y * component->stride + x);
+					}
+				}
+			}
+			nextUnit(my + 1 == jpeg.mcusY && mx + 1 == jpeg.mcusX);
+		}
+	}
+}
+
+// Color conversion of a row, JFIF YCbCr to RGB with 14 bits of fraction.
+void convertYCbCr(const unsigned char *y, const unsigned char *cb, const unsigned char *cr, unsigned char *out, uint32_t width)
+{
+	const int crR = 22970;		// 1.402
+	const int cbG = -5638;		// -0.344136
+	const int crG = -11700;		// -0.714136
+	const int cbB = 29032;		// 1.772
+	uint32_t x = 0;
+#if defined(IMAGE_SSE2)
+	// 8 pixels at a time, chroma terms are pairwise multiply-added in 32 bits.
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i offset = _mm_set1_epi16(128);
+	const __m128i round = _mm_set1_epi32(1 << 13);
+	auto pair = [](int a, int b) { return _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(a) & 0xFFFF))); };
+	const __m128i red = pair(crR, 0);
+	const __m128i green = pair(cbG, crG);
+	const __m128i blue = pair(cbB, 0);
+	auto scale = [&](__m128i a, __m128i b, __m128i coefficients) {
+		const __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), coefficients), round), 14);
+		const __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), coefficients), round), 14);
+		return _mm_packs_epi32(lo, hi);
+	};
+	for (; x + 8 <= width; x += 8)
+	{
+		const __m128i luma = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)), zero);
+		const __m128i u = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cb + x)), zero), offset);
+		const __m128i v = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cr + x)), zero), offset);
+		alignas(16) unsigned char rgb[3][16];
+		_mm_store_si128(reinterpret_cast<__m128i*>(rgb[0]), _mm_packus_epi16(_mm_add_epi16(luma, scale(v, zero, red)), zero));
+		_mm_store_si128(reinterpret_cast<__m128i*>(rgb[1]), _mm_packus_epi16(_mm_add_epi16(luma, scale(u, v, green)), zero));
+		_mm_store_si128(reinterpret_cast<__m128i*>(rgb[2]), _mm_packus_epi16(_mm_add_epi16(luma, scale(u, zero, blue)), zero));
+		unsigned char *o = out + x * 3;
+		for (unsigned int i = 0; i < 8; i++)
+		{
+			o[i * 3 + 0] = rgb[0][i];
+			o[i * 3 + 1] = rgb[1][i];
+			o[i * 3 + 2] = rgb[2][i];
+		}
+	}
+#endif
+	for (; x < width; x++)
+	{
+		const int luma = y[x];
+		const int u = cb[x] - 128;
+		const int v = cr[x] - 128;
+		out[x * 3 + 0] = clamp8(luma + ((v * crR + (1 << 13)) >> 14));
+		out[x * 3 + 1] = clamp8(luma + ((u * cbG + v * crG + (1 << 13)) >> 14));
+		out[x * 3 + 2] = clamp8(luma + ((u * cbB + (1 << 13)) >> 14));
+	}
+}
+
+// Row of a component at full resolution. Chroma subsampled by 2 is interpolated
+// with the 3/4 1/4 triangle filter of libjpeg, other factors are replicated.
+const unsigned char *upsample(const Jpeg &jpeg, const JpegComponent &component, uint32_t y, Buffer<int> &column, unsigned char *out)
+{
+	const unsigned int hScale = jpeg.hMax / component.h;
+	const unsigned int vScale = jpeg.vMax / component.v;
+	const uint32_t width = (jpeg.width * component.h + jpeg.hMax - 1) / jpeg.hMax;
+	const uint32_t height = (jpeg.height * component.v + jpeg.vMax - 1) / jpeg.vMax;
+	const bool fancy = (hScale == 1 || hScale == 2) && (vScale == 1 || vScale == 2) && jpeg.hMax % component.h == 0 && jpeg.vMax % component.v == 0;
+	if (!fancy)
+	{
+		const unsigned char *row = component.plane.data() + (y * component.v / jpeg.vMax) * component.stride;
+		for (uint32_t x = 0; x < jpeg.width; x++)
+			out[x] = row[x * component.h / jpeg.hMax];
+		return out;
+	}
+	if (hScale == 1 && vScale == 1)
+		return component.plane.data() + y * component.stride;
+	const uint32_t sy = y / vScale;
+	const unsigned char *near = component.plane.data() + sy * component.stride;
+	if (vScale == 1)
+	{
+		for (uint32_t x = 0; x < width; x++)
+			column[x] = near[x] * 4;
+	}
+	else
+	{
+		// Odd rows are closer to the next source row.
+		uint32_t farRow = (y % 2 == 0) ? (sy > 0 ? sy - 1 : 0) : (sy + 1 < height ? sy + 1 : sy);
+		const unsigned char *far = component.plane.data() + farRow * component.stride;
+		for (uint32_t x = 0; x < width; x++)
+			column[x] = near[x] * 3 + far[x];
+	}
+	if (hScale == 1)
+	{
+		const int bias = (vScale == 2 && y % 2 == 1) ? 1 : 2;
+		for (uint32_t x = 0; x < jpeg.width; x++)
+			out[x] = static_cast<unsigned char>((column[x] + bias) >> 2);
+		return out;
+	}
+	for (uint32_t x = 0; x < width; x++)
+	{
+		const int left = column[x > 0 ? x - 1 : 0];
+		const int right = column[x + 1 < width ? x + 1 : x];
+		const int center = column[x] * 3;
+		if (2 * x < jpeg.width)
+			out[2 * x] = static_cast<unsigned char>((center + left + 8) >> 4);
+		if (2 * x + 1 < jpeg.width)
+			out[2 * x + 1] = static_cast<unsigned char>((center + right + 7) >> 4);
+	}
+	return out;
+}
+
+// Planes to pixels.
+void writeJpeg(const Jpeg &jpeg, unsigned char *pixels)
+{
+	const unsigned int componentCount = static_cast<unsigned int>(jpeg.components.size());
+	const size_t stride = static_cast<size_t>(jpeg.width) * componentCount;
+	Buffer<int> column(jpeg.width + 1);
+	Buffer<unsigned char> upsampled[3];
+	const unsigned char *rows[3];
+	for (unsigned int iComponent = 0; iComponent < componentCount; iComponent++)
+		upsampled[iComponent].resize(jpeg.width);
+	for (uint32_t y = 0; y < jpeg.height; y++)
+	{
+		for (unsigned int iComponent = 0; iComponent < componentCount; iComponent++)
+			rows[iComponent] = upsample(jpeg, jpeg.components[iComponent], y, column, upsampled[iComponent].data());
+		unsigned char *out = pixels + y * stride;
+		if (componentCount == 1)
+		{
+			std::memcpy(out, rows[0], jpeg.width);
+		}
+		else if (jpeg.rgb)
+		{
+			for (uint32_t x = 0; x < jpeg.width; x++)
+			{
+				out[x * 3 + 0] = rows[0][x];
+				out[x * 3 + 1] = rows[1][x];
+				out[x * 3 + 2] = rows[2][x];
+			}
+		}
+		else
+		{
+			convertYCbCr(rows[0], rows[1], rows[2], out, jpeg.width);
+		}
+	}
+}
+
+// Parse markers up to the frame header, or through the whole file when decoding.
+void readJpeg(const unsigned char *data, size_t size, Jpeg &jpeg, unsigned char *pixels)
+{
+	const unsigned char *p = data + 2;
+	const unsigned char *end = data + size;
+	bool frame = false;
+	bool scanned = false;
+	bool adobe = false;
+	unsigned int adobeTransform = 1;
+	jpeg.restartInterval = 0;
+	jpeg.rgb = false;
+	while (true)
+	{
+		// Fill bytes before the marker
+		while (p < end && *p != 0xFF)
+			p++;
+		while (p < end && *p == 0xFF)
+			p++;
+		if (p >= end)
+			throw std::runtime_error("Truncated JPEG");
+		const unsigned int marker = *p++;
+		if (marker == 0xD9)
+		{
+			if (!scanned)
+				throw std::runtime_error("JPEG without image data");
+			writeJpeg(jpeg, pixels);
+			return;
+		}
+		if (marker >= 0xD0 && marker <= 0xD7)
+			continue;
+		if (end - p < 2)
+			throw std::runtime_error("Truncated JPEG");
+		const unsigned int length = readBE16(p);
+		if (length < 2 || length > static_cast<size_t>(end - p))
+			throw std::runtime_error("Truncated JPEG");
+		const unsigned char *segment = p + 2;
+		const unsigned char *segmentEnd = p + length;
+		p = segmentEnd;
+		switch (marker)
+		{
+		case 0xC0: // Baseline
+		case 0xC1: { // Extended sequential
+			if (length < 8 || segment[0] != 8)
+				throw std::runtime_error("Unsupported JPEG precision");
+			jpeg.height = readBE16(segment + 1);
+			jpeg.width = readBE16(segment + 3);
+			const unsigned int count = segment[5];
+			if (jpeg.width == 0 || jpeg.height == 0)
+				throw std::runtime_error("Unsupported JPEG size");
+			if ((count != 1 && count != 3) || length < 8 + count * 3)
+				throw std::runtime_error("Unsupported JPEG components");
+			jpeg.components.resize(count);
+			jpeg.hMax = jpeg.vMax = 1;
+			for (unsigned int iComponent = 0; iComponent < count; iComponent++)
+			{
+				JpegComponent &component = jpeg.components[iComponent];
+				const unsigned char *c = segment + 6 + iComponent * 3;
+				component.id = c[0];
+				component.h = c[1] >> 4;
+				component.v = c[1] & 15;
+				component.quantization = c[2];
+				if (component.h == 0 || component.h > 4 || component.v == 0 || component.v > 4 || component.quantization > 3)
+					throw std::runtime_error("Invalid JPEG component");
+				jpeg.hMax = std::max(jpeg.hMax, component.h);
+				jpeg.vMax = std::max(jpeg.vMax, component.v);
+			}
+			jpeg.mcusX = (jpeg.width + jpeg.hMax * 8 - 1) / (jpeg.hMax * 8);
+			jpeg.mcusY = (jpeg.height + jpeg.vMax * 8 - 1) / (jpeg.vMax * 8);
+			jpeg.rgb = (count == 3) && adobe && adobeTransform == 0;
+			frame = true;
+			if (pixels == nullptr)
+				return;
+			for (JpegComponent &component : jpeg.components)
+			{
+				component.blocksX = jpeg.mcusX * component.h;
+				component.blocksY = jpeg.mcusY * component.v;
+				component.stride = component.blocksX * 8;
+				component.plane.assign(component.stride * component.blocksY * 8, 0);
+			}
+			break;
+		}
+		case 0xC2:
+		case 0xC3:
+		case 0xC5: case 0xC6: case 0xC7:
+		case 0xC9: case 0xCA: case 0xCB:
+		case 0xCD: case 0xCE: case 0xCF:
+			throw std::runtime_error("Unsupported JPEG coding, only sequential huffman is supported");
+		case 0xC4: { // DHT
+			const unsigned char *t = segment;
+			while (t < segmentEnd)
+			{
+				if (segmentEnd - t < 17)
+					throw std::runtime_error("Invalid JPEG huffman table");
+				const unsigned int tableClass = t[0] >> 4;
+				const unsigned int index = t[0] & 15;
+				if (tableClass > 1 || index > 3)
+					throw std::runtime_error("Invalid JPEG huffman table");
+				unsigned int total = 0;
+				for (unsigned int i = 0; i < 16; i++)
+					total += t[1 + i];
+				if (total > 256 || static_cast<size_t>(segmentEnd - t) < 17 + total)
+					throw std::runtime_error("Invalid JPEG huffman table");
+				(tableClass == 0 ? jpeg.dc : jpeg.ac)[index].build(t + 1, t + 17, total);
+				t += 17 + total;
+			}
+			break;
+		}
+		case 0xDB: { // DQT
+			const unsigned char *t = segment;
+			while (t < segmentEnd)
+			{
+				const unsigned int precision = t[0] >> 4;
+				const unsigned int index = t[0] & 15;
+				const size_t tableSize = 1 + 64 * (precision + 1);
+				if (precision > 1 || index > 3 || static_cast<size_t>(segmentEnd - t) < tableSize)
+					throw std::runtime_error("Invalid JPEG quantization table");
+				for (unsigned int i = 0; i < 64; i++)
+					jpeg.quantization[index][i] = precision ? readBE16(t + 1 + i * 2) : t[1 + i];
+				t += tableSize;
+			}
+			break;
+		}
+		case 0xDD: // DRI
+			if (length < 4)
+				throw std::runtime_error("Invalid JPEG restart interval");
+			jpeg.restartInterval = readBE16(segment);
+			break;
+		case 0xEE: // APP14
+			if (length >= 14 && std::memcmp(segment, "Adobe", 5) == 0)
+			{
+				adobe = true;
+				adobeTransform = segment[11];
+			}
+			break;
+		case 0xDA: { // SOS
+			if (!frame)
+				throw std::runtime_error("JPEG scan before frame");
+			const unsigned int count = segment[0];
+			if (count == 0 || count > jpeg.components.size() || length < 6 + count * 2)
+				throw std::runtime_error("Invalid JPEG scan");
+			Buffer<JpegComponent*> scan;
+			for (unsigned int iComponent = 0; iComponent < count; iComponent++)
+			{
+				const unsigned char *c = segment + 1 + iComponent * 2;
+				JpegComponent *component = nullptr;
+				for (JpegComponent &candidate : jpeg.components)
+					if (candidate.id == c[0])
+						component = &candidate;
+				if (component == nullptr || (c[1] >> 4) > 3 || (c[1] & 15) > 3)
+					throw std::runtime_error("Invalid JPEG scan");
+				component->dc = c[1] >> 4;
+				component->ac = c[1] & 15;
+				scan.push_back(component);
+			}
+			JpegBits bits;
+			bits.end = end;
+			bits.reset(segmentEnd);
+			decodeScan(jpeg, bits, scan);
+			// Next marker, after the entropy coded data.
+			p = bits.data;
+			while (p + 1 < end && !(p[0] == 0xFF && p[1] != 0 && !(p[1] >= 0xD0 && p[1] <= 0xD7)))
+				p++;
+			scanned = true;
+			break;
+		}
+		default:
+			break; // APPn, COM...
+		}
+	}
+}
+
+// --- Radiance HDR
+
+struct Hdr {
+	uint32_t width, height;
+	const unsigned char *data; // First scanline
+};
+
+void parseHdr(const unsigned char *data, size_t size, Hdr &hdr)
+{
+	const char *p = reinterpret_cast<const char*>(data);
+	const char *end = p + size;
+	auto line = [&]() {
+		const char *start = p;
+		while (p < end && *p != '\n')
+			p++;
+		if (p >= end)
+			throw std::runtime_error("Truncated HDR header");
+		return std::string(start, p++);
+	};
+	line(); // Magic
+	while (true)
+	{
+		const std::string str = line();
+		if (str.empty())
+			break;
+		if (str.compare(0, 7, "FORMAT=") == 0 && str != "FORMAT=32-bit_rle_rgbe")
+			throw std::runtime_error("Unsupported HDR format " + str);
+	}
+	const std::string resolution = line();
+	unsigned int width = 0, height = 0;
+	char yAxis[3] = {}, xAxis[3] = {};
+	if (std::sscanf(resolution.c_str(), "%2s %u %2s %u", yAxis, &height, xAxis, &width) != 4 ||
+		std::strcmp(yAxis, "-Y") != 0 || std::strcmp(xAxis, "+X") != 0)
+		throw std::runtime_error("Unsupported HDR orientation");
+	if (width == 0 || height == 0 || width > (1U << 24) || height > (1U << 24))
+		throw std::runtime_error("Invalid HDR size");
+	hdr.width = width;
+	hdr.height = height;
+	hdr.data = reinterpret_cast<const unsigned char*>(p);
+}
+
+// Shared exponent to RGB, the mantissas are scaled by 2^(e - 136).
+void convertRGBE(const unsigned char *rgbe, float *out, uint32_t width)
+{
+	static const struct Scales {
+		float values[256];
+		Scales() { values[0] = 0.f; for (int e = 1; e < 256; e++) values[e] = std::ldexp(1.f, e - 136); }
+	} scales;
+	uint32_t x = 0;
+#if defined(IMAGE_SSE2)
+	// A pixel at a time, the 4th lane is overwritten by the next pixel.
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 1 < width; x++)
+	{
+		uint32_t value;
+		std::memcpy(&value, rgbe + x * 4, 4);
+		const __m128i pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(value)), zero), zero);
+		const __m128 color = _mm_mul_ps(_mm_cvtepi32_ps(pixel), _mm_set1_ps(scales.values[rgbe[x * 4 + 3]]));
+		_mm_storeu_ps(out + x * 3, color);
+	}
+#endif
+	for (; x < width; x++)
+	{
+		const float scale = scales.values[rgbe[x * 4 + 3]];
+		out[x * 3 + 0] = rgbe[x * 4 + 0] * scale;
+		out[x * 3 + 1] = rgbe[x * 4 + 1] * scale;
+		out[x * 3 + 2] = rgbe[x * 4 + 2] * scale;
+	}
+}
+
+void decodeHdr(const unsigned char *data, size_t size, float *pixels)
+{
+	Hdr hdr;
+	parseHdr(data, size, hdr);
+	const unsigned char *p = hdr.data;
+	const unsigned char *end = data + size;
+	const uint32_t width = hdr.width;
+	Buffer<unsigned char> rgbe(static_cast<size_t>(width) * 4);
+	for (uint32_t y = 0; y < hdr.height; y++)
+	{
+		const bool rle = width >= 8 && width < 32768 && end - p >= 4 && p[0] == 2 && p[1] == 2 && ((p[2] << 8) | p[3]) == static_cast<int>(width);
+		if (!rle)
+		{
+			// Flat scanline
+			if (static_cast<size_t>(end - p) < rgbe.size())
+				throw std::runtime_error("Truncated HDR");
+			std::memcpy(rgbe.data(), p, rgbe.size());
+			p += rgbe.size();
+		}
+		else
+		{
+			// Channels are run length encoded one after the other.
+			p += 4;
+			for (unsigned int channel = 0; channel < 4; channel++)
+			{
+				uint32_t x = 0;
+				while (x < width)
+				{
+					if (p >= end)
+						throw std::runtime_error("Truncated HDR");
+					unsigned int count = *p++;
+					if (count > 128)
+					{
+						count -= 128;
+						if (count > width - x || p >= end)
+							throw std::runtime_error("Invalid HDR run");
+						const unsigned char value = *p++;
+						for (unsigned int i = 0; i < count; i++)
+							rgbe[(x++) * 4 + channel] = value;
+					}
+					else
+					{
+						if (count == 0 || count > width - x || static_cast<size_t>(end - p) < count)
+							throw std::runtime_error("Invalid HDR run");
+						for (unsigned int i = 0; i < count; i++)
+							rgbe[(x++) * 4 + channel] = *p++;
+					}
+				}
+			}
+		}
+		convertRGBE(rgbe.data(), pixels + static_cast<size_t>(y) * width * 3, width);
+	}
+}
+
+Image::Format detect(const unsigned char *data, size_t size)
+{
+	if (size >= 8 && std::memcmp(data, pngSignature, 8) == 0)
+		return Image::Format::PNG;
+	if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF)
+		return Image::Format::JPEG;
+	if ((size >= 10 && std::memcmp(data, "#?RADIANCE", 10) == 0) || (size >= 6 && std::memcmp(data, "#?RGBE", 6) == 0))
+		return Image::Format::HDR;
+	return Image::Format::UNKNOWN;
+}
+
+}
+
+Image::Info Image::info(const unsigned char *data, size_t size)
+{
+	Info info;
+	info.format = detect(data, size);
+	switch (info.format)
+	{
+	case Format::PNG: {
+		Png png;
+		parsePng(data, size, png);
+		info.width = png.width;
+		info.height = png.height;
+		info.components = png.components;
+		break;
+	}
+	case Format::JPEG: {
+		Jpeg jpeg;
+		readJpeg(data, size, jpeg, nullptr);
+		info.width = jpeg.width;
+		info.height = jpeg.height;
+		info.components = static_cast<unsigned int>(jpeg.components.size());
+		break;
+	}
+	case Format::HDR: {
+		Hdr hdr;
+		parseHdr(data, size, hdr);
+		info.width = hdr.width;
+		info.height = hdr.height;
+		info.components = 3;
+		break;
+	}
+	default:
+		throw std::runtime_error("Unknown image format");
+	}
+	return info;
+}
+
+void Image::decode(const unsigned char *data, size_t size, void *pixels)
+{
+	switch (detect(data, size))
+	{
+	case Format::PNG:
+		decodePng(data, size, static_cast<unsigned char*>(pixels));
+		break;
+	case Format::JPEG: {
+		Jpeg jpeg;
+		readJpeg(data, size, jpeg, static_cast<unsigned char*>(pixels));
+		break;
+	}
+	case Format::HDR:
+		decodeHdr(data, size, static_cast<float*>(pixels));
+		break;
+	default:
+		throw std::runtime_error("Unknown image format");
+	}
+}
+
+Image Image::load(const unsigned char *data, size_t size)
+{
+	const Info info = Image::info(data, size);
+	Image image;
+	image.width = info.width;
+	image.height = info.height;
+	image.components = info.components;
+	if (info.isHDR())
+	{
+		image.pixelsHDR.resize(static_cast<size_t>(info.width) * info.height * info.components);
+		decode(data, size, image.pixelsHDR.data());
+	}
+	else
+	{
+		image.pixels.resize(info.size());
+		decode(data, size, image.pixels.data());
+	}
+	return image;
+}
+
 Image Image::load(const char * path)
 {
-	return Image();
+	MappedFile file(path);
+	if (!file.isOpen())
+		throw std::runtime_error("Could not open " + std::string(path));
+	return load(file.data(), file.size());
 }
 
+Buffer<Image> Image::load(job::Scheduler &scheduler, const std::vector<std::string> &paths)
+{
+	Buffer<Image> images(paths.size());
+	std::vector<job::Handle> jobs;
+	jobs.reserve(paths.size());
+	for (size_t iPath = 0; iPath < paths.size(); iPath++)
+		jobs.push_back(scheduler.add([&images, &paths, iPath]() { images[iPath] = load(paths[iPath].c_str()); }));
+	// Every job references the images, wait for all of them before reporting an error.
+	std::exception_ptr error;
+	for (const job::Handle &job : jobs)
+	{
+		try
+		{
+			scheduler.wait(job);
+		}
+		catch (...)
+		{
+			if (!error)
+				error = std::current_exception();
+		}
+	}
+	if (error)
+		std::rethrow_exception(error);
+	return images;
 }
+
+void benchmarkDecode(const std::vector<std::string> &paths, unsigned int iterations, double &serial, double &parallel)
+{
+	Buffer<MappedFile> files;
+	double pixels = 0.0;
+	size_t largest = 0;
+	for (const std::string &path : paths)
+	{
+		files.emplace_back(path.c_str());
+		if (!files.back().isOpen())
+			throw std::runtime_error("Could not open " + path);
+		const Image::Info info = Image::info(files.back().data(), files.back().size());
+		pixels += static_cast<double>(info.width) * info.height;
+		largest = std::max(largest, info.size());
+	}
+	// Same destination for every image, as a staging buffer would be.
+	Buffer<unsigned char> staging(largest);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int iteration = 0; iteration < iterations; iteration++)
+		for (const MappedFile &file : files)
+			Image::decode(file.data(), file.size(), staging.data());
+	auto end = std::chrono::high_resolution_clock::now();
+	serial = pixels * iterations / 1e6 / std::chrono::duration<double>(end - start).count();
+
+	job::Scheduler scheduler;
+	std::vector<std::string> batch;
+	for (unsigned int iteration = 0; iteration < iterations; iteration++)
+		batch.insert(batch.end(), paths.begin(), paths.end());
+	start = std::chrono::high_resolution_clock::now();
+	Image::load(scheduler, batch);
+	end = std::chrono::high_resolution_clock::now();
+	parallel = pixels * iterations / 1e6 / std::chrono::duration<double>(end - start).count();
 }
 
+}
+}
@@ -1,15 +1,59 @@
 #pragma once
 
+#include "Buffer.h"
+
+#include <string>
+#include <vector>
+
 namespace engine {
 
+namespace job {
+class Scheduler;
+}
+
 namespace io {
 
+// Decoded image, rows top to bottom with interleaved components.
+// PNG & JPEG are decoded to 8 bits per component, Radiance HDR to float RGB.
 struct Image {
+	enum class Format {
+		UNKNOWN,
+		PNG,
+		JPEG,
+		HDR
+	};
+
+	struct Info {
+		Format format;
+		unsigned int width, height, components;
+
+		bool isHDR() const { return format == Format::HDR; }
+		// Bytes written by decode.
+		size_t size() const { return static_cast<size_t>(width) * height * components * (isHDR() ? sizeof(float) : 1); }
+	};
 
+	Buffer<unsigned char> pixels;
+	Buffer<float> pixelsHDR;
+	unsigned int width = 0, height = 0, components = 0;
+
+	bool isHDR() const { return !pixelsHDR.empty(); }
+
+	// Throw std::runtime_error on invalid or unsupported files.
 	static Image load(const char* path);
+	static Image load(const unsigned char *data, size_t size);
+	// Decode the files concurrently, a job per image.
+	static Buffer<Image> load(job::Scheduler &scheduler, const std::vector<std::string> &paths);
+
+	// Read the header only.
+	static Info info(const unsigned char *data, size_t size);
+	// Decode into memory of info().size() bytes, such as a mapped staging buffer, to avoid a copy.
+	static void decode(const unsigned char *data, size_t size, void *pixels);
 };
 
-}
+// Decode the files repeatedly, one after the other into a reused buffer then concurrently,
+// and return both throughputs in megapixels per second.
+void benchmarkDecode(const std::vector<std::string> &paths, unsigned int iterations, double &serial, double &parallel);
 
 }
 
+}
@@ -0,0 +1,189 @@
+#include "JobSystem.h"
+
+namespace engine {
+namespace job {
+
+Scheduler::Scheduler(unsigned int threadCount) :
+	m_active(0),
+	m_stop(false)
+{
+	if (threadCount == 0)
+	{
+		const unsigned int cores = std::thread::hardware_concurrency();
+		threadCount = (cores > 1) ? cores - 1 : 1;
+	}
+	m_threads.reserve(threadCount);
+	for (unsigned int iThread = 0; iThread < threadCount; iThread++)
+		m_threads.emplace_back(&Scheduler::loop, this);
+}
+
+Scheduler::~Scheduler()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [this]() { return m_active == 0; });
+		m_stop = true;
+	}
+	m_work.notify_all();
+	for (std::thread &thread : m_threads)
+		thread.join();
+}
+
+Handle Scheduler::add(std::function<void()> function)
+{
+	return add(std::move(function), std::vector<Handle>());
+}
+
+Handle Scheduler::add(std::function<void()> function, const std::vector<Handle> &dependencies)
+{
+	Handle job = std::make_shared<Job>();
+	job->function = std::move(function);
+	// Hold the job until every dependency is registered.
+	job->pending = 1;
+	job->done = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_active++;
+	}
+	for (const Handle &dependency : dependencies)
+	{
+		if (dependency == nullptr)
+			continue;
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (!dependency->done)
+		{
+			job->pending++;
+			dependency->dependents.push_back(job);
+		}
+		else if (dependency->error && !job->error)
+		{
+			job->error = dependency->error;
+		}
+	}
+	release(job);
+	return job;
+}
+
+bool Scheduler::isDone(const Handle &handle)
+{
+	return handle == nullptr || handle->done;
+}
+
+void Scheduler::wait(const Handle &handle)
+{
+	while (!isDone(handle))
+	{
+		if (runOne())
+			continue;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_finished.wait(lock, [&]() { return isDone(handle) || !m_queue.empty(); });
+	}
+	std::lock_guard<std::mutex> lock(handle->mutex);
+	if (handle->error)
+		std::rethrow_exception(handle->error);
+}
+
+void Scheduler::waitAll()
+{
+	while (true)
+	{
+		if (runOne())
+			continue;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_active == 0)
+			return;
+		m_finished.wait(lock, [this]() { return m_active == 0 || !m_queue.empty(); });
+	}
+}
+
+void Scheduler::loop()
+{
+	while (true)
+	{
+		Handle job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_work.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+			if (m_queue.empty())
+				return; // Stopping
+			job = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+		execute(job);
+	}
+}
+
+void Scheduler::release(const Handle &job)
+{
+	if (--job->pending != 0)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(job);
+	}
+	m_work.notify_one();
+	// Waiting threads help running jobs.
+	m_finished.notify_all();
+}
+
+void Scheduler::execute(const Handle &job)
+{
+	bool failed;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		failed = (job->error != nullptr);
+	}
+	if (!failed)
+	{
+		try
+		{
+			job->function();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->error = std::current_exception();
+		}
+	}
+	job->function = nullptr; // Release captures
+	std::vector<Handle> dependents;
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->done = true;
+		dependents.swap(job->dependents);
+		error = job->error;
+	}
+	for (const Handle &dependent : dependents)
+	{
+		if (error)
+		{
+			std::lock_guard<std::mutex> lock(dependent->mutex);
+			if (!dependent->error)
+				dependent->error = error;
+		}
+		release(dependent);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_active--;
+	}
+	m_finished.notify_all();
+}
+
+bool Scheduler::runOne()
+{
+	Handle job;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_queue.empty())
+			return false;
+		job = std::move(m_queue.front());
+		m_queue.pop_front();
+	}
+	execute(job);
+	return true;
+}
+
+}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine {
+namespace job {
+
+struct Job;
+
+// Handle on a scheduled job, shared by the scheduler & its dependents.
+using Handle = std::shared_ptr<Job>;
+
+struct Job {
+	std::function<void()> function;
+	std::mutex mutex;				// Protect dependents & error
+	std::vector<Handle> dependents;	// Released when this job is done
+	std::atomic<unsigned int> pending;	// Dependencies not done yet
+	std::atomic<bool> done;
+	std::exception_ptr error;		// Thrown by the job or one of its dependencies
+};
+
+// Thread pool running jobs once all their dependencies are done.
+// A job whose dependency failed is not run and carries the error of the dependency.
+class Scheduler {
+public:
+	// Default to a worker per core, minus the calling thread which helps while waiting.
+	explicit Scheduler(unsigned int threadCount = 0);
+	Scheduler(const Scheduler &) = delete;
+	Scheduler &operator=(const Scheduler &) = delete;
+	// Wait for every job.
+	~Scheduler();
+
+	// Jobs can be added from any thread, including from other jobs.
+	Handle add(std::function<void()> function);
+	Handle add(std::function<void()> function, const std::vector<Handle> &dependencies);
+
+	static bool isDone(const Handle &handle);
+	// Run queued jobs until the job is done, then rethrow its error if any.
+	void wait(const Handle &handle);
+	// Run queued jobs until every job is done.
+	void waitAll();
+
+	unsigned int threadCount() const { return static_cast<unsigned int>(m_threads.size()); }
+private:
+	void loop();
+	void release(const Handle &job);
+	void execute(const Handle &job);
+	bool runOne();
+private:
+	std::vector<std::thread> m_threads;
+	std::deque<Handle> m_queue;
+	std::mutex m_mutex;
+	std::condition_variable m_work;		// Job queued or stopping
+	std::condition_variable m_finished;	// Job done
+	size_t m_active;	// Added and not done
+	bool m_stop;
+};
+
+}
+}
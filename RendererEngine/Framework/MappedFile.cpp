@@ -0,0 +1,141 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine {
+namespace io {
+
+MappedFile::MappedFile() :
+	m_data(nullptr),
+	m_size(0),
+#if defined(_WIN32)
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr)
+#else
+	m_file(-1)
+#endif
+{
+}
+
+MappedFile::MappedFile(const char *path) :
+	MappedFile()
+{
+	open(path);
+}
+
+MappedFile::MappedFile(MappedFile &&file) :
+	m_data(file.m_data),
+	m_size(file.m_size),
+	m_file(file.m_file)
+#if defined(_WIN32)
+	, m_mapping(file.m_mapping)
+#endif
+{
+	file.m_data = nullptr;
+	file.m_size = 0;
+#if defined(_WIN32)
+	file.m_file = INVALID_HANDLE_VALUE;
+	file.m_mapping = nullptr;
+#else
+	file.m_file = -1;
+#endif
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&file)
+{
+	if (this != &file)
+	{
+		close();
+		std::swap(m_data, file.m_data);
+		std::swap(m_size, file.m_size);
+		std::swap(m_file, file.m_file);
+#if defined(_WIN32)
+		std::swap(m_mapping, file.m_mapping);
+#endif
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char *path)
+{
+	close();
+#if defined(_WIN32)
+	m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr)
+	{
+		close();
+		return false;
+	}
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	m_file = ::open(path, O_RDONLY);
+	if (m_file < 0)
+		return false;
+	struct stat info;
+	if (fstat(m_file, &info) != 0 || info.st_size == 0)
+	{
+		close();
+		return false;
+	}
+	void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	m_data = (data == MAP_FAILED) ? nullptr : static_cast<const unsigned char*>(data);
+	m_size = static_cast<size_t>(info.st_size);
+#endif
+	if (m_data == nullptr)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = nullptr;
+#else
+	if (m_data != nullptr)
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	if (m_file >= 0)
+		::close(m_file);
+	m_file = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+}
+}
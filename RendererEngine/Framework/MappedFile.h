@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <string_view>
+
+namespace engine {
+namespace io {
+
+// Read only memory mapped file.
+// Pages are loaded by the OS on access, so huge files do not need to fit in memory.
+struct MappedFile
+{
+	MappedFile();
+	MappedFile(const char *path);
+	MappedFile(const MappedFile &) = delete;
+	MappedFile(MappedFile &&file);
+	MappedFile &operator=(const MappedFile &) = delete;
+	MappedFile &operator=(MappedFile &&file);
+	~MappedFile();
+
+	// Return false if the file could not be mapped.
+	bool open(const char *path);
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+	const unsigned char *data() const { return m_data; }
+	size_t size() const { return m_size; }
+	std::string_view string() const { return std::string_view(reinterpret_cast<const char*>(m_data), m_size); }
+private:
+	const unsigned char *m_data;
+	size_t m_size;
+#if defined(_WIN32)
+	void *m_file;
+	void *m_mapping;
+#else
+	int m_file;
+#endif
+};
+
+}
+}
@@ -2,6 +2,9 @@
 
 #include "Buffer.h"
 #include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
 
 namespace engine {
 namespace io {
@@ -16,8 +19,14 @@ struct BinaryReader
 	template <typename T>
 	void read(T* data, size_t size);
 
+	// Move the read position, relative to the beginning of the bytes.
+	void seek(size_t offset);
+	void skip(size_t size);
+
 	const unsigned char * data() const;
 	size_t size() const;
+	size_t offset() const;
+	size_t remaining() const;
 private:
 	const unsigned char * m_bytes;
 	const size_t m_size;
@@ -46,11 +55,40 @@ inline T BinaryReader::read() {
 
 template <typename T>
 inline void BinaryReader::read(T* data, size_t size) {
+	static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be read");
 	size_t realSize = size * sizeof(T);
-	if (realSize + offset > bytes.size())
-		throw std::out_of_range();
-	memcpy(data, &bytes[offset], realSize);
+	if (realSize > m_size - m_offset)
+		throw std::out_of_range("Read out of bounds");
+	// Bytes are not aligned for T
+	memcpy(data, m_bytes + m_offset, realSize);
+	m_offset += realSize;
+}
+
+inline void BinaryReader::seek(size_t offset) {
+	if (offset > m_size)
+		throw std::out_of_range("Seek out of bounds");
+	m_offset = offset;
+}
+
+inline void BinaryReader::skip(size_t size) {
+	seek(m_offset + size);
+}
+
+inline const unsigned char * BinaryReader::data() const {
+	return m_bytes;
 }
 
+inline size_t BinaryReader::size() const {
+	return m_size;
+}
+
+inline size_t BinaryReader::offset() const {
+	return m_offset;
+}
+
+inline size_t BinaryReader::remaining() const {
+	return m_size - m_offset;
+}
+
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,963 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vk {
+
+namespace {
+
+constexpr uint32_t invalidIndex = ~0U;
+constexpr VkAccessFlags writeAccesses = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+// Usual alignment of optimal tiling images.
+constexpr VkDeviceSize estimatedAlignment = 64 * 1024;
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool imageUsage(RenderGraph::Usage usage)
+{
+	switch (usage)
+	{
+	case RenderGraph::Usage::SAMPLED:
+	case RenderGraph::Usage::STORAGE_IMAGE_READ:
+	case RenderGraph::Usage::STORAGE_IMAGE_WRITE:
+	case RenderGraph::Usage::STORAGE_IMAGE_READ_WRITE:
+	case RenderGraph::Usage::COLOR_ATTACHMENT:
+	case RenderGraph::Usage::DEPTH_ATTACHMENT:
+	case RenderGraph::Usage::DEPTH_ATTACHMENT_READ:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool bufferUsage(RenderGraph::Usage usage)
+{
+	return !imageUsage(usage);
+}
+
+VkImageUsageFlags imageUsageFlags(RenderGraph::Usage usage)
+{
+	switch (usage)
+	{
+	case RenderGraph::Usage::SAMPLED:
+		return VK_IMAGE_USAGE_SAMPLED_BIT;
+	case RenderGraph::Usage::STORAGE_IMAGE_READ:
+	case RenderGraph::Usage::STORAGE_IMAGE_WRITE:
+	case RenderGraph::Usage::STORAGE_IMAGE_READ_WRITE:
+		return VK_IMAGE_USAGE_STORAGE_BIT;
+	case RenderGraph::Usage::COLOR_ATTACHMENT:
+		return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	case RenderGraph::Usage::DEPTH_ATTACHMENT:
+	case RenderGraph::Usage::DEPTH_ATTACHMENT_READ:
+		return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	case RenderGraph::Usage::TRANSFER_SRC:
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	case RenderGraph::Usage::TRANSFER_DST:
+		return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	default:
+		return 0;
+	}
+}
+
+VkDeviceSize texelSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_UINT:
+	case VK_FORMAT_S8_UINT:
+		return 1;
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R16_SFLOAT:
+	case VK_FORMAT_R16_UINT:
+	case VK_FORMAT_D16_UNORM:
+		return 2;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R16G16B16A16_UNORM:
+	case VK_FORMAT_R32G32_SFLOAT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return 8;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+	case VK_FORMAT_R32G32B32A32_UINT:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+bool overlap(uint32_t first0, uint32_t last0, uint32_t first1, uint32_t last1)
+{
+	return first0 <= last1 && first1 <= last0;
+}
+
+const char *layoutName(VkImageLayout layout)
+{
+	switch (layout)
+	{
+	case VK_IMAGE_LAYOUT_UNDEFINED: return "UNDEFINED";
+	case VK_IMAGE_LAYOUT_GENERAL: return "GENERAL";
+	case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "COLOR_ATTACHMENT";
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "DEPTH_STENCIL_ATTACHMENT";
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL: return "DEPTH_STENCIL_READ_ONLY";
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "SHADER_READ_ONLY";
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "TRANSFER_SRC";
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return "TRANSFER_DST";
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "PRESENT_SRC";
+	default: return "OTHER";
+	}
+}
+
+}
+
+RenderGraph::RenderGraph() :
+	m_queueFamilies{ 0, 0, 0 },
+	m_compiled(false),
+	m_final{},
+	m_statistics{}
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+}
+
+void RenderGraph::setQueueFamilies(uint32_t graphics, uint32_t compute, uint32_t transfer)
+{
+	m_queueFamilies[static_cast<uint32_t>(Queue::GRAPHICS)] = graphics;
+	m_queueFamilies[static_cast<uint32_t>(Queue::COMPUTE)] = compute;
+	m_queueFamilies[static_cast<uint32_t>(Queue::TRANSFER)] = transfer;
+	m_compiled = false;
+}
+
+RenderGraph::Resource RenderGraph::createImage(const std::string &name, const ImageDesc &desc)
+{
+	ResourceData resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.desc = desc;
+	resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.block = invalidIndex;
+	m_resources.push_back(resource);
+	m_compiled = false;
+	return Resource(static_cast<uint32_t>(m_resources.size() - 1));
+}
+
+RenderGraph::Resource RenderGraph::importImage(const std::string &name, const ImageDesc &desc, VkImageLayout initialLayout, VkPipelineStageFlags initialStages, VkImageLayout finalLayout, bool output)
+{
+	ResourceData resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.output = output;
+	resource.desc = desc;
+	resource.initialLayout = initialLayout;
+	resource.initialStages = initialStages;
+	resource.finalLayout = finalLayout;
+	resource.block = invalidIndex;
+	m_resources.push_back(resource);
+	m_compiled = false;
+	return Resource(static_cast<uint32_t>(m_resources.size() - 1));
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const std::string &name, VkDeviceSize size, bool output)
+{
+	ResourceData resource{};
+	resource.name = name;
+	resource.imported = true;
+	resource.output = output;
+	resource.size = size;
+	resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.block = invalidIndex;
+	m_resources.push_back(resource);
+	m_compiled = false;
+	return Resource(static_cast<uint32_t>(m_resources.size() - 1));
+}
+
+uint32_t RenderGraph::addPass(const std::string &name, PassType type, Queue queue, Execute execute, bool sideEffect)
+{
+	Pass pass{};
+	pass.name = name;
+	pass.type = type;
+	pass.queue = queue;
+	pass.execute = execute;
+	pass.sideEffect = sideEffect;
+	m_passes.push_back(pass);
+	m_compiled = false;
+	return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void RenderGraph::use(uint32_t pass, Resource resource, Usage usage)
+{
+	if (pass >= m_passes.size() || !resource.valid() || resource() >= m_resources.size())
+		throw std::runtime_error("Invalid pass or resource");
+	ResourceData &data = m_resources[resource()];
+	if (data.isImage ? !imageUsage(usage) && usage != Usage::TRANSFER_SRC && usage != Usage::TRANSFER_DST : !bufferUsage(usage))
+		throw std::runtime_error("Usage does not match the resource '" + data.name + "'");
+	Use use;
+	use.resource = resource();
+	usageState(usage, m_passes[pass].type, use.layout, use.stages, use.access, use.write);
+	if (!data.isImage)
+		use.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// A pass uses a resource once, with every stage & access of its usages.
+	std::vector<Use> &uses = m_passes[pass].uses;
+	auto it = std::find_if(uses.begin(), uses.end(), [&](const Use &u) { return u.resource == use.resource; });
+	if (it == uses.end())
+		uses.push_back(use);
+	else if (it->layout != use.layout)
+		throw std::runtime_error("Pass '" + m_passes[pass].name + "' uses '" + data.name + "' in two layouts");
+	else
+	{
+		it->stages |= use.stages;
+		it->access |= use.access;
+		it->write |= use.write;
+	}
+	data.usage |= imageUsageFlags(usage);
+	m_compiled = false;
+}
+
+void RenderGraph::usageState(Usage usage, PassType type, VkImageLayout &layout, VkPipelineStageFlags &stages, VkAccessFlags &access, bool &write)
+{
+	VkPipelineStageFlags shaderStages = 0;
+	switch (type)
+	{
+	case PassType::GRAPHICS:
+		shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		break;
+	case PassType::COMPUTE:
+		shaderStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		break;
+	case PassType::TRANSFER:
+		if (usage != Usage::TRANSFER_SRC && usage != Usage::TRANSFER_DST)
+			throw std::runtime_error("Transfer passes only copy");
+		break;
+	}
+	layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	stages = 0;
+	access = 0;
+	write = false;
+	switch (usage)
+	{
+	case Usage::SAMPLED:
+		layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		stages = shaderStages;
+		access = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case Usage::STORAGE_IMAGE_READ:
+		layout = VK_IMAGE_LAYOUT_GENERAL;
+		stages = shaderStages;
+		access = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case Usage::STORAGE_IMAGE_WRITE:
+		layout = VK_IMAGE_LAYOUT_GENERAL;
+		stages = shaderStages;
+		access = VK_ACCESS_SHADER_WRITE_BIT;
+		write = true;
+		break;
+	case Usage::STORAGE_IMAGE_READ_WRITE:
+		layout = VK_IMAGE_LAYOUT_GENERAL;
+		stages = shaderStages;
+		access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		write = true;
+		break;
+	case Usage::COLOR_ATTACHMENT:
+		layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		write = true;
+		break;
+	case Usage::DEPTH_ATTACHMENT:
+		layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		write = true;
+		break;
+	case Usage::DEPTH_ATTACHMENT_READ:
+		layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		break;
+	case Usage::UNIFORM_BUFFER:
+		stages = shaderStages;
+		access = VK_ACCESS_UNIFORM_READ_BIT;
+		break;
+	case Usage::STORAGE_BUFFER_READ:
+		stages = shaderStages;
+		access = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case Usage::STORAGE_BUFFER_WRITE:
+		stages = shaderStages;
+		access = VK_ACCESS_SHADER_WRITE_BIT;
+		write = true;
+		break;
+	case Usage::STORAGE_BUFFER_READ_WRITE:
+		stages = shaderStages;
+		access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		write = true;
+		break;
+	case Usage::INDIRECT_BUFFER:
+		stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+		access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		break;
+	case Usage::VERTEX_BUFFER:
+		stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		break;
+	case Usage::INDEX_BUFFER:
+		stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		access = VK_ACCESS_INDEX_READ_BIT;
+		break;
+	case Usage::TRANSFER_SRC:
+		layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access = VK_ACCESS_TRANSFER_READ_BIT;
+		break;
+	case Usage::TRANSFER_DST:
+		layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		write = true;
+		break;
+	}
+}
+
+VkMemoryRequirements RenderGraph::estimateRequirements(const ImageDesc &desc)
+{
+	VkDeviceSize size = 0;
+	for (uint32_t iLevel = 0; iLevel < std::max(desc.mipLevels, 1U); iLevel++)
+		size += std::max(desc.width >> iLevel, 1U) * static_cast<VkDeviceSize>(std::max(desc.height >> iLevel, 1U)) * texelSize(desc.format);
+	VkMemoryRequirements requirements;
+	requirements.size = (size + estimatedAlignment - 1) / estimatedAlignment * estimatedAlignment;
+	requirements.alignment = estimatedAlignment;
+	requirements.memoryTypeBits = ~0U;
+	return requirements;
+}
+
+uint32_t RenderGraph::queueFamily(Queue queue) const
+{
+	return m_queueFamilies[static_cast<uint32_t>(queue)];
+}
+
+void RenderGraph::compile()
+{
+	cull();
+	computeLifetimes();
+	for (ResourceData &resource : m_resources)
+		if (resource.isImage && !resource.imported && resource.image == VK_NULL_HANDLE)
+			resource.requirements = estimateRequirements(resource.desc);
+	plan();
+}
+
+void RenderGraph::plan()
+{
+	aliasMemory();
+	computeSegments();
+	computeBarriers();
+	computeStatistics();
+	m_compiled = true;
+}
+
+// Reference counting from the outputs: a pass is culled when nothing reads what it writes.
+// A pass reading what it writes is not a reader of it, it would keep itself alive.
+void RenderGraph::cull()
+{
+	std::vector<uint32_t> passReferences(m_passes.size(), 0);
+	std::vector<uint32_t> resourceReferences(m_resources.size(), 0);
+	std::vector<std::vector<uint32_t>> writers(m_resources.size());
+	for (uint32_t iPass = 0; iPass < m_passes.size(); iPass++)
+	{
+		m_passes[iPass].culled = false;
+		for (const Use &use : m_passes[iPass].uses)
+		{
+			if (use.write)
+			{
+				passReferences[iPass]++;
+				writers[use.resource].push_back(iPass);
+			}
+			else
+				resourceReferences[use.resource]++;
+		}
+	}
+	std::vector<uint32_t> unreferenced;
+	for (uint32_t iResource = 0; iResource < m_resources.size(); iResource++)
+	{
+		if (m_resources[iResource].output)
+			resourceReferences[iResource]++;
+		if (resourceReferences[iResource] == 0)
+			unreferenced.push_back(iResource);
+	}
+	std::vector<uint32_t> culled;
+	auto release = [&](uint32_t iPass) {
+		Pass &pass = m_passes[iPass];
+		if (pass.sideEffect || pass.culled)
+			return;
+		pass.culled = true;
+		for (const Use &use : pass.uses)
+			if (!use.write && --resourceReferences[use.resource] == 0)
+				unreferenced.push_back(use.resource);
+	};
+	for (uint32_t iPass = 0; iPass < m_passes.size(); iPass++)
+		if (passReferences[iPass] == 0)
+			release(iPass);
+	while (!unreferenced.empty())
+	{
+		const uint32_t iResource = unreferenced.back();
+		unreferenced.pop_back();
+		for (uint32_t iPass : writers[iResource])
+			if (--passReferences[iPass] == 0)
+				release(iPass);
+	}
+}
+
+void RenderGraph::computeLifetimes()
+{
+	for (ResourceData &resource : m_resources)
+	{
+		resource.firstPass = invalidIndex;
+		resource.lastPass = invalidIndex;
+		resource.queueFamily = invalidIndex;
+	}
+	for (uint32_t iPass = 0; iPass < m_passes.size(); iPass++)
+	{
+		const Pass &pass = m_passes[iPass];
+		if (pass.culled)
+			continue;
+		const uint32_t family = queueFamily(pass.queue);
+		for (const Use &use : pass.uses)
+		{
+			ResourceData &resource = m_resources[use.resource];
+			if (resource.firstPass == invalidIndex)
+			{
+				resource.firstPass = iPass;
+				resource.queueFamily = family;
+			}
+			else if (resource.queueFamily != family)
+				resource.queueFamily = invalidIndex;
+			resource.lastPass = iPass;
+		}
+	}
+}
+
+// Greedy, largest first: an image goes in the first block whose images are all dead before it
+// starts or after it ends. Queues run in parallel, so only images of a single queue family alias,
+// their order in the passes is then their order on the GPU.
+void RenderGraph::aliasMemory()
+{
+	m_blocks.clear();
+	std::vector<uint32_t> transients;
+	for (uint32_t iResource = 0; iResource < m_resources.size(); iResource++)
+	{
+		ResourceData &resource = m_resources[iResource];
+		resource.block = invalidIndex;
+		if (resource.isImage && !resource.imported && resource.firstPass != invalidIndex)
+			transients.push_back(iResource);
+	}
+	std::stable_sort(transients.begin(), transients.end(), [&](uint32_t lhs, uint32_t rhs) {
+		return m_resources[lhs].requirements.size > m_resources[rhs].requirements.size;
+	});
+	for (uint32_t iResource : transients)
+	{
+		ResourceData &resource = m_resources[iResource];
+		const bool aliasable = resource.queueFamily != invalidIndex;
+		for (uint32_t iBlock = 0; iBlock < m_blocks.size() && aliasable && resource.block == invalidIndex; iBlock++)
+		{
+			MemoryBlock &block = m_blocks[iBlock];
+			if ((block.memoryTypeBits & resource.requirements.memoryTypeBits) == 0)
+				continue;
+			bool fits = true;
+			for (uint32_t iOther : block.resources)
+			{
+				const ResourceData &other = m_resources[iOther];
+				if (other.queueFamily != resource.queueFamily || overlap(resource.firstPass, resource.lastPass, other.firstPass, other.lastPass))
+				{
+					fits = false;
+					break;
+				}
+			}
+			if (!fits)
+				continue;
+			block.size = std::max(block.size, resource.requirements.size);
+			block.alignment = std::max(block.alignment, resource.requirements.alignment);
+			block.memoryTypeBits &= resource.requirements.memoryTypeBits;
+			block.resources.push_back(iResource);
+			resource.block = iBlock;
+		}
+		if (resource.block == invalidIndex)
+		{
+			MemoryBlock block{};
+			block.size = resource.requirements.size;
+			block.alignment = resource.requirements.alignment;
+			block.memoryTypeBits = resource.requirements.memoryTypeBits;
+			block.resources.push_back(iResource);
+			resource.block = static_cast<uint32_t>(m_blocks.size());
+			m_blocks.push_back(block);
+		}
+	}
+}
+
+void RenderGraph::computeSegments()
+{
+	m_segments.clear();
+	for (uint32_t iPass = 0; iPass < m_passes.size(); iPass++)
+	{
+		Pass &pass = m_passes[iPass];
+		pass.segment = invalidIndex;
+		if (pass.culled)
+			continue;
+		if (m_segments.empty() || queueFamily(m_segments.back().queue) != queueFamily(pass.queue))
+		{
+			Segment segment;
+			segment.queue = pass.queue;
+			m_segments.push_back(segment);
+		}
+		m_segments.back().passes.push_back(iPass);
+		pass.segment = static_cast<uint32_t>(m_segments.size() - 1);
+	}
+}
+
+void RenderGraph::addBarrier(BarrierBatch &batch, uint32_t resource, const State &state, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, const Use &use, uint32_t srcFamily, uint32_t dstFamily) const
+{
+	const ResourceData &data = m_resources[resource];
+	batch.srcStages |= srcStages;
+	batch.dstStages |= use.stages;
+	const bool transfer = srcFamily != dstFamily;
+	if (data.isImage && (transfer || state.layout != use.layout))
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = transfer ? srcFamily : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = transfer ? dstFamily : VK_QUEUE_FAMILY_IGNORED;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = use.access;
+		barrier.oldLayout = state.defined ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = use.layout;
+		barrier.subresourceRange = VkImageSubresourceRange{ data.desc.aspect, 0, std::max(data.desc.mipLevels, 1U), 0, 1 };
+		batch.images.push_back(barrier);
+		batch.imageResources.push_back(resource);
+	}
+	else if (!data.isImage && transfer)
+	{
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = use.access;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		batch.buffers.push_back(barrier);
+		batch.bufferResources.push_back(resource);
+	}
+	else
+	{
+		// Same layout, same family: a global memory barrier covers it & the others of the pass.
+		batch.memory.srcAccessMask |= srcAccess;
+		batch.memory.dstAccessMask |= use.access;
+	}
+}
+
+// Walk the passes in order with the synchronization state of each resource. A use waits for:
+// - the last write, unless already visible to its stages & accesses (read after write),
+// - the reads since the last write when it writes (write after read, execution only),
+// - everything before it when its layout changes, the transition being a write.
+// The first use of an aliased image also waits for the last uses of the images before it in
+// its memory. Uses of a resource from another queue family are a release after the last pass
+// of the previous family & an acquire before the pass, the later segment waiting for the former.
+void RenderGraph::computeBarriers()
+{
+	std::vector<State> states(m_resources.size());
+	for (uint32_t iResource = 0; iResource < m_resources.size(); iResource++)
+	{
+		const ResourceData &resource = m_resources[iResource];
+		State &state = states[iResource];
+		state = State{};
+		state.layout = resource.initialLayout;
+		state.writeStages = resource.initialStages;
+		state.queueFamily = VK_QUEUE_FAMILY_IGNORED;
+		state.lastPass = invalidIndex;
+		state.defined = resource.imported && (!resource.isImage || resource.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+	m_final = BarrierBatch{};
+	m_final.memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	for (Pass &pass : m_passes)
+	{
+		pass.barriers = BarrierBatch{};
+		pass.barriers.memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		pass.releases = pass.barriers;
+	}
+	m_statistics.queueTransfers = 0;
+
+	for (uint32_t iPass = 0; iPass < m_passes.size(); iPass++)
+	{
+		Pass &pass = m_passes[iPass];
+		if (pass.culled)
+			continue;
+		const uint32_t family = queueFamily(pass.queue);
+		for (const Use &use : pass.uses)
+		{
+			const ResourceData &resource = m_resources[use.resource];
+			State &state = states[use.resource];
+			bool synchronized = false;
+			bool transferred = false;
+			if (state.defined && state.queueFamily != VK_QUEUE_FAMILY_IGNORED && state.queueFamily != family)
+			{
+				// The release makes the writes available, the acquire visible.
+				Pass &previous = m_passes[state.lastPass];
+				Use release = use;
+				release.stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+				release.access = 0;
+				addBarrier(previous.releases, use.resource, state, state.writeStages | state.readStages | state.lastStages, state.writeAccess, release, state.queueFamily, family);
+				addBarrier(pass.barriers, use.resource, state, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, use, state.queueFamily, family);
+				std::vector<uint32_t> &waits = m_segments[pass.segment].waits;
+				if (std::find(waits.begin(), waits.end(), previous.segment) == waits.end())
+					waits.push_back(previous.segment);
+				m_statistics.queueTransfers++;
+				synchronized = true;
+				transferred = true;
+			}
+			else
+			{
+				const bool layoutChange = resource.isImage && (state.layout != use.layout || !state.defined);
+				const bool pendingWrite = state.writeStages != 0;
+				const bool visible = (use.stages & ~state.visibleStages) == 0 && (use.access & ~state.visibleAccess) == 0;
+				VkPipelineStageFlags aliasStages = 0;
+				if (resource.block != invalidIndex && iPass == resource.firstPass)
+					for (uint32_t iOther : m_blocks[resource.block].resources)
+						if (m_resources[iOther].lastPass < resource.firstPass)
+							aliasStages |= states[iOther].lastStages;
+				if (layoutChange || aliasStages != 0 || (use.write && (pendingWrite || state.readStages != 0)) || (!use.write && pendingWrite && !visible))
+				{
+					VkPipelineStageFlags srcStages = state.writeStages | aliasStages;
+					if (layoutChange || use.write)
+						srcStages |= state.readStages;
+					addBarrier(pass.barriers, use.resource, state, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, state.writeAccess, use, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+					synchronized = true;
+				}
+			}
+			if (synchronized)
+			{
+				// The barrier ordered every previous use before this one.
+				if (transferred || (resource.isImage && state.layout != use.layout))
+				{
+					state.writeStages = use.stages;
+					state.writeAccess = 0;
+					state.readStages = 0;
+					state.visibleStages = use.stages;
+					state.visibleAccess = use.access;
+				}
+				else
+				{
+					// Writes made available once are made visible with no source access.
+					state.writeAccess = 0;
+					state.visibleStages |= use.stages;
+					state.visibleAccess |= use.access;
+				}
+			}
+			if (use.write)
+			{
+				state.writeStages = use.stages;
+				state.writeAccess = use.access & writeAccesses;
+				state.readStages = 0;
+				state.visibleStages = 0;
+				state.visibleAccess = 0;
+			}
+			else
+				state.readStages |= use.stages;
+			state.layout = use.layout;
+			state.lastStages = use.stages;
+			state.queueFamily = family;
+			state.lastPass = iPass;
+			state.defined = state.defined || use.write;
+		}
+	}
+
+	// Imported images to their final layout. Those kept for the next execute are made visible to
+	// their first use in it, the others are handed to outside of the graph, presentation, by a semaphore.
+	const uint32_t lastFamily = m_segments.empty() ? VK_QUEUE_FAMILY_IGNORED : queueFamily(m_segments.back().queue);
+	for (uint32_t iResource = 0; iResource < m_resources.size(); iResource++)
+	{
+		const ResourceData &resource = m_resources[iResource];
+		const State &state = states[iResource];
+		if (!resource.isImage || !resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == state.layout)
+			continue;
+		Use use{};
+		use.resource = iResource;
+		use.layout = resource.finalLayout;
+		use.stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		if (resource.finalLayout == resource.initialLayout && resource.firstPass != invalidIndex)
+		{
+			for (const Use &first : m_passes[resource.firstPass].uses)
+			{
+				if (first.resource == iResource)
+				{
+					use.stages = first.stages;
+					use.access = first.access;
+				}
+			}
+		}
+		const VkPipelineStageFlags srcStages = state.writeStages | state.readStages;
+		if (state.lastPass != invalidIndex && state.queueFamily != lastFamily)
+			addBarrier(m_passes[state.lastPass].releases, iResource, state, srcStages, state.writeAccess, use, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		else
+			addBarrier(m_final, iResource, state, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, state.writeAccess, use, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	}
+}
+
+void RenderGraph::computeStatistics()
+{
+	const uint32_t queueTransfers = m_statistics.queueTransfers;
+	m_statistics = Statistics{};
+	m_statistics.queueTransfers = queueTransfers;
+	auto count = [&](const BarrierBatch &batch) {
+		if (batch.empty())
+			return;
+		m_statistics.barrierBatches++;
+		m_statistics.imageBarriers += static_cast<uint32_t>(batch.images.size());
+		m_statistics.bufferBarriers += static_cast<uint32_t>(batch.buffers.size());
+	};
+	for (const Pass &pass : m_passes)
+	{
+		m_statistics.passes++;
+		if (pass.culled)
+		{
+			m_statistics.culledPasses++;
+			continue;
+		}
+		count(pass.barriers);
+		count(pass.releases);
+	}
+	count(m_final);
+	for (const ResourceData &resource : m_resources)
+	{
+		if (resource.block == invalidIndex)
+			continue;
+		m_statistics.transientImages++;
+		m_statistics.transientMemory += resource.requirements.size;
+	}
+	m_statistics.memoryBlocks = static_cast<uint32_t>(m_blocks.size());
+	for (const MemoryBlock &block : m_blocks)
+		m_statistics.aliasedMemory += block.size;
+}
+
+void RenderGraph::create(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+	compile();
+	for (ResourceData &resource : m_resources)
+	{
+		if (!resource.isImage || resource.imported || resource.firstPass == invalidIndex)
+			continue;
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = resource.desc.width;
+		imageInfo.extent.height = resource.desc.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = std::max(resource.desc.mipLevels, 1U);
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateImage(device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create render graph image '" + resource.name + "'");
+		vkGetImageMemoryRequirements(device, resource.image, &resource.requirements);
+	}
+	plan();
+	for (MemoryBlock &block : m_blocks)
+	{
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block.size;
+		allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate render graph memory");
+		for (uint32_t iResource : block.resources)
+		{
+			ResourceData &resource = m_resources[iResource];
+			if (vkBindImageMemory(device, resource.image, block.memory, 0) != VK_SUCCESS)
+				throw std::runtime_error("Failed to bind render graph image '" + resource.name + "'");
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = resource.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = resource.desc.format;
+			viewInfo.subresourceRange = VkImageSubresourceRange{ resource.desc.aspect, 0, std::max(resource.desc.mipLevels, 1U), 0, 1 };
+			if (vkCreateImageView(device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS)
+				throw std::runtime_error("Failed to create render graph image view '" + resource.name + "'");
+		}
+	}
+}
+
+void RenderGraph::destroy(VkDevice device)
+{
+	for (ResourceData &resource : m_resources)
+	{
+		if (resource.imported)
+			continue;
+		if (resource.view != VK_NULL_HANDLE)
+			vkDestroyImageView(device, resource.view, nullptr);
+		if (resource.image != VK_NULL_HANDLE)
+			vkDestroyImage(device, resource.image, nullptr);
+		resource.view = VK_NULL_HANDLE;
+		resource.image = VK_NULL_HANDLE;
+	}
+	for (MemoryBlock &block : m_blocks)
+	{
+		if (block.memory != VK_NULL_HANDLE)
+			vkFreeMemory(device, block.memory, nullptr);
+		block.memory = VK_NULL_HANDLE;
+	}
+	m_compiled = false;
+}
+
+void RenderGraph::setImage(Resource resource, VkImage image, VkImageView view)
+{
+	ResourceData &data = m_resources[resource()];
+	if (!data.imported || !data.isImage)
+		throw std::runtime_error("'" + data.name + "' is not an imported image");
+	data.image = image;
+	data.view = view;
+}
+
+void RenderGraph::setBuffer(Resource resource, VkBuffer buffer)
+{
+	ResourceData &data = m_resources[resource()];
+	if (!data.imported || data.isImage)
+		throw std::runtime_error("'" + data.name + "' is not an imported buffer");
+	data.buffer = buffer;
+}
+
+VkImage RenderGraph::getImage(Resource resource) const
+{
+	return m_resources[resource()].image;
+}
+
+VkImageView RenderGraph::getImageView(Resource resource) const
+{
+	return m_resources[resource()].view;
+}
+
+VkBuffer RenderGraph::getBuffer(Resource resource) const
+{
+	return m_resources[resource()].buffer;
+}
+
+void RenderGraph::record(const BarrierBatch &batch, VkCommandBuffer cmdBuff) const
+{
+	if (batch.empty())
+		return;
+	std::vector<VkImageMemoryBarrier> images = batch.images;
+	for (size_t iBarrier = 0; iBarrier < images.size(); iBarrier++)
+		images[iBarrier].image = m_resources[batch.imageResources[iBarrier]].image;
+	std::vector<VkBufferMemoryBarrier> buffers = batch.buffers;
+	for (size_t iBarrier = 0; iBarrier < buffers.size(); iBarrier++)
+		buffers[iBarrier].buffer = m_resources[batch.bufferResources[iBarrier]].buffer;
+	const bool memory = batch.memory.srcAccessMask != 0 || batch.memory.dstAccessMask != 0;
+	vkCmdPipelineBarrier(
+		cmdBuff,
+		batch.srcStages,
+		batch.dstStages,
+		0,
+		memory ? 1 : 0, memory ? &batch.memory : nullptr,
+		static_cast<uint32_t>(buffers.size()), buffers.data(),
+		static_cast<uint32_t>(images.size()), images.data()
+	);
+}
+
+void RenderGraph::recordPass(uint32_t pass, VkCommandBuffer cmdBuff) const
+{
+	record(m_passes[pass].barriers, cmdBuff);
+	if (m_passes[pass].execute)
+		m_passes[pass].execute(cmdBuff, *this);
+	record(m_passes[pass].releases, cmdBuff);
+}
+
+void RenderGraph::execute(VkCommandBuffer cmdBuff) const
+{
+	if (!m_compiled)
+		throw std::runtime_error("Render graph not compiled");
+	if (m_segments.size() > 1)
+		throw std::runtime_error("Render graph on several queues, execute each segment");
+	if (!m_segments.empty())
+		execute(0, cmdBuff);
+}
+
+void RenderGraph::execute(uint32_t segment, VkCommandBuffer cmdBuff) const
+{
+	if (!m_compiled)
+		throw std::runtime_error("Render graph not compiled");
+	for (uint32_t iPass : m_segments[segment].passes)
+		recordPass(iPass, cmdBuff);
+	if (segment == m_segments.size() - 1)
+		record(m_final, cmdBuff);
+}
+
+void RenderGraph::dump(std::ostream &stream) const
+{
+	auto dumpBatch = [&](const char *label, const BarrierBatch &batch) {
+		if (batch.empty())
+			return;
+		stream << "\t" << label << " stages 0x" << std::hex << batch.srcStages << " -> 0x" << batch.dstStages << std::dec;
+		if (batch.memory.srcAccessMask != 0 || batch.memory.dstAccessMask != 0)
+			stream << ", memory 0x" << std::hex << batch.memory.srcAccessMask << " -> 0x" << batch.memory.dstAccessMask << std::dec;
+		stream << "\n";
+		for (size_t iBarrier = 0; iBarrier < batch.images.size(); iBarrier++)
+		{
+			const VkImageMemoryBarrier &barrier = batch.images[iBarrier];
+			stream << "\t\t" << m_resources[batch.imageResources[iBarrier]].name << " " << layoutName(barrier.oldLayout) << " -> " << layoutName(barrier.newLayout);
+			if (barrier.srcQueueFamilyIndex != barrier.dstQueueFamilyIndex)
+				stream << ", family " << barrier.srcQueueFamilyIndex << " -> " << barrier.dstQueueFamilyIndex;
+			stream << "\n";
+		}
+		for (size_t iBarrier = 0; iBarrier < batch.buffers.size(); iBarrier++)
+		{
+			const VkBufferMemoryBarrier &barrier = batch.buffers[iBarrier];
+			stream << "\t\t" << m_resources[batch.bufferResources[iBarrier]].name << ", family " << barrier.srcQueueFamilyIndex << " -> " << barrier.dstQueueFamilyIndex << "\n";
+		}
+	};
+	for (uint32_t iSegment = 0; iSegment < m_segments.size(); iSegment++)
+	{
+		const Segment &segment = m_segments[iSegment];
+		stream << "segment " << iSegment << ", family " << queueFamily(segment.queue);
+		for (uint32_t wait : segment.waits)
+			stream << ", waits " << wait;
+		stream << "\n";
+		for (uint32_t iPass : segment.passes)
+		{
+			stream << "pass " << m_passes[iPass].name << "\n";
+			dumpBatch("barrier", m_passes[iPass].barriers);
+			dumpBatch("release", m_passes[iPass].releases);
+		}
+	}
+	dumpBatch("final", m_final);
+	for (const Pass &pass : m_passes)
+		if (pass.culled)
+			stream << "culled " << pass.name << "\n";
+	for (uint32_t iBlock = 0; iBlock < m_blocks.size(); iBlock++)
+	{
+		stream << "block " << iBlock << ", " << m_blocks[iBlock].size << " bytes:";
+		for (uint32_t iResource : m_blocks[iBlock].resources)
+			stream << " " << m_resources[iResource].name;
+		stream << "\n";
+	}
+	stream << "transient memory " << m_statistics.transientMemory << " bytes, aliased " << m_statistics.aliasedMemory << " bytes\n";
+}
+
+}
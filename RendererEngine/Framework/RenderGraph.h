@@ -0,0 +1,260 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace vk {
+
+// Frame described as passes declaring the resources they use, instead of hand written barriers.
+// Only depends on Vulkan headers so that every project can build it, whatever its vk::Context.
+//
+// Passes are recorded in the order they are added, which must be a valid order of their uses.
+// compile() culls the passes no output depends on, then computes for each pass the barriers it
+// needs, in a single batch, & the queue ownership transfers between passes of different queue
+// families. Transient images whose lifetimes do not overlap share memory.
+//
+// compile() needs no device, memory sizes are then estimated from formats. It is a dry run: the
+// plan, statistics & dump() can be checked without a GPU. create() allocates transient images
+// & compiles again with the real memory requirements, execute() records the plan.
+class RenderGraph
+{
+public:
+	struct Resource {
+		static Resource invalid() { return Resource(); }
+		explicit Resource() : m_index(~0U) {}
+		explicit Resource(uint32_t index) : m_index(index) {}
+
+		uint32_t operator()() const { return m_index; }
+
+		bool valid() const { return m_index != ~0U; }
+
+		bool operator==(const Resource &handle) const { return handle.m_index == m_index; }
+		bool operator!=(const Resource &handle) const { return handle.m_index != m_index; }
+	private:
+		uint32_t m_index;
+	};
+
+	// Kind of work of a pass, gives the shader stages of its uses.
+	enum class PassType {
+		GRAPHICS,
+		COMPUTE,
+		TRANSFER,
+	};
+	// Queue a pass is submitted to, see setQueueFamilies.
+	enum class Queue {
+		GRAPHICS,
+		COMPUTE,
+		TRANSFER,
+	};
+	// Layout, stages & accesses of a use, see usageState.
+	enum class Usage {
+		// Images
+		SAMPLED,
+		STORAGE_IMAGE_READ,
+		STORAGE_IMAGE_WRITE,
+		STORAGE_IMAGE_READ_WRITE,
+		COLOR_ATTACHMENT,
+		DEPTH_ATTACHMENT,
+		DEPTH_ATTACHMENT_READ,
+		// Buffers
+		UNIFORM_BUFFER,
+		STORAGE_BUFFER_READ,
+		STORAGE_BUFFER_WRITE,
+		STORAGE_BUFFER_READ_WRITE,
+		INDIRECT_BUFFER,
+		VERTEX_BUFFER,
+		INDEX_BUFFER,
+		// Both
+		TRANSFER_SRC,
+		TRANSFER_DST,
+	};
+
+	struct ImageDesc {
+		VkFormat format;
+		uint32_t width, height;
+		uint32_t mipLevels;
+		VkImageAspectFlags aspect;
+	};
+
+	using Execute = std::function<void(VkCommandBuffer cmdBuff, const RenderGraph &graph)>;
+
+	// One vkCmdPipelineBarrier. Buffers owned by a single queue family share a global memory barrier.
+	struct BarrierBatch {
+		VkPipelineStageFlags srcStages;
+		VkPipelineStageFlags dstStages;
+		VkMemoryBarrier memory;
+		std::vector<VkImageMemoryBarrier> images;
+		std::vector<VkBufferMemoryBarrier> buffers;
+		std::vector<uint32_t> imageResources;	// Of each image barrier, its VkImage is set on record
+		std::vector<uint32_t> bufferResources;
+
+		bool empty() const { return dstStages == 0; }
+	};
+
+	// Consecutive passes of a queue, submitted at once after the segments it waits for.
+	struct Segment {
+		Queue queue;
+		std::vector<uint32_t> passes;
+		std::vector<uint32_t> waits;	// Segments to wait for, with a semaphore
+	};
+
+	struct Statistics {
+		uint32_t passes;
+		uint32_t culledPasses;
+		uint32_t barrierBatches;		// vkCmdPipelineBarrier calls
+		uint32_t imageBarriers;
+		uint32_t bufferBarriers;
+		uint32_t queueTransfers;		// Release & acquire pairs
+		uint32_t transientImages;
+		uint32_t memoryBlocks;			// Allocations of the transient images
+		VkDeviceSize transientMemory;	// Without aliasing
+		VkDeviceSize aliasedMemory;		// With aliasing
+	};
+
+public:
+	RenderGraph();
+	~RenderGraph();
+
+	// Queue family of each queue, the same family for all by default.
+	void setQueueFamilies(uint32_t graphics, uint32_t compute, uint32_t transfer);
+
+	// Image owned by the graph, its content only lives between its first & last use.
+	Resource createImage(const std::string &name, const ImageDesc &desc);
+	// Image owned by the caller, set with setImage before each execute. Its content is kept when
+	// initialLayout is not undefined. initialStages are the stages that last used it outside of the
+	// graph, 0 if none since the previous execute. It is in finalLayout after the graph, or in the
+	// layout of its last use if undefined. Outputs keep the passes writing them alive.
+	Resource importImage(const std::string &name, const ImageDesc &desc, VkImageLayout initialLayout, VkPipelineStageFlags initialStages, VkImageLayout finalLayout, bool output);
+	Resource importBuffer(const std::string &name, VkDeviceSize size, bool output);
+
+	// Passes are kept alive by outputs & side effects, work outside of the graph that must happen.
+	uint32_t addPass(const std::string &name, PassType type, Queue queue, Execute execute, bool sideEffect = false);
+	void use(uint32_t pass, Resource resource, Usage usage);
+
+	// Plan the graph with estimated memory requirements, needs no device.
+	void compile();
+	// Create the transient images & their memory, then compile again with their requirements.
+	void create(VkDevice device, VkPhysicalDevice physicalDevice);
+	void destroy(VkDevice device);
+
+	// Imported resources for the next execute.
+	void setImage(Resource resource, VkImage image, VkImageView view);
+	void setBuffer(Resource resource, VkBuffer buffer);
+	VkImage getImage(Resource resource) const;
+	VkImageView getImageView(Resource resource) const;
+	VkBuffer getBuffer(Resource resource) const;
+
+	// Record the passes of a single segment graph.
+	void execute(VkCommandBuffer cmdBuff) const;
+	// Record the passes of a segment, each on a command buffer of its queue.
+	void execute(uint32_t segment, VkCommandBuffer cmdBuff) const;
+
+	// Compiled plan.
+	bool isCulled(uint32_t pass) const { return m_passes[pass].culled; }
+	const BarrierBatch &getBarriers(uint32_t pass) const { return m_passes[pass].barriers; }
+	const BarrierBatch &getReleases(uint32_t pass) const { return m_passes[pass].releases; }
+	const BarrierBatch &getFinalBarriers() const { return m_final; }
+	const std::vector<Segment> &getSegments() const { return m_segments; }
+	// Memory block of a transient image, shared with the images it aliases. ~0U if culled.
+	uint32_t getMemoryBlock(Resource resource) const { return m_resources[resource()].block; }
+	const Statistics &getStatistics() const { return m_statistics; }
+	// Passes, barriers & memory of the plan, readable.
+	void dump(std::ostream &stream) const;
+
+	// Layout, stages & accesses of a usage in a pass of a type.
+	static void usageState(Usage usage, PassType type, VkImageLayout &layout, VkPipelineStageFlags &stages, VkAccessFlags &access, bool &write);
+	// Memory of an image without a device, the texel size times its mips, aligned.
+	static VkMemoryRequirements estimateRequirements(const ImageDesc &desc);
+
+private:
+	struct Use {
+		uint32_t resource;
+		VkImageLayout layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		bool write;
+	};
+	struct Pass {
+		std::string name;
+		PassType type;
+		Queue queue;
+		Execute execute;
+		bool sideEffect;
+		std::vector<Use> uses;
+		// Compiled
+		bool culled;
+		uint32_t segment;
+		BarrierBatch barriers;	// Before the pass
+		BarrierBatch releases;	// After the pass, of resources acquired by another queue family
+	};
+	struct ResourceData {
+		std::string name;
+		bool isImage;
+		bool imported;
+		bool output;
+		ImageDesc desc;
+		VkDeviceSize size;	// Of buffers
+		VkImageLayout initialLayout;
+		VkPipelineStageFlags initialStages;
+		VkImageLayout finalLayout;
+		VkImageUsageFlags usage;	// Of transient images, from their uses
+		// Compiled
+		uint32_t firstPass, lastPass;	// Lifetime, among the passes not culled
+		uint32_t queueFamily;			// Of every use, ~0U if used by several families
+		VkMemoryRequirements requirements;
+		uint32_t block;
+		// Handles
+		VkImage image;
+		VkImageView view;
+		VkBuffer buffer;
+	};
+	// Synchronization state of a resource while compiling.
+	struct State {
+		VkImageLayout layout;
+		VkPipelineStageFlags writeStages;	// Of the last write not yet waited for by every stage
+		VkAccessFlags writeAccess;
+		VkPipelineStageFlags readStages;	// Of the reads since the last write
+		VkPipelineStageFlags visibleStages;	// Stages & accesses the last write is visible to
+		VkAccessFlags visibleAccess;
+		VkPipelineStageFlags lastStages;	// Of the last use, for aliasing
+		uint32_t queueFamily;
+		uint32_t lastPass;
+		bool defined;	// Content to keep
+	};
+	struct MemoryBlock {
+		VkDeviceSize size;
+		VkDeviceSize alignment;
+		uint32_t memoryTypeBits;
+		std::vector<uint32_t> resources;
+		VkDeviceMemory memory;
+	};
+
+	void cull();
+	void computeLifetimes();
+	void plan();
+	void aliasMemory();
+	void computeBarriers();
+	void computeSegments();
+	void computeStatistics();
+	uint32_t queueFamily(Queue queue) const;
+	void record(const BarrierBatch &batch, VkCommandBuffer cmdBuff) const;
+	void recordPass(uint32_t pass, VkCommandBuffer cmdBuff) const;
+	void addBarrier(BarrierBatch &batch, uint32_t resource, const State &state, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, const Use &use, uint32_t srcFamily, uint32_t dstFamily) const;
+
+private:
+	uint32_t m_queueFamilies[3];
+	bool m_compiled;
+	std::vector<Pass> m_passes;
+	std::vector<ResourceData> m_resources;
+	std::vector<MemoryBlock> m_blocks;
+	std::vector<Segment> m_segments;
+	BarrierBatch m_final;	// After the last pass, to the final layouts
+	Statistics m_statistics;
+};
+
+}
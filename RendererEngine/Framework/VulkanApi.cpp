@@ -428,8 +428,22 @@ void Device::create(const vk::PhysicalDevice & physicalDevice, const vk::DeviceE
 	deviceFeatures.shaderFloat64 = VK_TRUE;
 	deviceFeatures.multiDrawIndirect = VK_TRUE;
 
+	// Descriptor indexing of the bindless table
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	indexingFeatures.shaderStorageImageArrayNonUniformIndexing = VK_TRUE;
+	indexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+	indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	indexingFeatures.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+	indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &indexingFeatures;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
@@ -624,9 +638,15 @@ Context::Context(const Window &window)
 	vk::InstanceExtensions instanceExtensions;
 	window.add(instanceExtensions);
 	instanceExtensions.add(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	instanceExtensions.add(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
 	vk::DeviceExtensions deviceExtensions;
 	deviceExtensions.add(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	// Draws of the culling stage, core in 1.2 only.
+	deviceExtensions.add(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	// Bindless table, core in 1.2 only.
+	deviceExtensions.add(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+	deviceExtensions.add(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
 	//deviceExtensions.add(VK_NV_RAY_TRACING_EXTENSION_NAME);
 	//deviceExtensions.add(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
 
@@ -635,10 +655,12 @@ Context::Context(const Window &window)
 	m_physicalDevice.create(m_instance);
 	m_device.create(m_physicalDevice, deviceExtensions, m_surface);
 	m_swapChain.create(m_physicalDevice, m_device, m_surface);
+	m_bindless.create(m_instance, m_physicalDevice, m_device);
 }
 
 Context::~Context()
 {
+	m_bindless.destroy();
 }
 
 uint32_t Context::getWidth() const
@@ -694,7 +716,10 @@ void Context::endSingleTimeCommand(VkCommandBuffer commandBuffer) const
 
 bool Context::acquireNextFrame(vk::SwapChainFrame * frame)
 {
-	return m_swapChain.acquireNextFrame(m_device, frame);
+	bool needRecreation = m_swapChain.acquireNextFrame(m_device, frame);
+	// The frame reusing this one resources has ended.
+	m_bindless.nextFrame();
+	return needRecreation;
 }
 
 bool Context::presentFrame(const vk::SwapChainFrame & frame)
@@ -731,6 +756,214 @@ void Context::destroyShaders()
 	m_shaders.clear();
 }
 
+BindlessTable::BindlessTable() :
+	m_device(VK_NULL_HANDLE),
+	m_layout(VK_NULL_HANDLE),
+	m_pipelineLayout(VK_NULL_HANDLE),
+	m_pool(VK_NULL_HANDLE),
+	m_set(VK_NULL_HANDLE),
+	m_frame(0),
+	m_slots{}
+{
+}
+
+static const VkDescriptorType bindlessDescriptorTypes[BindlessTable::TYPE_COUNT] = {
+	VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+	VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+	VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+};
+
+void BindlessTable::create(const vk::Instance &instance, const vk::PhysicalDevice &physicalDevice, const vk::Device &device)
+{
+	m_device = device();
+	m_frame = 0;
+
+	// --- Capacities, within the update after bind limits
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+	VkPhysicalDeviceProperties2KHR properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+	properties.pNext = &indexingProperties;
+	auto getProperties = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(instance(), "vkGetPhysicalDeviceProperties2KHR");
+	if (getProperties == nullptr)
+		throw std::runtime_error("vkGetPhysicalDeviceProperties2KHR not available");
+	getProperties(physicalDevice(), &properties);
+
+	// Every binding is visible to every stage, they share the per stage resources.
+	const uint32_t perType = (std::min)(maxCapacity, indexingProperties.maxPerStageUpdateAfterBindResources / TYPE_COUNT);
+	m_slots[SAMPLED_IMAGE].capacity = (std::min)({ perType, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages, indexingProperties.maxDescriptorSetUpdateAfterBindSamplers });
+	m_slots[STORAGE_IMAGE].capacity = (std::min)({ perType, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageImages, indexingProperties.maxDescriptorSetUpdateAfterBindStorageImages });
+	m_slots[STORAGE_BUFFER].capacity = (std::min)({ perType, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+	for (Slots &slots : m_slots)
+	{
+		slots.next = 0;
+		slots.free.clear();
+		slots.removed.clear();
+	}
+
+	// --- Descriptor set layout
+	std::array<VkDescriptorSetLayoutBinding, TYPE_COUNT> bindings{};
+	std::array<VkDescriptorBindingFlagsEXT, TYPE_COUNT> bindingFlags{};
+	for (uint32_t iType = 0; iType < TYPE_COUNT; iType++)
+	{
+		bindings[iType].binding = iType;
+		bindings[iType].descriptorCount = m_slots[iType].capacity;
+		bindings[iType].descriptorType = bindlessDescriptorTypes[iType];
+		bindings[iType].pImmutableSamplers = nullptr;
+		bindings[iType].stageFlags = VK_SHADER_STAGE_ALL;
+		// Slots are written while the set is bound, unused ones are never written.
+		bindingFlags[iType] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = TYPE_COUNT;
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = TYPE_COUNT;
+	layoutInfo.pBindings = bindings.data();
+
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_layout));
+
+	// --- Pipeline layout, shared by every stage
+	VkPushConstantRange pushConstants{};
+	pushConstants.offset = 0;
+	pushConstants.size = pushConstantSize;
+	pushConstants.stageFlags = VK_SHADER_STAGE_ALL;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_layout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+
+	VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout));
+
+	// --- Descriptor pool & set
+	std::array<VkDescriptorPoolSize, TYPE_COUNT> poolSizes{};
+	for (uint32_t iType = 0; iType < TYPE_COUNT; iType++)
+	{
+		poolSizes[iType].type = bindlessDescriptorTypes[iType];
+		poolSizes[iType].descriptorCount = m_slots[iType].capacity;
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = TYPE_COUNT;
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	VK_CHECK_RESULT(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pool));
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_layout;
+
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &allocInfo, &m_set));
+}
+
+void BindlessTable::destroy()
+{
+	if (m_device == VK_NULL_HANDLE)
+		return;
+	vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+	vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+	m_device = VK_NULL_HANDLE;
+}
+
+BindlessHandle BindlessTable::allocate(Type type)
+{
+	Slots &slots = m_slots[type];
+	if (!slots.free.empty())
+	{
+		const uint32_t index = slots.free.back();
+		slots.free.pop_back();
+		return BindlessHandle(index);
+	}
+	if (slots.next == slots.capacity)
+		throw std::runtime_error("Bindless table full");
+	return BindlessHandle(slots.next++);
+}
+
+void BindlessTable::write(Type type, BindlessHandle handle, const VkDescriptorImageInfo *imageInfo, const VkDescriptorBufferInfo *bufferInfo)
+{
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_set;
+	descriptorWrite.dstBinding = static_cast<uint32_t>(type);
+	descriptorWrite.dstArrayElement = handle();
+	descriptorWrite.descriptorType = bindlessDescriptorTypes[type];
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = imageInfo;
+	descriptorWrite.pBufferInfo = bufferInfo;
+	vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+BindlessHandle BindlessTable::addSampledImage(VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+	BindlessHandle handle = allocate(SAMPLED_IMAGE);
+	VkDescriptorImageInfo imageInfo{ sampler, view, layout };
+	write(SAMPLED_IMAGE, handle, &imageInfo, nullptr);
+	return handle;
+}
+
+BindlessHandle BindlessTable::addStorageImage(VkImageView view)
+{
+	BindlessHandle handle = allocate(STORAGE_IMAGE);
+	VkDescriptorImageInfo imageInfo{ VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL };
+	write(STORAGE_IMAGE, handle, &imageInfo, nullptr);
+	return handle;
+}
+
+BindlessHandle BindlessTable::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	BindlessHandle handle = allocate(STORAGE_BUFFER);
+	VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+	write(STORAGE_BUFFER, handle, nullptr, &bufferInfo);
+	return handle;
+}
+
+void BindlessTable::remove(Type type, BindlessHandle handle)
+{
+	ASSERT(handle.valid() && handle() < m_slots[type].next, "Invalid bindless handle");
+	m_slots[type].removed.push_back(std::make_pair(handle(), m_frame));
+}
+
+void BindlessTable::nextFrame()
+{
+	m_frame++;
+	// Removed during frame f, read at most by the frames in flight up to f, the last of which
+	// has been waited for once maxInFlight frames have been acquired since.
+	for (Slots &slots : m_slots)
+	{
+		while (!slots.removed.empty() && slots.removed.front().second + FrameIndex::maxInFlight() <= m_frame)
+		{
+			slots.free.push_back(slots.removed.front().first);
+			slots.removed.pop_front();
+		}
+	}
+}
+
+void BindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint) const
+{
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, m_pipelineLayout, 0, 1, &m_set, 0, nullptr);
+}
+
+uint32_t BindlessTable::getCount(Type type) const
+{
+	const Slots &slots = m_slots[type];
+	return slots.next - static_cast<uint32_t>(slots.free.size() + slots.removed.size());
+}
+
 void SwapChainFrame::wait(VkDevice device)
 {
 	VK_CHECK_RESULT(vkWaitForFences(
@@ -4,6 +4,7 @@
 #include <vector>
 #include <array>
 #include <map>
+#include <deque>
 #include <iostream>
 
 #define STRINGIFY(x) #x
@@ -232,6 +233,73 @@ private:
 	std::array<SwapChainFrame, FrameIndex::maxInFlight()> m_frames;
 };
 
+// Index of a resource in the bindless table, as read by shaders.
+struct BindlessHandle {
+	static BindlessHandle invalid() { return BindlessHandle(); }
+	explicit BindlessHandle() : m_index(~0U) {}
+	explicit BindlessHandle(uint32_t index) : m_index(index) {}
+
+	uint32_t operator()() const { return m_index; }
+
+	bool valid() const { return m_index != ~0U; }
+
+	bool operator==(const BindlessHandle &handle) const { return handle.m_index == m_index; }
+	bool operator!=(const BindlessHandle &handle) const { return handle.m_index != m_index; }
+private:
+	uint32_t m_index;
+};
+
+// A single descriptor set of update after bind arrays, one per resource type, indexed by handles
+// (see shaders/bindless.h). Stages share its pipeline layout & bind it once per frame, handles go
+// to shaders through push constants or buffers.
+// Removed handles are recycled once the frames in flight that may read them have ended.
+struct BindlessTable {
+	enum Type {
+		SAMPLED_IMAGE,	// Combined with a sampler, binding 0
+		STORAGE_IMAGE,	// Binding 1
+		STORAGE_BUFFER,	// Binding 2
+		TYPE_COUNT
+	};
+	static constexpr uint32_t maxCapacity = 1 << 16;	// Per type, lowered to the device limits
+	static constexpr uint32_t pushConstantSize = 128;	// Minimum guaranteed, visible to every stage
+
+	BindlessTable();
+	void create(const vk::Instance &instance, const vk::PhysicalDevice &physicalDevice, const vk::Device &device);
+	void destroy();
+
+	BindlessHandle addSampledImage(VkImageView view, VkSampler sampler, VkImageLayout layout);
+	BindlessHandle addStorageImage(VkImageView view);
+	BindlessHandle addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	void remove(Type type, BindlessHandle handle);
+
+	// Recycle the handles removed before the frames in flight, once a frame has been waited for.
+	void nextFrame();
+
+	void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint) const;
+
+	VkDescriptorSetLayout getLayout() const { return m_layout; }
+	VkPipelineLayout getPipelineLayout() const { return m_pipelineLayout; }
+	uint32_t getCapacity(Type type) const { return m_slots[type].capacity; }
+	uint32_t getCount(Type type) const;
+private:
+	BindlessHandle allocate(Type type);
+	void write(Type type, BindlessHandle handle, const VkDescriptorImageInfo *imageInfo, const VkDescriptorBufferInfo *bufferInfo);
+private:
+	struct Slots {
+		uint32_t capacity;
+		uint32_t next;	// Never allocated from here
+		std::vector<uint32_t> free;
+		std::deque<std::pair<uint32_t, uint64_t>> removed;	// With the frame they were removed
+	};
+	VkDevice m_device;
+	VkDescriptorSetLayout m_layout;
+	VkPipelineLayout m_pipelineLayout;
+	VkDescriptorPool m_pool;
+	VkDescriptorSet m_set;
+	uint64_t m_frame;
+	std::array<Slots, TYPE_COUNT> m_slots;
+};
+
 struct Context {
 	Context(const Window &window);
 	~Context();
@@ -263,12 +331,17 @@ struct Context {
 	VkShaderModule getShader(const std::string &name) const;
 	void destroyShaders();
 
+	// Bindless
+	BindlessTable &getBindlessTable() { return m_bindless; }
+	const BindlessTable &getBindlessTable() const { return m_bindless; }
+
 private:
 	vk::Instance m_instance;
 	vk::Surface m_surface;
 	vk::PhysicalDevice m_physicalDevice;
 	vk::Device m_device;
 	vk::SwapChain m_swapChain;
+	vk::BindlessTable m_bindless;
 private:
 	std::map<std::string, VkShaderModule> m_shaders;
 };
@@ -0,0 +1,367 @@
+#include "VulkanCulling.h"
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace vk {
+
+static_assert(sizeof(CullInstance) == 32, "CullInstance must match the std430 layout of cull.comp");
+static_assert(sizeof(CullView) == 176, "CullView must match the std430 layout of cull.comp");
+static_assert(sizeof(DrawIndexedCommand) == sizeof(VkDrawIndexedIndirectCommand), "DrawIndexedCommand must match VkDrawIndexedIndirectCommand");
+static_assert(offsetof(DrawIndexedCommand, firstInstance) == offsetof(VkDrawIndexedIndirectCommand, firstInstance), "DrawIndexedCommand must match VkDrawIndexedIndirectCommand");
+
+namespace {
+
+constexpr uint32_t cullGroupSize = 64;
+constexpr uint32_t pyramidGroupSize = 8;
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkImageMemoryBarrier pyramidBarrier(VkImage image, uint32_t baseLevel, uint32_t levelCount, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.image = image;
+	barrier.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1 };
+	return barrier;
+}
+
+}
+
+void CullingStage::createBuffer(const vk::Context &context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &memory)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VK_CHECK_RESULT(vkCreateBuffer(context.getLogicalDevice(), &bufferInfo, nullptr, &buffer));
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(context.getLogicalDevice(), buffer, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(context.getPhysicalDevice(), memRequirements.memoryTypeBits, properties);
+
+	VK_CHECK_RESULT(vkAllocateMemory(context.getLogicalDevice(), &allocInfo, nullptr, &memory));
+	VK_CHECK_RESULT(vkBindBufferMemory(context.getLogicalDevice(), buffer, memory, 0));
+}
+
+void CullingStage::createPipeline(const vk::Context &context, const char *shader, VkPipeline &pipeline)
+{
+	VkPipelineShaderStageCreateInfo shaderStageInfo{};
+	shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shaderStageInfo.module = context.getShader(shader);
+	shaderStageInfo.pName = "main";
+
+	VkComputePipelineCreateInfo computePipelineInfo = {};
+	computePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	computePipelineInfo.flags = 0;
+	computePipelineInfo.basePipelineIndex = -1;
+	computePipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	computePipelineInfo.layout = m_layout;
+	computePipelineInfo.stage = shaderStageInfo;
+
+	VK_CHECK_RESULT(vkCreateComputePipelines(context.getLogicalDevice(), VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &pipeline));
+}
+
+void CullingStage::createPyramid(const vk::Context &context)
+{
+	depthPyramidSize(m_depthWidth, m_depthHeight, m_pyramidWidth, m_pyramidHeight);
+	const uint32_t levels = depthPyramidLevels(m_depthWidth, m_depthHeight);
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = m_pyramidWidth;
+	imageInfo.extent.height = m_pyramidHeight;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = levels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VK_CHECK_RESULT(vkCreateImage(context.getLogicalDevice(), &imageInfo, nullptr, &m_pyramidImage));
+
+	VkMemoryRequirements imageMemRequirements;
+	vkGetImageMemoryRequirements(context.getLogicalDevice(), m_pyramidImage, &imageMemRequirements);
+
+	VkMemoryAllocateInfo imageAllocInfo = {};
+	imageAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	imageAllocInfo.allocationSize = imageMemRequirements.size;
+	imageAllocInfo.memoryTypeIndex = findMemoryType(context.getPhysicalDevice(), imageMemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VK_CHECK_RESULT(vkAllocateMemory(context.getLogicalDevice(), &imageAllocInfo, nullptr, &m_pyramidImageMemory));
+	VK_CHECK_RESULT(vkBindImageMemory(context.getLogicalDevice(), m_pyramidImage, m_pyramidImageMemory, 0));
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = m_pyramidImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+
+	VK_CHECK_RESULT(vkCreateImageView(context.getLogicalDevice(), &viewInfo, nullptr, &m_pyramidImageView));
+
+	m_pyramidViews.resize(levels);
+	for (uint32_t iLevel = 0; iLevel < levels; iLevel++)
+	{
+		viewInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, iLevel, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(context.getLogicalDevice(), &viewInfo, nullptr, &m_pyramidViews[iLevel]));
+	}
+
+	// The pyramid stays in the general layout, written as storage & sampled.
+	VkCommandBuffer cmdBuff = context.createSingleTimeCommand();
+
+	VkImageMemoryBarrier barrier = pyramidBarrier(m_pyramidImage, 0, levels, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	vkCmdPipelineBarrier(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	context.endSingleTimeCommand(cmdBuff);
+}
+
+void CullingStage::create(vk::Context &context, uint32_t maxInstances, uint32_t depthWidth, uint32_t depthHeight)
+{
+	static_assert(sizeof(CullPushConstant) <= BindlessTable::pushConstantSize && sizeof(PyramidPushConstant) <= BindlessTable::pushConstantSize, "Push constants too large");
+	const uint32_t imageCount = context.getImageCount();
+	BindlessTable &bindless = context.getBindlessTable();
+	m_maxInstances = std::max(maxInstances, 1U);
+	m_instanceCount = 0;
+	m_depthWidth = depthWidth;
+	m_depthHeight = depthHeight;
+	m_pyramidBuilt = false;
+	m_viewProjection = geometry::mat4f::identity();
+	m_pyramidViewProjection = geometry::mat4f::identity();
+	m_layout = bindless.getPipelineLayout();
+	m_depthHandle = BindlessHandle::invalid();
+
+	// VK_KHR_draw_indirect_count, enabled by the context.
+	m_drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(context.getLogicalDevice(), "vkCmdDrawIndexedIndirectCountKHR");
+	if (m_drawIndexedIndirectCount == nullptr)
+		throw std::runtime_error("vkCmdDrawIndexedIndirectCountKHR not available");
+
+	// --- Resources
+	createPyramid(context);
+	const uint32_t levels = getPyramidLevels();
+
+	m_viewBuffers.resize(imageCount);
+	m_viewBuffersMemory.resize(imageCount);
+	m_viewHandles.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		createBuffer(context, sizeof(CullView), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_viewBuffers[i], m_viewBuffersMemory[i]);
+		m_viewHandles[i] = bindless.addStorageBuffer(m_viewBuffers[i]);
+	}
+
+	createBuffer(context, m_maxInstances * sizeof(CullInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_instanceBuffer, m_instanceBufferMemory);
+	VK_CHECK_RESULT(vkMapMemory(context.getLogicalDevice(), m_instanceBufferMemory, 0, m_maxInstances * sizeof(CullInstance), 0, reinterpret_cast<void**>(&m_instanceData)));
+	createBuffer(context, m_maxInstances * sizeof(DrawIndexedCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_commandBuffer, m_commandBufferMemory);
+	createBuffer(context, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_countBuffer, m_countBufferMemory);
+	m_instanceHandle = bindless.addStorageBuffer(m_instanceBuffer);
+	m_commandHandle = bindless.addStorageBuffer(m_commandBuffer);
+	m_countHandle = bindless.addStorageBuffer(m_countBuffer);
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.minLod = 0.f;
+	samplerInfo.maxLod = static_cast<float>(levels);
+
+	VK_CHECK_RESULT(vkCreateSampler(context.getLogicalDevice(), &samplerInfo, nullptr, &m_sampler));
+
+	// Every level sampled by the cull, each level sampled then written by the build.
+	m_pyramidHandle = bindless.addSampledImage(m_pyramidImageView, m_sampler, VK_IMAGE_LAYOUT_GENERAL);
+	m_pyramidSampledHandles.resize(levels);
+	m_pyramidStorageHandles.resize(levels);
+	for (uint32_t iLevel = 0; iLevel < levels; iLevel++)
+	{
+		m_pyramidSampledHandles[iLevel] = bindless.addSampledImage(m_pyramidViews[iLevel], m_sampler, VK_IMAGE_LAYOUT_GENERAL);
+		m_pyramidStorageHandles[iLevel] = bindless.addStorageImage(m_pyramidViews[iLevel]);
+	}
+
+	// --- Pipelines
+	createPipeline(context, "cull.comp", m_cullPipeline);
+	createPipeline(context, "depthPyramid.comp", m_pyramidPipeline);
+}
+
+void CullingStage::destroy(vk::Context &context)
+{
+	const VkDevice device = context.getLogicalDevice();
+	BindlessTable &bindless = context.getBindlessTable();
+	vkDestroyPipeline(device, m_cullPipeline, nullptr);
+	vkDestroyPipeline(device, m_pyramidPipeline, nullptr);
+	vkDestroySampler(device, m_sampler, nullptr);
+	for (size_t i = 0; i < m_viewBuffers.size(); i++)
+	{
+		bindless.remove(BindlessTable::STORAGE_BUFFER, m_viewHandles[i]);
+		vkDestroyBuffer(device, m_viewBuffers[i], nullptr);
+		vkFreeMemory(device, m_viewBuffersMemory[i], nullptr);
+	}
+	bindless.remove(BindlessTable::STORAGE_BUFFER, m_instanceHandle);
+	bindless.remove(BindlessTable::STORAGE_BUFFER, m_commandHandle);
+	bindless.remove(BindlessTable::STORAGE_BUFFER, m_countHandle);
+	vkUnmapMemory(device, m_instanceBufferMemory);
+	vkDestroyBuffer(device, m_instanceBuffer, nullptr);
+	vkFreeMemory(device, m_instanceBufferMemory, nullptr);
+	vkDestroyBuffer(device, m_commandBuffer, nullptr);
+	vkFreeMemory(device, m_commandBufferMemory, nullptr);
+	vkDestroyBuffer(device, m_countBuffer, nullptr);
+	vkFreeMemory(device, m_countBufferMemory, nullptr);
+	if (m_depthHandle.valid())
+		bindless.remove(BindlessTable::SAMPLED_IMAGE, m_depthHandle);
+	bindless.remove(BindlessTable::SAMPLED_IMAGE, m_pyramidHandle);
+	for (uint32_t iLevel = 0; iLevel < getPyramidLevels(); iLevel++)
+	{
+		bindless.remove(BindlessTable::SAMPLED_IMAGE, m_pyramidSampledHandles[iLevel]);
+		bindless.remove(BindlessTable::STORAGE_IMAGE, m_pyramidStorageHandles[iLevel]);
+		vkDestroyImageView(device, m_pyramidViews[iLevel], nullptr);
+	}
+	vkDestroyImageView(device, m_pyramidImageView, nullptr);
+	vkDestroyImage(device, m_pyramidImage, nullptr);
+	vkFreeMemory(device, m_pyramidImageMemory, nullptr);
+	m_viewBuffers.clear();
+	m_viewBuffersMemory.clear();
+	m_viewHandles.clear();
+	m_pyramidViews.clear();
+	m_pyramidSampledHandles.clear();
+	m_pyramidStorageHandles.clear();
+	m_depthHandle = BindlessHandle::invalid();
+	m_instanceData = nullptr;
+}
+
+void CullingStage::setInstances(const CullInstance *instances, uint32_t count)
+{
+	if (count > m_maxInstances)
+		throw std::runtime_error("Too many instances for the culling stage");
+	memcpy(m_instanceData, instances, count * sizeof(CullInstance));
+	m_instanceCount = count;
+}
+
+void CullingStage::setDepth(vk::Context &context, VkImageView depthView, VkImageLayout depthLayout)
+{
+	BindlessTable &bindless = context.getBindlessTable();
+	if (m_depthHandle.valid())
+		bindless.remove(BindlessTable::SAMPLED_IMAGE, m_depthHandle);
+	m_depthHandle = bindless.addSampledImage(depthView, m_sampler, depthLayout);
+}
+
+void CullingStage::update(const vk::ImageIndex &imageIndex, const vk::Context &context, const geometry::mat4f &viewProjection)
+{
+	m_viewProjection = viewProjection;
+	const uint32_t pyramidLevels = m_pyramidBuilt ? getPyramidLevels() : 0;
+	const CullView view = makeCullView(viewProjection, m_pyramidViewProjection, m_depthWidth, m_depthHeight, pyramidLevels, m_instanceCount);
+
+	void* data;
+	VK_CHECK_RESULT(vkMapMemory(context.getLogicalDevice(), m_viewBuffersMemory[imageIndex()], 0, sizeof(CullView), 0, &data));
+	memcpy(data, &view, sizeof(CullView));
+	vkUnmapMemory(context.getLogicalDevice(), m_viewBuffersMemory[imageIndex()]);
+}
+
+void CullingStage::execute(const vk::ImageIndex &imageIndex, const vk::CommandBuffer &cmdBuff, const vk::Context &context)
+{
+	ASSERT(imageIndex == cmdBuff.getImageIndex(), "Incorrect image index");
+	// The draws of the previous frame read the commands & count.
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuff(), VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdFillBuffer(cmdBuff(), m_countBuffer, 0, sizeof(uint32_t), 0);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuff(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	if (m_instanceCount > 0)
+	{
+		CullPushConstant pushc;
+		pushc.view = m_viewHandles[imageIndex()]();
+		pushc.instances = m_instanceHandle();
+		pushc.commands = m_commandHandle();
+		pushc.count = m_countHandle();
+		pushc.pyramid = m_pyramidHandle();
+
+		vkCmdBindPipeline(cmdBuff(), VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+		context.getBindlessTable().bind(cmdBuff(), VK_PIPELINE_BIND_POINT_COMPUTE);
+		vkCmdPushConstants(cmdBuff(), m_layout, VK_SHADER_STAGE_ALL, 0, sizeof(CullPushConstant), &pushc);
+		vkCmdDispatch(cmdBuff(), (m_instanceCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuff(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void CullingStage::draw(const vk::CommandBuffer &cmdBuff) const
+{
+	m_drawIndexedIndirectCount(cmdBuff(), m_commandBuffer, 0, m_countBuffer, 0, m_maxInstances, sizeof(DrawIndexedCommand));
+}
+
+void CullingStage::buildPyramid(const vk::CommandBuffer &cmdBuff, const vk::Context &context)
+{
+	ASSERT(m_depthHandle.valid(), "No depth to build the pyramid from");
+	const uint32_t levels = getPyramidLevels();
+	// The cull of this frame reads the pyramid of the previous one.
+	VkImageMemoryBarrier barrier = pyramidBarrier(m_pyramidImage, 0, levels, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmdBuff(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdBindPipeline(cmdBuff(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipeline);
+	context.getBindlessTable().bind(cmdBuff(), VK_PIPELINE_BIND_POINT_COMPUTE);
+	for (uint32_t iLevel = 0; iLevel < levels; iLevel++)
+	{
+		const uint32_t width = std::max(m_pyramidWidth >> iLevel, 1U);
+		const uint32_t height = std::max(m_pyramidHeight >> iLevel, 1U);
+		PyramidPushConstant pushc;
+		pushc.source = (iLevel == 0) ? m_depthHandle() : m_pyramidSampledHandles[iLevel - 1]();
+		pushc.destination = m_pyramidStorageHandles[iLevel]();
+		pushc.sourceSize[0] = static_cast<int32_t>((iLevel == 0) ? m_depthWidth : std::max(m_pyramidWidth >> (iLevel - 1), 1U));
+		pushc.sourceSize[1] = static_cast<int32_t>((iLevel == 0) ? m_depthHeight : std::max(m_pyramidHeight >> (iLevel - 1), 1U));
+		pushc.destinationSize[0] = static_cast<int32_t>(width);
+		pushc.destinationSize[1] = static_cast<int32_t>(height);
+		pushc.reduce = (iLevel == 0) ? 0 : 1;
+
+		vkCmdPushConstants(cmdBuff(), m_layout, VK_SHADER_STAGE_ALL, 0, sizeof(PyramidPushConstant), &pushc);
+		vkCmdDispatch(cmdBuff(), (width + pyramidGroupSize - 1) / pyramidGroupSize, (height + pyramidGroupSize - 1) / pyramidGroupSize, 1);
+
+		// The next level reads this one.
+		barrier = pyramidBarrier(m_pyramidImage, iLevel, 1, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(cmdBuff(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+	m_pyramidViewProjection = m_viewProjection;
+	m_pyramidBuilt = true;
+}
+
+}
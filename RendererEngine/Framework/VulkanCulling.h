@@ -0,0 +1,108 @@
+#pragma once
+
+#include "VulkanApi.h"
+#include "Culling.h"
+
+namespace vk {
+
+// Frustum & occlusion culling of instances by compute, drawn with vkCmdDrawIndexedIndirectCountKHR.
+// The instances live on the GPU, so the CPU cost of a frame does not depend on their count.
+//
+// A frame updates the view, executes the cull before its draws, draws, then builds the depth
+// pyramid from its depth once written. The next frame tests its instances against that pyramid.
+// Registered shaders: cull.comp & depthPyramid.comp. Resources go through the bindless table.
+class CullingStage
+{
+public:
+	CullingStage() : m_maxInstances(0), m_instanceCount(0), m_pyramidBuilt(false) {}
+
+	// Size of the depth the pyramid is built from, recreate the stage when it changes.
+	void create(vk::Context &context, uint32_t maxInstances, uint32_t depthWidth, uint32_t depthHeight);
+	void destroy(vk::Context &context);
+
+	// Copy the instances to the GPU. They are read by the frames in flight, this must wait for all frames to end.
+	void setInstances(const CullInstance *instances, uint32_t count);
+	// Depth sampled by buildPyramid, in the given layout when it is recorded. This must wait for all frames to end.
+	void setDepth(vk::Context &context, VkImageView depthView, VkImageLayout depthLayout);
+
+	// Update the view for the given image.
+	void update(const vk::ImageIndex &imageIndex, const vk::Context &context, const geometry::mat4f &viewProjection);
+
+	// Write the commands of the visible instances & their count, before the draws.
+	void execute(const vk::ImageIndex &imageIndex, const vk::CommandBuffer &cmdBuff, const vk::Context &context);
+	// Draw the commands, with the pipeline, vertex & index buffers bound by the caller.
+	void draw(const vk::CommandBuffer &cmdBuff) const;
+	// Build the pyramid from the depth, after the draws writing it.
+	void buildPyramid(const vk::CommandBuffer &cmdBuff, const vk::Context &context);
+
+	uint32_t getInstanceCount() const { return m_instanceCount; }
+	uint32_t getPyramidLevels() const { return static_cast<uint32_t>(m_pyramidViews.size()); }
+
+	VkBuffer getCommandBuffer() const { return m_commandBuffer; }
+	VkBuffer getCountBuffer() const { return m_countBuffer; }
+	VkImage getPyramid() const { return m_pyramidImage; }
+
+private:
+	void createBuffer(const vk::Context &context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &memory);
+	void createPipeline(const vk::Context &context, const char *shader, VkPipeline &pipeline);
+	void createPyramid(const vk::Context &context);
+private:
+	// Bindless handles & sizes, see the shaders.
+	struct CullPushConstant
+	{
+		uint32_t view;
+		uint32_t instances;
+		uint32_t commands;
+		uint32_t count;
+		uint32_t pyramid;
+	};
+	struct PyramidPushConstant
+	{
+		uint32_t source;
+		uint32_t destination;
+		int32_t sourceSize[2];
+		int32_t destinationSize[2];
+		uint32_t reduce;	// 0 copies the depth to the level 0, 1 reduces the previous level
+	};
+
+	uint32_t m_maxInstances;
+	uint32_t m_instanceCount;
+	uint32_t m_depthWidth, m_depthHeight;
+	uint32_t m_pyramidWidth, m_pyramidHeight;
+	bool m_pyramidBuilt;	// No occlusion test until a pyramid is built
+	geometry::mat4f m_viewProjection;
+	geometry::mat4f m_pyramidViewProjection;
+
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_drawIndexedIndirectCount;
+
+	VkPipeline m_cullPipeline;
+	VkPipeline m_pyramidPipeline;
+	VkPipelineLayout m_layout;	// Of the bindless table
+	VkSampler m_sampler;
+
+	std::vector<VkBuffer> m_viewBuffers;	// Per image
+	std::vector<VkDeviceMemory> m_viewBuffersMemory;
+	std::vector<BindlessHandle> m_viewHandles;
+
+	VkBuffer m_instanceBuffer;
+	VkDeviceMemory m_instanceBufferMemory;
+	CullInstance *m_instanceData;	// Mapped for the lifetime of the stage
+	VkBuffer m_commandBuffer;
+	VkDeviceMemory m_commandBufferMemory;
+	VkBuffer m_countBuffer;
+	VkDeviceMemory m_countBufferMemory;
+	BindlessHandle m_instanceHandle;
+	BindlessHandle m_commandHandle;
+	BindlessHandle m_countHandle;
+	BindlessHandle m_depthHandle;
+
+	VkImage m_pyramidImage;
+	VkDeviceMemory m_pyramidImageMemory;
+	VkImageView m_pyramidImageView;				// Every level, sampled by the cull
+	std::vector<VkImageView> m_pyramidViews;	// A level each, written then read by the build
+	BindlessHandle m_pyramidHandle;
+	std::vector<BindlessHandle> m_pyramidSampledHandles;
+	std::vector<BindlessHandle> m_pyramidStorageHandles;
+};
+
+}
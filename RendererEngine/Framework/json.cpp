@@ -0,0 +1,294 @@
+#include "json.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define JSON_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC allows intrinsics of any instruction set, the caller checks the CPU.
+#define JSON_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define JSON_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace json {
+
+namespace {
+
+// Bit masks of 64 consecutive characters, one bit per character.
+struct Block {
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t whitespace;
+	uint64_t op;		// { } [ ] : ,
+	uint64_t control;	// < 0x20
+};
+
+inline uint64_t prefixXor(uint64_t bits)
+{
+	// Each bit becomes the xor of itself and every lower bit, ie 1 inside quotes.
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+}
+
+inline unsigned int trailingZeros(uint64_t bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, static_cast<uint32_t>(bits)))
+		return index;
+	_BitScanForward(&index, static_cast<uint32_t>(bits >> 32));
+	return index + 32;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+inline unsigned int popCount(uint64_t bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return static_cast<unsigned int>(__popcnt64(bits));
+#elif defined(_MSC_VER)
+	return __popcnt(static_cast<uint32_t>(bits)) + __popcnt(static_cast<uint32_t>(bits >> 32));
+#else
+	return __builtin_popcountll(bits);
+#endif
+}
+
+#if !defined(JSON_X86)
+void classifyScalar(const char *chars, Block &block)
+{
+	block = Block{};
+	for (unsigned int i = 0; i < 64; i++)
+	{
+		const uint64_t bit = uint64_t(1) << i;
+		const unsigned char c = static_cast<unsigned char>(chars[i]);
+		switch (c)
+		{
+		case '"': block.quote |= bit; break;
+		case '\\': block.backslash |= bit; break;
+		case ' ': block.whitespace |= bit; break;
+		case '\t':
+		case '\n':
+		case '\r': block.whitespace |= bit; block.control |= bit; break;
+		case '{':
+		case '}':
+		case '[':
+		case ']':
+		case ':':
+		case ',': block.op |= bit; break;
+		default:
+			if (c < 0x20)
+				block.control |= bit;
+			break;
+		}
+	}
+}
+#endif
+
+#if defined(JSON_X86)
+inline uint64_t movemask16(__m128i v0, __m128i v1, __m128i v2, __m128i v3)
+{
+	return
+		(static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(v0)))) |
+		(static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(v1))) << 16) |
+		(static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(v2))) << 32) |
+		(static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(v3))) << 48);
+}
+
+inline void classify16(__m128i c, __m128i &quote, __m128i &backslash, __m128i &whitespace, __m128i &op, __m128i &control)
+{
+	quote = _mm_cmpeq_epi8(c, _mm_set1_epi8('"'));
+	backslash = _mm_cmpeq_epi8(c, _mm_set1_epi8('\\'));
+	whitespace = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\t'))),
+		_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\r')))
+	);
+	// '[' & '{', ']' & '}' only differ by 0x20
+	const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	op = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+		_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(':')), _mm_cmpeq_epi8(c, _mm_set1_epi8(',')))
+	);
+	control = _mm_cmpeq_epi8(_mm_min_epu8(c, _mm_set1_epi8(0x1F)), c);
+}
+
+void classifySSE2(const char *chars, Block &block)
+{
+	__m128i q[4], b[4], w[4], o[4], c[4];
+	for (unsigned int i = 0; i < 4; i++)
+		classify16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + 16 * i)), q[i], b[i], w[i], o[i], c[i]);
+	block.quote = movemask16(q[0], q[1], q[2], q[3]);
+	block.backslash = movemask16(b[0], b[1], b[2], b[3]);
+	block.whitespace = movemask16(w[0], w[1], w[2], w[3]);
+	block.op = movemask16(o[0], o[1], o[2], o[3]);
+	block.control = movemask16(c[0], c[1], c[2], c[3]);
+}
+
+JSON_TARGET_AVX2 inline uint64_t movemask32(__m256i v0, __m256i v1)
+{
+	return
+		(static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(v0)))) |
+		(static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(v1))) << 32);
+}
+
+JSON_TARGET_AVX2 void classifyAVX2(const char *chars, Block &block)
+{
+	const __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chars));
+	const __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chars + 32));
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	block.quote = movemask32(_mm256_cmpeq_epi8(c0, quote), _mm256_cmpeq_epi8(c1, quote));
+	block.backslash = movemask32(_mm256_cmpeq_epi8(c0, backslash), _mm256_cmpeq_epi8(c1, backslash));
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i lf = _mm256_set1_epi8('\n');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	block.whitespace = movemask32(
+		_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c0, space), _mm256_cmpeq_epi8(c0, tab)), _mm256_or_si256(_mm256_cmpeq_epi8(c0, lf), _mm256_cmpeq_epi8(c0, cr))),
+		_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c1, space), _mm256_cmpeq_epi8(c1, tab)), _mm256_or_si256(_mm256_cmpeq_epi8(c1, lf), _mm256_cmpeq_epi8(c1, cr)))
+	);
+	const __m256i case20 = _mm256_set1_epi8(0x20);
+	const __m256i open = _mm256_set1_epi8('{');
+	const __m256i close = _mm256_set1_epi8('}');
+	const __m256i colon = _mm256_set1_epi8(':');
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i l0 = _mm256_or_si256(c0, case20);
+	const __m256i l1 = _mm256_or_si256(c1, case20);
+	block.op = movemask32(
+		_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(l0, open), _mm256_cmpeq_epi8(l0, close)), _mm256_or_si256(_mm256_cmpeq_epi8(c0, colon), _mm256_cmpeq_epi8(c0, comma))),
+		_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(l1, open), _mm256_cmpeq_epi8(l1, close)), _mm256_or_si256(_mm256_cmpeq_epi8(c1, colon), _mm256_cmpeq_epi8(c1, comma)))
+	);
+	const __m256i control = _mm256_set1_epi8(0x1F);
+	block.control = movemask32(
+		_mm256_cmpeq_epi8(_mm256_min_epu8(c0, control), c0),
+		_mm256_cmpeq_epi8(_mm256_min_epu8(c1, control), c1)
+	);
+}
+
+bool hasAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	// OSXSAVE & AVX, then check the OS saves YMM registers.
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+using Classifier = void(*)(const char *, Block &);
+
+Classifier selectClassifier()
+{
+#if defined(JSON_X86)
+	if (hasAVX2())
+		return classifyAVX2;
+	return classifySSE2;
+#else
+	return classifyScalar;
+#endif
+}
+
+}
+
+bool buildStructuralIndex(std::string_view str, std::vector<uint32_t> &structurals, size_t &errorOffset)
+{
+	static const Classifier classify = selectClassifier();
+	// Written through a raw pointer, capacity is checked once per block.
+	size_t count = 0;
+	if (structurals.size() < str.size() / 8 + 128)
+		structurals.resize(str.size() / 8 + 128);
+	uint64_t prevEscaped = 0;	// Last character of previous block escapes the first of this one
+	uint64_t prevInString = 0;	// All ones if previous block ended inside a string
+	uint64_t prevScalar = 0;	// Last character of previous block is part of a scalar
+	const uint64_t evenBits = 0x5555555555555555ULL;
+	Block block;
+	for (size_t offset = 0; offset < str.size(); offset += 64)
+	{
+		const size_t remaining = str.size() - offset;
+		if (remaining >= 64)
+		{
+			classify(str.data() + offset, block);
+		}
+		else
+		{
+			// Pad the tail with spaces, they are never structural.
+			char tail[64];
+			std::memset(tail, ' ', sizeof(tail));
+			std::memcpy(tail, str.data() + offset, remaining);
+			classify(tail, block);
+		}
+		// Escaped characters follow an odd sequence of backslashes.
+		uint64_t backslash = block.backslash & ~prevEscaped;
+		const uint64_t followsEscape = (backslash << 1) | prevEscaped;
+		const uint64_t oddSequenceStarts = backslash & ~evenBits & ~followsEscape;
+		uint64_t sequencesStartingOnEvenBits = oddSequenceStarts + backslash;
+		prevEscaped = (sequencesStartingOnEvenBits < oddSequenceStarts) ? 1 : 0;
+		const uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+		const uint64_t escaped = (evenBits ^ invertMask) & followsEscape;
+
+		const uint64_t quote = block.quote & ~escaped;
+		// Opening quotes are inside the string, closing ones outside.
+		const uint64_t inString = prefixXor(quote) ^ prevInString;
+		prevInString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+		// Control characters, even whitespaces, must be escaped in strings.
+		const uint64_t controlInString = block.control & inString;
+		if (controlInString != 0)
+		{
+			errorOffset = offset + trailingZeros(controlInString);
+			return false;
+		}
+		const uint64_t outside = ~inString;
+		const uint64_t op = block.op & outside;
+		const uint64_t scalar = ~(block.op | block.whitespace | quote) & outside;
+		const uint64_t scalarStart = scalar & ~((scalar << 1) | prevScalar);
+		prevScalar = scalar >> 63;
+		uint64_t bits = op | quote | scalarStart;
+		if (count + 64 > structurals.size())
+			structurals.resize(structurals.size() * 2);
+		// Unconditionally write 8 indices at a time, the extra ones are overwritten.
+		uint32_t *out = structurals.data() + count;
+		const uint32_t base = static_cast<uint32_t>(offset);
+		const unsigned int bitCount = popCount(bits);
+		for (unsigned int i = 0; i < bitCount; i += 8, out += 8)
+		{
+			for (unsigned int j = 0; j < 8; j++)
+			{
+				out[j] = base + trailingZeros(bits | (uint64_t(1) << 63));
+				bits &= bits - 1;
+			}
+		}
+		count += bitCount;
+	}
+	structurals.resize(count);
+	if (prevInString != 0)
+	{
+		errorOffset = str.size();
+		return false;
+	}
+	return true;
+}
+
+}
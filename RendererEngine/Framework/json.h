@@ -1,12 +1,21 @@
 #pragma once
 #include <vector>
 #include <string>
-#include <map>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdio>
+#include <charconv>
+#include <ostream>
+#include <chrono>
+#include <type_traits>
+#include <initializer_list>
 
 /*
  * TODO
  * - ios compat for debug (operator<< operator>>)
- * - parser
  * - serializer
  * - test
  *
@@ -26,94 +35,135 @@ public:
 	InvalidValue(const std::string &str) : Exception(str) {}
 };
 
+class ParseError : public Exception {
+public:
+	ParseError(const char *str, size_t offset) : Exception(std::string(str) + " at offset " + std::to_string(offset)), m_offset(offset) {}
+	// Offset in the source where the error happened
+	size_t offset() const { return m_offset; }
+private:
+	size_t m_offset;
+};
+
+// Bump allocator owning every node of a document.
+// Memory is only released when the arena is cleared or destroyed.
+class Arena {
+public:
+	Arena(size_t blockSize = 64 * 1024);
+	Arena(const Arena &) = delete;
+	Arena(Arena &&arena);
+	Arena &operator=(const Arena &) = delete;
+	Arena &operator=(Arena &&arena);
+	~Arena();
+
+	void *allocate(size_t size, size_t alignment);
+	template <typename T>
+	T *allocate(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count, alignof(T))); }
+	// Copy a string in the arena, used for strings that do not live in the source.
+	std::string_view copy(std::string_view str);
+	void clear();
+private:
+	struct alignas(std::max_align_t) Block {
+		Block *next;
+		size_t size;
+		size_t offset;
+		unsigned char *data() { return reinterpret_cast<unsigned char*>(this + 1); }
+	};
+	Block *m_block;
+	size_t m_blockSize;
+};
+
+// Names are views, either in the parsed source or in an arena.
+using Name = std::string_view;
+
 class Variable;
-class Name;
+struct Member;
 
+// Objects & arrays are handles on contiguous nodes allocated in an Arena.
+// They are copied by value, add children to a container before adding it to its parent.
 struct Object {
 	Object();
 
-	Variable &operator[](const Name &index);
-	const Variable &operator[](const Name &index) const;
-	void add(const Name &name, const Variable &variable);
-	void add(const Name &name, Variable &&variable);
-	void remove(const Name &name);
+	// Throw if the name does not exist.
+	Variable &operator[](Name name);
+	const Variable &operator[](Name name) const;
+	// Return nullptr if the name does not exist.
+	Variable *find(Name name);
+	const Variable *find(Name name) const;
+	bool contains(Name name) const;
+	void add(Arena &arena, Name name, const Variable &variable);
+	void remove(Name name);
 	size_t size() const;
-	
-	using iterator = std::map<Name, Variable>::iterator; // TODO use custom iterator to use Node
-	using const_iterator = std::map<Name, Variable>::const_iterator;
-	iterator begin() { return m_nodes.begin(); }
-	const_iterator begin() const { return m_nodes.begin(); }
-	iterator end() { return m_nodes.end(); }
-	const_iterator end() const { return m_nodes.end(); }
+
+	using iterator = Member*;
+	using const_iterator = const Member*;
+	iterator begin();
+	const_iterator begin() const;
+	iterator end();
+	const_iterator end() const;
 private:
-	std::map<Name, Variable> m_nodes; // TODO custom map ?
+	friend class Parser;
+	Member *m_members;
+	uint32_t m_size;
+	uint32_t m_capacity;
 };
-    
+
 struct Array {
 	Array();
-	Array(const std::initializer_list<Variable> &list);
+	Array(Arena &arena, const std::initializer_list<Variable> &list);
 	Variable &operator[](size_t index);
 	const Variable &operator[](size_t index) const;
-	void add(const Variable &variable);
-	void add(Variable &&variable);
-	void insert(size_t index, const Variable &variable);
+	void add(Arena &arena, const Variable &variable);
+	void insert(Arena &arena, size_t index, const Variable &variable);
 	void remove(size_t index);
 	size_t size() const;
 
-	using vector = std::vector<Variable>;
-	using iterator = vector::iterator;
-	using const_iterator = vector::const_iterator;
-	iterator begin() { return m_data.begin(); }
-	const_iterator begin() const { return m_data.begin(); }
-	iterator end() { return m_data.end(); }
-	const_iterator end() const { return m_data.end(); }
+	using iterator = Variable*;
+	using const_iterator = const Variable*;
+	iterator begin();
+	const_iterator begin() const;
+	iterator end();
+	const_iterator end() const;
 private:
-	std::vector<Variable> m_data;
+	friend class Parser;
+	void reserve(Arena &arena, uint32_t capacity);
+	Variable *m_data;
+	uint32_t m_size;
+	uint32_t m_capacity;
 };
 
 struct Null {
 	Null();
 };
 
-class Name {
-public:
-	Name() {}
-	Name(const char *str) : m_name(str) {}
-	Name(const std::string &str) : m_name(str) {}
-	// Is it a valid name (no invalid character)
-	std::string &name() { return m_name; }
-	const std::string &name() const { return m_name; }
-	bool operator<(const Name &name) const { return m_name < name.m_name; }
-private:
-	std::string m_name;
-};
-    
+// Tagged union, trivially copyable so that nodes can be moved around with memcpy.
 class Variable {
 public:
-	enum class Type {
+	enum class Type : uint8_t {
 		eOBJECT,
 		eARRAY,
 		eNUMBER,
+		eINTEGER,
 		eSTRING,
 		eBOOL,
 		eNULL
 	};
 	Variable() : m_type(Type::eNULL) {}
-	Variable(const Object &object) : m_type(Type::eOBJECT), m_value(object) {}
-	Variable(const Array &array) : m_type(Type::eARRAY), m_value(array) {}
-	Variable(const std::initializer_list<Variable> &list) : m_type(Type::eARRAY),  m_value(list) {}
-	Variable(int integer) : m_type(Type::eNUMBER), m_value(static_cast<double>(integer)) {}
-	Variable(double real) : m_type(Type::eNUMBER), m_value(real) {}
-	Variable(const char *str) : m_type(Type::eSTRING), m_value(str) {}
-	Variable(const std::string &str) : m_type(Type::eSTRING), m_value(str) {}
-	Variable(bool boolean) : m_type(Type::eBOOL), m_value(boolean) {}
-
-	Variable &operator=(const Object &value) { m_type = Type::eOBJECT; m_value.object = value; }
-	Variable &operator=(const Array &value) { m_type = Type::eARRAY; m_value.array = value; }
-	Variable &operator=(double value) { m_type = Type::eNUMBER; m_value.number = value; }
-	Variable &operator=(const char *value) { m_type = Type::eSTRING; m_value.string = value; }
-	Variable &operator=(const std::string &value) { m_type = Type::eSTRING; m_value.string = value; }
-	Variable &operator=(bool value) { m_type = Type::eBOOL; m_value.boolean = value; }
+	Variable(const Object &object) : m_type(Type::eOBJECT) { m_value.object = object; }
+	Variable(const Array &array) : m_type(Type::eARRAY) { m_value.array = array; }
+	Variable(int integer) : m_type(Type::eINTEGER) { m_value.integer = integer; }
+	Variable(int64_t integer) : m_type(Type::eINTEGER) { m_value.integer = integer; }
+	Variable(double real) : m_type(Type::eNUMBER) { m_value.number = real; }
+	Variable(const char *str) : m_type(Type::eSTRING) { m_value.string = str; }
+	Variable(std::string_view str) : m_type(Type::eSTRING) { m_value.string = str; }
+	Variable(bool boolean) : m_type(Type::eBOOL) { m_value.boolean = boolean; }
+
+	Variable &operator=(const Object &value) { m_type = Type::eOBJECT; m_value.object = value; return *this; }
+	Variable &operator=(const Array &value) { m_type = Type::eARRAY; m_value.array = value; return *this; }
+	Variable &operator=(double value) { m_type = Type::eNUMBER; m_value.number = value; return *this; }
+	Variable &operator=(int64_t value) { m_type = Type::eINTEGER; m_value.integer = value; return *this; }
+	Variable &operator=(const char *value) { m_type = Type::eSTRING; m_value.string = value; return *this; }
+	Variable &operator=(std::string_view value) { m_type = Type::eSTRING; m_value.string = value; return *this; }
+	Variable &operator=(bool value) { m_type = Type::eBOOL; m_value.boolean = value; return *this; }
 
 	operator Null() const { if (m_type != Type::eNULL) throw InvalidValue("Null type");  return Null(); }
 	operator Object&() { if (m_type != Type::eOBJECT) throw InvalidValue("Object type");  return m_value.object; }
@@ -122,123 +172,253 @@ public:
 	operator const Array&() const { if (m_type != Type::eARRAY) throw InvalidValue("Array type");  return m_value.array; }
 	operator double&() { if (m_type != Type::eNUMBER) throw InvalidValue("Number type");  return m_value.number; }
 	operator const double&() const { if (m_type != Type::eNUMBER) throw InvalidValue("Number type");  return m_value.number; }
-	operator std::string&() { if (m_type != Type::eSTRING) throw InvalidValue("String type");  return m_value.string; }
-	operator const std::string&() const { if (m_type != Type::eSTRING) throw InvalidValue("String type");  return m_value.string; }
+	operator int64_t&() { if (m_type != Type::eINTEGER) throw InvalidValue("Integer type");  return m_value.integer; }
+	operator const int64_t&() const { if (m_type != Type::eINTEGER) throw InvalidValue("Integer type");  return m_value.integer; }
+	operator std::string_view() const { if (m_type != Type::eSTRING) throw InvalidValue("String type");  return m_value.string; }
 	operator bool&() { if (m_type != Type::eBOOL) throw InvalidValue("Boolean type");  return m_value.boolean; }
 	operator const bool&() const { if (m_type != Type::eBOOL) throw InvalidValue("Boolean type");  return m_value.boolean; }
+	// Value of any number, integers are converted.
+	double number() const { if (m_type == Type::eINTEGER) return static_cast<double>(m_value.integer); return static_cast<const double&>(*this); }
 
+	Type type() const { return m_type; }
 	bool isNull() const { return m_type == Type::eNULL; }
 	bool isObject() const { return m_type == Type::eOBJECT; }
 	bool isArray() const { return m_type == Type::eARRAY; }
-	bool isNumber() const { return m_type == Type::eNUMBER; }
+	// Integers are numbers as well
+	bool isNumber() const { return m_type == Type::eNUMBER || m_type == Type::eINTEGER; }
+	bool isInteger() const { return m_type == Type::eINTEGER; }
 	bool isString() const { return m_type == Type::eSTRING; }
 	bool isBoolean() const { return m_type == Type::eBOOL; }
 
 private:
-	struct Value {
-		Value() {}
-		Value(const Object &object) : object(object) {}
-		Value(const Array &array) : array(array) {}
-		Value(double number) : number(number) {}
-		Value(const char *str) : string(str) {}
-		Value(const std::string &str) : string(str) {}
-		Value(bool boolean) : boolean(boolean) {}
+	union Value {
+		Value() : number(0.0) {}
 		Object object;
 		Array array;
 		double number;
-		std::string string;
+		int64_t integer;
+		std::string_view string;
 		bool boolean;
 	} m_value;
 	Type m_type;
 };
-    
-struct JSON {
-	JSON() {}
+
+struct Member {
+	Name name;
+	Variable value;
+};
+
+static_assert(std::is_trivially_copyable<Variable>::value, "Variable must be trivially copyable");
+static_assert(std::is_trivially_copyable<Member>::value, "Member must be trivially copyable");
+
+// Document, owns the arena of its nodes.
+// Strings without escape sequences point into the parsed source, which must outlive the document.
+class JSON {
+public:
+	JSON() : m_root(Object()) {}
+	JSON(JSON &&) = default;
+	JSON &operator=(JSON &&) = default;
+
+	Arena &arena() { return m_arena; }
+	Variable &root() { return m_root; }
+	const Variable &root() const { return m_root; }
 	operator Object&() { return m_root; }
 	operator const Object&() const { return m_root; }
 private:
-	Object m_root;
+	friend class Parser;
+	Arena m_arena;
+	Variable m_root;
 };
 // Into serializer
-struct Writer {
-	Writer(std::string &string) : m_string(string) {}
-	void set(char c) {
-		m_string += c;
-	}
-	size_t size() { return m_string.size(); }
+// Output sink of the serializer. Characters are gathered in a fixed buffer and flushed
+// to a string, a stream or a file when full, so the output never goes through temporaries.
+class Writer {
+public:
+	Writer(std::string &string);
+	Writer(std::ostream &stream);
+	Writer(FILE *file);
+	Writer(const Writer &) = delete;
+	Writer &operator=(const Writer &) = delete;
+	~Writer();
+
+	void set(char c);
+	void write(const char *data, size_t size);
+	void write(std::string_view string) { write(string.data(), string.size()); }
+	void flush();
+	// Number of characters written so far
+	size_t size() const { return m_written + m_size; }
 private:
-	std::string &m_string;
+	void output(const char *data, size_t size);
+private:
+	static const size_t capacity = 4096;
+	std::string *m_string;
+	std::ostream *m_stream;
+	FILE *m_file;
+	size_t m_size;
+	size_t m_written;
+	char m_buffer[capacity];
 };
 
+// Correctly rounded value of mantissa * 10^exponent, with the Eisel-Lemire algorithm.
+// Return false in the rare cases where 128 bits are not enough to decide the rounding.
+bool computeFloat(uint64_t mantissa, int64_t exponent, bool negative, double &value);
+
+// Write digits that parse back to the exact same double, with the Grisu2 algorithm
+// (shortest representation for the vast majority of values). Infinity & NaN are written as null.
+// The buffer must hold 32 characters, return the end of the written characters.
+char *writeDouble(double value, char *buffer);
+
 class Serializer {
 public:
 	Serializer();
+	Serializer(bool prettify);
+
+	// Write the document in a single pass into the writer.
+	void operator()(const json::JSON &json, Writer &writer);
+	void operator()(const json::Variable &variable, Writer &writer);
 
 	std::string operator()(const json::JSON &json);
-	std::string operator()(const json::Name &name);
 	std::string operator()(const json::Variable &variable);
 	std::string operator()(const json::Object &object);
 	std::string operator()(const json::Array &array);
 	std::string operator()(const json::Null &null);
-	std::string operator()(const std::string &string);
+	std::string operator()(std::string_view string);
 	std::string operator()(double number);
+	std::string operator()(int64_t integer);
 	std::string operator()(bool boolean);
+private:
+	void writeVariable(Writer &writer, const json::Variable &variable);
+	void writeObject(Writer &writer, const json::Object &object);
+	void writeArray(Writer &writer, const json::Array &array);
+	void writeString(Writer &writer, std::string_view string);
+	void writeNumber(Writer &writer, double number);
+	void writeInteger(Writer &writer, int64_t integer);
+	void writeIndent(Writer &writer);
 private:
 	bool m_prettify;
 	unsigned int m_depth;
 };
+
+// Build the index of every structural character of a document, in the style of simdjson.
+// Structurals are { } [ ] : , opening & closing quotes, and the first character of
+// literals & numbers, all outside strings. Characters are classified 64 at a time
+// with AVX2 or SSE2 depending on the CPU, with a scalar fallback on other platforms.
+// Return false & the offset of the error on unterminated strings or unescaped control characters.
+bool buildStructuralIndex(std::string_view str, std::vector<uint32_t> &structurals, size_t &errorOffset);
+
+// Throwing version, offsets are stored on 32 bits so documents are limited to 4GB.
+inline void indexStructurals(std::string_view str, std::vector<uint32_t> &structurals)
+{
+	if (str.size() > UINT32_MAX)
+		throw ParseError("Document too big", 0);
+	size_t errorOffset = 0;
+	if (!buildStructuralIndex(str, structurals, errorOffset))
+		throw ParseError("Invalid string", errorOffset);
+}
+
 // Into parser
 struct Reader {
-	Reader(const std::string &string) : m_string(string), m_offset(0) {}
-	// get next char
-	const char &get();
+	Reader(std::string_view string) : m_string(string), m_offset(0), m_structurals(nullptr), m_structuralCount(0), m_cursor(0) {}
+	// Whitespaces are skipped by walking the structural index instead of the characters.
+	Reader(std::string_view string, const std::vector<uint32_t> &structurals) : m_string(string), m_offset(0), m_structurals(structurals.data()), m_structuralCount(structurals.size()), m_cursor(0) {}
+	// get next char, '\0' at the end of the string
+	char get();
 	// get next char & skip everything until this.
-	const char &get(char c);
+	char get(char c);
 	// Get next valid character
-	const char &getValid();
-	// peek next char
-	const char &peek();
+	char getValid();
+	// peek next char without consuming it
+	char peek() const;
+	// peek next valid character without consuming it
+	char peekValid();
 	// Skip n char
 	void skip(size_t count = 1);
+	// Move forward to offset
+	void seek(size_t offset);
+	// Is the whole string consumed ?
+	bool eof() const;
+	size_t offset() const { return m_offset; }
+	size_t remaining() const { return m_string.size() - m_offset; }
+	// Remaining characters
+	const char *data() const { return m_string.data() + m_offset; }
+	// Offset of the first structural character at or after the current offset.
+	// Return the string size if there is none left, npos if the reader has no index.
+	size_t nextStructural();
+	bool indexed() const { return m_structurals != nullptr; }
 private:
-	const std::string &m_string;
+	std::string_view m_string;
 	size_t m_offset;
+	const uint32_t *m_structurals;
+	size_t m_structuralCount;
+	size_t m_cursor;
 };
 
-inline const char &Reader::get() {
+inline char Reader::get() {
+	if (m_offset >= m_string.size())
+		return '\0';
 	return m_string[m_offset++];
 }
-inline const char &Reader::get(char c) {
-	while (peek() != c)
+inline char Reader::get(char c) {
+	while (!eof() && peek() != c)
 		m_offset++;
 	return get();
 }
 inline bool isWhitespace(char c) {
 	return  c == '\r' || c == '\n' || c == '\t' || c == ' ';
 }
-inline const char &Reader::getValid() {
-	while (isWhitespace(peek()))
-		m_offset++;
+inline char Reader::getValid() {
+	peekValid();
 	return get();
 }
-inline const char &Reader::peek() {
-	return m_string[m_offset + 1];
+inline char Reader::peek() const {
+	if (m_offset >= m_string.size())
+		return '\0';
+	return m_string[m_offset];
+}
+inline char Reader::peekValid() {
+	if (m_structurals != nullptr)
+	{
+		// Tokens are always fully consumed, so anything but whitespace is already a structural.
+		if (isWhitespace(peek()))
+			m_offset = nextStructural();
+		return peek();
+	}
+	while (isWhitespace(peek()))
+		m_offset++;
+	return peek();
 }
 inline void Reader::skip(size_t count) {
 	m_offset += count;
 }
+inline void Reader::seek(size_t offset) {
+	m_offset = offset;
+}
+inline size_t Reader::nextStructural() {
+	if (m_structurals == nullptr)
+		return std::string_view::npos;
+	while (m_cursor < m_structuralCount && m_structurals[m_cursor] < m_offset)
+		m_cursor++;
+	return (m_cursor < m_structuralCount) ? m_structurals[m_cursor] : m_string.size();
+}
+inline bool Reader::eof() const {
+	return m_offset >= m_string.size();
+}
 
+// Single pass recursive descent parser.
+// Children are gathered on scratch stacks and copied contiguously in the
+// document arena once their container is closed.
 class Parser {
 public:
 	Parser();
 
 	enum class Token {
-		UNINTIALIZED, 
+		UNINTIALIZED,
 		BOOLEAN_TRUE,
 		BOOLEAN_FALSE,
 		NULL_VALUE,
 		STRING_VALUE,
-		NUMBER_VALUE, // TODO split as int, uint, float
+		INTEGER_VALUE,
+		NUMBER_VALUE,
 		ARRAY_START,      // [
 		ARRAY_END,        // {
 		OBJECT_START,     // ]
@@ -247,59 +427,228 @@ public:
 		VALUE_SEPARATOR,  // ,
 	};
 
-	json::JSON operator()(const std::string &str);
-	bool validate(const std::string &str);
+	// The string must outlive the returned document.
+	json::JSON operator()(std::string_view str);
+	bool validate(std::string_view str);
 private:
-	json::Name parseName(Reader &str);
-	json::Variable parseVariable(Reader &str);
-	json::Object parseObject(Reader &str);
-	json::Array parseArray(Reader &str);
-	json::Variable parseNull(Reader &str);
-	std::string parseString(Reader &str);
-	double parseNumber(Reader &str);
-	bool parseBoolean(Reader &str);
-	const char &get();
+	json::Name parseName(Reader &reader, Arena &arena);
+	json::Variable parseVariable(Reader &reader, Arena &arena);
+	json::Object parseObject(Reader &reader, Arena &arena);
+	json::Array parseArray(Reader &reader, Arena &arena);
+	json::Variable parseNull(Reader &reader);
+	std::string_view parseString(Reader &reader, Arena &arena);
+	json::Variable parseNumber(Reader &reader);
+	bool parseBoolean(Reader &reader);
 private:
-	bool m_prettify;
+	static const unsigned int maxDepth = 512;
+	std::vector<uint32_t> m_structurals;
+	std::vector<Member> m_members;
+	std::vector<Variable> m_values;
+	unsigned int m_depth;
+};
+
+// Returned by key events to tell the SaxParser what to do with the value.
+enum class Action {
+	ePARSE,	// Emit events for the value
+	eSKIP,	// Skip the value without decoding it
+	eSTOP,	// Stop parsing
+};
+
+// Default SAX handler, ignoring every event.
+// Handlers are used as template parameter, hide the events needed in a derived struct.
+// Returning false from an event stops the parsing.
+struct Handler {
+	bool null() { return true; }
+	bool boolean(bool) { return true; }
+	bool number(double) { return true; }
+	// Numbers without fraction nor exponent, fitting on 64 bits.
+	bool integer(int64_t) { return true; }
+	// Views are only valid during the call.
+	bool string(std::string_view) { return true; }
+	bool startObject() { return true; }
+	Action key(std::string_view) { return Action::ePARSE; }
+	bool endObject() { return true; }
+	bool startArray() { return true; }
+	bool endArray() { return true; }
+};
+
+// Event driven parser, no node is allocated.
+// Memory usage only depends on the nesting depth & the longest escaped string, so the
+// characters are scanned directly: the structural index would grow with the document.
+template <typename T>
+class SaxParser {
+public:
+	SaxParser(T &handler);
+
+	// Return false if the handler stopped the parsing.
+	bool operator()(std::string_view str);
+private:
+	bool parseVariable(Reader &reader);
+	bool parseObject(Reader &reader);
+	bool parseArray(Reader &reader);
+	std::string_view parseString(Reader &reader);
+private:
+	static const unsigned int maxDepth = 512;
+	T &m_handler;
+	std::string m_scratch;
 	unsigned int m_depth;
 };
 
 
 // ------ Declaration
+// --- Arena
+inline Arena::Arena(size_t blockSize) :
+	m_block(nullptr),
+	m_blockSize(blockSize)
+{
+}
+inline Arena::Arena(Arena &&arena) :
+	m_block(arena.m_block),
+	m_blockSize(arena.m_blockSize)
+{
+	arena.m_block = nullptr;
+}
+inline Arena &Arena::operator=(Arena &&arena)
+{
+	if (this != &arena)
+	{
+		clear();
+		m_block = arena.m_block;
+		m_blockSize = arena.m_blockSize;
+		arena.m_block = nullptr;
+	}
+	return *this;
+}
+inline Arena::~Arena()
+{
+	clear();
+}
+inline void *Arena::allocate(size_t size, size_t alignment)
+{
+	if (m_block != nullptr)
+	{
+		size_t offset = (m_block->offset + alignment - 1) & ~(alignment - 1);
+		if (offset + size <= m_block->size)
+		{
+			m_block->offset = offset + size;
+			return m_block->data() + offset;
+		}
+	}
+	// Header size keeps the data aligned on max_align_t.
+	static_assert(sizeof(Block) % alignof(std::max_align_t) == 0, "Invalid block header size");
+	size_t blockSize = (m_blockSize > size + alignment) ? m_blockSize : size + alignment;
+	Block *block = static_cast<Block*>(std::malloc(sizeof(Block) + blockSize));
+	if (block == nullptr)
+		throw std::bad_alloc();
+	block->next = m_block;
+	block->size = blockSize;
+	block->offset = size;
+	m_block = block;
+	return block->data();
+}
+inline std::string_view Arena::copy(std::string_view str)
+{
+	char *data = allocate<char>(str.size());
+	std::memcpy(data, str.data(), str.size());
+	return std::string_view(data, str.size());
+}
+inline void Arena::clear()
+{
+	while (m_block != nullptr)
+	{
+		Block *next = m_block->next;
+		std::free(m_block);
+		m_block = next;
+	}
+}
 // --- Object
-inline Object::Object()
+inline Object::Object() :
+	m_members(nullptr),
+	m_size(0),
+	m_capacity(0)
 {
 }
-inline Variable &Object::operator[](const Name &index)
+inline Variable &Object::operator[](Name name)
 {
-	return m_nodes.at(index);
-} // TODO do not throw
-inline const Variable &Object::operator[](const Name &index) const
+	Variable *variable = find(name);
+	if (variable == nullptr)
+		throw InvalidValue("Missing member " + std::string(name));
+	return *variable;
+}
+inline const Variable &Object::operator[](Name name) const
 {
-	return m_nodes.at(index);
-} // TODO do not throw
-inline void Object::add(const Name &name, const Variable &variable)
+	const Variable *variable = find(name);
+	if (variable == nullptr)
+		throw InvalidValue("Missing member " + std::string(name));
+	return *variable;
+}
+inline Variable *Object::find(Name name)
 {
-	m_nodes.insert(std::make_pair(name, variable));
+	// Objects are small, linear search is faster than hashing here.
+	for (uint32_t iMember = 0; iMember < m_size; iMember++)
+		if (m_members[iMember].name == name)
+			return &m_members[iMember].value;
+	return nullptr;
 }
-inline void Object::add(const Name &name, Variable &&variable)
+inline const Variable *Object::find(Name name) const
 {
-	m_nodes.insert(std::make_pair(name, variable));
+	for (uint32_t iMember = 0; iMember < m_size; iMember++)
+		if (m_members[iMember].name == name)
+			return &m_members[iMember].value;
+	return nullptr;
 }
-inline void Object::remove(const Name &name)
+inline bool Object::contains(Name name) const
 {
-
+	return find(name) != nullptr;
+}
+inline void Object::add(Arena &arena, Name name, const Variable &variable)
+{
+	if (m_size == m_capacity)
+	{
+		uint32_t capacity = (m_capacity == 0) ? 4 : m_capacity * 2;
+		Member *members = arena.allocate<Member>(capacity);
+		if (m_size > 0)
+			std::memcpy(members, m_members, m_size * sizeof(Member));
+		m_members = members;
+		m_capacity = capacity;
+	}
+	m_members[m_size].name = name;
+	m_members[m_size].value = variable;
+	m_size++;
+}
+inline void Object::remove(Name name)
+{
+	for (uint32_t iMember = 0; iMember < m_size; iMember++)
+	{
+		if (m_members[iMember].name == name)
+		{
+			std::memmove(&m_members[iMember], &m_members[iMember + 1], (m_size - iMember - 1) * sizeof(Member));
+			m_size--;
+			return;
+		}
+	}
 }
 inline size_t Object::size() const
 {
-	return m_nodes.size();
+	return m_size;
 }
+inline Object::iterator Object::begin() { return m_members; }
+inline Object::const_iterator Object::begin() const { return m_members; }
+inline Object::iterator Object::end() { return m_members + m_size; }
+inline Object::const_iterator Object::end() const { return m_members + m_size; }
 // --- Array
-inline Array::Array()
+inline Array::Array() :
+	m_data(nullptr),
+	m_size(0),
+	m_capacity(0)
 {
 }
-inline Array::Array(const std::initializer_list<Variable> &list) : m_data(list)
+inline Array::Array(Arena &arena, const std::initializer_list<Variable> &list) :
+	Array()
 {
+	reserve(arena, static_cast<uint32_t>(list.size()));
+	for (const Variable &variable : list)
+		m_data[m_size++] = variable;
 }
 inline Variable &Array::operator[](size_t index)
 {
@@ -309,24 +658,43 @@ inline const Variable &Array::operator[](size_t index) const
 {
 	return m_data[index];
 }
-inline void Array::add(const Variable &variable)
+inline void Array::reserve(Arena &arena, uint32_t capacity)
 {
-	m_data.push_back(variable);
+	if (capacity <= m_capacity)
+		return;
+	Variable *data = arena.allocate<Variable>(capacity);
+	if (m_size > 0)
+		std::memcpy(data, m_data, m_size * sizeof(Variable));
+	m_data = data;
+	m_capacity = capacity;
 }
-inline void Array::add(Variable &&variable)
+inline void Array::add(Arena &arena, const Variable &variable)
 {
-	m_data.push_back(variable);
+	if (m_size == m_capacity)
+		reserve(arena, (m_capacity == 0) ? 4 : m_capacity * 2);
+	m_data[m_size++] = variable;
 }
-inline void Array::insert(size_t index, const Variable &variable)
+inline void Array::insert(Arena &arena, size_t index, const Variable &variable)
 {
+	if (m_size == m_capacity)
+		reserve(arena, (m_capacity == 0) ? 4 : m_capacity * 2);
+	std::memmove(&m_data[index + 1], &m_data[index], (m_size - index) * sizeof(Variable));
+	m_data[index] = variable;
+	m_size++;
 }
 inline void Array::remove(size_t index)
 {
+	std::memmove(&m_data[index], &m_data[index + 1], (m_size - index - 1) * sizeof(Variable));
+	m_size--;
 }
 inline size_t Array::size() const
 {
-	return m_data.size();
+	return m_size;
 }
+inline Array::iterator Array::begin() { return m_data; }
+inline Array::const_iterator Array::begin() const { return m_data; }
+inline Array::iterator Array::end() { return m_data + m_size; }
+inline Array::const_iterator Array::end() const { return m_data + m_size; }
 // --- Null
 inline Null::Null()
 {
@@ -335,243 +703,937 @@ inline Null::Null()
 
 // --------------------------------
 
+inline Writer::Writer(std::string &string) :
+	m_string(&string),
+	m_stream(nullptr),
+	m_file(nullptr),
+	m_size(0),
+	m_written(0)
+{
+}
+inline Writer::Writer(std::ostream &stream) :
+	m_string(nullptr),
+	m_stream(&stream),
+	m_file(nullptr),
+	m_size(0),
+	m_written(0)
+{
+}
+inline Writer::Writer(FILE *file) :
+	m_string(nullptr),
+	m_stream(nullptr),
+	m_file(file),
+	m_size(0),
+	m_written(0)
+{
+}
+inline Writer::~Writer()
+{
+	flush();
+}
+inline void Writer::set(char c)
+{
+	if (m_size == capacity)
+		flush();
+	m_buffer[m_size++] = c;
+}
+inline void Writer::write(const char *data, size_t size)
+{
+	if (size > capacity - m_size)
+	{
+		flush();
+		if (size >= capacity)
+		{
+			// Big chunks bypass the buffer
+			output(data, size);
+			m_written += size;
+			return;
+		}
+	}
+	std::memcpy(m_buffer + m_size, data, size);
+	m_size += size;
+}
+inline void Writer::flush()
+{
+	output(m_buffer, m_size);
+	m_written += m_size;
+	m_size = 0;
+}
+inline void Writer::output(const char *data, size_t size)
+{
+	if (size == 0)
+		return;
+	if (m_string != nullptr)
+		m_string->append(data, size);
+	else if (m_stream != nullptr)
+		m_stream->write(data, size);
+	else if (m_file != nullptr)
+		std::fwrite(data, 1, size, m_file);
+}
+
 inline Serializer::Serializer() :
-	m_prettify(true),
+	Serializer(true)
+{
+}
+
+inline Serializer::Serializer(bool prettify) :
+	m_prettify(prettify),
 	m_depth(0)
 {
+}
 
+inline void Serializer::operator()(const JSON &json, Writer &writer)
+{
+	writeVariable(writer, json.root());
 }
 
-inline std::string Serializer::operator()(const JSON &json)
+inline void Serializer::operator()(const json::Variable &variable, Writer &writer)
 {
-	return this->operator()(static_cast<json::Object>(json));
+	writeVariable(writer, variable);
 }
 
-inline std::string Serializer::operator()(const json::Name & name)
+inline std::string Serializer::operator()(const JSON &json)
 {
-	return this->operator()(name.name());
+	return this->operator()(json.root());
 }
+
 inline std::string Serializer::operator()(const json::Variable &variable)
 {
-	if (variable.isObject())
-	{
-		return this->operator()(static_cast<json::Object>(variable));
-	}
-	else if (variable.isArray())
-	{
-		return this->operator()(static_cast<json::Array>(variable));
-	}
-	else if (variable.isNumber())
-	{
-		return this->operator()(static_cast<double>(variable));
-	}
-	else if (variable.isString())
-	{
-		return this->operator()(static_cast<std::string>(variable));
-	}
-	else if (variable.isBoolean())
-	{
-		return this->operator()(static_cast<bool>(variable));
-	}
-	else // Default is null
-	{
-		return this->operator()(static_cast<json::Null>(variable));
-	}
+	std::string str;
+	Writer writer(str);
+	writeVariable(writer, variable);
+	writer.flush();
+	return str;
 }
 inline std::string Serializer::operator()(const json::Object &object)
 {
 	std::string str;
-	str += '{';
-	if(m_prettify)
-		str += '\n';
+	Writer writer(str);
+	writeObject(writer, object);
+	writer.flush();
+	return str;
+}
+inline std::string Serializer::operator()(const json::Array &array)
+{
+	std::string str;
+	Writer writer(str);
+	writeArray(writer, array);
+	writer.flush();
+	return str;
+}
+inline std::string Serializer::operator()(double number)
+{
+	char buffer[32];
+	return std::string(buffer, writeDouble(number, buffer));
+}
+inline std::string Serializer::operator()(int64_t integer)
+{
+	char buffer[24];
+	return std::string(buffer, std::to_chars(buffer, buffer + sizeof(buffer), integer).ptr);
+}
+inline std::string Serializer::operator()(std::string_view string)
+{
+	std::string str;
+	Writer writer(str);
+	writeString(writer, string);
+	writer.flush();
+	return str;
+}
+inline std::string Serializer::operator()(bool boolean)
+{
+	if (boolean) return "true";
+	return "false";
+}
+inline std::string Serializer::operator()(const Null &null)
+{
+	return "null";
+}
+
+inline void Serializer::writeVariable(Writer &writer, const json::Variable &variable)
+{
+	switch (variable.type())
+	{
+	case Variable::Type::eOBJECT:
+		writeObject(writer, static_cast<const json::Object&>(variable));
+		break;
+	case Variable::Type::eARRAY:
+		writeArray(writer, static_cast<const json::Array&>(variable));
+		break;
+	case Variable::Type::eNUMBER:
+		writeNumber(writer, static_cast<const double&>(variable));
+		break;
+	case Variable::Type::eINTEGER:
+		writeInteger(writer, static_cast<const int64_t&>(variable));
+		break;
+	case Variable::Type::eSTRING:
+		writeString(writer, static_cast<std::string_view>(variable));
+		break;
+	case Variable::Type::eBOOL:
+		if (static_cast<const bool&>(variable))
+			writer.write("true", 4);
+		else
+			writer.write("false", 5);
+		break;
+	default: // Default is null
+		writer.write("null", 4);
+		break;
+	}
+}
+inline void Serializer::writeObject(Writer &writer, const json::Object &object)
+{
+	writer.set('{');
+	if (m_prettify)
+		writer.set('\n');
 	size_t elemCount = 0;
 	m_depth++;
-	for(const std::pair<json::Name, json::Variable> &element : object)
+	for (const json::Member &element : object)
 	{
 		bool lastElement = (++elemCount == object.size());
+		writeIndent(writer);
+		writeString(writer, element.name);
+		writer.write(": ", 2);
+		writeVariable(writer, element.value);
+		if (!lastElement)
+			writer.set(',');
 		if (m_prettify)
-			for (unsigned int i = 0; i < m_depth; i++)
-				str += '\t';
-		str += this->operator()(element.first);
-		str += ": ";
-		str += this->operator()(element.second);
-		if(!lastElement)
-			str += ',';
-		if (m_prettify)
-			str += '\n';
+			writer.set('\n');
 	}
 	m_depth--;
-	if(m_prettify)
-	for (unsigned int i = 0; i < m_depth; i++)
-		str += '\t';
-	str += '}';
-	return str;
+	writeIndent(writer);
+	writer.set('}');
 }
-inline std::string Serializer::operator()(const json::Array &array)
+inline void Serializer::writeArray(Writer &writer, const json::Array &array)
 {
-	std::string str;
-	str += '[';
+	writer.set('[');
 	for (size_t iVar = 0; iVar < array.size(); iVar++)
 	{
-		const json::Variable &var = array[iVar];
-		str += (*this)(var);
+		writeVariable(writer, array[iVar]);
 		if (iVar != (array.size() - 1)) {
-			str += ',';
+			writer.set(',');
 			if (m_prettify)
-				str += ' ';
+				writer.set(' ');
 		}
 	}
-	str += ']';
-	return str;
+	writer.set(']');
 }
-inline std::string Serializer::operator()(double number)
+inline void Serializer::writeString(Writer &writer, std::string_view string)
 {
-	// TODO optimizer formatting
-	// TODO support e & E for exponent
-	std::string s(16, '\0');
-	int written = std::snprintf(&s[0], s.size(), "%.2f", number);
-	s.resize(written);
-	return s;
+	static const char hex[] = "0123456789abcdef";
+	writer.set('"');
+	// Copy runs of plain characters, escape quotes, backslashes & control characters.
+	size_t begin = 0;
+	for (size_t i = 0; i < string.size(); i++)
+	{
+		const unsigned char c = static_cast<unsigned char>(string[i]);
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+		writer.write(string.data() + begin, i - begin);
+		begin = i + 1;
+		writer.set('\\');
+		switch (c)
+		{
+		case '"': writer.set('"'); break;
+		case '\\': writer.set('\\'); break;
+		case '\b': writer.set('b'); break;
+		case '\f': writer.set('f'); break;
+		case '\n': writer.set('n'); break;
+		case '\r': writer.set('r'); break;
+		case '\t': writer.set('t'); break;
+		default: {
+			const char unicode[5] = { 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+			writer.write(unicode, 5);
+			break;
+		}
+		}
+	}
+	writer.write(string.data() + begin, string.size() - begin);
+	writer.set('"');
 }
-inline std::string Serializer::operator()(const std::string &string)
+inline void Serializer::writeNumber(Writer &writer, double number)
 {
-	// is u supported
-	// TODO sanitize string
-	return '"' + string + '"';
+	char buffer[32];
+	writer.write(buffer, writeDouble(number, buffer) - buffer);
 }
-inline std::string Serializer::operator()(bool boolean)
+inline void Serializer::writeInteger(Writer &writer, int64_t integer)
 {
-	if (boolean) return "true";
-	return "false";
+	char buffer[24];
+	writer.write(buffer, std::to_chars(buffer, buffer + sizeof(buffer), integer).ptr - buffer);
 }
-inline std::string Serializer::operator()(const Null &null)
+inline void Serializer::writeIndent(Writer &writer)
 {
-	return "null";
+	if (!m_prettify)
+		return;
+	for (unsigned int i = 0; i < m_depth; i++)
+		writer.set('\t');
+}
+
+// --- Tokens
+// Scalars must be followed by a delimiter, "truex" or "01" are not valid.
+inline bool isDelimiter(char c)
+{
+	return isWhitespace(c) || c == ',' || c == ']' || c == '}' || c == ':' || c == '\0';
 }
 
-inline Parser::Parser()
+inline void readLiteral(Reader &reader, const char *literal, size_t size)
 {
+	if (reader.remaining() < size || std::memcmp(reader.data(), literal, size) != 0)
+		throw ParseError("Invalid literal", reader.offset());
+	reader.skip(size);
+	if (!isDelimiter(reader.peek()))
+		throw ParseError("Invalid literal", reader.offset());
 }
 
-inline json::JSON Parser::operator()(const std::string & str)
+inline void encodeUTF8(uint32_t codepoint, char *&out)
+{
+	if (codepoint < 0x80)
+	{
+		*out++ = static_cast<char>(codepoint);
+	}
+	else if (codepoint < 0x800)
+	{
+		*out++ = static_cast<char>(0xC0 | (codepoint >> 6));
+		*out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+	else if (codepoint < 0x10000)
+	{
+		*out++ = static_cast<char>(0xE0 | (codepoint >> 12));
+		*out++ = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		*out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+	else
+	{
+		*out++ = static_cast<char>(0xF0 | (codepoint >> 18));
+		*out++ = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+		*out++ = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		*out++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+}
+
+inline uint32_t parseHex4(const char *str, size_t offset)
+{
+	uint32_t value = 0;
+	for (size_t i = 0; i < 4; i++)
+	{
+		char c = str[i];
+		value <<= 4;
+		if (c >= '0' && c <= '9') value |= c - '0';
+		else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+		else throw ParseError("Invalid unicode escape", offset + i);
+	}
+	return value;
+}
+
+// Read a string at the reader position.
+// Strings without escape sequence are returned as a view in the source. Others are decoded
+// in the buffer returned by allocate(size), size being an upper bound of the decoded length.
+template <typename Allocator>
+inline std::string_view readString(Reader &reader, Allocator allocate)
+{
+	if (reader.get() != '"')
+		throw ParseError("Expected string", reader.offset());
+	// Fast path, strings without escape sequence are returned as a view in the source.
+	const char *begin = reader.data();
+	const size_t remaining = reader.remaining();
+	if (reader.indexed())
+	{
+		// Closing quote is the next structural, control characters were checked by the index.
+		const size_t end = reader.nextStructural();
+		if (end >= reader.offset() + remaining)
+			throw ParseError("Unterminated string", reader.offset());
+		const size_t size = end - reader.offset();
+		if (std::memchr(begin, '\\', size) == nullptr)
+		{
+			reader.skip(size + 1);
+			return std::string_view(begin, size);
+		}
+	}
+	size_t length = 0;
+	while (length < remaining && begin[length] != '"' && begin[length] != '\\')
+	{
+		if (static_cast<unsigned char>(begin[length]) < 0x20)
+			throw ParseError("Control character in string", reader.offset() + length);
+		length++;
+	}
+	if (length == remaining)
+		throw ParseError("Unterminated string", reader.offset());
+	if (begin[length] == '"')
+	{
+		reader.skip(length + 1);
+		return std::string_view(begin, length);
+	}
+	// Escaped strings are decoded in the arena, output is never longer than the input.
+	size_t end = length;
+	while (end < remaining && begin[end] != '"')
+		end += (begin[end] == '\\') ? 2 : 1;
+	if (end >= remaining)
+		throw ParseError("Unterminated string", reader.offset());
+	char *data = allocate(end);
+	char *out = data;
+	std::memcpy(out, begin, length);
+	out += length;
+	reader.skip(length);
+	while (true)
+	{
+		char c = reader.get();
+		if (c == '"')
+			break;
+		if (static_cast<unsigned char>(c) < 0x20)
+			throw ParseError("Control character in string", reader.offset() - 1);
+		if (c != '\\')
+		{
+			*out++ = c;
+			continue;
+		}
+		switch (reader.get())
+		{
+		case '"': *out++ = '"'; break;
+		case '\\': *out++ = '\\'; break;
+		case '/': *out++ = '/'; break;
+		case 'b': *out++ = '\b'; break;
+		case 'f': *out++ = '\f'; break;
+		case 'n': *out++ = '\n'; break;
+		case 'r': *out++ = '\r'; break;
+		case 't': *out++ = '\t'; break;
+		case 'u': {
+			if (reader.remaining() < 4)
+				throw ParseError("Invalid unicode escape", reader.offset());
+			uint32_t codepoint = parseHex4(reader.data(), reader.offset());
+			reader.skip(4);
+			if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+			{
+				// Surrogate pair
+				if (reader.remaining() < 6 || reader.data()[0] != '\\' || reader.data()[1] != 'u')
+					throw ParseError("Invalid surrogate pair", reader.offset());
+				uint32_t low = parseHex4(reader.data() + 2, reader.offset() + 2);
+				if (low < 0xDC00 || low > 0xDFFF)
+					throw ParseError("Invalid surrogate pair", reader.offset());
+				reader.skip(6);
+				codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+			}
+			encodeUTF8(codepoint, out);
+			break;
+		}
+		default:
+			throw ParseError("Invalid escape sequence", reader.offset() - 1);
+		}
+	}
+	return std::string_view(data, out - data);
+}
+
+// Tokens without fraction nor exponent are integers when they fit on 64 bits.
+inline Variable readNumber(Reader &reader)
+{
+	// Exact powers of ten representable as double.
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const char *begin = reader.data();
+	const char *end = begin + reader.remaining();
+	const char *c = begin;
+	bool negative = false;
+	if (c != end && *c == '-')
+	{
+		negative = true;
+		c++;
+	}
+	if (c == end || *c < '0' || *c > '9')
+		throw ParseError("Invalid number", reader.offset());
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool integer = true;
+	if (*c == '0')
+	{
+		c++;
+	}
+	else
+	{
+		for (; c != end && *c >= '0' && *c <= '9'; c++, digits++)
+			if (digits < 19)
+				mantissa = mantissa * 10 + (*c - '0');
+			else
+				exponent++;
+	}
+	if (c != end && *c == '.')
+	{
+		c++;
+		integer = false;
+		if (c == end || *c < '0' || *c > '9')
+			throw ParseError("Invalid number", reader.offset() + (c - begin));
+		for (; c != end && *c >= '0' && *c <= '9'; c++)
+		{
+			if (mantissa == 0 && *c == '0')
+			{
+				exponent--; // Leading zeros are not significant
+			}
+			else if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*c - '0');
+				digits++;
+				exponent--;
+			}
+			else
+			{
+				digits++;
+			}
+		}
+	}
+	if (c != end && (*c == 'e' || *c == 'E'))
+	{
+		c++;
+		integer = false;
+		bool negativeExponent = false;
+		if (c != end && (*c == '+' || *c == '-'))
+			negativeExponent = (*c++ == '-');
+		if (c == end || *c < '0' || *c > '9')
+			throw ParseError("Invalid number", reader.offset() + (c - begin));
+		int value = 0;
+		for (; c != end && *c >= '0' && *c <= '9'; c++)
+			if (value < 100000)
+				value = value * 10 + (*c - '0');
+		exponent += negativeExponent ? -value : value;
+	}
+	if (c != end && !isDelimiter(*c))
+		throw ParseError("Invalid number", reader.offset() + (c - begin));
+	const size_t length = c - begin;
+	reader.skip(length);
+	if (integer && digits <= 19)
+	{
+		const uint64_t max = static_cast<uint64_t>(INT64_MAX);
+		if (!negative && mantissa <= max)
+			return static_cast<int64_t>(mantissa);
+		// -0 stays a floating point value to keep its sign.
+		if (negative && mantissa != 0 && mantissa <= max + 1)
+			return -static_cast<int64_t>(mantissa - 1) - 1;
+	}
+	// Clinger fast path, exact when mantissa & power of ten are exact doubles.
+	if (digits <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double value = static_cast<double>(mantissa);
+		value = (exponent < 0) ? value / powers[-exponent] : value * powers[exponent];
+		return negative ? -value : value;
+	}
+	// Eisel-Lemire, truncated digits are only used when they can't change the rounding.
+	double value, upper;
+	if (computeFloat(mantissa, exponent, negative, value) && (digits <= 19 || (computeFloat(mantissa + 1, exponent, negative, upper) && value == upper)))
+		return value;
+	// Slow path, correctly rounded by the CRT.
+	std::string str(begin, length);
+	return std::strtod(str.c_str(), nullptr);
+}
+
+
+// Skip the value at the reader position without decoding it.
+inline void skipValue(Reader &reader)
+{
+	switch (reader.peekValid())
+	{
+	case '"': {
+		reader.skip();
+		while (true)
+		{
+			char c = reader.get();
+			if (c == '"')
+				return;
+			if (c == '\\')
+				reader.skip();
+			else if (c == '\0' && reader.eof())
+				throw ParseError("Unterminated string", reader.offset());
+		}
+	}
+	case '{':
+	case '[': {
+		if (reader.indexed())
+		{
+			// Brackets inside strings are not indexed, only walk the structurals.
+			size_t depth = 0;
+			do
+			{
+				const size_t offset = reader.nextStructural();
+				if (offset >= reader.offset() + reader.remaining())
+					throw ParseError("Unterminated container", offset);
+				reader.seek(offset);
+				switch (reader.get())
+				{
+				case '{':
+				case '[':
+					depth++;
+					break;
+				case '}':
+				case ']':
+					depth--;
+					break;
+				}
+			} while (depth > 0);
+			return;
+		}
+		// Only track nesting, strings are skipped as they may contain brackets.
+		size_t depth = 0;
+		do
+		{
+			char c = reader.get();
+			switch (c)
+			{
+			case '{':
+			case '[':
+				depth++;
+				break;
+			case '}':
+			case ']':
+				depth--;
+				break;
+			case '"':
+				while ((c = reader.get()) != '"')
+				{
+					if (c == '\\')
+						reader.skip();
+					else if (c == '\0' && reader.eof())
+						throw ParseError("Unterminated string", reader.offset());
+				}
+				break;
+			case '\0':
+				if (reader.eof())
+					throw ParseError("Unterminated container", reader.offset());
+				break;
+			}
+		} while (depth > 0);
+		return;
+	}
+	case 't':
+		readLiteral(reader, "true", 4);
+		return;
+	case 'f':
+		readLiteral(reader, "false", 5);
+		return;
+	case 'n':
+		readLiteral(reader, "null", 4);
+		return;
+	default:
+		readNumber(reader);
+		return;
+	}
+}
+
+// --- Parser
+inline Parser::Parser() :
+	m_depth(0)
+{
+}
+
+inline json::JSON Parser::operator()(std::string_view str)
 {
 	JSON json;
-	Object &obj = json;
-	Reader reader(str);
-	obj = parseObject(reader);
+	indexStructurals(str, m_structurals);
+	Reader reader(str, m_structurals);
+	m_depth = 0;
+	m_members.clear();
+	m_values.clear();
+	json.m_root = parseVariable(reader, json.m_arena);
+	if (reader.peekValid() != '\0' || !reader.eof())
+		throw ParseError("Unexpected character after root value", reader.offset());
 	return json;
 }
 
-inline json::Name Parser::parseName(Reader& reader)
+inline bool Parser::validate(std::string_view str)
 {
-	if (reader.getValid() != '"')
-		throw InvalidValue("");
-	char c;
-	std::string name;
-	while ((c = reader.get()) != '"') // TODO check for '\"'
+	try
 	{
-		name += c;
-		c = reader.get();
+		(*this)(str);
+		return true;
+	}
+	catch (const Exception &)
+	{
+		return false;
 	}
-	// TODO sanitize string
-	return json::Name(name);
 }
 
-inline json::Variable Parser::parseVariable(Reader& reader)
+inline json::Name Parser::parseName(Reader &reader, Arena &arena)
 {
-	Variable::Type type = Variable::Type::eNULL;
-	switch (reader.peek())
+	if (reader.peekValid() != '"')
+		throw ParseError("Expected name", reader.offset());
+	return parseString(reader, arena);
+}
+
+inline json::Variable Parser::parseVariable(Reader &reader, Arena &arena)
+{
+	switch (reader.peekValid())
 	{
 	case '[':
-		return parseArray(reader);
+		return parseArray(reader, arena);
 	case '{':
-		return parseObject(reader);
+		return parseObject(reader, arena);
 	case '"':
-		return parseString(reader);
+		return parseString(reader, arena);
 	case 't':
 	case 'f':
 		return parseBoolean(reader);
 	case 'n':
-	case 'N':
 		return parseNull(reader);
-	default:
+	case '-':
+	case '0': case '1': case '2': case '3': case '4':
+	case '5': case '6': case '7': case '8': case '9':
 		return parseNumber(reader);
-		throw InvalidValue("Invalid value");
+	default:
+		throw ParseError("Invalid value", reader.offset());
 	}
 }
 
-inline json::Object Parser::parseObject(Reader& reader)
+inline json::Object Parser::parseObject(Reader &reader, Arena &arena)
 {
-	json::Object object;
 	if (reader.getValid() != '{')
-		throw InvalidValue("");
+		throw ParseError("Expected object", reader.offset());
+	if (++m_depth > maxDepth)
+		throw ParseError("Maximum depth reached", reader.offset());
+	json::Object object;
+	if (reader.peekValid() == '}')
+	{
+		reader.skip();
+		m_depth--;
+		return object;
+	}
+	const size_t start = m_members.size();
 	while (true)
 	{
-		json::Name name = parseName(reader);
+		json::Name name = parseName(reader, arena);
 		if (reader.getValid() != ':')
-			throw InvalidValue("");
-		json::Variable var = parseVariable(reader);
-		object.add(std::move(name), std::move(var));
+			throw ParseError("Expected ':'", reader.offset());
+		json::Variable var = parseVariable(reader, arena);
+		m_members.push_back(Member{ name, var });
 		switch (reader.getValid())
 		{
-		case '}':
+		case '}': {
+			const size_t count = m_members.size() - start;
+			object.m_members = arena.allocate<Member>(count);
+			object.m_size = static_cast<uint32_t>(count);
+			object.m_capacity = static_cast<uint32_t>(count);
+			std::memcpy(object.m_members, &m_members[start], count * sizeof(Member));
+			m_members.resize(start);
+			m_depth--;
 			return object;
+		}
 		case ',':
 			continue;
 		default:
-			throw InvalidValue("");
+			throw ParseError("Expected ',' or '}'", reader.offset());
 		}
 	}
 }
 
-inline json::Array Parser::parseArray(Reader& reader)
+inline json::Array Parser::parseArray(Reader &reader, Arena &arena)
 {
 	if (reader.getValid() != '[')
-		throw InvalidValue("");
+		throw ParseError("Expected array", reader.offset());
+	if (++m_depth > maxDepth)
+		throw ParseError("Maximum depth reached", reader.offset());
 	json::Array array;
-	char c;
-	std::string value;
-	while ((c = reader.get()) != '"') // TODO check for '\"'
+	if (reader.peekValid() == ']')
 	{
-		//name += c;
-		c = reader.get();
+		reader.skip();
+		m_depth--;
+		return array;
+	}
+	const size_t start = m_values.size();
+	while (true)
+	{
+		json::Variable var = parseVariable(reader, arena);
+		m_values.push_back(var);
+		switch (reader.getValid())
+		{
+		case ']': {
+			const size_t count = m_values.size() - start;
+			array.m_data = arena.allocate<Variable>(count);
+			array.m_size = static_cast<uint32_t>(count);
+			array.m_capacity = static_cast<uint32_t>(count);
+			std::memcpy(array.m_data, &m_values[start], count * sizeof(Variable));
+			m_values.resize(start);
+			m_depth--;
+			return array;
+		}
+		case ',':
+			continue;
+		default:
+			throw ParseError("Expected ',' or ']'", reader.offset());
+		}
 	}
-	return json::Array();
 }
 
-inline json::Variable Parser::parseNull(Reader& reader)
+inline json::Variable Parser::parseNull(Reader &reader)
 {
-	if (reader.getValid() != 'n')
-		throw InvalidValue("");
+	readLiteral(reader, "null", 4);
 	return json::Variable();
 }
 
-inline std::string Parser::parseString(Reader& reader)
+inline std::string_view Parser::parseString(Reader &reader, Arena &arena)
 {
-	if (reader.getValid() != '"')
-		throw InvalidValue("");
-	return std::string();
+	return readString(reader, [&arena](size_t size) { return arena.allocate<char>(size); });
 }
 
-inline double Parser::parseNumber(Reader& reader)
+inline json::Variable Parser::parseNumber(Reader &reader)
 {
-	if (reader.getValid() != '[')
-		throw InvalidValue("");
-	return 0.0;
+	return readNumber(reader);
 }
 
-inline bool Parser::parseBoolean(Reader& reader)
+inline bool Parser::parseBoolean(Reader &reader)
 {
-	if (reader.getValid() != '[')
-		throw InvalidValue("");
+	if (reader.peek() == 't')
+	{
+		readLiteral(reader, "true", 4);
+		return true;
+	}
+	readLiteral(reader, "false", 5);
 	return false;
 }
 
+
+// --- SaxParser
+template <typename T>
+inline SaxParser<T>::SaxParser(T &handler) :
+	m_handler(handler),
+	m_depth(0)
+{
+}
+
+template <typename T>
+inline bool SaxParser<T>::operator()(std::string_view str)
+{
+	Reader reader(str);
+	m_depth = 0;
+	if (!parseVariable(reader))
+		return false;
+	if (reader.peekValid() != '\0' || !reader.eof())
+		throw ParseError("Unexpected character after root value", reader.offset());
+	return true;
+}
+
+template <typename T>
+inline bool SaxParser<T>::parseVariable(Reader &reader)
+{
+	switch (reader.peekValid())
+	{
+	case '[':
+		return parseArray(reader);
+	case '{':
+		return parseObject(reader);
+	case '"':
+		return m_handler.string(parseString(reader));
+	case 't':
+		readLiteral(reader, "true", 4);
+		return m_handler.boolean(true);
+	case 'f':
+		readLiteral(reader, "false", 5);
+		return m_handler.boolean(false);
+	case 'n':
+		readLiteral(reader, "null", 4);
+		return m_handler.null();
+	case '-':
+	case '0': case '1': case '2': case '3': case '4':
+	case '5': case '6': case '7': case '8': case '9':
+	{
+		const Variable number = readNumber(reader);
+		if (number.isInteger())
+			return m_handler.integer(static_cast<const int64_t&>(number));
+		return m_handler.number(static_cast<const double&>(number));
+	}
+	default:
+		throw ParseError("Invalid value", reader.offset());
+	}
+}
+
+template <typename T>
+inline bool SaxParser<T>::parseObject(Reader &reader)
+{
+	if (reader.getValid() != '{')
+		throw ParseError("Expected object", reader.offset());
+	if (++m_depth > maxDepth)
+		throw ParseError("Maximum depth reached", reader.offset());
+	if (!m_handler.startObject())
+		return false;
+	if (reader.peekValid() == '}')
+	{
+		reader.skip();
+		m_depth--;
+		return m_handler.endObject();
+	}
+	while (true)
+	{
+		if (reader.peekValid() != '"')
+			throw ParseError("Expected name", reader.offset());
+		Action action = m_handler.key(parseString(reader));
+		if (reader.getValid() != ':')
+			throw ParseError("Expected ':'", reader.offset());
+		switch (action)
+		{
+		case Action::ePARSE:
+			if (!parseVariable(reader))
+				return false;
+			break;
+		case Action::eSKIP:
+			skipValue(reader);
+			break;
+		default:
+			return false;
+		}
+		switch (reader.getValid())
+		{
+		case '}':
+			m_depth--;
+			return m_handler.endObject();
+		case ',':
+			continue;
+		default:
+			throw ParseError("Expected ',' or '}'", reader.offset());
+		}
+	}
+}
+
+template <typename T>
+inline bool SaxParser<T>::parseArray(Reader &reader)
+{
+	if (reader.getValid() != '[')
+		throw ParseError("Expected array", reader.offset());
+	if (++m_depth > maxDepth)
+		throw ParseError("Maximum depth reached", reader.offset());
+	if (!m_handler.startArray())
+		return false;
+	if (reader.peekValid() == ']')
+	{
+		reader.skip();
+		m_depth--;
+		return m_handler.endArray();
+	}
+	while (true)
+	{
+		if (!parseVariable(reader))
+			return false;
+		switch (reader.getValid())
+		{
+		case ']':
+			m_depth--;
+			return m_handler.endArray();
+		case ',':
+			continue;
+		default:
+			throw ParseError("Expected ',' or ']'", reader.offset());
+		}
+	}
+}
+
+template <typename T>
+inline std::string_view SaxParser<T>::parseString(Reader &reader)
+{
+	return readString(reader, [this](size_t size) {
+		m_scratch.resize(size);
+		return &m_scratch[0];
+	});
+}
+
 }
 
 
 inline void testParse() {
-	std::string str;
+	std::string str = "{\"hash\": \"blablabla\", \"data\": {\"scene\": {}}}";
 	json::Parser parser;
 	const json::JSON j = parser(str);
 	const json::Object &obj = j;
@@ -583,43 +1645,160 @@ inline void testParse() {
 	const json::Object &obj2 = obj1["scene"];
 }
 
+// Return the parsing throughput in MB/s
+inline double benchmarkParse(const std::string &str, unsigned int iterations) {
+	json::Parser parser;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++)
+		json::JSON j = parser(str);
+	auto end = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	return (str.size() * static_cast<double>(iterations)) / (1024.0 * 1024.0) / seconds;
+}
+
+// Return the serialization throughput in MB/s, output is streamed into a reused string.
+inline double benchmarkSerialize(const json::JSON &json, unsigned int iterations) {
+	json::Serializer serializer;
+	std::string str;
+	size_t size = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		str.clear();
+		json::Writer writer(str);
+		serializer(json, writer);
+		writer.flush();
+		size += str.size();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	return size / (1024.0 * 1024.0) / seconds;
+}
+
+// Return the structural indexing throughput in GB/s
+inline double benchmarkStructuralIndex(const std::string &str, unsigned int iterations) {
+	std::vector<uint32_t> structurals;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++)
+		json::indexStructurals(str, structurals);
+	auto end = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+	return (str.size() * static_cast<double>(iterations)) / (1024.0 * 1024.0 * 1024.0) / seconds;
+}
+
+// Round trip tricky values & random bit patterns through the writer & the parser.
+inline void testNumbers(unsigned int count) {
+	auto equal = [](double a, double b) { return std::memcmp(&a, &b, sizeof(double)) == 0; };
+	auto read = [](std::string_view str) {
+		json::Reader reader(str);
+		json::Variable variable = json::readNumber(reader);
+		if (variable.isInteger())
+			throw std::runtime_error("Integer token");
+		return static_cast<double>(variable);
+	};
+	// Halfway cases, subnormals, extremes & long mantissas, checked against the CRT.
+	static const char *corpus[] = {
+		"0.1", "0.3", "1e23", "8.41e21", "9007199254740993.0", "9007199254740992.9999999999",
+		"2.2250738585072011e-308", "2.2250738585072014e-308", "4.9e-324", "2.4703282292062328e-324",
+		"2.4703282292062327e-324", "1.7976931348623157e308", "1.7976931348623158e308", "1e400", "1e-400",
+		"7.2057594037927933e16", "3.14159265358979323846264338327950288", "123456789012345678901234567890.0",
+		"0.000000000000000000000000000000000000000000001", "-0.0", "5e-324", "1.0e-5",
+		"4.4501477170144023e-308", "6.631236846766476e-316", "2.9802322387695312500000000000000001e-8",
+	};
+	for (const char *str : corpus)
+		if (!equal(read(str), std::strtod(str, nullptr)))
+			throw std::runtime_error(std::string("Number round trip mismatch: ") + str);
+	uint64_t state = 0x9E3779B97F4A7C15;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// xorshift64*
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		const uint64_t bits = state * 0x2545F4914F6CDD1D;
+		double value;
+		std::memcpy(&value, &bits, sizeof(double));
+		if (value != value || value - value != 0.0) // NaN & infinity
+			continue;
+		char buffer[32];
+		const char *end = json::writeDouble(value, buffer);
+		if (!equal(read(std::string_view(buffer, end - buffer)), value))
+			throw std::runtime_error("Number round trip mismatch: " + std::string(buffer, end - buffer));
+	}
+}
+
+// Millions of doubles parsed & written per second
+inline void benchmarkNumbers(unsigned int count, double &parsed, double &written) {
+	std::string str;
+	uint64_t state = 0x9E3779B97F4A7C15;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// Values in [-1000, 1000] like glTF positions & matrices.
+		state = state * 6364136223846793005 + 1442695040888963407;
+		const double value = (static_cast<double>(state >> 11) / 9007199254740992.0) * 2000.0 - 1000.0;
+		char buffer[32];
+		str.append(buffer, json::writeDouble(value, buffer));
+		str += ',';
+	}
+	double sum = 0.0;
+	auto start = std::chrono::high_resolution_clock::now();
+	json::Reader reader(str);
+	while (!reader.eof())
+	{
+		sum += static_cast<double>(json::readNumber(reader));
+		reader.skip();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	parsed = count / std::chrono::duration<double>(end - start).count() / 1e6;
+
+	char buffer[32];
+	size_t length = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+		length += json::writeDouble(sum + i * 0.001, buffer) - buffer;
+	end = std::chrono::high_resolution_clock::now();
+	written = count / std::chrono::duration<double>(end - start).count() / 1e6;
+	if (length == 0)
+		throw std::runtime_error("error");
+}
+
 inline void testSerialize() {
-	// TODO add initializer list
+	json::JSON j;
+	json::Arena &arena = j.arena();
+
 	json::Object cameraTransform;
-	cameraTransform.add("rotation", { 0.f, 0.f, 0.f, 1.f });
-	cameraTransform.add("position", { 5.f, 6.f, 7.f });
+	cameraTransform.add(arena, "rotation", json::Array(arena, { 0.f, 0.f, 0.f, 1.f }));
+	cameraTransform.add(arena, "position", json::Array(arena, { 5.f, 6.f, 7.f }));
 	json::Object camera;
-	camera.add("fov", 60.f);
-	camera.add("transform", cameraTransform);
+	camera.add(arena, "fov", 60.f);
+	camera.add(arena, "transform", cameraTransform);
 
 	json::Object sceneTransform;
-	sceneTransform.add("rotation", { 0.f, 0.f, 0.f, 1.f });
-	sceneTransform.add("position", { 0.f, 0.f, 0.f });
-	sceneTransform.add("scale", { 1.f, 1.f, 1.f });
+	sceneTransform.add(arena, "rotation", json::Array(arena, { 0.f, 0.f, 0.f, 1.f }));
+	sceneTransform.add(arena, "position", json::Array(arena, { 0.f, 0.f, 0.f }));
+	sceneTransform.add(arena, "scale", json::Array(arena, { 1.f, 1.f, 1.f }));
 	json::Object scene;
-	scene.add("transform", sceneTransform);
+	scene.add(arena, "transform", sceneTransform);
 
 	json::Object image;
-	image.add("width", 800);
-	image.add("height", 600);
+	image.add(arena, "width", 800);
+	image.add(arena, "height", 600);
 
 	json::Object data;
-	data.add("clay", false);
-	data.add("alpha", false);
-	data.add("tod", 12.f);
-	data.add("camera", camera);
-	data.add("scene", scene);
-	data.add("image", image);
+	data.add(arena, "clay", false);
+	data.add(arena, "alpha", false);
+	data.add(arena, "tod", 12.f);
+	data.add(arena, "camera", camera);
+	data.add(arena, "scene", scene);
+	data.add(arena, "image", image);
 
-
-	json::JSON j;
 	json::Object &command = j;
-	command.add("hash", "blablabla");
-	command.add("data", data);
-	command.add("nulltest", json::Variable());
+	command.add(arena, "hash", "blablabla");
+	command.add(arena, "data", data);
+	command.add(arena, "nulltest", json::Variable());
 
 	json::Serializer serializer;
 	std::string str = serializer(j);
 
 	int ss = 0;
-}
\ No newline at end of file
+}
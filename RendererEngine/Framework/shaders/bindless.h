@@ -0,0 +1,22 @@
+#ifndef _BINDLESS_H_
+#define _BINDLESS_H_
+
+// Arrays of the bindless table, mirror of vk::BindlessTable.
+// Index them with the handles of the stage, from push constants or buffers, through nonuniformEXT()
+// when a handle varies within a draw or a dispatch.
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define BINDLESS_SET 0
+
+layout(set = BINDLESS_SET, binding = 0) uniform sampler2D bindlessTextures[];
+
+// Storage images need a format, declare an array per format used:
+// BINDLESS_STORAGE_IMAGE(rgba8) bindlessImages[];
+#define BINDLESS_STORAGE_IMAGE(format) layout(set = BINDLESS_SET, binding = 1, format) uniform image2D
+
+// Storage buffers need a block, declare an array per block used:
+// BINDLESS_STORAGE_BUFFER Vertices { vec4 positions[]; } bindlessVertices[];
+#define BINDLESS_STORAGE_BUFFER layout(std430, set = BINDLESS_SET, binding = 2) buffer
+
+#endif
@@ -54,6 +54,12 @@ Application::Application() :
 	m_scene.camera.zFar = 1000.f;
 	m_scene.camera.dt = 1.f;
 	m_scene.sun.direction = geo::vec3f(0, 1, 0);
+	// Mountain peaks are at most 10 + sum of octave amplitudes, water plane is at 0.
+	m_scene.terrain.bounds = geo::aabbf(
+		geo::point3f(-1e6f, -10.f, -1e6f),
+		geo::point3f(1e6f, 10.f + 100.f + 50.f + 0.1f + 0.2f, 1e6f)
+	);
+	m_scene.settings.sampler = Sampler::SOBOL;
 
 	m_gui.setScene(&m_scene);
 	m_gui.create(m_context, m_window);
@@ -176,74 +182,10 @@ void Application::execute()
 
 			vk::CommandBuffer &cmdBuff = m_commandBuffers[frame.imageIndex()];
 			cmdBuff.begin();
-			m_compute.execute(frame.imageIndex, cmdBuff, m_context);
-
-			VkImageMemoryBarrier imageMemoryBarrier[2]{};
-			// barrier render target
-			imageMemoryBarrier[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			imageMemoryBarrier[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageMemoryBarrier[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier[0].image = m_compute.getImage();
-			imageMemoryBarrier[0].subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-			// barrier swapchain
-			imageMemoryBarrier[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier[1].srcAccessMask = 0;
-			imageMemoryBarrier[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier[1].oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-			imageMemoryBarrier[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier[1].image = m_context.getImage(frame.imageIndex);
-			imageMemoryBarrier[1].subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-			vkCmdPipelineBarrier(
-				cmdBuff(),
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				2, imageMemoryBarrier
-			);
-
-			VkImageCopy copyRegion{};
-			VkImageSubresourceLayers subResource{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
-			copyRegion.extent = VkExtent3D{ m_context.getWidth(), m_context.getHeight(), 1 };
-			copyRegion.srcSubresource = subResource;
-			copyRegion.dstSubresource = subResource;
-			vkCmdCopyImage(
-				cmdBuff(),
-				m_compute.getImage(),
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				m_context.getImage(frame.imageIndex),
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1, &copyRegion
-			);
-
-			// barrier swapchain
-			imageMemoryBarrier[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-			imageMemoryBarrier[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier[0].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-			imageMemoryBarrier[0].image = m_compute.getImage();
-			imageMemoryBarrier[0].subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-			vkCmdPipelineBarrier(
-				cmdBuff(),
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, imageMemoryBarrier
-			);
-
+			m_imageIndex = frame.imageIndex;
+			m_graph.setImage(m_graphCompute, m_compute.getImage(), m_compute.getImageView());
+			m_graph.setImage(m_graphSwapChain, m_context.getImage(frame.imageIndex), m_context.getImageView(frame.imageIndex));
+			m_graph.execute(cmdBuff());
 			cmdBuff.end();
 			submit(m_context.getLogicalDevice(), m_context.getGraphicQueue(), frame, cmdBuff);
 		}
@@ -265,6 +207,7 @@ void Application::createStages()
 	// Pass
 	m_compute.create(m_context);
 	m_compute.reset(m_context, m_scene);
+	createGraph();
 
 	// Clean
 	m_context.destroyShaders();
@@ -272,9 +215,45 @@ void Application::createStages()
 
 void Application::destroyStages()
 {
+	m_graph.destroy(m_context.getLogicalDevice());
 	m_compute.destroy(m_context);
 }
 
+void Application::createGraph()
+{
+	// The compute image accumulates samples between frames, it stays in general.
+	// The swap chain image is entirely overwritten by the copy, its content is discarded.
+	const vk::RenderGraph::ImageDesc desc{ m_context.getFormat(), m_context.getWidth(), m_context.getHeight(), 1, VK_IMAGE_ASPECT_COLOR_BIT };
+	m_graph = vk::RenderGraph();
+	m_graphCompute = m_graph.importImage("compute", desc, VK_IMAGE_LAYOUT_GENERAL, 0, VK_IMAGE_LAYOUT_GENERAL, true);
+	m_graphSwapChain = m_graph.importImage("swapchain", desc, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, true);
+
+	uint32_t procedural = m_graph.addPass("procedural", vk::RenderGraph::PassType::COMPUTE, vk::RenderGraph::Queue::GRAPHICS, [this](VkCommandBuffer, const vk::RenderGraph &) {
+		m_compute.execute(m_imageIndex, m_commandBuffers[m_imageIndex()], m_context);
+	});
+	m_graph.use(procedural, m_graphCompute, vk::RenderGraph::Usage::STORAGE_IMAGE_READ_WRITE);
+
+	uint32_t copy = m_graph.addPass("copy", vk::RenderGraph::PassType::TRANSFER, vk::RenderGraph::Queue::GRAPHICS, [this](VkCommandBuffer cmdBuff, const vk::RenderGraph &graph) {
+		VkImageCopy copyRegion{};
+		VkImageSubresourceLayers subResource{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.extent = VkExtent3D{ m_context.getWidth(), m_context.getHeight(), 1 };
+		copyRegion.srcSubresource = subResource;
+		copyRegion.dstSubresource = subResource;
+		vkCmdCopyImage(
+			cmdBuff,
+			graph.getImage(m_graphCompute),
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			graph.getImage(m_graphSwapChain),
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &copyRegion
+		);
+	});
+	m_graph.use(copy, m_graphCompute, vk::RenderGraph::Usage::TRANSFER_SRC);
+	m_graph.use(copy, m_graphSwapChain, vk::RenderGraph::Usage::TRANSFER_DST);
+
+	m_graph.create(m_context.getLogicalDevice(), m_context.getPhysicalDevice());
+}
+
 void Application::recreate()
 {
 	if (!buildShaders())
@@ -307,24 +286,15 @@ bool Application::buildShaders()
 void GUI::create(const vk::Context &context, const app::Window &window)
 {
 	{ // Custom descriptor pool for imgui
+		// The backend allocates a single set, for the font texture.
 		VkDescriptorPoolSize pool_sizes[] =
 		{
-			{ VK_DESCRIPTOR_TYPE_SAMPLER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 },
-			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000 }
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
 		};
 		VkDescriptorPoolCreateInfo pool_info = {};
 		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-		pool_info.maxSets = 1000 * IM_ARRAYSIZE(pool_sizes);
+		pool_info.maxSets = 1;
 		pool_info.poolSizeCount = (uint32_t)IM_ARRAYSIZE(pool_sizes);
 		pool_info.pPoolSizes = pool_sizes;
 		VK_CHECK_RESULT(vkCreateDescriptorPool(context.getLogicalDevice(), &pool_info, nullptr, &m_descriptorPool));
@@ -401,6 +371,13 @@ bool GUI::draw(const Stats &stats)
 		ImGui::Text("%.1f FPS", io.Framerate);
 		ImGui::Text("Samples : %u", stats.samples);
 		ImGui::Checkbox("Pause rendering", &m_pause);
+		const char *samplers[] = { "Random", "Sobol (Owen scrambled)", "R2 (blue noise)" };
+		int sampler = static_cast<int>(m_scene->settings.sampler);
+		if (ImGui::Combo("Sampler", &sampler, samplers, IM_ARRAYSIZE(samplers)))
+		{
+			m_scene->settings.sampler = static_cast<Sampler>(sampler);
+			updated = true;
+		}
 
 		if (ImGui::CollapsingHeader("Scene##header", ImGuiTreeNodeFlags_DefaultOpen))
 		{
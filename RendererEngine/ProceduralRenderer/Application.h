@@ -5,6 +5,7 @@
 #include "ProceduralCompute.h"
 #include "Geometry.h"
 #include "Scene.h"
+#include "../Framework/RenderGraph.h"
 
 namespace app {
 
@@ -46,11 +47,16 @@ public:
 	bool buildShaders();
 	void createStages();
 	void destroyStages();
+	void createGraph();
 private:
 	Window m_window;
 	vk::Context m_context;
 	ProceduralCompute m_compute;
 	std::vector<vk::CommandBuffer> m_commandBuffers;
+	vk::RenderGraph m_graph;
+	vk::RenderGraph::Resource m_graphCompute;
+	vk::RenderGraph::Resource m_graphSwapChain;
+	vk::ImageIndex m_imageIndex;	// Of the frame the graph executes
 	Scene m_scene;
 	GUI m_gui;
 };
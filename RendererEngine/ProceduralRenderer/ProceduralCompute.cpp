@@ -24,7 +24,7 @@ void ProceduralCompute::create(const vk::Context & context)
 	const uint32_t imageCount = context.getImageCount();
 
 	// --- Descriptor set layout
-	m_descriptorBindings.resize(2);
+	m_descriptorBindings.resize(3);
 
 	m_descriptorBindings[0].binding = 0;
 	m_descriptorBindings[0].descriptorCount = 1;
@@ -38,6 +38,11 @@ void ProceduralCompute::create(const vk::Context & context)
 	m_descriptorBindings[1].pImmutableSamplers = nullptr;
 	m_descriptorBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+	m_descriptorBindings[2].binding = 2;
+	m_descriptorBindings[2].descriptorCount = 1;
+	m_descriptorBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	m_descriptorBindings[2].pImmutableSamplers = nullptr;
+	m_descriptorBindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -177,10 +182,143 @@ void ProceduralCompute::create(const vk::Context & context)
 	viewInfo.subresourceRange.layerCount = 1;
 
 	VK_CHECK_RESULT(vkCreateImageView(context.getLogicalDevice(), &viewInfo, nullptr, &m_imageView));
+
+	// Accumulated between frames in general, the layout the render graph expects it in.
+	VkCommandBuffer cmdBuff = context.createSingleTimeCommand();
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.image = m_image;
+	barrier.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdPipelineBarrier(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	context.endSingleTimeCommand(cmdBuff);
+
+	createBlueNoise(context);
+}
+
+void ProceduralCompute::createBlueNoise(const vk::Context &context)
+{
+	// Generating the tile is slow, only do it once.
+	if (m_blueNoise.empty())
+	{
+		m_blueNoise.resize(blueNoiseSize * blueNoiseSize);
+		geo::sample::blueNoise(blueNoiseSize, m_blueNoise.data());
+	}
+	const VkDeviceSize size = m_blueNoise.size() * sizeof(float);
+
+	// --- Staging buffer
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VK_CHECK_RESULT(vkCreateBuffer(context.getLogicalDevice(), &bufferInfo, nullptr, &stagingBuffer));
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(context.getLogicalDevice(), stagingBuffer, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(context.getPhysicalDevice(), memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	VK_CHECK_RESULT(vkAllocateMemory(context.getLogicalDevice(), &allocInfo, nullptr, &stagingBufferMemory));
+	VK_CHECK_RESULT(vkBindBufferMemory(context.getLogicalDevice(), stagingBuffer, stagingBufferMemory, 0));
+
+	void* data;
+	VK_CHECK_RESULT(vkMapMemory(context.getLogicalDevice(), stagingBufferMemory, 0, size, 0, &data));
+	memcpy(data, m_blueNoise.data(), static_cast<size_t>(size));
+	vkUnmapMemory(context.getLogicalDevice(), stagingBufferMemory);
+
+	// --- Image
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = blueNoiseSize;
+	imageInfo.extent.height = blueNoiseSize;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VK_CHECK_RESULT(vkCreateImage(context.getLogicalDevice(), &imageInfo, nullptr, &m_blueNoiseImage));
+
+	VkMemoryRequirements imageMemRequirements;
+	vkGetImageMemoryRequirements(context.getLogicalDevice(), m_blueNoiseImage, &imageMemRequirements);
+
+	VkMemoryAllocateInfo imageAllocInfo = {};
+	imageAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	imageAllocInfo.allocationSize = imageMemRequirements.size;
+	imageAllocInfo.memoryTypeIndex = findMemoryType(context.getPhysicalDevice(), imageMemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VK_CHECK_RESULT(vkAllocateMemory(context.getLogicalDevice(), &imageAllocInfo, nullptr, &m_blueNoiseImageMemory));
+	VK_CHECK_RESULT(vkBindImageMemory(context.getLogicalDevice(), m_blueNoiseImage, m_blueNoiseImageMemory, 0));
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = m_blueNoiseImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	VK_CHECK_RESULT(vkCreateImageView(context.getLogicalDevice(), &viewInfo, nullptr, &m_blueNoiseImageView));
+
+	// --- Upload
+	VkCommandBuffer cmdBuff = context.createSingleTimeCommand();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.image = m_blueNoiseImage;
+	barrier.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdPipelineBarrier(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = VkExtent3D{ blueNoiseSize, blueNoiseSize, 1 };
+	vkCmdCopyBufferToImage(cmdBuff, stagingBuffer, m_blueNoiseImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	vkCmdPipelineBarrier(cmdBuff, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	context.endSingleTimeCommand(cmdBuff);
+
+	vkDestroyBuffer(context.getLogicalDevice(), stagingBuffer, nullptr);
+	vkFreeMemory(context.getLogicalDevice(), stagingBufferMemory, nullptr);
+}
+
+void ProceduralCompute::destroyBlueNoise(const vk::Context &context)
+{
+	vkDestroyImageView(context.getLogicalDevice(), m_blueNoiseImageView, nullptr);
+	vkDestroyImage(context.getLogicalDevice(), m_blueNoiseImage, nullptr);
+	vkFreeMemory(context.getLogicalDevice(), m_blueNoiseImageMemory, nullptr);
 }
 
 void ProceduralCompute::destroy(const vk::Context &context)
 {
+	destroyBlueNoise(context);
 	for (size_t i = 0; i < m_uniformBuffers.size(); i++)
 	{
 		vkDestroyBuffer(context.getLogicalDevice(), m_uniformBuffers[i], nullptr);
@@ -214,6 +352,7 @@ void ProceduralCompute::reset(const vk::Context & context, const Scene & scene)
 {
 	// Reset variables
 	m_samples = 0;
+	m_pushc.sampler = static_cast<uint32_t>(scene.settings.sampler);
 
 	// --- Descriptor set
 	for (uint32_t i = 0; i < context.getImageCount(); i++)
@@ -227,6 +366,11 @@ void ProceduralCompute::reset(const vk::Context & context, const Scene & scene)
 		VkDescriptorBufferInfo descriptorCameraInfo{};
 		descriptorCameraInfo.buffer = m_uniformBuffers[i];
 		descriptorCameraInfo.range = sizeof(UniformBufferObject);
+		// Blue noise
+		VkDescriptorImageInfo descriptorBlueNoiseInfo{};
+		descriptorBlueNoiseInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		descriptorBlueNoiseInfo.imageView = m_blueNoiseImageView;
+		descriptorBlueNoiseInfo.sampler = nullptr;
 
 		std::vector<VkWriteDescriptorSet> descriptorWrites(m_descriptorBindings.size());
 		for (size_t iBinding = 0; iBinding < m_descriptorBindings.size(); iBinding++)
@@ -240,6 +384,7 @@ void ProceduralCompute::reset(const vk::Context & context, const Scene & scene)
 		}
 		descriptorWrites[0].pImageInfo = &descriptorInputImageInfo;
 		descriptorWrites[1].pBufferInfo = &descriptorCameraInfo;
+		descriptorWrites[2].pImageInfo = &descriptorBlueNoiseInfo;
 		vkUpdateDescriptorSets(context.getLogicalDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
 }
@@ -258,6 +403,8 @@ void ProceduralCompute::update(const vk::ImageIndex &imageIndex, const vk::Conte
 	ubo.zNear = scene.camera.zNear;
 	ubo.zFar = scene.camera.zFar;
 	ubo.dt = scene.camera.dt;
+	ubo.boundsMin = geo::vec3f(scene.terrain.bounds.min);
+	ubo.boundsMax = geo::vec3f(scene.terrain.bounds.max);
 
 	void* data;
 	VK_CHECK_RESULT(vkMapMemory(context.getLogicalDevice(), m_uniformBuffersMemory[imageIndex()], 0, sizeof(UniformBufferObject), 0, &data));
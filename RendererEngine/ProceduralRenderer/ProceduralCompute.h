@@ -26,7 +26,11 @@ public:
 	uint32_t getSampleCount() const { return m_samples; }
 
 	VkImage getImage() { return m_image; }
+	VkImageView getImageView() { return m_imageView; }
 
+private:
+	void createBlueNoise(const vk::Context &context);
+	void destroyBlueNoise(const vk::Context &context);
 private:
 	struct alignas(16) PushConstant
 	{
@@ -34,6 +38,7 @@ private:
 		uint32_t width;
 		uint32_t height;
 		float time;
+		uint32_t sampler;
 	} m_pushc;
 
 	struct UniformBufferObject
@@ -47,6 +52,8 @@ private:
 		float zNear;
 		float zFar;
 		float dt;
+		alignas(16) geo::vec3f boundsMin;
+		alignas(16) geo::vec3f boundsMax;
 	};
 
 	uint32_t m_samples;
@@ -65,6 +72,12 @@ private:
 	VkImage m_image;
 	VkImageView m_imageView;
 	VkDeviceMemory m_imageMemory;
+
+	static constexpr uint32_t blueNoiseSize = 64;
+	std::vector<float> m_blueNoise; // Generated once, reused on recreate
+	VkImage m_blueNoiseImage;
+	VkImageView m_blueNoiseImageView;
+	VkDeviceMemory m_blueNoiseImageMemory;
 };
 
 }
\ No newline at end of file
@@ -15,9 +15,27 @@ struct Sun {
 	geo::vec3f direction;
 };
 
+// Sequence used to jitter samples inside a pixel. Must match procedural.comp
+enum class Sampler : uint32_t {
+	RANDOM,
+	SOBOL,
+	R2_BLUE_NOISE,
+};
+
+// Conservative bounds of the SDF scene. Rays missing them are not marched.
+struct Terrain {
+	geo::aabbf bounds;
+};
+
+struct Settings {
+	Sampler sampler;
+};
+
 struct Scene {
 	Camera camera;
 	Sun sun;
+	Terrain terrain;
+	Settings settings;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef _SAMPLING_H_
+#define _SAMPLING_H_
+
+// Low discrepancy sequences. Mirror of Engine/math/sequence.inl
+
+uint reverseBits(uint value)
+{
+	return bitfieldReverse(value);
+}
+
+uint hash(uint value)
+{
+	// PCG hash
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+uint hashCombine(uint seed, uint value)
+{
+	return seed ^ (value + (seed << 6) + (seed >> 2));
+}
+
+uint laineKarrasPermutation(uint value, uint seed)
+{
+	value += seed;
+	value ^= value * 0x6c50b47cu;
+	value ^= value * 0xb82f1e52u;
+	value ^= value * 0xc7afe638u;
+	value ^= value * 0x8d22f6e6u;
+	return value;
+}
+
+uint nestedUniformScramble(uint value, uint seed)
+{
+	return reverseBits(laineKarrasPermutation(reverseBits(value), seed));
+}
+
+uint sobol0(uint index)
+{
+	return reverseBits(index);
+}
+
+uint sobol1(uint index)
+{
+	uint result = 0;
+	for (uint v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		if ((index & 1u) != 0)
+			result ^= v;
+	return result;
+}
+
+float toUnit(uint value)
+{
+	return float(value >> 8) / float(1u << 24);
+}
+
+vec2 sobol(uint index)
+{
+	return vec2(toUnit(sobol0(index)), toUnit(sobol1(index)));
+}
+
+// Owen scrambled Sobol, from "Practical Hash-based Owen Scrambling", Brent Burley
+vec2 sobolOwen(uint index, uint seed)
+{
+	index = nestedUniformScramble(index, seed);
+	return vec2(
+		toUnit(nestedUniformScramble(sobol0(index), hashCombine(seed, 0u))),
+		toUnit(nestedUniformScramble(sobol1(index), hashCombine(seed, 1u)))
+	);
+}
+
+// R2 sequence, from "The Unreasonable Effectiveness of Quasirandom Sequences", Martin Roberts
+vec2 r2(uint index)
+{
+	const uint alpha0 = 3242174889u; // 1 / g * 2^32
+	const uint alpha1 = 2447445414u; // 1 / g^2 * 2^32
+	return vec2(
+		toUnit(0x80000000u + alpha0 * index),
+		toUnit(0x80000000u + alpha1 * index)
+	);
+}
+
+// Blue noise tile lookup, must be included after the blueNoise image declaration.
+// Second dimension is read with a half tile offset to stay decorrelated.
+vec2 blueNoise2D(ivec2 pixel)
+{
+	const ivec2 size = imageSize(blueNoise);
+	return vec2(
+		imageLoad(blueNoise, pixel % size).r,
+		imageLoad(blueNoise, (pixel + size / 2) % size).r
+	);
+}
+
+#endif